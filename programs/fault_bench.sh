@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Runs the storage benchmark under each fault profile and collects the
+# numbers in logs/fault_bench_<date>.txt, so a change to the capture or
+# render path can be compared against the last run on the worst-case card.
+#
+# Build first with: make storage-bench
+# Usage: ./programs/fault_bench.sh [frames] [interval_ms]
+
+PROJECT_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+BENCH="${PROJECT_DIR}/programs/timelapse_storage_bench"
+SHIM="${PROJECT_DIR}/programs/libfaultshim.so"
+FRAMES="${1:-100}"
+INTERVAL_MS="${2:-200}"
+WORK_DIR="/tmp/timelapse_fault_bench"
+REPORT="${PROJECT_DIR}/logs/fault_bench_$(date +%Y%m%d_%H%M%S).txt"
+
+if [ ! -x "${BENCH}" ] || [ ! -f "${SHIM}" ]; then
+    echo "Missing ${BENCH} or ${SHIM} - run 'make storage-bench' first"
+    exit 1
+fi
+
+# name|fault settings (see src/fault_shim.cpp)
+PROFILES=(
+    "baseline|"
+    "slow|FAULT_LATENCY_MS=5 FAULT_FSYNC_MS=50"
+    "throttled|FAULT_THROUGHPUT_KBPS=4096"
+    "stalls|FAULT_STALL_EVERY=40 FAULT_STALL_MS=1500"
+    "enospc|FAULT_ENOSPC_AFTER_MB=20"
+    "eio|FAULT_EIO_RATE=0.01 FAULT_SEED=7"
+)
+
+mkdir -p "${PROJECT_DIR}/logs"
+{
+    echo "# fault bench $(date '+%Y-%m-%d %H:%M:%S') on $(hostname), ${FRAMES} frames every ${INTERVAL_MS} ms"
+    for profile in "${PROFILES[@]}"; do
+        name="${profile%%|*}"
+        settings="${profile#*|}"
+        dir="${WORK_DIR}/${name}"
+        rm -rf "${dir}"
+        mkdir -p "${dir}"
+
+        echo
+        echo "[${name}] ${settings}"
+        # Only the bench directory is faulted; the render pass reads the frames
+        # through the same shim
+        env ${settings} FAULT_PATH_PREFIX="${dir}/" LD_PRELOAD="${SHIM}" \
+            "${BENCH}" --dir "${dir}" --frames "${FRAMES}" --interval-ms "${INTERVAL_MS}" --durable
+        echo "exit_code=$?"
+    done
+} | tee "${REPORT}"
+
+rm -rf "${WORK_DIR}"
+echo
+echo "Report saved to ${REPORT}"
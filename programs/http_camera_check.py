@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+Checks the HTTP snapshot backend (network_camera.cpp) against a local
+stand-in camera instead of a real one.
+
+Zero external dependencies - uses only Python stdlib.
+
+Serves a small JPEG on 127.0.0.1 in several ways and runs
+timelapse_camera_check (make camera-check) against each:
+
+  length   Content-Length body on a keep-alive connection (one connection)
+  chunked  Transfer-Encoding: chunked, with a chunk extension (one connection)
+  close    no length, body ends when the server closes (one per frame)
+  drop     keep-alive promised, then the server drops the connection, so
+           every capture after the first needs the reconnect retry
+  badchunk a chunk size line that isn't hex: every capture must fail with
+           "bad chunk size line" and leave no file behind
+
+Usage: ./programs/http_camera_check.py [--frames N] [--jpeg PATH]
+"""
+
+import argparse
+import base64
+import os
+import shutil
+import subprocess
+import sys
+import threading
+from http.server import ThreadingHTTPServer, BaseHTTPRequestHandler
+from pathlib import Path
+
+# --- Project Path Setup ---
+SCRIPT_PATH = Path(__file__).resolve().parent
+CHECK_BINARY = SCRIPT_PATH / "timelapse_camera_check"
+WORK_DIR = "/tmp/timelapse_http_check"
+
+# 64x48 test image, so no camera or image library is needed
+TEST_JPEG = base64.b64decode(
+    "/9j/4AAQSkZJRgABAQAAAQABAAD/2wBDABALDA4MChAODQ4SERATGCgaGBYWGDEjJR0oOjM9"
+    "PDkzODdASFxOQERXRTc4UG1RV19iZ2hnPk1xeXBkeFxlZ2P/2wBDARESEhgVGC8aGi9jQjhC"
+    "Y2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2NjY2P/wAAR"
+    "CAAwAEADASIAAhEBAxEB/8QAFgABAQEAAAAAAAAAAAAAAAAAAwUG/8QAFhAAAwAAAAAAAAAA"
+    "AAAAAAAAAAID/8QAGAEBAQEBAQAAAAAAAAAAAAAAAwQCBgX/xAAXEQADAQAAAAAAAAAAAAAA"
+    "AAAAAQMC/9oADAMBAAIRAxEAPwDHLMRZjrMVZnrPYU6ALMVZjrMVZhPZfOgCzEWY6zFWYT2X"
+    "zoAsxVmOsxVmE9l86ElZirMdZirM09nBToAsxFmOsxVmE9l86ALMVZjrMVZhPZfOgCzFWYyz"
+    "FWYT2XzoSVmKsx1mKszb2cFOgCzFWY6zFWYT2XzoAsxFmOsxVmE9l86ALMVZjrMVZhPZfOh/"
+    "/9k="
+)
+TEST_WIDTH = 64
+TEST_HEIGHT = 48
+
+CHUNK_SIZE = 100
+
+# mode -> (capture must fail, expected connections: "one", "per_frame" or None)
+MODES = {
+    "length": (False, "one"),
+    "chunked": (False, "one"),
+    "close": (False, "per_frame"),
+    "drop": (False, "per_frame"),
+    "badchunk": (True, None),
+}
+
+
+class StandInCamera(BaseHTTPRequestHandler):
+    """Snapshot server; the request path picks the mode."""
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True
+    body = TEST_JPEG
+    connections = 0
+    lock = threading.Lock()
+
+    def setup(self):
+        super().setup()
+        with StandInCamera.lock:
+            StandInCamera.connections += 1
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_GET(self):
+        mode = self.path.strip("/")
+        if mode not in MODES:
+            self.send_error(404)
+            return
+
+        self.send_response(200)
+        self.send_header("Content-Type", "image/jpeg")
+
+        if mode in ("length", "drop"):
+            self.send_header("Content-Length", str(len(self.body)))
+            self.send_header("Connection", "keep-alive")
+            self.end_headers()
+            self.wfile.write(self.body)
+            # drop: close anyway, like a camera timing out an idle connection
+            self.close_connection = mode == "drop"
+        elif mode == "close":
+            self.send_header("Connection", "close")
+            self.end_headers()
+            self.wfile.write(self.body)
+        else:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(0, len(self.body), CHUNK_SIZE):
+                chunk = self.body[i:i + CHUNK_SIZE]
+                if mode == "badchunk" and i > 0:
+                    # Read as size 0 plus an empty trailer, this would end
+                    # the body cleanly and save a truncated JPEG
+                    self.wfile.write(b"zz\r\n\r\n")
+                    break
+                extension = b";part=1" if i == 0 else b""
+                self.wfile.write(b"%x%s\r\n%s\r\n" % (len(chunk), extension, chunk))
+            else:
+                self.wfile.write(b"0\r\n\r\n")
+        self.wfile.flush()
+
+
+def run_mode(port, mode, frames, sized):
+    """Runs the check binary against one mode; returns (passed, report lines)."""
+    must_fail, connections = MODES[mode]
+    StandInCamera.connections = 0
+
+    cmd = [str(CHECK_BINARY), "--backend", "http", "--url", f"http://127.0.0.1:{port}/{mode}",
+           "--frames", str(frames), "--interval-ms", "20", "--dir", f"{WORK_DIR}/{mode}"]
+    if sized:
+        cmd += ["--width", str(TEST_WIDTH), "--height", str(TEST_HEIGHT)]
+    if must_fail:
+        cmd.append("--expect-fail")
+    result = subprocess.run(cmd, capture_output=True, text=True, timeout=120)
+
+    report = result.stdout.splitlines()
+    report.append(f"connections={StandInCamera.connections}")
+    passed = result.returncode == 0
+
+    if must_fail and "bad chunk size line" not in result.stderr:
+        report.append("error: captures did not fail on the chunk size line")
+        passed = False
+    if connections == "one" and StandInCamera.connections != 1:
+        report.append("error: keep-alive connection was not reused")
+        passed = False
+    if connections == "per_frame" and StandInCamera.connections != frames:
+        report.append(f"error: expected {frames} connections")
+        passed = False
+    if not passed and result.stderr:
+        report += ["stderr: " + line for line in result.stderr.splitlines()[-5:]]
+    return passed, report
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the HTTP camera backend against a local stand-in")
+    parser.add_argument("--frames", type=int, default=10)
+    parser.add_argument("--jpeg", help="serve this JPEG instead of the built-in test image")
+    args = parser.parse_args()
+
+    if not CHECK_BINARY.exists():
+        print(f"Missing {CHECK_BINARY} - run 'make camera-check' first")
+        return 1
+    if args.jpeg:
+        StandInCamera.body = Path(args.jpeg).read_bytes()
+
+    server = ThreadingHTTPServer(("127.0.0.1", 0), StandInCamera)
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    port = server.server_address[1]
+
+    os.makedirs(WORK_DIR, exist_ok=True)
+    failed = False
+    for mode in MODES:
+        passed, report = run_mode(port, mode, args.frames, not args.jpeg)
+        print(f"\n[{mode}]")
+        for line in report:
+            print(line)
+        failed = failed or not passed
+
+    server.shutdown()
+    shutil.rmtree(WORK_DIR, ignore_errors=True)
+    print("\nHTTP check " + ("FAILED" if failed else "passed"))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
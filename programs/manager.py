@@ -112,7 +112,8 @@ class TimeLapseManager:
         destination = f"rsync://{nas_host}/{nas_module}/{self.device_id}/{remote_folder_name}/"
         
         # Simple rsync command - no authentication needed
-        rsync_cmd = ['rsync', '-avh', f"{str(source_dir)}/", destination]
+        # Parity (see "timelapse parity") only matters on the card
+        rsync_cmd = ['rsync', '-avh', '--exclude=parity/', f"{str(source_dir)}/", destination]
         
         logging.info(f"Starting photo backup: {source_dir.name} -> {destination}")
         
@@ -127,7 +128,34 @@ class TimeLapseManager:
             logging.error(f"Backup error: {str(e)}", exc_info=True)
             return False
 
-        
+
+    def stream_day_to_nas(self, photo_dir, video_file):
+        """
+        Backup photo directory and video to NAS as one tar stream
+        ("timelapse send-day" -> "timelapse receive" on the NAS).
+        One connection instead of a round trip per file.
+        """
+        if not self.config.getboolean('BACKUP', 'backup_enabled', fallback=False):
+            logging.warning("Backup disabled in configuration. Skipping stream backup.")
+            return False
+
+        send_cmd = [str(SCRIPT_PATH / "timelapse"), 'send-day', str(photo_dir)]
+        if video_file.exists():
+            send_cmd += ['--video', str(video_file)]
+
+        logging.info(f"Starting stream backup: {photo_dir.name} (+ video: {video_file.exists()})")
+
+        try:
+            subprocess.run(send_cmd, check=True, capture_output=True, text=True, cwd=PROJECT_ROOT)
+            logging.info("Stream backup completed and verified by the receiver")
+            return True
+        except subprocess.CalledProcessError as e:
+            logging.error(f"Stream backup failed (Code {e.returncode}). Output: {(e.stdout + e.stderr).strip()}")
+            return False
+        except Exception as e:
+            logging.error(f"Stream backup error: {str(e)}", exc_info=True)
+            return False
+
     def cleanup_old_files(self):
         """Clean up old backed-up photos and videos based on retention policy.
 
@@ -270,36 +298,61 @@ class TimeLapseManager:
             logging.error(f"YouTube upload failed: {e}", exc_info=True)
             return None
     
-    def process_completed_timelapse(self, date_str):
-        """Process a completed timelapse: backup, upload, cleanup"""
-        logging.info(f"Starting process for timelapse date {date_str} (Device: {self.device_id})")
-        
+    def _find_day(self, date_str):
+        """Returns (clean_date, photo_dir or None, video_file) for a YYYY-MM-DD date."""
         clean_date = date_str.replace('-', '')
-        
-        schedule_data = self._load_schedule_metadata(clean_date)
-        
+
         photo_dir = None
         for item_path in PICS_DIR.iterdir():
             if item_path.is_dir() and item_path.name.startswith(f'{clean_date}_{self.device_id}_pics'):
                 photo_dir = item_path
                 break
-        
-        if not photo_dir:
-            logging.warning(f"No photo directory found for {date_str}. Aborting processing.")
-            return
 
         video_file = VIDEOS_DIR / f'{clean_date}_{self.device_id}_timelapse.mp4'
-        
+        return clean_date, photo_dir, video_file
+
+    def backup_day(self, date_str):
+        """Step 1: back up the day's photos and video to the NAS. Returns True on success."""
+        clean_date, photo_dir, video_file = self._find_day(date_str)
+        delete_after_backup = self.config.getboolean('BACKUP', 'delete_after_backup', fallback=False)
+
+        # A retry (e.g. after the video step failed) must not redo or fail on
+        # what's already done: the photos are backed up if their marker is
+        # there, or if delete_after_backup already removed them.
+        photos_done = False
+        if not photo_dir:
+            if not delete_after_backup:
+                logging.warning(f"No photo directory found for {date_str}. Aborting processing.")
+                return False
+            logging.info(f"No photo directory for {date_str}, already backed up and deleted.")
+            photos_done = True
+        elif (photo_dir / ".backed_up").exists():
+            logging.info(f"Photos already backed up: {photo_dir}")
+            photos_done = True
+
         # Photo Folder: YYYYMMDD-[Device_ID]-timelaps_pics
         nas_photo_folder_name = f"{clean_date}_{self.device_id}_pics"
         
         # Video File: YYYYMMDD-[Device_ID]-timelapse.mp4
         nas_video_file_name = f"{clean_date}_{self.device_id}_timelapse.mp4"
         
-        # Step 1: Backup to NAS (Photos)
-        is_backup_success = self.rsync_to_nas(photo_dir, nas_photo_folder_name)
-        
-        if is_backup_success:
+        # Step 1: Backup to NAS (Photos; "stream" sends the video in the same stream)
+        streamed = self.config.get('BACKUP', 'backup_method', fallback='rsync') == 'stream'
+        video_marker_path = VIDEOS_DIR / f"{video_file.name}.backed_up"
+        if photos_done:
+            # The stream sends photos and video together; only rsync can
+            # still send the video on its own below
+            if streamed and video_file.exists() and not video_marker_path.exists():
+                streamed = False
+        else:
+            if streamed:
+                is_backup_success = self.stream_day_to_nas(photo_dir, video_file)
+            else:
+                is_backup_success = self.rsync_to_nas(photo_dir, nas_photo_folder_name)
+
+            if not is_backup_success:
+                return False
+
             # Create backup marker for disk_cleanup.py to know this folder is safe to delete
             marker_path = photo_dir / ".backed_up"
             try:
@@ -308,47 +361,84 @@ class TimeLapseManager:
             except OSError as e:
                 logging.error(f"Failed to create backup marker: {e}")
 
-            # Step 1b: Optional immediate deletion of photos
-            if self.config.getboolean('BACKUP', 'delete_after_backup', fallback=False):
-                try:
-                    shutil.rmtree(photo_dir)
-                    logging.info(f"Photo directory deleted after successful backup: {photo_dir}")
-                except OSError as e:
-                    logging.error(f"Failed to delete photo directory after backup: {e}")
+        # Step 1b: Optional immediate deletion of photos
+        if delete_after_backup and photo_dir and photo_dir.exists():
+            try:
+                shutil.rmtree(photo_dir)
+                logging.info(f"Photo directory deleted after successful backup: {photo_dir}")
+            except OSError as e:
+                logging.error(f"Failed to delete photo directory after backup: {e}")
+        
+        # Step 1c: Backup the Video File
+        if video_marker_path.exists():
+            logging.info(f"Video already backed up: {video_file.name}")
+        elif streamed and video_file.exists():
+            try:
+                video_marker_path.touch()
+                logging.info(f"Created video backup marker: {video_marker_path}")
+            except OSError as e:
+                logging.error(f"Failed to create video backup marker: {e}")
+        elif video_file.exists() and self.config.getboolean('BACKUP', 'backup_enabled', fallback=False):
+            nas_host = self.config.get('BACKUP', 'nas_host', fallback='localhost')
+            nas_module = self.config.get('BACKUP', 'nas_module', fallback='timelapse')
+
+            # Build rsync daemon URL for the video file
+            video_destination = f"rsync://{nas_host}/{nas_module}/{self.device_id}/{nas_video_file_name}"
+            
+            # Simple rsync command - no authentication needed
+            video_backup_cmd = ['rsync', '-avh', str(video_file), video_destination]
             
-    # Step 1c: Backup the Video File
-            if video_file.exists() and self.config.getboolean('BACKUP', 'backup_enabled', fallback=False):
-                nas_host = self.config.get('BACKUP', 'nas_host', fallback='localhost')
-                nas_module = self.config.get('BACKUP', 'nas_module', fallback='timelapse')
-
-                # Build rsync daemon URL for the video file
-                video_destination = f"rsync://{nas_host}/{nas_module}/{self.device_id}/{nas_video_file_name}"
-                
-                # Simple rsync command - no authentication needed
-                video_backup_cmd = ['rsync', '-avh', str(video_file), video_destination]
-                
-                logging.info(f"Starting video backup: {video_file.name} -> {video_destination}")
-                
+            logging.info(f"Starting video backup: {video_file.name} -> {video_destination}")
+            
+            try:
+                subprocess.run(video_backup_cmd, check=True, capture_output=True, text=True)
+                logging.info("Video backed up successfully")
+                # Create backup marker for disk_cleanup.py
                 try:
-                    subprocess.run(video_backup_cmd, check=True, capture_output=True, text=True)
-                    logging.info("Video backed up successfully")
-                    # Create backup marker for disk_cleanup.py
-                    video_marker_path = VIDEOS_DIR / f"{video_file.name}.backed_up"
-                    try:
-                        video_marker_path.touch()
-                        logging.info(f"Created video backup marker: {video_marker_path}")
-                    except OSError as e:
-                        logging.error(f"Failed to create video backup marker: {e}")
-                except subprocess.CalledProcessError as e:
-                    logging.error(f"Video backup failed (Code {e.returncode}). Stderr: {e.stderr.strip()}")
-                except Exception as e:
-                    logging.error(f"Video backup error: {str(e)}", exc_info=True)
-            else:
-                logging.warning("Video file not found or backup is disabled, skipping video backup.")
+                    video_marker_path.touch()
+                    logging.info(f"Created video backup marker: {video_marker_path}")
+                except OSError as e:
+                    logging.error(f"Failed to create video backup marker: {e}")
+            except subprocess.CalledProcessError as e:
+                logging.error(f"Video backup failed (Code {e.returncode}). Stderr: {e.stderr.strip()}")
+                return False
+            except Exception as e:
+                logging.error(f"Video backup error: {str(e)}", exc_info=True)
+                return False
+        else:
+            logging.warning("Video file not found or backup is disabled, skipping video backup.")
+
+        return True
+
+    def upload_day(self, date_str):
+        """Step 2: upload the day's video to YouTube. Returns True if uploaded or nothing to do."""
+        clean_date, _, video_file = self._find_day(date_str)
+
+        if not video_file.exists():
+            logging.warning(f"No video found for {date_str}, skipping upload.")
+            return True
+
+        if not self.config.getboolean('YOUTUBE', 'upload_enabled', fallback=False):
+            logging.info("YouTube upload disabled in config.")
+            return True
+
+        schedule_data = self._load_schedule_metadata(clean_date)
+        return self.upload_to_youtube(video_file, schedule_data) is not None
+
+    def process_completed_timelapse(self, date_str):
+        """Process a completed timelapse: backup, upload, cleanup"""
+        logging.info(f"Starting process for timelapse date {date_str} (Device: {self.device_id})")
+        
+        _, photo_dir, _ = self._find_day(date_str)
+        if not photo_dir:
+            logging.warning(f"No photo directory found for {date_str}. Aborting processing.")
+            return
+
+        # Step 1: Backup to NAS
+        self.backup_day(date_str)
 
         # Step 2: Upload to YouTube
-        if video_file.exists():
-            self.upload_to_youtube(video_file, schedule_data)
+        self.upload_day(date_str)
 
         # Step 3: Cleanup old files
         self.cleanup_old_files()
@@ -361,15 +451,33 @@ def main():
     
     try:
         manager = TimeLapseManager()
+
+        # Usage: manager.py [--step backup|upload|cleanup] [YYYY-MM-DD]
+        # --step runs a single step and exits non-zero on failure, so the
+        # C++ job graph can retry it. Without it, all steps run (cron mode).
+        args = sys.argv[1:]
+        step = None
+        if len(args) >= 2 and args[0] == '--step':
+            step = args[1]
+            args = args[2:]
         
-        if len(sys.argv) > 1:
-            date_str = sys.argv[1]
+        if args:
+            date_str = args[0]
         else:
             yesterday = datetime.now() - timedelta(days=1)
             date_str = yesterday.strftime('%Y-%m-%d')
 
-        # load config file?    
-        manager.process_completed_timelapse(date_str)
+        if step is None:
+            manager.process_completed_timelapse(date_str)
+        elif step == 'backup':
+            sys.exit(0 if manager.backup_day(date_str) else 1)
+        elif step == 'upload':
+            sys.exit(0 if manager.upload_day(date_str) else 1)
+        elif step == 'cleanup':
+            manager.cleanup_old_files()
+        else:
+            logging.critical(f"Unknown step: {step}")
+            sys.exit(2)
         
     except configparser.Error as e:
         logging.critical(f"A configuration file error occurred: {e}", exc_info=True)
@@ -176,10 +176,74 @@ def collect_metrics(device_id):
         gauge("timelapse_status_file_updated_at", status.get("updated_at", 0),
               "Unix timestamp when the status file was last updated")
 
+        # --- Job graph states (only present when job_graph_enabled) ---
+        job_state_map = {"pending": 0, "running": 1, "done": 2, "failed": 3, "skipped": 4}
+        for job, state in status.get("jobs", {}).items():
+            gauge("timelapse_job_state", job_state_map.get(state, -1),
+                  "Job graph state (0=pending, 1=running, 2=done, 3=failed, 4=skipped)",
+                  labels={"job": job})
+
         if status.get("expected_photos", 0) > 0:
             progress = (status.get("photos_captured", 0) / status["expected_photos"]) * 100
             gauge("timelapse_capture_progress_percent", f"{progress:.1f}",
                   "Capture progress as percentage")
+
+        if "capture_latency_baseline_ms" in status:
+            gauge("timelapse_capture_latency_ewma_ms", status["capture_latency_ewma_ms"],
+                  "Recent capture latency (fast moving average)")
+            gauge("timelapse_capture_latency_baseline_ms", status["capture_latency_baseline_ms"],
+                  "Learnt normal capture latency")
+            gauge("timelapse_capture_latency_cusum", status.get("capture_latency_cusum", 0),
+                  "CUSUM of capture latency above the baseline (restart past the threshold)")
+            gauge("timelapse_capture_error_rate", status.get("capture_error_rate", 0),
+                  "Recent capture failure rate, 0-1")
+            gauge("timelapse_camera_restart_due", 1 if status.get("camera_restart_due") else 0,
+                  "1 while a camera restart is waiting for an idle window")
+            gauge("timelapse_camera_restarts_total", status.get("camera_restarts", 0),
+                  "Camera restarts by the capture health monitor today")
+            gauge("timelapse_capture_latency_rebaselines_total", status.get("capture_latency_rebaselines", 0),
+                  "Times a lasting latency rise was accepted as the new baseline")
+
+        if "encode_backlog" in status:
+            gauge("timelapse_encode_backlog_days", status["encode_backlog"],
+                  "Days with frames but no video yet, waiting for an idle window")
+            gauge("timelapse_encode_backlog_gave_up_days", status.get("encode_backlog_gave_up", 0),
+                  "Backlog days whose video failed every attempt")
+
+        if "slo_burn_rate" in status:
+            for scope in ("today", "window"):
+                for outcome, count in status.get(f"slo_{scope}", {}).items():
+                    gauge("timelapse_slo_slots", count,
+                          "Capture slots by outcome (on_time, late, invalid, missed), today or in the rolling window",
+                          labels={"scope": scope, "outcome": outcome})
+            gauge("timelapse_slo_target", status.get("slo_target", 0),
+                  "Target share of slots with a valid photo on time")
+            gauge("timelapse_slo_ratio_today", status.get("slo_ratio_today", 1),
+                  "Share of today's slots so far with a valid photo on time")
+            gauge("timelapse_slo_burn_rate", status["slo_burn_rate"],
+                  "Error budget burn rate over the rolling window (1 = ends the day on target)")
+            gauge("timelapse_slo_budget_remaining", status.get("slo_budget_remaining", 0),
+                  "Slots that can still go wrong today before missing the target")
+
+        for stage, times in status.get("stages", {}).items():
+            gauge("timelapse_stage_wall_seconds", times.get("wall_s", 0),
+                  "Wall time spent in a pipeline stage today", labels={"stage": stage})
+            gauge("timelapse_stage_cpu_seconds", times.get("cpu_s", 0),
+                  "Thread CPU time spent in a pipeline stage today", labels={"stage": stage})
+            gauge("timelapse_stage_calls", times.get("calls", 0),
+                  "Times a pipeline stage ran today", labels={"stage": stage})
+
+        if status.get("cloud_cover", -1) >= 0:
+            gauge("timelapse_cloud_cover_percent", status["cloud_cover"],
+                  "Cloud cover of the sky region in the latest photo")
+
+        if "jpeg_quality" in status:
+            gauge("timelapse_jpeg_quality", status["jpeg_quality"],
+                  "Current JPEG quality chosen by adaptive quality")
+            gauge("timelapse_bytes_today", status.get("bytes_today", 0),
+                  "Bytes of photos captured today")
+            gauge("timelapse_byte_budget", status.get("byte_budget", 0),
+                  "Byte budget for today's photos")
     else:
         gauge("timelapse_status", -1,
               "Current status (0=waiting, 1=capturing, 2=creating_video, 3=finished, -1=unknown)")
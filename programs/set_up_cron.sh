@@ -4,8 +4,36 @@
 # IMPORTANT: Define the absolute path to your project directory.
 PROJECT_DIR="/home/jack/github/auto-timelapse/v5-zero_test"
 
+# When the job graph is enabled the timelapse binary runs backup, upload and
+# cleanup itself as soon as the video is ready, so only its start is needed.
+if grep -Eq "^job_graph_enabled *= *true" "${PROJECT_DIR}/conf/timelapse.conf" 2>/dev/null; then
+    JOB_GRAPH_ENABLED=true
+else
+    JOB_GRAPH_ENABLED=false
+fi
+
 # Define the block of cron jobs to be added.
 # NOTE: The last line MUST be a newline character (\n) for crontab to read the file correctly.
+if [ "${JOB_GRAPH_ENABLED}" = true ]; then
+CRON_JOBS="
+# START: AUTO-TIMELAPSE JOBS
+# Generate tomorrow's schedule (end of day) - the binary also runs the scheduler if it's missing
+59 23 * * * cd ${PROJECT_DIR} && python3 ./programs/scheduler.py
+
+# Start daily timelapse at 3:00 AM (capture -> encode -> backup -> upload -> cleanup)
+0 3 * * * cd ${PROJECT_DIR} && nohup ./programs/timelapse > logs/todays_run.log 2>&1 &
+
+# Log free disk space
+5 1 * * * cd ${PROJECT_DIR} && python3 ./programs/disk_checker.py
+
+# Parity for finished days that don't have it yet (does nothing unless parity_shards > 0)
+30 0 * * * cd ${PROJECT_DIR} && ./programs/timelapse parity --max-minutes 25 >> logs/parity_run.log 2>&1
+
+# Scrub archived frames for bit rot (resumes each night, done before capture starts)
+15 1 * * * cd ${PROJECT_DIR} && ./programs/timelapse scrub --max-minutes 90 >> logs/scrub_run.log 2>&1
+# END: AUTO-TIMELAPSE JOBS
+"
+else
 CRON_JOBS="
 # START: AUTO-TIMELAPSE JOBS
 # Generate tomorrow's schedule (end of day)
@@ -22,8 +50,15 @@ CRON_JOBS="
 
 # Disk-based cleanup (after manager sets .backed_up markers)
 10 1 * * * cd ${PROJECT_DIR} && python3 ./programs/disk_cleanup.py
+
+# Parity for finished days that don't have it yet (does nothing unless parity_shards > 0)
+30 0 * * * cd ${PROJECT_DIR} && ./programs/timelapse parity --max-minutes 25 >> logs/parity_run.log 2>&1
+
+# Scrub archived frames for bit rot (resumes each night, done before capture starts)
+15 1 * * * cd ${PROJECT_DIR} && ./programs/timelapse scrub --max-minutes 90 >> logs/scrub_run.log 2>&1
 # END: AUTO-TIMELAPSE JOBS
 "
+fi
 # ---------------------
 
 echo "--- Starting Cron Job Setup (Bash) ---"
@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# Checks the V4L2 capture backend without a USB camera: feeds a v4l2loopback
+# device with an ffmpeg test pattern, once as MJPEG (saved as delivered) and
+# once as YUYV (encoded by the backend), and runs timelapse_camera_check
+# against each feed. Every frame must be complete and decodable, with
+# nothing left half-written.
+#
+# Needs the v4l2loopback module, ffmpeg and root (to load the module).
+# Build first with: make camera-check
+# Usage: sudo ./programs/v4l2_check.sh [frames] [WIDTHxHEIGHT]
+
+PROJECT_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+CHECK="${PROJECT_DIR}/programs/timelapse_camera_check"
+FRAMES="${1:-20}"
+SIZE="${2:-1280x720}"
+WIDTH="${SIZE%x*}"
+HEIGHT="${SIZE#*x}"
+VIDEO_NR=42
+DEVICE="/dev/video${VIDEO_NR}"
+WORK_DIR="/tmp/timelapse_v4l2_check"
+
+if [ ! -x "${CHECK}" ]; then
+    echo "Missing ${CHECK} - run 'make camera-check' first"
+    exit 1
+fi
+if ! command -v ffmpeg > /dev/null; then
+    echo "ffmpeg not found"
+    exit 1
+fi
+
+loaded_here=0
+if [ ! -e "${DEVICE}" ]; then
+    if ! modprobe v4l2loopback devices=1 video_nr=${VIDEO_NR} card_label="timelapse check" exclusive_caps=1; then
+        echo "Could not load v4l2loopback (apt install v4l2loopback-dkms, and run as root)"
+        exit 1
+    fi
+    loaded_here=1
+fi
+
+# name|ffmpeg output options
+FEEDS=(
+    "mjpeg|-c:v mjpeg -q:v 3"
+    "yuyv|-c:v rawvideo -pix_fmt yuyv422"
+)
+
+mkdir -p "${WORK_DIR}"
+failed=0
+for feed in "${FEEDS[@]}"; do
+    name="${feed%%|*}"
+    options="${feed#*|}"
+
+    ffmpeg -hide_banner -loglevel error -re -f lavfi -i "testsrc2=size=${SIZE}:rate=10" \
+        ${options} -f v4l2 "${DEVICE}" &
+    feeder=$!
+    # The feeder sets the device format; give it time before the backend opens it
+    sleep 2
+
+    echo
+    echo "[${name}] ${DEVICE} ${SIZE}"
+    "${CHECK}" --backend v4l2 --device "${DEVICE}" --width "${WIDTH}" --height "${HEIGHT}" \
+        --frames "${FRAMES}" --dir "${WORK_DIR}/${name}"
+    code=$?
+    echo "exit_code=${code}"
+    if [ ${code} -ne 0 ]; then
+        failed=1
+    fi
+
+    kill ${feeder} 2> /dev/null
+    wait ${feeder} 2> /dev/null
+done
+
+rm -rf "${WORK_DIR}"
+if [ ${loaded_here} -eq 1 ]; then
+    modprobe -r v4l2loopback
+fi
+
+echo
+if [ ${failed} -eq 0 ]; then
+    echo "V4L2 check passed"
+else
+    echo "V4L2 check FAILED"
+fi
+exit ${failed}
@@ -0,0 +1,400 @@
+// bench.cpp
+//
+// Standalone benchmark/check harness (no camera): `make bench`
+// builds programs/timelapse_bench. For every kernel (pixel and GF(256)) and
+// every variant this CPU supports it checks the output is bit-identical to
+// the scalar reference, then reports throughput. Exits non-zero on any
+// mismatch.
+//
+// Given photos (`make bench BENCH_PHOTOS="a.jpg b.jpg"`), it also times the
+// ways of reading them: full YUV decode, 1/8 luma decode, the DC-only luma
+// decode and the thumbnail analysis the frame index uses. For the video
+// stage it times the three ways frames reach an encoder: the YUV decode the
+// ffmpeg encoder takes as it is, the BGR decode the OpenCV encoder uses
+// without filters (cv::imread's decode, what the render used before) and
+// YUV decode + yuv420_to_bgr for the OpenCV encoder with filters, with the
+// largest difference between the two BGR results (0 for 4:2:0 photos). When OpenCV is installed the Makefile defines BENCH_OPENCV and
+// cv::imread itself is timed too; the DC map is also checked against the
+// 1/8 decode, which it must match exactly.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef BENCH_OPENCV
+#include <opencv2/imgcodecs.hpp>
+#endif
+
+#include "cpu_features.hpp"
+#include "dc_luma.hpp"
+#include "frame_analysis.hpp"
+#include "gf256.hpp"
+#include "pixel_kernels.hpp"
+#include "yuv_frame.hpp"
+
+// Frame-sized buffers; an 8 MP RGB frame is ~24 MB but 1920x1080x3 keeps the
+// run short on a Pi Zero.
+static const size_t BENCH_BYTES = 1920 * 1080 * 3;
+
+// Deterministic pseudo-random bytes (xorshift) so runs are comparable
+static void fill_random(std::vector<uint8_t>& buf, uint32_t seed) {
+    uint32_t x = seed ? seed : 1;
+    for (uint8_t& b : buf) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        b = static_cast<uint8_t>(x >> 24);
+    }
+}
+
+// Returns MB/s of `bytes` processed per call, best of a few timed runs
+static double time_kernel(const std::function<void()>& fn, size_t bytes) {
+    using clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (int run = 0; run < 5; run++) {
+        auto start = clock::now();
+        fn();
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds > 0.0) {
+            double mbps = bytes / seconds / (1024.0 * 1024.0);
+            if (mbps > best) {
+                best = mbps;
+            }
+        }
+    }
+    return best;
+}
+
+struct BenchInput {
+    std::vector<uint8_t> a;
+    std::vector<uint8_t> b;
+    uint8_t lut[256];
+    uint16_t gains[3];
+    int weight;
+};
+
+// Runs each kernel on `k`, compares with `ref`, and prints one line per kernel.
+// Odd lengths exercise the scalar tails of the SIMD loops.
+static bool check_and_time(const PixelKernels& k, const PixelKernels& ref, const BenchInput& in) {
+    bool ok = true;
+    const size_t lengths[] = { 0, 1, 15, 17, 33, 95, 97, 1001, BENCH_BYTES };
+    const uint8_t* a = in.a.data();
+    const uint8_t* b = in.b.data();
+
+    std::vector<uint8_t> out(BENCH_BYTES), expect(BENCH_BYTES);
+
+    auto report = [&](const char* kernel, bool match, double mbps) {
+        printf("  %-14s %-8s %10.1f MB/s\n", kernel, match ? "ok" : "MISMATCH", mbps);
+        if (!match) {
+            ok = false;
+        }
+    };
+
+    // apply_lut
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            k.apply_lut(a, out.data(), n, in.lut);
+            ref.apply_lut(a, expect.data(), n, in.lut);
+            match = match && memcmp(out.data(), expect.data(), n) == 0;
+        }
+        report("apply_lut", match, time_kernel([&]() { k.apply_lut(a, out.data(), BENCH_BYTES, in.lut); }, BENCH_BYTES));
+    }
+
+    // blend (including the end points 0 and 256)
+    {
+        bool match = true;
+        const int weights[] = { 0, 1, in.weight, 255, 256 };
+        for (int w : weights) {
+            for (size_t n : lengths) {
+                k.blend(a, b, out.data(), n, w);
+                ref.blend(a, b, expect.data(), n, w);
+                match = match && memcmp(out.data(), expect.data(), n) == 0;
+            }
+        }
+        report("blend", match, time_kernel([&]() { k.blend(a, b, out.data(), BENCH_BYTES, in.weight); }, BENCH_BYTES));
+    }
+
+    // absdiff
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            k.absdiff(a, b, out.data(), n);
+            ref.absdiff(a, b, expect.data(), n);
+            match = match && memcmp(out.data(), expect.data(), n) == 0;
+        }
+        report("absdiff", match, time_kernel([&]() { k.absdiff(a, b, out.data(), BENCH_BYTES); }, BENCH_BYTES));
+    }
+
+    // sad
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            match = match && k.sad(a, b, n) == ref.sad(a, b, n);
+        }
+        volatile uint64_t sink = 0;
+        report("sad", match, time_kernel([&]() { sink = sink + k.sad(a, b, BENCH_BYTES); }, BENCH_BYTES));
+    }
+
+    // histogram (accumulates, so start both from the same non-zero counts)
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            uint32_t h1[256], h2[256];
+            for (int v = 0; v < 256; v++) {
+                h1[v] = h2[v] = v;
+            }
+            k.histogram(a, n, h1);
+            ref.histogram(a, n, h2);
+            match = match && memcmp(h1, h2, sizeof(h1)) == 0;
+        }
+        uint32_t hist[256];
+        report("histogram", match, time_kernel([&]() {
+            memset(hist, 0, sizeof(hist));
+            k.histogram(a, BENCH_BYTES, hist);
+        }, BENCH_BYTES));
+    }
+
+    // channel_gains (gains above 1.0 so the clamp is exercised)
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            size_t pixels = n / 3;
+            k.channel_gains(a, out.data(), pixels, in.gains);
+            ref.channel_gains(a, expect.data(), pixels, in.gains);
+            match = match && memcmp(out.data(), expect.data(), pixels * 3) == 0;
+        }
+        // In place, as the video stage uses it
+        std::vector<uint8_t> in_place(in.a.begin(), in.a.begin() + 3001 * 3);
+        k.channel_gains(in_place.data(), in_place.data(), 3001, in.gains);
+        ref.channel_gains(a, expect.data(), 3001, in.gains);
+        match = match && memcmp(in_place.data(), expect.data(), in_place.size()) == 0;
+
+        report("channel_gains", match, time_kernel([&]() {
+            k.channel_gains(a, out.data(), BENCH_BYTES / 3, in.gains);
+        }, BENCH_BYTES));
+    }
+
+    // max_stack
+    {
+        bool match = true;
+        for (size_t n : lengths) {
+            memcpy(out.data(), b, n);
+            memcpy(expect.data(), b, n);
+            k.max_stack(a, out.data(), n);
+            ref.max_stack(a, expect.data(), n);
+            match = match && memcmp(out.data(), expect.data(), n) == 0;
+        }
+        report("max_stack", match, time_kernel([&]() { k.max_stack(a, out.data(), BENCH_BYTES); }, BENCH_BYTES));
+    }
+
+    // sky_counts (thresholds at both ends, and the cloud ratio's end points)
+    {
+        bool match = true;
+        const int sums[] = { 0, 1, 120, 384, 765 };
+        const int ratios[] = { 0, 192, 256 };
+        for (int min_sum : sums) {
+            for (int ratio : ratios) {
+                for (size_t n : lengths) {
+                    uint32_t c1[2] = { 7, 3 };
+                    uint32_t c2[2] = { 7, 3 };
+                    k.sky_counts(a, n / 3, min_sum, ratio, c1);
+                    ref.sky_counts(a, n / 3, min_sum, ratio, c2);
+                    match = match && c1[0] == c2[0] && c1[1] == c2[1];
+                }
+            }
+        }
+        uint32_t counts[2];
+        report("sky_counts", match, time_kernel([&]() {
+            counts[0] = counts[1] = 0;
+            k.sky_counts(a, BENCH_BYTES / 3, 120, 192, counts);
+        }, BENCH_BYTES));
+    }
+
+    return ok;
+}
+
+// The GF(256) region kernels of the parity code: every coefficient on short
+// lengths, then throughput of the multiply-accumulate encoding runs on
+static bool check_and_time_gf(const GfKernels& k, const GfKernels& ref, const BenchInput& in) {
+    const size_t lengths[] = { 0, 1, 15, 17, 33, 63, 65, 97, 1001 };
+    const uint8_t* a = in.a.data();
+    const uint8_t* b = in.b.data();
+    std::vector<uint8_t> out(BENCH_BYTES), expect(BENCH_BYTES);
+
+    bool match = true;
+    for (int c = 0; c < 256; c++) {
+        for (size_t n : lengths) {
+            k.mul(a, out.data(), n, static_cast<uint8_t>(c));
+            ref.mul(a, expect.data(), n, static_cast<uint8_t>(c));
+            match = match && memcmp(out.data(), expect.data(), n) == 0;
+
+            memcpy(out.data(), b, n);
+            memcpy(expect.data(), b, n);
+            k.mul_add(a, out.data(), n, static_cast<uint8_t>(c));
+            ref.mul_add(a, expect.data(), n, static_cast<uint8_t>(c));
+            match = match && memcmp(out.data(), expect.data(), n) == 0;
+        }
+    }
+    double mbps = time_kernel([&]() { k.mul_add(a, out.data(), BENCH_BYTES, 0x8e); }, BENCH_BYTES);
+    printf("  %-14s %-8s %10.1f MB/s\n", "gf_mul_add", match ? "ok" : "MISMATCH", mbps);
+    return match;
+}
+
+// Milliseconds per call, best of a few runs
+static double time_ms(const std::function<bool()>& fn) {
+    using clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (int run = 0; run < 5; run++) {
+        auto start = clock::now();
+        if (!fn()) {
+            return -1.0;
+        }
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        if (run == 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+static bool bench_photo(const char* path) {
+    YuvFrame frame;
+    LumaImage luma;
+    LumaImage dc_luma;
+    Thumbnail thumb;
+    FrameAnalysis analysis;
+    std::string error;
+
+    double full = time_ms([&]() { return decode_jpeg_yuv420(path, frame, error); });
+    double eighth = time_ms([&]() { return decode_jpeg_luma_scaled(path, 8, luma, error); });
+    double dc = time_ms([&]() { return decode_jpeg_dc_luma(path, dc_luma, error); });
+    double analyse = time_ms([&]() {
+        if (!load_thumbnail(path, thumb, error)) {
+            return false;
+        }
+        analyse_thumbnail(thumb, analysis);
+        return true;
+    });
+
+    std::vector<uint8_t> reference(static_cast<size_t>(frame.width) * frame.height * 3);
+    double bgr_decode = time_ms([&]() { return decode_jpeg_bgr(path, frame.width, frame.height, reference.data(), error); });
+    std::vector<uint8_t> converted(reference.size());
+    double yuv_to_bgr = time_ms([&]() {
+        if (!decode_jpeg_yuv420(path, frame, error)) {
+            return false;
+        }
+        yuv420_to_bgr(frame, converted.data());
+        return true;
+    });
+    int max_diff = 0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        max_diff = std::max(max_diff, std::abs(reference[i] - converted[i]));
+    }
+
+    if (full < 0 || eighth < 0 || dc < 0 || analyse < 0 || bgr_decode < 0 || yuv_to_bgr < 0) {
+        printf("%s: %s\n", path, error.c_str());
+        return false;
+    }
+#ifdef BENCH_OPENCV
+    cv::Mat image;
+    double imread = time_ms([&]() {
+        image = cv::imread(path, cv::IMREAD_COLOR);
+        return !image.empty();
+    });
+#endif
+
+    printf("%s (%dx%d)\n", path, frame.width, frame.height);
+#ifdef BENCH_OPENCV
+    if (imread >= 0) {
+        printf("  %-22s %8.2f ms  %5.1fx\n", "cv::imread", imread, full / imread);
+    }
+#endif
+    printf("  %-22s %8.2f ms\n", "full YUV decode", full);
+    printf("  %-22s %8.2f ms  %5.1fx\n", "BGR decode", bgr_decode, full / bgr_decode);
+    printf("  %-22s %8.2f ms  %5.1fx  (max diff %d from the BGR decode)\n", "YUV decode + to BGR", yuv_to_bgr,
+           full / yuv_to_bgr, max_diff);
+    printf("  %-22s %8.2f ms  %5.1fx\n", "1/8 luma decode", eighth, full / eighth);
+    printf("  %-22s %8.2f ms  %5.1fx  (%dx%d)\n", "DC-only luma", dc, full / dc, dc_luma.width, dc_luma.height);
+    printf("  %-22s %8.2f ms  %5.1fx  (%s %dx%d)\n", "thumbnail analysis", analyse, full / analyse,
+           thumb.from_exif ? "EXIF thumbnail" : "1/8 decode", thumb.width, thumb.height);
+
+    if (dc_luma.width != luma.width || dc_luma.height != luma.height || dc_luma.pixels != luma.pixels) {
+        printf("  FAILED: DC-only luma does not match the 1/8 decode\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const CpuFeatures& cpu = cpu_features();
+    printf("CPU features: sse4.1=%d avx2=%d neon=%d\n", cpu.sse41, cpu.avx2, cpu.neon);
+    printf("Selected kernels: %s (GF: %s)\n\n", pixel_kernels().name, gf_kernels().name);
+
+    BenchInput in;
+    in.a.resize(BENCH_BYTES);
+    in.b.resize(BENCH_BYTES);
+    fill_random(in.a, 12345);
+    fill_random(in.b, 67890);
+
+    // A gamma-ish curve like the deflicker LUT
+    for (int v = 0; v < 256; v++) {
+        in.lut[v] = static_cast<uint8_t>(255 - ((255 - v) * (255 - v)) / 255);
+    }
+    in.gains[0] = 310; // ~1.21
+    in.gains[1] = 256; // 1.0
+    in.gains[2] = 200; // ~0.78
+    in.weight = 77;
+
+    bool field_ok = true;
+    for (int a = 1; a < 256; a++) {
+        field_ok = field_ok && gf_mul(static_cast<uint8_t>(a), gf_inv(static_cast<uint8_t>(a))) == 1;
+    }
+    if (!field_ok) {
+        printf("FAILED: GF(256) inverse table is wrong\n");
+        return 1;
+    }
+
+    const PixelKernels* ref = pixel_kernels_for(ISA_SCALAR);
+    const GfKernels* gf_ref = gf_kernels_for(ISA_SCALAR);
+    const PixelIsa variants[] = { ISA_SCALAR, ISA_SSE41, ISA_AVX2, ISA_NEON };
+    bool all_ok = true;
+
+    for (PixelIsa isa : variants) {
+        const PixelKernels* k = pixel_kernels_for(isa);
+        if (k == nullptr) {
+            continue;
+        }
+        printf("[%s]\n", k->name);
+        if (!check_and_time(*k, *ref, in)) {
+            all_ok = false;
+        }
+        const GfKernels* gf = gf_kernels_for(isa);
+        if (gf != nullptr && !check_and_time_gf(*gf, *gf_ref, in)) {
+            all_ok = false;
+        }
+        printf("\n");
+    }
+
+    if (!all_ok) {
+        printf("FAILED: a SIMD kernel does not match the scalar reference\n");
+        return 1;
+    }
+    printf("All kernels match the scalar reference\n");
+
+    bool photos_ok = true;
+    for (int i = 1; i < argc; i++) {
+        printf("\n");
+        if (!bench_photo(argv[i])) {
+            photos_ok = false;
+        }
+    }
+    return photos_ok ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+// camera_backend.hpp
+
+#pragma once
+
+#include <string>
+
+// --- Native Capture Backends ---
+// A backend keeps the camera session open between frames instead of
+// spawning capture_command for every photo. The default "command" backend
+// stays inside TimeLapse::capture_photo().
+class CameraBackend {
+public:
+    virtual ~CameraBackend() {}
+
+    // Opens the device/session. Safe to call again after close().
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool is_open() const = 0;
+
+    // Writes the freshest available frame to path.
+    // On failure returns false and fills error with a readable reason.
+    virtual bool capture(const std::string& path, std::string& error) = 0;
+
+    // Asks the camera to encode later frames at this JPEG quality (1-100).
+    // Returns false when the backend has no way to change it.
+    virtual bool set_quality(int quality) { (void)quality; return false; }
+
+    // Short name used in logs ("v4l2", "http", ...)
+    virtual std::string name() const = 0;
+};
@@ -0,0 +1,195 @@
+// camera_check.cpp
+//
+// Capture backend check: `make camera-check` builds
+// programs/timelapse_camera_check. It drives a capture backend against a
+// stand-in source instead of a real camera and checks what lands on disk:
+//
+//   v4l2:  a v4l2loopback device fed by ffmpeg (programs/v4l2_check.sh sets
+//          one up and runs this for an MJPEG and a YUYV feed)
+//   http:  a local snapshot server (programs/http_camera_check.py serves
+//          Content-Length, chunked and close-delimited bodies, drops the
+//          connection to force the reconnect retry, and sends a broken
+//          chunk size that must fail every capture: run with --expect-fail)
+//
+// Every frame must appear under its final name only once it is complete: a
+// JPEG that starts with SOI, ends with EOI and decodes (at --width x
+// --height when given), with no temporary files left in the directory.
+// Results are printed as key=value lines; the exit code is 0 only when
+// every check passed (with --expect-fail: when every capture failed and
+// left nothing behind).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_slo.hpp"
+#include "network_camera.hpp"
+#include "utils.hpp"
+#include "v4l2_camera.hpp"
+#include "yuv_frame.hpp"
+
+struct CameraCheckOptions {
+    std::string backend;
+    std::string device;
+    std::string url;
+    std::string dir;
+    int width;
+    int height;
+    int frames;
+    int interval_ms;
+    int timeout_ms;
+    bool expect_fail;
+};
+
+static void camera_check_usage() {
+    std::cerr << "Usage: timelapse_camera_check --backend v4l2 --device DEV | --backend http --url URL\n"
+                 "                              [--width W --height H] [--frames N] [--interval-ms N]\n"
+                 "                              [--timeout-ms N] [--dir DIR] [--expect-fail]\n";
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+int main(int argc, char* argv[]) {
+    CameraCheckOptions opts;
+    opts.dir = "/tmp/timelapse_camera_check/";
+    opts.width = 0;
+    opts.height = 0;
+    opts.frames = 20;
+    opts.interval_ms = 200;
+    opts.timeout_ms = 2000;
+    opts.expect_fail = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--backend" && has_value) {
+            opts.backend = argv[++i];
+        } else if (arg == "--device" && has_value) {
+            opts.device = argv[++i];
+        } else if (arg == "--url" && has_value) {
+            opts.url = argv[++i];
+        } else if (arg == "--dir" && has_value) {
+            opts.dir = argv[++i];
+        } else if (arg == "--width" && has_value) {
+            opts.width = std::stoi(argv[++i]);
+        } else if (arg == "--height" && has_value) {
+            opts.height = std::stoi(argv[++i]);
+        } else if (arg == "--frames" && has_value) {
+            opts.frames = std::stoi(argv[++i]);
+        } else if (arg == "--interval-ms" && has_value) {
+            opts.interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--timeout-ms" && has_value) {
+            opts.timeout_ms = std::stoi(argv[++i]);
+        } else if (arg == "--expect-fail") {
+            opts.expect_fail = true;
+        } else {
+            camera_check_usage();
+            return 2;
+        }
+    }
+
+    std::unique_ptr<CameraBackend> camera;
+    if (opts.backend == "v4l2" && !opts.device.empty()) {
+        camera.reset(new V4L2Camera(opts.device, opts.width > 0 ? opts.width : 1920,
+                                    opts.height > 0 ? opts.height : 1080, opts.timeout_ms));
+    } else if (opts.backend == "http" && !opts.url.empty()) {
+        camera.reset(new NetworkCamera(opts.url, opts.timeout_ms));
+    } else {
+        camera_check_usage();
+        return 2;
+    }
+
+    opts.dir = with_slash(opts.dir);
+    if (!create_dir(opts.dir)) {
+        std::cerr << "Cannot create " << opts.dir << std::endl;
+        return 1;
+    }
+    // Only ever clear what an earlier check left (check_*): anything else
+    // may be someone's photos, and would count as a stray file anyway
+    for (const std::string& name : list_dir(opts.dir)) {
+        if (name.compare(0, 6, "check_") != 0) {
+            std::cerr << opts.dir << " has files this check didn't write (" << name
+                      << ") - use an empty directory" << std::endl;
+            return 2;
+        }
+    }
+    for (const std::string& name : list_dir(opts.dir)) {
+        std::remove((opts.dir + name).c_str());
+    }
+
+    if (!camera->open()) {
+        printf("open=failed\n");
+        return 1;
+    }
+    printf("backend=%s\n", camera->name().c_str());
+
+    int failed_captures = 0;
+    int bad_frames = 0;
+    std::vector<double> latencies_ms;
+    std::vector<std::string> expected;
+    YuvFrame frame;
+    for (int i = 0; i < opts.frames; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "check_%04d.jpg", i);
+        std::string path = opts.dir + name;
+
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = camera->capture(path, error);
+        latencies_ms.push_back(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        if (!ok) {
+            std::cerr << name << ": capture failed: " << error << std::endl;
+            failed_captures++;
+        } else {
+            expected.push_back(name);
+            if (!jpeg_file_complete(path)) {
+                std::cerr << name << ": not a complete JPEG" << std::endl;
+                bad_frames++;
+            } else if (!decode_jpeg_yuv420(path, frame, error)) {
+                std::cerr << name << ": does not decode: " << error << std::endl;
+                bad_frames++;
+            } else if ((opts.width > 0 && frame.width != opts.width) ||
+                       (opts.height > 0 && frame.height != opts.height)) {
+                std::cerr << name << ": " << frame.width << "x" << frame.height << ", expected " << opts.width
+                          << "x" << opts.height << std::endl;
+                bad_frames++;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(opts.interval_ms));
+    }
+    camera->close();
+
+    // Only finished frames may be left: a temporary or partial file means a
+    // write wasn't atomic
+    int stray_files = 0;
+    for (const std::string& name : list_dir(opts.dir)) {
+        if (std::find(expected.begin(), expected.end(), name) == expected.end()) {
+            std::cerr << "stray file: " << name << std::endl;
+            stray_files++;
+        }
+    }
+
+    printf("frames=%d\n", opts.frames);
+    printf("failed_captures=%d\n", failed_captures);
+    printf("bad_frames=%d\n", bad_frames);
+    printf("stray_files=%d\n", stray_files);
+    printf("capture_ms_p50=%.1f\n", percentile(latencies_ms, 0.5));
+    printf("capture_ms_max=%.1f\n", percentile(latencies_ms, 1.0));
+
+    bool passed = stray_files == 0 && bad_frames == 0 &&
+                  (opts.expect_fail ? failed_captures == opts.frames : failed_captures == 0);
+    printf("result=%s\n", passed ? "pass" : "fail");
+    return passed ? 0 : 1;
+}
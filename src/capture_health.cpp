@@ -0,0 +1,88 @@
+// capture_health.cpp
+
+#include <algorithm>
+#include <cmath>
+
+#include "capture_health.hpp"
+
+// Baseline EWMA weight (~last 50 captures) and the fast one for metrics
+#define HEALTH_BASELINE_ALPHA 0.02
+#define HEALTH_RECENT_ALPHA 0.2
+
+// Failure-rate EWMA weight: 3 failures in a row from 0 reach ~0.27
+#define HEALTH_ERROR_ALPHA 0.1
+
+// CUSUM slack (z-scores below this count as normal) and the cap on one
+// capture's z-score, so a single hiccup can't raise the alarm
+#define HEALTH_CUSUM_SLACK 0.5
+#define HEALTH_Z_CAP 4.0
+
+// Successful captures before the baseline is trusted
+#define HEALTH_WARMUP 20
+
+// Spread never taken as tighter than 5% of the mean or 5 ms: a camera with
+// very steady latency shouldn't alarm on a few ms of jitter
+#define HEALTH_MIN_SIGMA_FRACTION 0.05
+#define HEALTH_MIN_SIGMA_MS 5.0
+
+CaptureHealthMonitor::CaptureHealthMonitor(double cusum_threshold, double error_threshold, int cooldown_frames)
+    : cusum_threshold(std::max(1.0, cusum_threshold)), error_threshold(std::min(1.0, std::max(0.05, error_threshold))),
+      cooldown_frames(std::max(0, cooldown_frames)), samples(0), mean_ms(0.0), var_ms(0.0), recent_ms(0.0),
+      sum(0.0), errors(0.0), cooldown(0), checking(false), due(false), due_to_errors(false), restart_count(0),
+      rebaseline_count(0) {}
+
+void CaptureHealthMonitor::record(double duration_ms, bool success) {
+    errors += HEALTH_ERROR_ALPHA * ((success ? 0.0 : 1.0) - errors);
+    if (cooldown > 0) {
+        cooldown--;
+        if (success) {
+            recent_ms += HEALTH_RECENT_ALPHA * (duration_ms - recent_ms);
+        }
+        return;
+    }
+
+    if (success) {
+        recent_ms = samples == 0 ? duration_ms : recent_ms + HEALTH_RECENT_ALPHA * (duration_ms - recent_ms);
+        samples++;
+        if (samples <= HEALTH_WARMUP) {
+            // Plain running mean/variance until the EWMA has something to hold
+            double delta = duration_ms - mean_ms;
+            mean_ms += delta / samples;
+            var_ms += (delta * (duration_ms - mean_ms) - var_ms) / samples;
+        } else {
+            double sigma = std::max(std::sqrt(var_ms), std::max(HEALTH_MIN_SIGMA_MS, mean_ms * HEALTH_MIN_SIGMA_FRACTION));
+            double z = std::min(HEALTH_Z_CAP, (duration_ms - mean_ms) / sigma);
+            sum = std::max(0.0, sum + z - HEALTH_CUSUM_SLACK);
+
+            if (sum == 0.0) {
+                checking = false; // back to normal since the last restart
+            }
+            if (sum < cusum_threshold / 2) {
+                double delta = duration_ms - mean_ms;
+                mean_ms += HEALTH_BASELINE_ALPHA * delta;
+                var_ms = (1.0 - HEALTH_BASELINE_ALPHA) * (var_ms + HEALTH_BASELINE_ALPHA * delta * delta);
+            }
+        }
+    }
+
+    bool slow = sum > cusum_threshold;
+    if (slow && checking && errors <= error_threshold) {
+        // Still slow after restarting for it: that's the new normal
+        mean_ms = recent_ms;
+        sum = 0.0;
+        checking = false;
+        rebaseline_count++;
+        slow = false;
+    }
+    due_to_errors = errors > error_threshold;
+    due = slow || due_to_errors;
+}
+
+void CaptureHealthMonitor::restarted() {
+    checking = !due_to_errors;
+    due = false;
+    sum = 0.0;
+    errors = 0.0;
+    cooldown = cooldown_frames;
+    restart_count++;
+}
@@ -0,0 +1,66 @@
+// capture_health.hpp
+
+#pragma once
+
+// --- Capture Health ---
+// A camera that is about to hang usually gets slow first: capture latency
+// creeps up and stays up, with the odd failed frame, long before captures
+// stop altogether. The monitor watches for that and asks for a camera
+// restart while frames are still coming in.
+//
+// Latency: a slow EWMA of mean and variance is the baseline. Each capture's
+// latency becomes a z-score against it, and a one-sided CUSUM adds up how far
+// the z-scores sit above `slack`. A single slow frame adds little (z is
+// capped), so only a sustained rise crosses `cusum_threshold`. Once the
+// CUSUM is halfway there the baseline stops learning, so a slow creep can't
+// be absorbed as normal.
+//
+// Errors: a faster EWMA of the failure rate (1 per failed capture, 0 per
+// good one). A handful of failures in a short stretch crosses
+// `error_threshold`.
+//
+// Latency also rises for good reasons (long exposures at dusk). So if
+// latency is still up after a restart, the monitor takes the new level as
+// its baseline instead of restarting again.
+class CaptureHealthMonitor {
+public:
+    CaptureHealthMonitor(double cusum_threshold, double error_threshold, int cooldown_frames);
+
+    // Records one capture attempt (latency is only used when it succeeded)
+    void record(double duration_ms, bool success);
+
+    // True while the camera should be restarted (at the next idle moment)
+    bool restart_due() const { return due; }
+
+    // Call after restarting: clears the alarms and skips the next
+    // cooldown_frames captures while the camera settles
+    void restarted();
+
+    // Why the last restart was asked for ("latency" or "errors")
+    const char* reason() const { return due_to_errors ? "errors" : "latency"; }
+
+    double latency_ms() const { return recent_ms; }
+    double baseline_ms() const { return mean_ms; }
+    double cusum() const { return sum; }
+    double error_rate() const { return errors; }
+    int restarts() const { return restart_count; }
+    int rebaselines() const { return rebaseline_count; }
+
+private:
+    double cusum_threshold;
+    double error_threshold;
+    int cooldown_frames;
+
+    long samples;     // successful captures seen (warm-up)
+    double mean_ms;   // baseline latency
+    double var_ms;    // baseline variance
+    double recent_ms; // fast EWMA, for metrics
+    double sum;       // one-sided CUSUM of z-scores
+    double errors;    // EWMA failure rate, 0-1
+    int cooldown;     // captures still to skip after a restart
+    bool checking;    // restarted for latency, not healthy since
+    bool due;
+    bool due_to_errors;
+    int restart_count;
+    int rebaseline_count;
+};
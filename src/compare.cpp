@@ -0,0 +1,355 @@
+// compare.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+
+#include "compare.hpp"
+#include "manifest.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+#include "video_encoder.hpp"
+#include "yuv_frame.hpp"
+
+// Largest grid width picked automatically (the scale is chosen to fit)
+#define COMPARE_MAX_WIDTH 1920
+
+bool load_compare_day(const std::string& dir, CompareDay& day, std::string& error) {
+    day.dir = with_slash(dir);
+    std::string name = day.dir.substr(0, day.dir.size() - 1);
+    name = name.substr(name.find_last_of('/') + 1);
+
+    memset(&day.date, 0, sizeof(day.date));
+    if (name.size() < 8 || strptime(name.substr(0, 8).c_str(), "%Y%m%d", &day.date) == nullptr) {
+        error = "no YYYYMMDD date at the start of " + name;
+        return false;
+    }
+
+    if (read_frame_index(day.dir, day.frames) && !day.frames.empty()) {
+        // Appended in capture order; a clock step could break that
+        std::stable_sort(day.frames.begin(), day.frames.end(),
+                         [](const FrameIndexEntry& a, const FrameIndexEntry& b) { return a.epoch < b.epoch; });
+        return true;
+    }
+
+    // No index (older days): file times, once
+    day.frames.clear();
+    for (const std::string& frame : list_frames(day.dir)) {
+        struct stat st;
+        if (stat((day.dir + frame).c_str(), &st) == 0) {
+            FrameIndexEntry entry;
+            entry.name = frame;
+            entry.epoch = st.st_mtime;
+            day.frames.push_back(entry);
+        }
+    }
+    std::stable_sort(day.frames.begin(), day.frames.end(),
+                     [](const FrameIndexEntry& a, const FrameIndexEntry& b) { return a.epoch < b.epoch; });
+    if (day.frames.empty()) {
+        error = "no frames in " + day.dir;
+        return false;
+    }
+    return true;
+}
+
+long compare_target_epoch(const CompareDay& day, long seconds, bool solar, double longitude) {
+    std::tm tm = day.date;
+    if (!solar) {
+        tm.tm_isdst = -1;
+        return static_cast<long>(mktime(&tm)) + seconds;
+    }
+
+    // Apparent solar time = UTC + longitude (4 min per degree) + equation of time
+    long utc_midnight = static_cast<long>(timegm(&tm));
+    double b = 2.0 * M_PI * (tm.tm_yday - 81) / 364.0;
+    double equation_minutes = 9.87 * std::sin(2 * b) - 7.53 * std::cos(b) - 1.5 * std::sin(b);
+    return utc_midnight + seconds - std::lround(longitude * 240.0 + equation_minutes * 60.0);
+}
+
+// --- Rendering ---
+
+struct CompareOptions {
+    int days;
+    long from_seconds;
+    long to_seconds;
+    int step_seconds;
+    long max_gap_seconds;
+    bool solar;
+    double longitude;
+    int columns;
+    int scale;
+    int threads;
+    int fps;
+    std::string output;
+    std::string ffmpeg_command;
+    std::string x264_preset;
+    int x264_crf;
+    std::vector<std::string> day_dirs;
+};
+
+static void fill_black(YuvFrame& grid, int x0, int y0, int w, int h) {
+    for (int row = 0; row < h; row++) {
+        memset(&grid.y[static_cast<size_t>(y0 + row) * grid.width + x0], 0, w);
+    }
+    for (int row = 0; row < h / 2; row++) {
+        size_t offset = static_cast<size_t>(y0 / 2 + row) * grid.chroma_width() + x0 / 2;
+        memset(&grid.u[offset], 128, w / 2);
+        memset(&grid.v[offset], 128, w / 2);
+    }
+}
+
+// Copies `tile` into the grid cell at x0,y0 (w x h, even), cropped or padded
+static void blit_tile(const YuvFrame& tile, YuvFrame& grid, int x0, int y0, int w, int h) {
+    int cw = std::min(w, tile.width);
+    int ch = std::min(h, tile.height);
+    if (cw < w || ch < h) {
+        fill_black(grid, x0, y0, w, h);
+    }
+    for (int row = 0; row < ch; row++) {
+        memcpy(&grid.y[static_cast<size_t>(y0 + row) * grid.width + x0],
+               &tile.y[static_cast<size_t>(row) * tile.width], cw);
+    }
+    for (int row = 0; row < ch / 2; row++) {
+        size_t offset = static_cast<size_t>(y0 / 2 + row) * grid.chroma_width() + x0 / 2;
+        memcpy(&grid.u[offset], &tile.u[static_cast<size_t>(row) * tile.chroma_width()], cw / 2);
+        memcpy(&grid.v[offset], &tile.v[static_cast<size_t>(row) * tile.chroma_width()], cw / 2);
+    }
+}
+
+static bool render_compare(const std::vector<CompareDay>& days, const CompareOptions& opts) {
+    // Tile size: the first frame of the first day at the chosen scale
+    const int columns = opts.columns > 0 ? opts.columns
+                                         : static_cast<int>(std::ceil(std::sqrt(static_cast<double>(days.size()))));
+    const int rows = static_cast<int>((days.size() + columns - 1) / columns);
+
+    YuvFrame probe;
+    std::string error;
+    if (!decode_jpeg_yuv420(days[0].dir + days[0].frames[0].name, probe, error)) {
+        std::cerr << "Compare: " << error << std::endl;
+        return false;
+    }
+    int scale = opts.scale;
+    if (scale <= 0) {
+        scale = 1;
+        while (scale < 8 && columns * probe.width / scale > COMPARE_MAX_WIDTH) {
+            scale *= 2;
+        }
+    }
+    const int tile_w = (probe.width / scale) & ~1;
+    const int tile_h = (probe.height / scale) & ~1;
+
+    YuvFrame grid;
+    grid.resize(tile_w * columns, tile_h * rows);
+    fill_black(grid, 0, 0, grid.width, grid.height);
+
+    YuvVideoWriter writer;
+    if (!writer.open(opts.output, grid.width, grid.height, opts.fps, opts.ffmpeg_command, opts.x264_preset,
+                     opts.x264_crf, error)) {
+        std::cerr << "Compare: " << error << std::endl;
+        return false;
+    }
+
+    const int threads = std::max(1, std::min(opts.threads, static_cast<int>(days.size())));
+    std::vector<YuvFrame> scratch(threads);
+    std::vector<long> shown(days.size(), -2); // frame index in each tile; -1 = black
+    std::vector<long> wanted(days.size(), -1);
+    std::vector<size_t> jobs;
+    std::atomic<int> failures(0);
+    long decodes = 0;
+    int frames = 0;
+    bool write_failed = false;
+    auto start = std::chrono::steady_clock::now();
+
+    for (long t = opts.from_seconds; t <= opts.to_seconds; t += opts.step_seconds) {
+        jobs.clear();
+        for (size_t d = 0; d < days.size(); d++) {
+            long target = compare_target_epoch(days[d], t, opts.solar, opts.longitude);
+            long nearest = find_nearest_frame(days[d].frames, target);
+            if (nearest >= 0 && std::labs(days[d].frames[nearest].epoch - target) > opts.max_gap_seconds) {
+                nearest = -1; // nothing near this time that day (before start, after stop)
+            }
+            wanted[d] = nearest;
+            if (nearest != shown[d]) {
+                jobs.push_back(d);
+            }
+        }
+
+        // One tile per task; each task writes only its own grid cell
+        std::atomic<size_t> next(0);
+        auto worker = [&](int id) {
+            for (size_t j = next++; j < jobs.size(); j = next++) {
+                size_t d = jobs[j];
+                int x0 = static_cast<int>(d % columns) * tile_w;
+                int y0 = static_cast<int>(d / columns) * tile_h;
+                std::string tile_error;
+                if (wanted[d] < 0) {
+                    fill_black(grid, x0, y0, tile_w, tile_h);
+                } else if (decode_jpeg_yuv420(days[d].dir + days[d].frames[wanted[d]].name, scratch[id], tile_error,
+                                              scale)) {
+                    blit_tile(scratch[id], grid, x0, y0, tile_w, tile_h);
+                } else {
+                    fill_black(grid, x0, y0, tile_w, tile_h);
+                    failures++;
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads && static_cast<size_t>(i) < jobs.size(); i++) {
+            pool.emplace_back(worker, i);
+        }
+        worker(0);
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+        for (size_t d : jobs) {
+            decodes += wanted[d] >= 0 ? 1 : 0;
+            shown[d] = wanted[d];
+        }
+
+        if (!writer.write(grid)) {
+            std::cerr << "Compare: ffmpeg stopped accepting frames" << std::endl;
+            write_failed = true;
+            break;
+        }
+        frames++;
+    }
+
+    bool ok = writer.close() && !write_failed;
+    if (!ok) {
+        // A truncated video mustn't look finished
+        std::remove(opts.output.c_str());
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Compare: " << days.size() << " days, " << frames << " frames (" << grid.width << "x" << grid.height
+              << ", tiles 1/" << scale << "), " << decodes << " tile decodes, " << failures.load()
+              << " unreadable, " << format_duration(elapsed.count()) << " -> " << opts.output << std::endl;
+    return ok;
+}
+
+// --- Command line ---
+
+static void compare_usage() {
+    std::cerr << "Usage: timelapse compare [--days N] [--from HH:MM] [--to HH:MM] [--step SECONDS] [--solar]\n"
+              << "         [--columns N] [--scale 1|2|4|8] [--max-gap SECONDS] [--threads N] [--fps N]\n"
+              << "         [-o OUTPUT.mp4] [PICS_DAY_DIR...]\n";
+}
+
+static bool parse_clock(const std::string& text, long& seconds) {
+    int hours = 0, minutes = 0;
+    if (sscanf(text.c_str(), "%d:%d", &hours, &minutes) != 2 || hours < 0 || hours > 24 || minutes < 0 ||
+        minutes > 59) {
+        return false;
+    }
+    seconds = hours * 3600L + minutes * 60L;
+    return true;
+}
+
+// The most recent `count` day directories under pics/
+static std::vector<std::string> recent_days(int count) {
+    std::vector<std::string> days;
+    for (const std::string& name : list_dir(PICS_PATH)) {
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, "_pics") == 0) {
+            days.push_back(std::string(PICS_PATH) + name + "/");
+        }
+    }
+    if (static_cast<int>(days.size()) > count) {
+        days.erase(days.begin(), days.end() - count);
+    }
+    return days;
+}
+
+int run_compare(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+
+    CompareOptions opts;
+    opts.days = 7;
+    opts.from_seconds = 7 * 3600;
+    opts.to_seconds = 19 * 3600;
+    opts.step_seconds = 60;
+    opts.max_gap_seconds = 900;
+    opts.solar = false;
+    opts.longitude = std::stod(config_value(config, "longitude", "0"));
+    opts.columns = 0;
+    opts.scale = 0;
+    opts.threads = 0;
+    opts.fps = 25;
+    opts.ffmpeg_command = config_value(config, "ffmpeg_command", "ffmpeg");
+    opts.x264_preset = config_value(config, "x264_preset", "veryfast");
+    opts.x264_crf = std::stoi(config_value(config, "x264_crf", "23"));
+    std::string from_text = "0700";
+    std::string to_text = "1900";
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--days" && has_value) {
+            opts.days = std::stoi(argv[++i]);
+        } else if (arg == "--from" && has_value && parse_clock(argv[i + 1], opts.from_seconds)) {
+            from_text = argv[++i];
+        } else if (arg == "--to" && has_value && parse_clock(argv[i + 1], opts.to_seconds)) {
+            to_text = argv[++i];
+        } else if (arg == "--step" && has_value) {
+            opts.step_seconds = std::stoi(argv[++i]);
+        } else if (arg == "--solar") {
+            opts.solar = true;
+        } else if (arg == "--columns" && has_value) {
+            opts.columns = std::stoi(argv[++i]);
+        } else if (arg == "--scale" && has_value) {
+            opts.scale = std::stoi(argv[++i]);
+        } else if (arg == "--max-gap" && has_value) {
+            opts.max_gap_seconds = std::stol(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            opts.threads = std::stoi(argv[++i]);
+        } else if (arg == "--fps" && has_value) {
+            opts.fps = std::stoi(argv[++i]);
+        } else if ((arg == "-o" || arg == "--output") && has_value) {
+            opts.output = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            opts.day_dirs.push_back(arg);
+        } else {
+            compare_usage();
+            return 2;
+        }
+    }
+
+    bool scale_ok = opts.scale == 0 || opts.scale == 1 || opts.scale == 2 || opts.scale == 4 || opts.scale == 8;
+    if (opts.days < 1 || opts.step_seconds < 1 || opts.fps < 1 || opts.to_seconds < opts.from_seconds || !scale_ok) {
+        compare_usage();
+        return 2;
+    }
+    if (opts.threads <= 0) {
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (opts.day_dirs.empty()) {
+        opts.day_dirs = recent_days(opts.days);
+    }
+    if (opts.output.empty()) {
+        from_text.erase(std::remove(from_text.begin(), from_text.end(), ':'), from_text.end());
+        to_text.erase(std::remove(to_text.begin(), to_text.end(), ':'), to_text.end());
+        opts.output = std::string(VIDEOS_PATH) + "compare_" + from_text + "-" + to_text + "_" +
+                      std::to_string(opts.day_dirs.size()) + "days" + (opts.solar ? "_solar" : "") + ".mp4";
+    }
+
+    std::vector<CompareDay> days;
+    for (const std::string& dir : opts.day_dirs) {
+        CompareDay day;
+        std::string error;
+        if (!load_compare_day(dir, day, error)) {
+            std::cerr << "Compare: skipping " << dir << ": " << error << std::endl;
+            continue;
+        }
+        days.push_back(day);
+    }
+    if (days.empty()) {
+        std::cerr << "Compare: no days to render" << std::endl;
+        return 1;
+    }
+
+    return render_compare(days, opts) ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+// compare.hpp
+
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "frame_index.hpp"
+
+// --- Same-Time-of-Day Comparison ---
+// "timelapse compare" renders several days side by side in a grid, one tile
+// per day. Every tile shows the same clock time (or local solar time, so
+// shadows line up across seasons) as the video advances through the hours.
+//
+// Each output frame needs "the frame nearest time T on day D" for every day.
+// That is a binary search on the epoch column of the day's frame index
+// (find_nearest_frame), so no directory is listed while rendering. A day
+// without an index gets one built in memory from file times, once.
+//
+// Tiles are decoded at 1/2, 1/4 or 1/8 scale inside the IDCT by a pool of
+// threads, one tile each, straight into the grid frame. A tile whose nearest
+// frame is the same as in the previous output frame isn't decoded again.
+
+struct CompareDay {
+    std::string dir;
+    std::tm date;                        // the day, from the directory name
+    std::vector<FrameIndexEntry> frames; // capture order
+};
+
+// Loads the frame index of a pics/<YYYYMMDD>_<id>_pics/ directory
+bool load_compare_day(const std::string& dir, CompareDay& day, std::string& error);
+
+// Epoch of `seconds` past midnight on `day`: local clock time, or apparent
+// solar time at `longitude` (degrees east) when `solar`
+long compare_target_epoch(const CompareDay& day, long seconds, bool solar, double longitude);
+
+// Command line entry point: "timelapse compare ..."
+int run_compare(int argc, char* argv[]);
@@ -0,0 +1,30 @@
+// cpu_features.cpp
+
+#include "cpu_features.hpp"
+
+#if defined(__arm__) && defined(__ARM_NEON)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+static CpuFeatures detect_cpu_features() {
+    CpuFeatures f = { false, false, false };
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    f.sse41 = __builtin_cpu_supports("sse4.1");
+    f.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(__aarch64__)
+    f.neon = true; // mandatory on ARMv8
+#elif defined(__arm__) && defined(__ARM_NEON)
+    // 32-bit builds with -mfpu=neon (Pi 2/3/4). The Pi Zero (ARMv6) has no NEON.
+    f.neon = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+
+    return f;
+}
+
+const CpuFeatures& cpu_features() {
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
@@ -0,0 +1,14 @@
+// cpu_features.hpp
+
+#pragma once
+
+// --- CPU Feature Detection ---
+// Checked once at runtime so one binary picks the fastest kernels on both
+// x86 render hosts and ARM Pis. Only the features our kernels use.
+struct CpuFeatures {
+    bool sse41;
+    bool avx2;
+    bool neon;
+};
+
+const CpuFeatures& cpu_features();
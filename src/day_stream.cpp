@@ -0,0 +1,768 @@
+// day_stream.cpp
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "day_stream.hpp"
+#include "manifest.hpp"
+#include "stage_times.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+#define RECEIVE_LOG LOGS_PATH "receive.log"
+#define TRANSFER_MANIFEST "transfer_manifest.txt"
+
+#define TAR_BLOCK 512
+#define STREAM_BUFFER (256 * 1024)
+#define STREAM_DEFAULT_PORT "7070"
+#define STREAM_READ_AHEAD 8
+#define STREAM_TIMEOUT_SECONDS 60
+#define FNV_SEED 0xcbf29ce484222325ULL
+
+static void send_usage() {
+    std::cerr << "Usage: timelapse send-day DAY_DIR [--video FILE] [--to HOST[:PORT] | -o FILE|-]\n"
+                 "                          [--prefix NAME] [--read-ahead N] [--max-mb-per-s N]\n";
+}
+
+static void receive_usage() {
+    std::cerr << "Usage: timelapse receive --dir DIR --bind ADDR [--port N] [--once]\n"
+                 "       (ADDR: the NAS's LAN address, or stream_bind in the config)\n";
+}
+
+static void set_timeouts(int sock) {
+    timeval tv;
+    tv.tv_sec = STREAM_TIMEOUT_SECONDS;
+    tv.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// --- ustar headers ---
+
+static void put_octal(char* field, size_t width, uint64_t value) {
+    snprintf(field, width, "%0*llo", static_cast<int>(width) - 1, static_cast<unsigned long long>(value));
+}
+
+static uint64_t get_octal(const char* field, size_t width) {
+    uint64_t value = 0;
+    size_t i = 0;
+    while (i < width && field[i] == ' ') {
+        i++;
+    }
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static unsigned header_checksum(const char* block) {
+    unsigned sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) {
+        sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    return sum;
+}
+
+// Names over 100 characters are split at a '/' into prefix (155) + name.
+// False if the name can't be stored.
+static bool tar_header(const std::string& name, uint64_t size, long mtime, char* block) {
+    memset(block, 0, TAR_BLOCK);
+    std::string prefix;
+    std::string rest = name;
+    if (name.size() > 100) {
+        size_t cut = name.find('/', name.size() - 101);
+        if (cut == std::string::npos || cut > 155) {
+            return false;
+        }
+        prefix = name.substr(0, cut);
+        rest = name.substr(cut + 1);
+    }
+    memcpy(block, rest.data(), rest.size());
+    put_octal(block + 100, 8, 0644);
+    put_octal(block + 108, 8, 0);
+    put_octal(block + 116, 8, 0);
+    put_octal(block + 124, 12, size);
+    put_octal(block + 136, 12, static_cast<uint64_t>(mtime));
+    block[156] = '0';
+    memcpy(block + 257, "ustar", 6);
+    memcpy(block + 263, "00", 2);
+    memcpy(block + 345, prefix.data(), prefix.size());
+    snprintf(block + 148, 8, "%06o", header_checksum(block));
+    block[155] = ' ';
+    return true;
+}
+
+// --- Sending ---
+
+struct StreamFile {
+    std::string path; // on disk
+    std::string name; // in the archive
+};
+
+struct StreamSender {
+    int out;
+    RateLimiter limiter;
+    std::vector<char> buffer;
+    std::vector<char> frame; // a whole frame, checked before it is sent
+    uint64_t bytes;
+    std::vector<ManifestEntry> sent;
+    std::vector<std::string> rejected; // frames that no longer match manifest.txt
+
+    StreamSender(int out, double bytes_per_second)
+        : out(out), limiter(bytes_per_second), buffer(STREAM_BUFFER), bytes(0) {}
+
+    // Sends one file as a tar member, hashing it on the way. A file that
+    // can't be opened is skipped; false means the stream itself broke.
+    // With `expected` (its manifest.txt entry), the file is read and
+    // checked first, and left out if it no longer matches.
+    bool send(const StreamFile& file, const ManifestEntry* expected, std::string& error);
+
+    // Sends an in-memory member (a checked frame, the transfer manifest)
+    bool send_data(const std::string& name, long mtime, const char* data, size_t size);
+
+    bool pad(uint64_t size);
+};
+
+bool StreamSender::pad(uint64_t size) {
+    static const char zeros[TAR_BLOCK] = {};
+    size_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    bytes += padding;
+    return write_all(out, zeros, padding);
+}
+
+bool StreamSender::send(const StreamFile& file, const ManifestEntry* expected, std::string& error) {
+    int fd = open(file.path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        archive_log("Send: skipping unreadable " + file.path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return true;
+    }
+
+    // A frame that rotted on the card must not replace the good copy on
+    // the NAS (the one scrub restores from), so it is checked before any
+    // of it goes out. Frames are small enough to hold.
+    if (expected != nullptr) {
+        frame.resize(st.st_size);
+        bool read_ok;
+        {
+            StageTimer read_timer("stream_read");
+            read_ok = read_all(fd, frame.data(), frame.size());
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+        std::string hash;
+        if (read_ok) {
+            StageTimer hash_timer("hash");
+            hash = hash_to_hex(hash_bytes(frame.data(), frame.size(), FNV_SEED));
+        }
+        if (!read_ok || hash != expected->hash || static_cast<uint64_t>(st.st_size) != expected->size) {
+            archive_log("Send: " + file.path + " no longer matches manifest.txt, not sent (run timelapse repair)");
+            rejected.push_back(file.name);
+            return true;
+        }
+        if (!send_data(file.name, st.st_mtime, frame.data(), frame.size())) {
+            error = "write failed";
+            return false;
+        }
+        ManifestEntry entry;
+        entry.name = file.name;
+        entry.size = st.st_size;
+        entry.hash = hash;
+        sent.push_back(entry);
+        return true;
+    }
+
+    char header[TAR_BLOCK];
+    if (!tar_header(file.name, st.st_size, st.st_mtime, header)) {
+        archive_log("Send: skipping " + file.path + " (name too long for tar)");
+        close(fd);
+        return true;
+    }
+    if (!write_all(out, header, TAR_BLOCK)) {
+        close(fd);
+        error = "write failed";
+        return false;
+    }
+
+    // A file that shrinks while being read is padded with zeros; its hash
+    // then won't match and the receiver drops it
+    uint64_t hash = FNV_SEED;
+    uint64_t remaining = st.st_size;
+    bool ok = true;
+    bool short_read = false;
+    while (remaining > 0) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+        ssize_t n = 0;
+        if (!short_read) {
+            StageTimer read_timer("stream_read");
+            n = read(fd, buffer.data(), want);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (!short_read) {
+                archive_log("Send: " + file.path + " shrank or could not be read, padding");
+                short_read = true;
+            }
+            n = static_cast<ssize_t>(want);
+            memset(buffer.data(), 0, want);
+        } else {
+            StageTimer hash_timer("hash");
+            hash = hash_bytes(buffer.data(), n, hash);
+        }
+        StageTimer write_timer("stream_write");
+        if (!write_all(out, buffer.data(), n)) {
+            ok = false;
+            break;
+        }
+        limiter.consume(n);
+        remaining -= n;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    bytes += TAR_BLOCK + st.st_size;
+    if (!ok || !pad(st.st_size)) {
+        error = "write failed";
+        return false;
+    }
+    ManifestEntry entry;
+    entry.name = file.name;
+    entry.size = st.st_size;
+    entry.hash = hash_to_hex(hash);
+    sent.push_back(entry);
+    return true;
+}
+
+bool StreamSender::send_data(const std::string& name, long mtime, const char* data, size_t size) {
+    char header[TAR_BLOCK];
+    if (!tar_header(name, size, mtime, header)) {
+        return false;
+    }
+    bytes += TAR_BLOCK + size;
+    StageTimer write_timer("stream_write");
+    if (!write_all(out, header, TAR_BLOCK)) {
+        return false;
+    }
+    for (size_t done = 0; done < size;) {
+        size_t n = std::min(size - done, buffer.size());
+        if (!write_all(out, data + done, n)) {
+            return false;
+        }
+        limiter.consume(n);
+        done += n;
+    }
+    return pad(size);
+}
+
+// Starts the kernel reading a file we'll send soon
+static void read_ahead(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
+
+static int connect_to(const std::string& target, std::string& error) {
+    std::string host = target;
+    std::string port = STREAM_DEFAULT_PORT;
+    size_t colon = target.rfind(':');
+    if (colon != std::string::npos) {
+        host = target.substr(0, colon);
+        port = target.substr(colon + 1);
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = "could not resolve " + host + ": " + gai_strerror(rc);
+        return -1;
+    }
+
+    int sock = -1;
+    error = "could not connect to " + host + ":" + port;
+    for (addrinfo* ai = result; ai != nullptr && sock < 0; ai = ai->ai_next) {
+        int s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0) {
+            continue;
+        }
+        set_timeouts(s);
+        if (connect(s, ai->ai_addr, ai->ai_addrlen) == 0) {
+            sock = s;
+        } else {
+            error += std::string(": ") + strerror(errno);
+            close(s);
+        }
+    }
+    freeaddrinfo(result);
+    return sock;
+}
+
+int run_send_day(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+    std::string day_dir;
+    std::string video;
+    std::string target;
+    std::string output;
+    std::string prefix = config_value(config, "id", "");
+    int ahead = STREAM_READ_AHEAD;
+    double max_mb_per_s = std::stod(config_value(config, "stream_max_mb_per_s", "0"));
+    std::string host = config_value(config, "nas_host", "");
+    if (!host.empty()) {
+        target = host + ":" + config_value(config, "stream_port", STREAM_DEFAULT_PORT);
+    }
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--video" && has_value) {
+            video = argv[++i];
+        } else if (arg == "--to" && has_value) {
+            target = argv[++i];
+        } else if (arg == "-o" && has_value) {
+            output = argv[++i];
+        } else if (arg == "--prefix" && has_value) {
+            prefix = argv[++i];
+        } else if (arg == "--read-ahead" && has_value) {
+            ahead = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--max-mb-per-s" && has_value) {
+            max_mb_per_s = std::stod(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-' && day_dir.empty()) {
+            day_dir = arg;
+        } else {
+            send_usage();
+            return 2;
+        }
+    }
+    if (day_dir.empty() || (output.empty() && target.empty())) {
+        send_usage();
+        return 2;
+    }
+    // With "-o -" the archive goes to stdout, so messages must not
+    set_archive_log_stderr(output == "-");
+    signal(SIGPIPE, SIG_IGN); // a dropped connection is a write error, not a crash
+
+    // Frames, frame_index.csv, manifest.txt... in name order; dotfiles
+    // (backup markers, partial files) stay behind
+    std::string day_name = base_name(day_dir);
+    std::string member_dir = (prefix.empty() ? "" : prefix + "/") + day_name + "/";
+    std::vector<StreamFile> files;
+    for (const std::string& name : list_dir(day_dir)) {
+        struct stat st;
+        std::string path = with_slash(day_dir) + name;
+        if (name[0] != '.' && name != TRANSFER_MANIFEST && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            files.push_back({path, member_dir + name});
+        }
+    }
+    if (files.empty()) {
+        archive_log("Send: no files in " + day_dir);
+        return 1;
+    }
+    if (!video.empty()) {
+        files.push_back({video, (prefix.empty() ? "" : prefix + "/") + base_name(video)});
+    }
+
+    int out = -1;
+    std::string error;
+    if (output == "-") {
+        out = STDOUT_FILENO;
+    } else if (!output.empty()) {
+        out = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        error = "cannot write " + output;
+    } else {
+        out = connect_to(target, error);
+    }
+    if (out < 0) {
+        archive_log("Send: " + error);
+        return 1;
+    }
+
+    // Frames are checked against manifest.txt before they are sent
+    std::vector<ManifestEntry> manifest;
+    read_manifest(day_dir, manifest);
+
+    auto start = std::chrono::steady_clock::now();
+    StreamSender sender(out, max_mb_per_s * 1024 * 1024);
+    bool ok = true;
+    for (size_t i = 0; i < files.size() && i < static_cast<size_t>(ahead); i++) {
+        read_ahead(files[i].path);
+    }
+    for (size_t i = 0; i < files.size() && ok; i++) {
+        if (ahead > 0 && i + ahead < files.size()) {
+            read_ahead(files[i + ahead].path);
+        }
+        const ManifestEntry* expected = nullptr;
+        if (files[i].name.compare(0, member_dir.size(), member_dir) == 0) {
+            expected = find_manifest_entry(manifest, base_name(files[i].name));
+        }
+        ok = sender.send(files[i], expected, error);
+    }
+
+    // Hashes go last, so the receiver can check everything it got
+    std::stringstream ss;
+    for (const ManifestEntry& entry : sender.sent) {
+        ss << entry.hash << " " << entry.size << " " << entry.name << "\n";
+    }
+    static const char end_blocks[2 * TAR_BLOCK] = {};
+    std::string listing = ss.str();
+    ok = ok && sender.send_data(member_dir + TRANSFER_MANIFEST, std::time(nullptr), listing.data(), listing.size()) &&
+         write_all(out, end_blocks, sizeof(end_blocks));
+
+    std::string reply;
+    if (ok && output.empty()) {
+        // Half-close: the receiver sees the end of the stream and answers
+        shutdown(out, SHUT_WR);
+        char c;
+        while (reply.size() < 256 && read(out, &c, 1) == 1 && c != '\n') {
+            reply += c;
+        }
+        ok = reply.compare(0, 3, "OK ") == 0;
+        if (!ok) {
+            error = reply.empty() ? "no answer from receiver" : "receiver: " + reply;
+        }
+    }
+    if (out != STDOUT_FILENO) {
+        close(out);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::string stage_error;
+    append_stage_times(STAGE_TIMES_FILE, "send-day", stage_error);
+    double mb = sender.bytes / (1024.0 * 1024.0);
+    char rate[96];
+    snprintf(rate, sizeof(rate), "%.1f MB in %.1f s (%.2f MB/s)", mb, elapsed.count(),
+             elapsed.count() > 0 ? mb / elapsed.count() : 0.0);
+    if (ok && !sender.rejected.empty()) {
+        // The NAS keeps its copies of those; the day isn't backed up until
+        // they are repaired and sent again
+        ok = false;
+        error = std::to_string(sender.rejected.size()) + " frame(s) no longer match manifest.txt and were not sent";
+    }
+    if (!ok) {
+        archive_log("Send: " + day_name + " failed after " + rate + ": " + error);
+        return 1;
+    }
+    archive_log("Send: " + day_name + " -> " + (output.empty() ? target : output) + ", " +
+                std::to_string(sender.sent.size()) + " files, " + rate);
+    return 0;
+}
+
+// --- Receiving ---
+
+// Archive names must stay inside the receive directory
+static bool safe_name(const std::string& name) {
+    if (name.empty() || name[0] == '/') {
+        return false;
+    }
+    std::stringstream ss(name);
+    std::string part;
+    while (std::getline(ss, part, '/')) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool make_parents(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        std::string dir = path.substr(0, slash);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Received {
+    uint64_t size;
+    std::string hash;
+    long mtime;
+};
+
+// Removes the .part files of a stream that won't be kept
+static void discard_parts(const std::string& root, const std::map<std::string, Received>& received) {
+    for (const auto& item : received) {
+        unlink((with_slash(root) + item.first + ".part").c_str());
+    }
+}
+
+// Unpacks one stream into root and checks it. Returns the reply line.
+// Everything stays under its .part name until the transfer manifest has
+// been checked, so a bad transfer never replaces a good copy.
+static std::string receive_stream(int sock, const std::string& root, std::vector<char>& buffer) {
+    std::map<std::string, Received> received;
+    std::vector<std::string> manifests;
+    char header[TAR_BLOCK];
+
+    for (;;) {
+        if (!read_all(sock, header, TAR_BLOCK)) {
+            discard_parts(root, received);
+            return "FAIL stream ended without end-of-archive";
+        }
+        bool zero = std::all_of(header, header + TAR_BLOCK, [](char c) { return c == 0; });
+        if (zero) {
+            read_all(sock, header, TAR_BLOCK); // the second end block
+            break;
+        }
+        if (get_octal(header + 148, 8) != header_checksum(header)) {
+            discard_parts(root, received);
+            return "FAIL bad tar header checksum";
+        }
+
+        std::string name(header, strnlen(header, 100));
+        if (header[345] != '\0') {
+            name = std::string(header + 345, strnlen(header + 345, 155)) + "/" + name;
+        }
+        uint64_t size = get_octal(header + 124, 12);
+        long mtime = static_cast<long>(get_octal(header + 136, 12));
+        char type = header[156];
+        uint64_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        if (!safe_name(name)) {
+            discard_parts(root, received);
+            return "FAIL unsafe name " + name;
+        }
+
+        std::string part = with_slash(root) + name + ".part";
+        int fd = -1;
+        if (type == '5') {
+            make_parents(with_slash(with_slash(root) + name));
+        } else if (type == '0' || type == '\0') {
+            if (!make_parents(part) || (fd = open(part.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+                discard_parts(root, received);
+                return "FAIL cannot write " + name;
+            }
+        }
+
+        // Other member types are read past
+        uint64_t hash = FNV_SEED;
+        uint64_t remaining = padded;
+        while (remaining > 0) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            if (!read_all(sock, buffer.data(), n)) {
+                if (fd >= 0) {
+                    close(fd);
+                    unlink(part.c_str());
+                }
+                discard_parts(root, received);
+                return "FAIL stream ended inside " + name;
+            }
+            uint64_t done = padded - remaining;
+            size_t data = done < size ? static_cast<size_t>(std::min<uint64_t>(n, size - done)) : 0;
+            if (fd >= 0 && data > 0) {
+                hash = hash_bytes(buffer.data(), data, hash);
+                if (!write_all(fd, buffer.data(), data)) {
+                    close(fd);
+                    unlink(part.c_str());
+                    discard_parts(root, received);
+                    return "FAIL write error on " + name;
+                }
+            }
+            remaining -= n;
+        }
+        if (fd < 0) {
+            continue;
+        }
+        close(fd);
+        received[name] = {size, hash_to_hex(hash), mtime};
+        if (base_name(name) == TRANSFER_MANIFEST) {
+            manifests.push_back(name);
+        }
+    }
+
+    // Check everything the sender listed. Only what matches (and the
+    // manifests themselves) gets its real name; the rest is dropped.
+    if (manifests.empty()) {
+        discard_parts(root, received);
+        return "FAIL no " TRANSFER_MANIFEST " in the stream";
+    }
+    std::map<std::string, bool> keep;
+    for (const std::string& manifest : manifests) {
+        keep[manifest] = true;
+    }
+    int listed = 0;
+    int bad = 0;
+    uint64_t bytes = 0;
+    for (const std::string& manifest : manifests) {
+        std::ifstream file(with_slash(root) + manifest + ".part");
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream ss(line);
+            ManifestEntry entry;
+            if (!(ss >> entry.hash >> entry.size >> entry.name)) {
+                continue;
+            }
+            listed++;
+            auto it = received.find(entry.name);
+            if (it == received.end() || it->second.hash != entry.hash || it->second.size != entry.size) {
+                log_message(RECEIVE_LOG, "Receive: " + entry.name + " failed verification, old copy kept");
+                bad++;
+                continue;
+            }
+            keep[entry.name] = true;
+            bytes += entry.size;
+        }
+    }
+
+    // Flush the data before any rename, so a crash can't leave a real
+    // name pointing at unwritten blocks; then flush the renames
+    int dir_fd = open(root.c_str(), O_RDONLY);
+    if (dir_fd >= 0) {
+        syncfs(dir_fd);
+    }
+    int rename_errors = 0;
+    for (const auto& item : received) {
+        std::string path = with_slash(root) + item.first;
+        if (!keep.count(item.first)) {
+            unlink((path + ".part").c_str());
+            continue;
+        }
+        if (rename((path + ".part").c_str(), path.c_str()) != 0) {
+            log_message(RECEIVE_LOG, "Receive: cannot rename " + path + ".part: " + strerror(errno));
+            rename_errors++;
+            continue;
+        }
+        struct timeval times[2] = {{item.second.mtime, 0}, {item.second.mtime, 0}};
+        utimes(path.c_str(), times);
+    }
+    if (dir_fd >= 0) {
+        syncfs(dir_fd);
+        close(dir_fd);
+    }
+    if (bad > 0) {
+        return "FAIL " + std::to_string(bad) + " of " + std::to_string(listed) + " files failed verification";
+    }
+    if (rename_errors > 0) {
+        return "FAIL cannot rename " + std::to_string(rename_errors) + " files";
+    }
+    return "OK " + std::to_string(listed) + " " + std::to_string(bytes);
+}
+
+int run_receive(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+    std::string root;
+    std::string port = config_value(config, "stream_port", STREAM_DEFAULT_PORT);
+    std::string bind_address = config_value(config, "stream_bind", "");
+    bool once = false;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--dir" && has_value) {
+            root = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            port = argv[++i];
+        } else if (arg == "--bind" && has_value) {
+            bind_address = argv[++i];
+        } else if (arg == "--once") {
+            once = true;
+        } else {
+            receive_usage();
+            return 2;
+        }
+    }
+    if (root.empty() || !create_dir(root)) {
+        receive_usage();
+        return 2;
+    }
+    // The receiver has no authentication and writes whatever it is sent
+    // under --dir, so it never listens on every interface by default
+    if (bind_address.empty()) {
+        std::cerr << "Receive: no address to listen on - pass --bind (or set stream_bind) to the LAN address;"
+                     " 0.0.0.0 listens on every interface"
+                  << std::endl;
+        receive_usage();
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(bind_address.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        std::cerr << "Receive: cannot resolve " << bind_address << ": " << gai_strerror(rc) << std::endl;
+        return 1;
+    }
+    int listener = -1;
+    for (addrinfo* ai = result; ai != nullptr && listener < 0; ai = ai->ai_next) {
+        int s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(s, ai->ai_addr, ai->ai_addrlen) == 0 && listen(s, 4) == 0) {
+            listener = s;
+        } else {
+            close(s);
+        }
+    }
+    freeaddrinfo(result);
+    if (listener < 0) {
+        std::cerr << "Receive: cannot listen on port " << port << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    log_message(RECEIVE_LOG, "Receive: listening on " + bind_address + ":" + port + ", unpacking into " + root);
+
+    // One stream at a time: the NAS disk is the bottleneck anyway
+    std::vector<char> buffer(STREAM_BUFFER);
+    bool ok = true;
+    do {
+        sockaddr_storage peer;
+        socklen_t peer_len = sizeof(peer);
+        int sock = accept(listener, reinterpret_cast<sockaddr*>(&peer), &peer_len);
+        if (sock < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        char host[NI_MAXHOST] = "?";
+        getnameinfo(reinterpret_cast<sockaddr*>(&peer), peer_len, host, sizeof(host), nullptr, 0, NI_NUMERICHOST);
+        set_timeouts(sock);
+
+        auto start = std::chrono::steady_clock::now();
+        std::string reply = receive_stream(sock, root, buffer);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::string line = reply + "\n";
+        write_all(sock, line.data(), line.size());
+        close(sock);
+
+        ok = reply.compare(0, 3, "OK ") == 0;
+        log_message(RECEIVE_LOG, "Receive: " + std::string(host) + ": " + reply + " (" +
+                                 format_duration(elapsed.count()) + ")");
+    } while (!once);
+
+    close(listener);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+// day_stream.hpp
+
+#pragma once
+
+// --- Day Stream Transfer ---
+// rsync backs a day up file by file. For ~1000 small frames over the Pi
+// Zero's Wi-Fi, the per-file round trips dominate, not the bytes.
+// "timelapse send-day" sends the whole day as one sequential tar (ustar)
+// stream over a single TCP connection. The stream holds the frames,
+// frame_index.csv and the rest of the day directory, plus the day's video.
+// "timelapse receive" on the NAS unpacks it. Nothing waits on a reply until
+// the very end.
+//
+// Member names match the rsync layout: <device id>/<day dir>/<file> and
+// <device id>/<video>. So a plain `nc -l 7070 | tar x` works as a receiver
+// too, and `send-day -o -` can be piped through ssh.
+//
+// Sending: files go out in name order, read with large reads. The next
+// `read_ahead` files are announced to the kernel (POSIX_FADV_WILLNEED), so
+// the card is read while the network sends. Pages already sent are dropped,
+// so the page cache keeps what capture needs. Every file is hashed (FNV-1a,
+// as in manifest.txt) on the way out.
+//
+// Frames listed in the day's manifest.txt are read and checked before any
+// of them is sent. A frame that no longer matches has gone bad on the card
+// since it was written: it is left out, so the good copy on the NAS stays,
+// and send-day fails until the frame is repaired.
+//
+// The last member, <day dir>/transfer_manifest.txt, lists
+// "<hash> <size> <name>" for everything sent. The receiver writes each file
+// to "<name>.part", hashing as it goes. At the end it checks every file
+// against that manifest, flushes the file system, renames the files that
+// match and removes the .part files that don't. A bad transfer therefore
+// never replaces a file already on the NAS. It answers "OK <files> <bytes>"
+// or "FAIL <reason>"; send-day exits 0 only on OK.
+//
+// The receiver has no authentication: anyone who can reach its port can
+// write under its --dir. It only listens on an address it is given
+// (--bind or stream_bind), which should be the NAS's LAN address.
+
+// Command line entry points: "timelapse send-day ..." / "timelapse receive ..."
+int run_send_day(int argc, char* argv[]);
+int run_receive(int argc, char* argv[]);
@@ -0,0 +1,479 @@
+// dc_luma.cpp
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dc_luma.hpp"
+
+// Codes up to this many bits are decoded with one table lookup
+#define HUFF_LOOKAHEAD 9
+
+// AC symbols whose code and value bits fit in this many bits are skipped
+// with one table lookup
+#define SKIP_LOOKAHEAD 12
+
+#define MAX_COMPONENTS 4
+
+namespace {
+
+struct HuffTable {
+    uint16_t lookup[1 << HUFF_LOOKAHEAD]; // (code length << 8) | symbol; 0 = longer code
+    uint16_t skip[1 << SKIP_LOOKAHEAD];     // AC: (coefficients << 8) | code + value bits; 0 = slow path
+    int32_t maxcode[18];                  // largest code of each length, -1 if none
+    int32_t valoffset[17];
+    uint8_t values[256];
+    bool defined;
+};
+
+struct Component {
+    int id;
+    int h;
+    int v;
+    int quant;
+    int dc_table;
+    int ac_table;
+};
+
+struct JpegInfo {
+    int width;
+    int height;
+    int max_h;
+    int max_v;
+    int restart_interval;
+    int ncomponents;
+    Component components[MAX_COMPONENTS];
+    int quant_dc[4]; // element 0 of each quantisation table
+    HuffTable dc[4];
+    HuffTable ac[4];
+};
+
+// Entropy-coded data reader: 0xFF00 is a stuffed 0xFF; any other marker
+// ends the data and reads as zero bits from then on.
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t acc;
+    int nbits;
+    bool at_marker;
+
+    void refill() {
+        // Fast path: whole bytes with no 0xFF among them
+        if (!at_marker && end - p >= 8) {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            uint64_t inverted = ~word;
+            if (((inverted - 0x0101010101010101ull) & ~inverted & 0x8080808080808080ull) == 0) {
+                int bytes = (63 - nbits) >> 3;
+                word = __builtin_bswap64(word);
+                acc = (acc << (bytes * 8)) | (word >> (64 - bytes * 8));
+                nbits += bytes * 8;
+                p += bytes;
+                return;
+            }
+        }
+        while (nbits <= 56) {
+            uint8_t byte = 0;
+            if (!at_marker && p < end) {
+                byte = *p++;
+                if (byte == 0xFF) {
+                    if (p < end && *p == 0x00) {
+                        p++;
+                    } else {
+                        at_marker = true;
+                        p--;
+                        byte = 0;
+                    }
+                }
+            }
+            acc = (acc << 8) | byte;
+            nbits += 8;
+        }
+    }
+
+    uint32_t peek(int n) const {
+        return static_cast<uint32_t>(acc >> (nbits - n)) & ((1u << n) - 1);
+    }
+
+    void skip(int n) {
+        nbits -= n;
+    }
+
+    int get(int n) {
+        uint32_t value = peek(n);
+        nbits -= n;
+        return static_cast<int>(value);
+    }
+
+    // Decodes one Huffman symbol; the caller has refilled
+    int decode(const HuffTable& table) {
+        uint16_t entry = table.lookup[peek(HUFF_LOOKAHEAD)];
+        if (entry != 0) {
+            nbits -= entry >> 8;
+            return entry & 0xFF;
+        }
+        for (int len = HUFF_LOOKAHEAD + 1; len <= 16; len++) {
+            int32_t code = static_cast<int32_t>(peek(len));
+            if (code <= table.maxcode[len]) {
+                nbits -= len;
+                return table.values[(code + table.valoffset[len]) & 0xFF];
+            }
+        }
+        nbits -= 16; // corrupt: no such code
+        return 0;
+    }
+
+    // Moves past the RSTn marker that ends a restart interval
+    void restart() {
+        acc = 0;
+        nbits = 0;
+        if (!at_marker) {
+            while (p + 1 < end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+                p++;
+            }
+        }
+        if (p + 1 < end && p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7) {
+            p += 2;
+        }
+        at_marker = false;
+    }
+};
+
+bool build_huff_table(const uint8_t* counts, const uint8_t* symbols, int total, HuffTable& table) {
+    memset(table.lookup, 0, sizeof(table.lookup));
+    memset(table.skip, 0, sizeof(table.skip));
+    memcpy(table.values, symbols, total);
+
+    int code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+        table.valoffset[len] = k - code;
+        for (int i = 0; i < counts[len - 1]; i++, k++, code++) {
+            if (code >= (1 << len)) {
+                return false; // more codes than fit in len bits
+            }
+            if (len <= HUFF_LOOKAHEAD) {
+                int shift = HUFF_LOOKAHEAD - len;
+                for (int fill = 0; fill < (1 << shift); fill++) {
+                    table.lookup[(code << shift) | fill] = static_cast<uint16_t>((len << 8) | symbols[k]);
+                }
+            }
+            int run = symbols[k] >> 4;
+            int size = symbols[k] & 15;
+            if (len + size <= SKIP_LOOKAHEAD) {
+                // Coefficients an AC symbol accounts for (end of block: all)
+                int advance = size != 0 ? run + 1 : (run == 15 ? 16 : 64);
+                int shift = SKIP_LOOKAHEAD - len;
+                for (int fill = 0; fill < (1 << shift); fill++) {
+                    table.skip[(code << shift) | fill] = static_cast<uint16_t>((advance << 8) | (len + size));
+                }
+            }
+        }
+        table.maxcode[len] = counts[len - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table.maxcode[17] = INT32_MAX;
+    table.defined = true;
+    return true;
+}
+
+inline int extend(int value, int bits) {
+    return value < (1 << (bits - 1)) ? value - (1 << bits) + 1 : value;
+}
+
+// Skips the 63 AC coefficients of a block
+inline void skip_ac(BitReader& br, const HuffTable& ac) {
+    for (int k = 1; k < 64;) {
+        if (br.nbits < 32) {
+            br.refill();
+        }
+        uint16_t entry = ac.skip[br.peek(SKIP_LOOKAHEAD)];
+        if (entry != 0) {
+            br.skip(entry & 0xFF);
+            k += entry >> 8;
+            continue;
+        }
+        int rs = br.decode(ac);
+        int run = rs >> 4;
+        int size = rs & 15;
+        if (size != 0) {
+            br.skip(size);
+            k += run + 1;
+        } else if (run == 15) {
+            k += 16;
+        } else {
+            break; // end of block
+        }
+    }
+}
+
+inline uint8_t dc_to_pixel(int dc, int quant) {
+    // Same rounding as libjpeg's 1x1 IDCT
+    int value = ((dc * quant + 4) >> 3) + 128;
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// Returns the position just past the entropy-coded data that starts at p
+const uint8_t* skip_entropy_data(const uint8_t* p, const uint8_t* end) {
+    while (p + 1 < end) {
+        if (p[0] == 0xFF && p[1] != 0x00 && !(p[1] >= 0xD0 && p[1] <= 0xD7)) {
+            return p;
+        }
+        p++;
+    }
+    return end;
+}
+
+} // namespace
+
+bool decode_jpeg_dc_luma(const uint8_t* data, size_t size, LumaImage& image, std::string& error) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    if (size < 4 || p[0] != 0xFF || p[1] != 0xD8) {
+        error = "not a JPEG";
+        return false;
+    }
+    p += 2;
+
+    JpegInfo info;
+    memset(&info, 0, sizeof(info));
+    bool have_frame = false;
+
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            error = "corrupt marker";
+            return false;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0xFF) {
+            p++;
+            continue;
+        }
+        if (marker == 0xD9) {
+            break;
+        }
+        size_t length = (static_cast<size_t>(p[2]) << 8) | p[3];
+        const uint8_t* seg = p + 4;
+        const uint8_t* seg_end = p + 2 + length;
+        if (length < 2 || seg_end > end) {
+            error = "truncated segment";
+            return false;
+        }
+
+        if (marker == 0xC0 || marker == 0xC1) { // baseline / extended sequential, Huffman
+            if (length < 8 || seg[0] != 8) {
+                error = "unsupported sample precision";
+                return false;
+            }
+            info.height = (seg[1] << 8) | seg[2];
+            info.width = (seg[3] << 8) | seg[4];
+            info.ncomponents = seg[5];
+            if (info.ncomponents < 1 || info.ncomponents > MAX_COMPONENTS ||
+                length < 8 + static_cast<size_t>(info.ncomponents) * 3 || info.width == 0 || info.height == 0) {
+                error = "unsupported frame header";
+                return false;
+            }
+            for (int i = 0; i < info.ncomponents; i++) {
+                Component& c = info.components[i];
+                c.id = seg[6 + i * 3];
+                c.h = seg[7 + i * 3] >> 4;
+                c.v = seg[7 + i * 3] & 15;
+                c.quant = seg[8 + i * 3] & 3;
+                if (c.h < 1 || c.v < 1) {
+                    error = "bad sampling factors";
+                    return false;
+                }
+                info.max_h = std::max(info.max_h, c.h);
+                info.max_v = std::max(info.max_v, c.v);
+            }
+            have_frame = true;
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            error = "progressive, lossless or arithmetic JPEG";
+            return false;
+        } else if (marker == 0xDB) { // DQT
+            const uint8_t* q = seg;
+            while (q < seg_end) {
+                int precision = q[0] >> 4;
+                int id = q[0] & 3;
+                if (q + 1 + (precision ? 128 : 64) > seg_end) {
+                    error = "bad quantisation table";
+                    return false;
+                }
+                info.quant_dc[id] = precision ? ((q[1] << 8) | q[2]) : q[1];
+                q += 1 + (precision ? 128 : 64);
+            }
+        } else if (marker == 0xC4) { // DHT
+            const uint8_t* h = seg;
+            while (h + 17 <= seg_end) {
+                int table_class = h[0] >> 4;
+                int id = h[0] & 3;
+                int total = 0;
+                for (int i = 1; i <= 16; i++) {
+                    total += h[i];
+                }
+                if (total > 256 || h + 17 + total > seg_end ||
+                    !build_huff_table(h + 1, h + 17, total, table_class ? info.ac[id] : info.dc[id])) {
+                    error = "bad Huffman table";
+                    return false;
+                }
+                h += 17 + total;
+            }
+        } else if (marker == 0xDD) { // DRI
+            if (length < 4) {
+                error = "bad restart interval";
+                return false;
+            }
+            info.restart_interval = (seg[0] << 8) | seg[1];
+        } else if (marker == 0xDA) { // SOS
+            if (!have_frame) {
+                error = "scan before frame header";
+                return false;
+            }
+            // Ns, then 2 bytes per component and 3 for the spectral selection
+            int scan_components = length > 2 ? seg[0] : 0;
+            int scan_index[MAX_COMPONENTS];
+            bool has_luma = false;
+            if (scan_components < 1 || scan_components > info.ncomponents ||
+                length < 6 + static_cast<size_t>(scan_components) * 2) {
+                error = "bad scan header";
+                return false;
+            }
+            for (int i = 0; i < scan_components; i++) {
+                int id = seg[1 + i * 2];
+                int tables = seg[2 + i * 2];
+                scan_index[i] = -1;
+                for (int c = 0; c < info.ncomponents; c++) {
+                    if (info.components[c].id == id) {
+                        scan_index[i] = c;
+                        info.components[c].dc_table = tables >> 4 & 3;
+                        info.components[c].ac_table = tables & 3;
+                    }
+                }
+                if (scan_index[i] < 0 ||
+                    !info.dc[info.components[scan_index[i]].dc_table].defined ||
+                    !info.ac[info.components[scan_index[i]].ac_table].defined) {
+                    error = "bad scan header";
+                    return false;
+                }
+                has_luma = has_luma || scan_index[i] == 0;
+            }
+
+            if (!has_luma) {
+                // Separate chroma scan: jump over it to the next marker
+                p = skip_entropy_data(seg_end, end);
+                continue;
+            }
+
+            const Component& y = info.components[0];
+            const int y_width = (info.width * y.h + info.max_h - 1) / info.max_h;
+            const int y_height = (info.height * y.v + info.max_v - 1) / info.max_v;
+            image.width = (y_width + 7) / 8;
+            image.height = (y_height + 7) / 8;
+            image.pixels.assign(static_cast<size_t>(image.width) * image.height, 0);
+            const int y_quant = info.quant_dc[y.quant];
+
+            BitReader br = { seg_end, end, 0, 0, false };
+            int predictor[MAX_COMPONENTS] = {};
+            int mcus_x;
+            int mcus_y;
+            if (scan_components == 1) {
+                // Non-interleaved: one block per MCU, over the component's own size
+                mcus_x = image.width;
+                mcus_y = image.height;
+            } else {
+                mcus_x = (info.width + info.max_h * 8 - 1) / (info.max_h * 8);
+                mcus_y = (info.height + info.max_v * 8 - 1) / (info.max_v * 8);
+            }
+
+            int mcus_to_restart = info.restart_interval;
+            for (int my = 0; my < mcus_y; my++) {
+                for (int mx = 0; mx < mcus_x; mx++) {
+                    if (info.restart_interval != 0) {
+                        if (mcus_to_restart == 0) {
+                            br.restart();
+                            memset(predictor, 0, sizeof(predictor));
+                            mcus_to_restart = info.restart_interval;
+                        }
+                        mcus_to_restart--;
+                    }
+
+                    for (int i = 0; i < scan_components; i++) {
+                        int c = scan_index[i];
+                        const Component& comp = info.components[c];
+                        const HuffTable& dc = info.dc[comp.dc_table];
+                        const HuffTable& ac = info.ac[comp.ac_table];
+                        int bh = scan_components == 1 ? 1 : comp.h;
+                        int bv = scan_components == 1 ? 1 : comp.v;
+
+                        for (int by = 0; by < bv; by++) {
+                            for (int bx = 0; bx < bh; bx++) {
+                                if (br.nbits < 32) {
+                                    br.refill();
+                                }
+                                int s = br.decode(dc);
+                                if (s > 11) {
+                                    // 8-bit DC differences need at most 11 bits
+                                    error = "bad DC coefficient";
+                                    return false;
+                                }
+                                if (s != 0) {
+                                    predictor[c] += extend(br.get(s), s);
+                                }
+                                skip_ac(br, ac);
+
+                                if (c == 0) {
+                                    int col = mx * bh + bx;
+                                    int row = my * bv + by;
+                                    if (col < image.width && row < image.height) {
+                                        image.pixels[static_cast<size_t>(row) * image.width + col] =
+                                            dc_to_pixel(predictor[0], y_quant);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return true; // luma is complete; later scans only hold chroma
+        }
+
+        p = seg_end;
+    }
+
+    error = "no image data";
+    return false;
+}
+
+bool decode_jpeg_dc_luma(const std::string& path, LumaImage& image, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = "cannot read " + path;
+        return false;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+    bool ok = decode_jpeg_dc_luma(static_cast<const uint8_t*>(map), size, image, error);
+    munmap(map, size);
+    if (!ok) {
+        // Progressive/arithmetic (or damaged) files: let libjpeg have a go
+        return decode_jpeg_luma_scaled(path, 8, image, error);
+    }
+    return true;
+}
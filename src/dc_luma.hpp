@@ -0,0 +1,31 @@
+// dc_luma.hpp
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "yuv_frame.hpp"
+
+// --- DC-Only Luma Decode ---
+// The DC coefficient of an 8x8 JPEG block is the block's mean brightness.
+// For block-level luma (exposure curves, light levels, deflicker gains) that
+// is all we need, so this decoder only Huffman-decodes the bitstream. It
+// keeps the Y DC values and skips every AC coefficient and chroma block
+// without dequantising it. There is no IDCT, upsampling or colour
+// conversion. The result is a (w/8)x(h/8) luma map, bit-identical to
+// libjpeg's 1/8 scale greyscale decode.
+//
+// Baseline and extended sequential Huffman JPEGs only (what cameras write).
+// Progressive or arithmetic-coded files, such as those from `timelapse
+// recompress`, make decode_jpeg_dc_luma() fall back to the libjpeg 1/8
+// decode.
+
+// Decodes a JPEG held in memory. Returns false (with `error`) for
+// unsupported or corrupt files.
+bool decode_jpeg_dc_luma(const uint8_t* data, size_t size, LumaImage& image, std::string& error);
+
+// Maps the file and decodes it; falls back to decode_jpeg_luma_scaled(8)
+// for files the DC decoder doesn't handle.
+bool decode_jpeg_dc_luma(const std::string& path, LumaImage& image, std::string& error);
@@ -0,0 +1,221 @@
+// encode_backlog.cpp
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "encode_backlog.hpp"
+#include "utils.hpp"
+
+// Don't retry a day sooner than this after its last attempt
+#define BACKLOG_RETRY_SECONDS 1800
+
+// Local midnight of a YYYYMMDD... prefix, or -1 if it doesn't start with a date
+static long prefix_day(const std::string& prefix) {
+    if (prefix.size() < 8 || !std::all_of(prefix.begin(), prefix.begin() + 8, ::isdigit)) {
+        return -1;
+    }
+    std::tm tm = {};
+    tm.tm_year = std::stoi(prefix.substr(0, 4)) - 1900;
+    tm.tm_mon = std::stoi(prefix.substr(4, 2)) - 1;
+    tm.tm_mday = std::stoi(prefix.substr(6, 2));
+    tm.tm_isdst = -1;
+    return static_cast<long>(std::mktime(&tm));
+}
+
+EncodeBacklog::EncodeBacklog(const std::string& path, int max_attempts)
+    : path(path), max_attempts(max_attempts), rate(0.0) {
+    load();
+}
+
+void EncodeBacklog::load() {
+    entries.clear();
+    encoded.clear();
+    std::ifstream file(path);
+    std::string key;
+    while (file >> key) {
+        if (key == "rate") {
+            file >> rate;
+        } else if (key == "day") {
+            BacklogEntry entry;
+            if (file >> entry.prefix >> entry.frames >> entry.attempts >> entry.last_attempt) {
+                entries.push_back(entry);
+            }
+        } else if (key == "encoded") {
+            std::string prefix;
+            if (file >> prefix) {
+                encoded.push_back(prefix);
+            }
+        } else {
+            std::string ignored;
+            std::getline(file, ignored);
+        }
+    }
+}
+
+bool EncodeBacklog::save() {
+    std::stringstream ss;
+    ss << "rate " << rate << "\n";
+    for (const BacklogEntry& entry : entries) {
+        ss << "day " << entry.prefix << " " << entry.frames << " " << entry.attempts << " " << entry.last_attempt
+           << "\n";
+    }
+    for (const std::string& prefix : encoded) {
+        ss << "encoded " << prefix << "\n";
+    }
+    std::string data = ss.str();
+    return write_file_atomic(path, data.data(), data.size(), true);
+}
+
+void EncodeBacklog::refresh(const std::string& pics_dir, const std::string& videos_dir, int max_days,
+                            const std::string& skip_prefix) {
+    std::lock_guard<std::mutex> lock(mutex);
+    load();
+
+    std::time_t now = std::time(nullptr);
+    std::tm tm = *std::localtime(&now);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    const long today = static_cast<long>(std::mktime(&tm));
+    // +12h: a DST change makes a day 23 or 25 hours long
+    auto outside_window = [&](long day) { return day < 0 || (today - day + 43200) / 86400 > max_days; };
+
+    bool changed = false;
+    size_t kept = 0;
+    for (const std::string& prefix : encoded) {
+        if (!outside_window(prefix_day(prefix))) {
+            encoded[kept++] = prefix;
+        }
+    }
+    if (kept != encoded.size()) {
+        encoded.resize(kept);
+        changed = true;
+    }
+
+    std::vector<BacklogEntry> found;
+    for (const std::string& name : list_dir(pics_dir)) {
+        if (name.size() <= 5 || name.compare(name.size() - 5, 5, "_pics") != 0) {
+            continue;
+        }
+        std::string prefix = name.substr(0, name.size() - 5);
+        if (prefix == skip_prefix || outside_window(prefix_day(prefix))) {
+            continue;
+        }
+        if (std::find(encoded.begin(), encoded.end(), prefix) != encoded.end()) {
+            continue;
+        }
+        // Encoded before it was recorded here (or by hand)
+        std::string video = videos_dir + prefix + "_timelapse.mp4";
+        if (file_exists(video) || file_exists(video + ".backed_up")) {
+            encoded.push_back(prefix);
+            changed = true;
+            continue;
+        }
+
+        int frames = 0;
+        for (const std::string& frame : list_dir(pics_dir + name)) {
+            if (frame.size() > prefix.size() + 4 && frame.compare(0, prefix.size(), prefix) == 0 &&
+                frame.compare(frame.size() - 4, 4, ".jpg") == 0) {
+                frames++;
+            }
+        }
+        if (frames == 0) {
+            continue;
+        }
+
+        BacklogEntry entry = { prefix, frames, 0, 0 };
+        for (const BacklogEntry& known : entries) {
+            if (known.prefix == prefix) {
+                entry.attempts = known.attempts;
+                entry.last_attempt = known.last_attempt;
+            }
+        }
+        found.push_back(entry);
+    }
+
+    // Days that got their video (or were deleted) drop out here
+    if (found.size() != entries.size() ||
+        !std::equal(found.begin(), found.end(), entries.begin(), [](const BacklogEntry& a, const BacklogEntry& b) {
+            return a.prefix == b.prefix && a.frames == b.frames;
+        })) {
+        entries.swap(found);
+        changed = true;
+    }
+    if (changed) {
+        save();
+    }
+}
+
+bool EncodeBacklog::next(long now, const std::string& today_prefix, BacklogEntry& entry) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const BacklogEntry* best = nullptr;
+    for (const BacklogEntry& e : entries) {
+        if (e.attempts >= max_attempts || (e.attempts > 0 && now - e.last_attempt < BACKLOG_RETRY_SECONDS)) {
+            continue;
+        }
+        if (e.prefix == today_prefix) {
+            best = &e;
+            break;
+        }
+        if (best == nullptr || e.prefix < best->prefix) { // names start with the date: oldest first
+            best = &e;
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+    entry = *best;
+    return true;
+}
+
+void EncodeBacklog::record(const std::string& prefix, int frames, bool ok, long now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const BacklogEntry& e) {
+        return e.prefix == prefix;
+    });
+    if (ok) {
+        if (it != entries.end()) {
+            entries.erase(it);
+        }
+        if (std::find(encoded.begin(), encoded.end(), prefix) == encoded.end()) {
+            encoded.push_back(prefix);
+        }
+    } else {
+        if (it == entries.end()) {
+            entries.push_back({ prefix, frames, 0, 0 });
+            it = entries.end() - 1;
+        }
+        it->attempts++;
+        it->last_attempt = now;
+    }
+    save();
+}
+
+void EncodeBacklog::record_rate(double seconds_per_frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rate = rate > 0.0 ? 0.7 * rate + 0.3 * seconds_per_frame : seconds_per_frame;
+    save();
+}
+
+double EncodeBacklog::seconds_per_frame() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rate;
+}
+
+int EncodeBacklog::depth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(std::count_if(entries.begin(), entries.end(), [this](const BacklogEntry& e) {
+        return e.attempts < max_attempts;
+    }));
+}
+
+int EncodeBacklog::gave_up() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(entries.size()) - static_cast<int>(std::count_if(
+        entries.begin(), entries.end(), [this](const BacklogEntry& e) { return e.attempts < max_attempts; }));
+}
@@ -0,0 +1,79 @@
+// encode_backlog.hpp
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --- Encode Backlog ---
+// A day whose video failed to encode, or whose run was cut short by a
+// reboot, used to keep its frames but never get a video. The backlog keeps
+// a list of those days and encodes them when the camera is idle: before the
+// capture window and after the day's own pipeline.
+//
+// It is rebuilt from the catalog each time: day directories in pics/ from
+// the last backlog_days days that have frames but have not been encoded.
+// Videos are written under a temporary name and renamed when complete, so a
+// half-written video never counts as done. A day counts as encoded once an
+// encode of it succeeded, which the queue file records: manager.py cleanup
+// deletes videos (keep_videos) while their photos stay, so a missing video
+// doesn't mean a missing encode. A day with a video (or its .backed_up
+// marker) but no record, e.g. one encoded by hand, is recorded as encoded
+// when it is found. The queue file (logs/encode_backlog.txt) keeps:
+//
+//   rate <encode seconds per frame, from the last encodes>
+//   day <prefix> <frames> <attempts> <last attempt epoch>
+//   encoded <prefix>
+//
+// Encoded records older than the scan window are dropped.
+//
+// A day is retried at most max_attempts times, and not within half an hour
+// of its last attempt. The file is replaced atomically and fsynced after
+// every attempt.
+//
+// Order: today's day first (its own encode failed), then the oldest.
+
+struct BacklogEntry {
+    std::string prefix; // e.g. 20251114_Pi0Cam
+    int frames;
+    int attempts;
+    long last_attempt; // epoch seconds, 0 = never tried
+};
+
+class EncodeBacklog {
+public:
+    EncodeBacklog(const std::string& path, int max_attempts);
+
+    // Re-reads the queue file and re-scans the catalog (days of the last
+    // max_days). skip_prefix is a day still being captured.
+    void refresh(const std::string& pics_dir, const std::string& videos_dir, int max_days,
+                 const std::string& skip_prefix);
+
+    // Next day to encode at `now`. False if nothing is due.
+    bool next(long now, const std::string& today_prefix, BacklogEntry& entry) const;
+
+    // Records an encode attempt and saves the queue. Success removes the day
+    // and records it as encoded.
+    void record(const std::string& prefix, int frames, bool ok, long now);
+
+    // Folds one finished encode's speed into the estimate
+    void record_rate(double seconds_per_frame);
+
+    // Encode seconds per frame (moving average, 0 = not measured yet)
+    double seconds_per_frame() const;
+
+    int depth() const;   // days waiting for a video
+    int gave_up() const; // days that failed max_attempts times
+
+private:
+    std::string path;
+    int max_attempts;
+    double rate;
+    std::vector<BacklogEntry> entries;
+    std::vector<std::string> encoded; // days with a successful encode
+    mutable std::mutex mutex;
+
+    void load();
+    bool save();
+};
@@ -0,0 +1,352 @@
+// fault_shim.cpp
+//
+// LD_PRELOAD library that makes storage behave like a dying SD card, for
+// benchmarking the capture and render paths at their worst. Built with
+// `make faultshim` (programs/libfaultshim.so) and driven by
+// programs/fault_bench.sh.
+//
+// Only files under FAULT_PATH_PREFIX are affected (so logs and the binary
+// itself stay fast). Settings, all optional:
+//
+//   FAULT_PATH_PREFIX      e.g. /tmp/bench/  (required - nothing happens without it)
+//   FAULT_LATENCY_MS       added to every read/write call (plain, vectored, stdio)
+//   FAULT_FSYNC_MS         added to every fsync/fdatasync
+//   FAULT_THROUGHPUT_KBPS  shared read+write bandwidth cap
+//   FAULT_STALL_EVERY      every Nth write call stalls ...
+//   FAULT_STALL_MS         ... for this long (SD card garbage collection)
+//   FAULT_ENOSPC_AFTER_MB  writes fail with ENOSPC once this much was written
+//   FAULT_EIO_RATE         probability (0-1) that a read or write fails with EIO
+//   FAULT_SEED             seed for the EIO dice (default 1)
+//
+// Child processes inherit LD_PRELOAD, so capture_command tools are slowed
+// down too.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define FAULT_MAX_FDS 65536
+
+namespace {
+
+struct FaultConfig {
+    char prefix[512];
+    size_t prefix_len;
+    long latency_us;
+    long fsync_us;
+    double throughput_bps;
+    long stall_every;
+    long stall_us;
+    long long enospc_after;
+    double eio_rate;
+};
+
+FaultConfig config;
+std::atomic<bool> tracked[FAULT_MAX_FDS];
+std::atomic<long long> bytes_written(0);
+std::atomic<long> write_calls(0);
+std::atomic<unsigned long> dice(1);
+std::mutex throughput_mutex;
+double throughput_next_free = 0.0;
+
+long env_long(const char* name, long fallback) {
+    const char* v = getenv(name);
+    return v ? atol(v) : fallback;
+}
+
+double env_double(const char* name, double fallback) {
+    const char* v = getenv(name);
+    return v ? atof(v) : fallback;
+}
+
+__attribute__((constructor)) void load_fault_config() {
+    const char* prefix = getenv("FAULT_PATH_PREFIX");
+    snprintf(config.prefix, sizeof(config.prefix), "%s", prefix ? prefix : "");
+    config.prefix_len = strlen(config.prefix);
+    config.latency_us = env_long("FAULT_LATENCY_MS", 0) * 1000;
+    config.fsync_us = env_long("FAULT_FSYNC_MS", 0) * 1000;
+    config.throughput_bps = env_double("FAULT_THROUGHPUT_KBPS", 0) * 1024;
+    config.stall_every = env_long("FAULT_STALL_EVERY", 0);
+    config.stall_us = env_long("FAULT_STALL_MS", 0) * 1000;
+    config.enospc_after = env_long("FAULT_ENOSPC_AFTER_MB", 0) * 1024LL * 1024;
+    config.eio_rate = env_double("FAULT_EIO_RATE", 0);
+    dice = static_cast<unsigned long>(env_long("FAULT_SEED", 1)) | 1;
+}
+
+template <typename Fn>
+Fn real(const char* name) {
+    return reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+}
+
+bool path_matches(const char* path) {
+    return config.prefix_len > 0 && path != nullptr && strncmp(path, config.prefix, config.prefix_len) == 0;
+}
+
+void track(int fd, const char* path) {
+    if (fd >= 0 && fd < FAULT_MAX_FDS) {
+        tracked[fd] = path_matches(path);
+    }
+}
+
+bool is_tracked(int fd) {
+    return fd >= 0 && fd < FAULT_MAX_FDS && tracked[fd];
+}
+
+void sleep_us(long us) {
+    if (us <= 0) {
+        return;
+    }
+    timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift; shared and lock-free, good enough for fault dice
+bool roll_eio() {
+    if (config.eio_rate <= 0) {
+        return false;
+    }
+    unsigned long x = dice.load();
+    unsigned long next;
+    do {
+        next = x;
+        next ^= next << 13;
+        next ^= next >> 7;
+        next ^= next << 17;
+    } while (!dice.compare_exchange_weak(x, next));
+    return (next % 1000000) < static_cast<unsigned long>(config.eio_rate * 1000000);
+}
+
+void throttle(size_t bytes) {
+    if (config.throughput_bps <= 0) {
+        return;
+    }
+    double wait;
+    {
+        std::lock_guard<std::mutex> lock(throughput_mutex);
+        double now = now_seconds();
+        if (throughput_next_free < now) {
+            throughput_next_free = now;
+        }
+        throughput_next_free += bytes / config.throughput_bps;
+        wait = throughput_next_free - now;
+    }
+    sleep_us(static_cast<long>(wait * 1e6));
+}
+
+// Applies the faults for an I/O call on a tracked file. Returns false (with
+// errno set) if the call should fail instead.
+bool before_io(size_t bytes, bool is_write) {
+    sleep_us(config.latency_us);
+    if (is_write) {
+        long n = ++write_calls;
+        if (config.stall_every > 0 && n % config.stall_every == 0) {
+            sleep_us(config.stall_us);
+        }
+        if (config.enospc_after > 0 && bytes_written + static_cast<long long>(bytes) > config.enospc_after) {
+            errno = ENOSPC;
+            return false;
+        }
+    }
+    if (roll_eio()) {
+        errno = EIO;
+        return false;
+    }
+    throttle(bytes);
+    if (is_write) {
+        bytes_written += bytes;
+    }
+    return true;
+}
+
+size_t iov_bytes(const struct iovec* iov, int iovcnt) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    return total;
+}
+
+mode_t mode_arg(int flags, va_list args) {
+    return (flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE ? va_arg(args, mode_t) : 0;
+}
+
+} // namespace
+
+extern "C" {
+
+int open(const char* path, int flags, ...) {
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = mode_arg(flags, args);
+    va_end(args);
+    int fd = real<int (*)(const char*, int, ...)>("open")(path, flags, mode);
+    track(fd, path);
+    return fd;
+}
+
+int open64(const char* path, int flags, ...) {
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = mode_arg(flags, args);
+    va_end(args);
+    int fd = real<int (*)(const char*, int, ...)>("open64")(path, flags, mode);
+    track(fd, path);
+    return fd;
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = mode_arg(flags, args);
+    va_end(args);
+    int fd = real<int (*)(int, const char*, int, ...)>("openat")(dirfd, path, flags, mode);
+    track(fd, path);
+    return fd;
+}
+
+int creat(const char* path, mode_t mode) {
+    int fd = real<int (*)(const char*, mode_t)>("creat")(path, mode);
+    track(fd, path);
+    return fd;
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    FILE* f = real<FILE* (*)(const char*, const char*)>("fopen")(path, mode);
+    if (f != nullptr) {
+        track(fileno(f), path);
+    }
+    return f;
+}
+
+FILE* fopen64(const char* path, const char* mode) {
+    FILE* f = real<FILE* (*)(const char*, const char*)>("fopen64")(path, mode);
+    if (f != nullptr) {
+        track(fileno(f), path);
+    }
+    return f;
+}
+
+int close(int fd) {
+    if (fd >= 0 && fd < FAULT_MAX_FDS) {
+        tracked[fd] = false;
+    }
+    return real<int (*)(int)>("close")(fd);
+}
+
+int fclose(FILE* f) {
+    if (f != nullptr) {
+        int fd = fileno(f);
+        if (fd >= 0 && fd < FAULT_MAX_FDS) {
+            tracked[fd] = false;
+        }
+    }
+    return real<int (*)(FILE*)>("fclose")(f);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    if (is_tracked(fd) && !before_io(count, true)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, const void*, size_t)>("write")(fd, buf, count);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    if (is_tracked(fd) && !before_io(count, true)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, const void*, size_t, off_t)>("pwrite")(fd, buf, count, offset);
+}
+
+// std::ofstream flushes with writev
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    if (is_tracked(fd) && !before_io(iov_bytes(iov, iovcnt), true)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, const struct iovec*, int)>("writev")(fd, iov, iovcnt);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    if (is_tracked(fd) && !before_io(count, false)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, void*, size_t)>("read")(fd, buf, count);
+}
+
+ssize_t __read_chk(int fd, void* buf, size_t count, size_t buflen) {
+    if (is_tracked(fd) && !before_io(count, false)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, void*, size_t, size_t)>("__read_chk")(fd, buf, count, buflen);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+    if (is_tracked(fd) && !before_io(iov_bytes(iov, iovcnt), false)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, const struct iovec*, int)>("readv")(fd, iov, iovcnt);
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+    if (is_tracked(fd) && !before_io(count, false)) {
+        return -1;
+    }
+    return real<ssize_t (*)(int, void*, size_t, off_t)>("pread")(fd, buf, count, offset);
+}
+
+// stdio does its own buffering with internal calls, so hook the entry points
+size_t fwrite(const void* ptr, size_t size, size_t n, FILE* f) {
+    if (is_tracked(fileno(f)) && !before_io(size * n, true)) {
+        return 0;
+    }
+    return real<size_t (*)(const void*, size_t, size_t, FILE*)>("fwrite")(ptr, size, n, f);
+}
+
+size_t fread(void* ptr, size_t size, size_t n, FILE* f) {
+    if (is_tracked(fileno(f)) && !before_io(size * n, false)) {
+        return 0;
+    }
+    return real<size_t (*)(void*, size_t, size_t, FILE*)>("fread")(ptr, size, n, f);
+}
+
+int fsync(int fd) {
+    if (is_tracked(fd)) {
+        sleep_us(config.fsync_us);
+        if (roll_eio()) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    return real<int (*)(int)>("fsync")(fd);
+}
+
+int fdatasync(int fd) {
+    if (is_tracked(fd)) {
+        sleep_us(config.fsync_us);
+        if (roll_eio()) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    return real<int (*)(int)>("fdatasync")(fd);
+}
+
+} // extern "C"
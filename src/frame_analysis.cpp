@@ -0,0 +1,364 @@
+// frame_analysis.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_analysis.hpp"
+#include "jpeg_error.hpp"
+#include "pixel_kernels.hpp"
+
+// Photos without an EXIF thumbnail are decoded at this scale instead
+#define ANALYSIS_FALLBACK_SCALE 8
+
+static uint16_t read_u16(const uint8_t* p, bool little_endian) {
+    return little_endian ? static_cast<uint16_t>(p[0] | (p[1] << 8))
+                         : static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uint8_t* p, bool little_endian) {
+    return little_endian ? (static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                            (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24))
+                         : ((static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                            (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]));
+}
+
+// Looks up the thumbnail tags in IFD1 of a TIFF block (EXIF payload)
+static bool find_tiff_thumbnail(const uint8_t* tiff, size_t size, size_t& offset, size_t& length) {
+    if (size < 8) {
+        return false;
+    }
+    bool le;
+    if (tiff[0] == 'I' && tiff[1] == 'I') {
+        le = true;
+    } else if (tiff[0] == 'M' && tiff[1] == 'M') {
+        le = false;
+    } else {
+        return false;
+    }
+    if (read_u16(tiff + 2, le) != 42) {
+        return false;
+    }
+
+    // IFD0 is the main image; the word after its entries points at IFD1
+    uint32_t ifd0 = read_u32(tiff + 4, le);
+    if (static_cast<size_t>(ifd0) + 2 > size) {
+        return false;
+    }
+    uint32_t entries = read_u16(tiff + ifd0, le);
+    size_t next = ifd0 + 2 + static_cast<size_t>(entries) * 12;
+    if (next + 4 > size) {
+        return false;
+    }
+    uint32_t ifd1 = read_u32(tiff + next, le);
+    if (ifd1 == 0 || static_cast<size_t>(ifd1) + 2 > size) {
+        return false;
+    }
+
+    entries = read_u16(tiff + ifd1, le);
+    uint32_t thumb_offset = 0;
+    uint32_t thumb_length = 0;
+    for (uint32_t i = 0; i < entries; i++) {
+        size_t entry = ifd1 + 2 + static_cast<size_t>(i) * 12;
+        if (entry + 12 > size) {
+            return false;
+        }
+        uint16_t tag = read_u16(tiff + entry, le);
+        uint16_t type = read_u16(tiff + entry + 2, le);
+        // LONG (4) normally; some writers use SHORT (3)
+        uint32_t value = type == 3 ? read_u16(tiff + entry + 8, le) : read_u32(tiff + entry + 8, le);
+        if (tag == 0x0201) { // JPEGInterchangeFormat
+            thumb_offset = value;
+        } else if (tag == 0x0202) { // JPEGInterchangeFormatLength
+            thumb_length = value;
+        }
+    }
+
+    if (thumb_offset == 0 || thumb_length < 4 || static_cast<size_t>(thumb_offset) + thumb_length > size ||
+        tiff[thumb_offset] != 0xFF || tiff[thumb_offset + 1] != 0xD8) {
+        return false;
+    }
+    offset = thumb_offset;
+    length = thumb_length;
+    return true;
+}
+
+bool find_exif_thumbnail(const uint8_t* data, size_t size, size_t& offset, size_t& length) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    // Walk the marker segments up to the image data
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++; // fill byte
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9) { // start of scan / end of image
+            return false;
+        }
+        size_t segment = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        if (segment < 2 || pos + 2 + segment > size) {
+            return false;
+        }
+        if (marker == 0xE1 && segment >= 8 && memcmp(data + pos + 4, "Exif\0\0", 6) == 0) {
+            size_t tiff = pos + 10;
+            if (find_tiff_thumbnail(data + tiff, segment - 8, offset, length)) {
+                offset += tiff;
+                return true;
+            }
+            return false;
+        }
+        pos += 2 + segment;
+    }
+    return false;
+}
+
+// Decodes a JPEG held in memory to RGB at 1/scale_denom size
+static bool decode_rgb(const uint8_t* data, size_t size, int scale_denom, Thumbnail& thumb, std::string& error) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+
+    if (setjmp(err.jump)) {
+        error = err.message;
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, size);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    thumb.width = cinfo.output_width;
+    thumb.height = cinfo.output_height;
+    thumb.rgb.resize(static_cast<size_t>(thumb.width) * thumb.height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &thumb.rgb[static_cast<size_t>(cinfo.output_scanline) * thumb.width * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+bool load_thumbnail(const std::string& path, Thumbnail& thumb, std::string& error, bool fallback) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = "cannot read " + path;
+        return false;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(map);
+
+    size_t offset = 0;
+    size_t length = 0;
+    bool ok = false;
+    if (find_exif_thumbnail(data, size, offset, length)) {
+        thumb.from_exif = true;
+        ok = decode_rgb(data + offset, length, 1, thumb, error);
+    }
+    if (!ok && !fallback) {
+        thumb.from_exif = false;
+        thumb.width = 0;
+        thumb.height = 0;
+        ok = true;
+    } else if (!ok) {
+        // No (usable) thumbnail: the whole file is needed after all
+        posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+        thumb.from_exif = false;
+        ok = decode_rgb(data, size, ANALYSIS_FALLBACK_SCALE, thumb, error);
+    }
+    munmap(map, size);
+    if (!ok) {
+        error = path + ": " + error;
+    }
+    return ok;
+}
+
+bool parse_sky_region(const std::string& text, SkyRegion& sky) {
+    double left, top, right, bottom;
+    if (sscanf(text.c_str(), "%lf,%lf,%lf,%lf", &left, &top, &right, &bottom) != 4 || left < 0.0 || top < 0.0 ||
+        right > 1.0 || bottom > 1.0 || left >= right || top >= bottom) {
+        return false;
+    }
+    sky.left = left;
+    sky.top = top;
+    sky.right = right;
+    sky.bottom = bottom;
+    return true;
+}
+
+// Cloud cover of the sky region, counted on the thumbnail's own pixels
+static double sky_cloud_cover(const Thumbnail& thumb, const SkyRegion& sky) {
+    int x0 = static_cast<int>(sky.left * thumb.width);
+    int x1 = std::max(x0 + 1, static_cast<int>(sky.right * thumb.width));
+    int y0 = static_cast<int>(sky.top * thumb.height);
+    int y1 = std::max(y0 + 1, static_cast<int>(sky.bottom * thumb.height));
+    x1 = std::min(x1, thumb.width);
+    y1 = std::min(y1, thumb.height);
+    if (x0 >= x1 || y0 >= y1) {
+        return -1.0;
+    }
+
+    const PixelKernels& k = pixel_kernels();
+    const int ratio_q8 = std::min(256, std::max(0, static_cast<int>(sky.cloud_ratio * 256.0 + 0.5)));
+    uint32_t counts[2] = {};
+    for (int y = y0; y < y1; y++) {
+        k.sky_counts(&thumb.rgb[(static_cast<size_t>(y) * thumb.width + x0) * 3], x1 - x0, sky.min_luma * 3, ratio_q8,
+                     counts);
+    }
+    uint32_t pixels = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+    if (counts[0] == 0 || counts[0] < sky.min_lit * pixels) {
+        return -1.0;
+    }
+    return 100.0 * counts[1] / counts[0];
+}
+
+// Mean luma and difference hash of an analysed frame's grid
+static void grid_stats(FrameAnalysis& analysis) {
+    const double cells = ANALYSIS_WIDTH * ANALYSIS_HEIGHT;
+    uint32_t hist[256] = {};
+    pixel_kernels().histogram(analysis.grid.data(), analysis.grid.size(), hist);
+    uint64_t sum_y = 0;
+    for (int v = 0; v < 256; v++) {
+        sum_y += static_cast<uint64_t>(v) * hist[v];
+    }
+    analysis.luma = sum_y / cells;
+
+    // Difference hash: shrink to 9x8, one bit per horizontal neighbour pair
+    uint64_t hash = 0;
+    for (int hy = 0; hy < 8; hy++) {
+        int row = hy * ANALYSIS_HEIGHT / 8;
+        int prev = -1;
+        for (int hx = 0; hx < 9; hx++) {
+            int x0 = hx * ANALYSIS_WIDTH / 9;
+            int x1 = (hx + 1) * ANALYSIS_WIDTH / 9;
+            int sum = 0;
+            for (int y = row; y < row + ANALYSIS_HEIGHT / 8; y++) {
+                for (int x = x0; x < x1; x++) {
+                    sum += analysis.grid[y * ANALYSIS_WIDTH + x];
+                }
+            }
+            int value = sum / ((x1 - x0) * (ANALYSIS_HEIGHT / 8));
+            if (prev >= 0) {
+                hash = (hash << 1) | (prev < value ? 1 : 0);
+            }
+            prev = value;
+        }
+    }
+    analysis.phash = hash;
+}
+
+void analyse_thumbnail(const Thumbnail& thumb, FrameAnalysis& analysis, const SkyRegion& sky) {
+    analysis.grid.assign(ANALYSIS_WIDTH * ANALYSIS_HEIGHT, 0);
+    analysis.cloud = -1.0;
+    if (thumb.width <= 0 || thumb.height <= 0) {
+        return;
+    }
+    analysis.cloud = sky_cloud_cover(thumb, sky);
+    uint64_t sum_r = 0, sum_g = 0, sum_b = 0;
+
+    // Box-average the thumbnail onto the grid (each cell at least one pixel)
+    for (int gy = 0; gy < ANALYSIS_HEIGHT; gy++) {
+        int y0 = gy * thumb.height / ANALYSIS_HEIGHT;
+        int y1 = std::max(y0 + 1, (gy + 1) * thumb.height / ANALYSIS_HEIGHT);
+        for (int gx = 0; gx < ANALYSIS_WIDTH; gx++) {
+            int x0 = gx * thumb.width / ANALYSIS_WIDTH;
+            int x1 = std::max(x0 + 1, (gx + 1) * thumb.width / ANALYSIS_WIDTH);
+            uint32_t r = 0, g = 0, b = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* p = &thumb.rgb[(static_cast<size_t>(y) * thumb.width + x0) * 3];
+                for (int x = x0; x < x1; x++, p += 3) {
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            uint32_t n = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+            r /= n;
+            g /= n;
+            b /= n;
+            sum_r += r;
+            sum_g += g;
+            sum_b += b;
+            // BT.601 luma, as JPEG's Y
+            analysis.grid[gy * ANALYSIS_WIDTH + gx] = static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+    }
+
+    const double cells = ANALYSIS_WIDTH * ANALYSIS_HEIGHT;
+    analysis.red = sum_r / cells;
+    analysis.green = sum_g / cells;
+    analysis.blue = sum_b / cells;
+    grid_stats(analysis);
+}
+
+void analyse_luma(const LumaImage& image, FrameAnalysis& analysis) {
+    analysis.grid.assign(ANALYSIS_WIDTH * ANALYSIS_HEIGHT, 0);
+    analysis.red = -1.0;
+    analysis.green = -1.0;
+    analysis.blue = -1.0;
+    analysis.cloud = -1.0;
+    if (image.width <= 0 || image.height <= 0) {
+        return;
+    }
+
+    // Box-average onto the grid, as analyse_thumbnail does
+    for (int gy = 0; gy < ANALYSIS_HEIGHT; gy++) {
+        int y0 = gy * image.height / ANALYSIS_HEIGHT;
+        int y1 = std::max(y0 + 1, (gy + 1) * image.height / ANALYSIS_HEIGHT);
+        for (int gx = 0; gx < ANALYSIS_WIDTH; gx++) {
+            int x0 = gx * image.width / ANALYSIS_WIDTH;
+            int x1 = std::max(x0 + 1, (gx + 1) * image.width / ANALYSIS_WIDTH);
+            uint32_t sum = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* p = &image.pixels[static_cast<size_t>(y) * image.width + x0];
+                for (int x = x0; x < x1; x++) {
+                    sum += *p++;
+                }
+            }
+            analysis.grid[gy * ANALYSIS_WIDTH + gx] = static_cast<uint8_t>(sum / ((y1 - y0) * (x1 - x0)));
+        }
+    }
+    grid_stats(analysis);
+}
+
+double analysis_motion(const FrameAnalysis& a, const FrameAnalysis& b) {
+    if (a.grid.size() != b.grid.size() || a.grid.empty()) {
+        return 0.0;
+    }
+    return static_cast<double>(pixel_kernels().sad(a.grid.data(), b.grid.data(), a.grid.size())) / a.grid.size();
+}
+
+int phash_distance(uint64_t a, uint64_t b) {
+    return __builtin_popcountll(a ^ b);
+}
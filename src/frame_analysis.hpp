@@ -0,0 +1,89 @@
+// frame_analysis.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "yuv_frame.hpp"
+
+// --- Frame Analysis on Thumbnails ---
+// Per-frame statistics (brightness, colour balance, motion, scene change)
+// don't need 2 million pixels. rpicam-still embeds a small JPEG thumbnail in
+// every photo's EXIF block (320x240 by default), which sits in the first few
+// KB of the file. load_thumbnail() maps the file, walks the JPEG markers to
+// APP1/EXIF, follows IFD1 to the thumbnail and decodes only that; the rest
+// of the file is never read. Photos without one (webcams, network cameras)
+// fall back to a 1/8 scale decode, where libjpeg skips most of the IDCT.
+//
+// Whatever the source, statistics are taken on a fixed 64x48 grid, so
+// frames with and without EXIF thumbnails stay comparable. Cloud cover is
+// the exception: it is counted on the thumbnail's own pixels in the sky
+// region.
+
+#define ANALYSIS_WIDTH 64
+#define ANALYSIS_HEIGHT 48
+
+struct Thumbnail {
+    int width;
+    int height;
+    std::vector<uint8_t> rgb; // width * height * 3
+    bool from_exif;
+
+    Thumbnail() : width(0), height(0), from_exif(false) {}
+};
+
+// Finds the EXIF thumbnail in a JPEG held in memory. Returns false if there
+// is none; offset/length locate the embedded JPEG within `data`.
+bool find_exif_thumbnail(const uint8_t* data, size_t size, size_t& offset, size_t& length);
+
+// EXIF thumbnail if there is one, otherwise a 1/8 scale decode. With
+// `fallback` false, a photo without a thumbnail leaves `thumb` empty (width
+// 0) and still returns true. `thumb` is reused between calls.
+bool load_thumbnail(const std::string& path, Thumbnail& thumb, std::string& error, bool fallback = true);
+
+// Cloud cover: within the sky region (fractions of the frame), the share of
+// lit pixels that are grey/white rather than blue. Clear sky has far less
+// red than blue; cloud has about as much of each. The red/blue test doesn't
+// depend on brightness, and pixels darker than min_luma are left out, so
+// the figure holds from overcast noon to dusk. Below min_lit of the region
+// lit (night), there is no figure.
+struct SkyRegion {
+    double left;
+    double top;
+    double right;
+    double bottom;
+    int min_luma;       // mean of r, g, b a pixel needs to count
+    double cloud_ratio; // red/blue at or above this = cloud
+    double min_lit;
+
+    SkyRegion() : left(0.0), top(0.0), right(1.0), bottom(0.33), min_luma(40), cloud_ratio(0.75), min_lit(0.25) {}
+};
+
+// "left,top,right,bottom" fractions; false if malformed or empty
+bool parse_sky_region(const std::string& text, SkyRegion& sky);
+
+struct FrameAnalysis {
+    double luma;  // mean, 0-255
+    double red;   // channel means, 0-255 (colour balance)
+    double green;
+    double blue;
+    uint64_t phash;           // 64-bit difference hash of the luma grid
+    double cloud;             // cloud cover 0-100 %, -1 = too dark to tell
+    std::vector<uint8_t> grid; // ANALYSIS_WIDTH x ANALYSIS_HEIGHT luma
+
+    FrameAnalysis() : luma(0.0), red(0.0), green(0.0), blue(0.0), phash(0), cloud(-1.0) {}
+};
+
+void analyse_thumbnail(const Thumbnail& thumb, FrameAnalysis& analysis, const SkyRegion& sky = SkyRegion());
+
+// The same statistics from a luma map alone (decode_jpeg_dc_luma). There is
+// no colour: red, green, blue and cloud are -1.
+void analyse_luma(const LumaImage& image, FrameAnalysis& analysis);
+
+// Mean absolute luma difference between two analysed frames (0-255)
+double analysis_motion(const FrameAnalysis& a, const FrameAnalysis& b);
+
+// Bits that differ between two hashes: 0 = same scene, >~20 = different
+int phash_distance(uint64_t a, uint64_t b);
@@ -0,0 +1,177 @@
+// frame_index.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "frame_index.hpp"
+#include "dc_luma.hpp"
+#include "utils.hpp"
+
+#define FRAME_INDEX_HEADER "name,epoch,bytes,luma,motion,red,green,blue,phash,scene,source,cloud"
+
+static std::string dir_of(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "./" : path.substr(0, slash + 1);
+}
+
+bool read_frame_index(const std::string& day_dir, std::vector<FrameIndexEntry>& entries) {
+    std::ifstream file(with_slash(day_dir) + FRAME_INDEX_NAME);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line)) {
+        return false;
+    }
+
+    std::map<std::string, size_t> column;
+    std::vector<std::string> header = split_csv(line);
+    for (size_t i = 0; i < header.size(); i++) {
+        column[header[i]] = i;
+    }
+    if (!column.count("name")) {
+        return false;
+    }
+
+    auto field = [&](const std::vector<std::string>& fields, const char* name) -> const std::string* {
+        auto it = column.find(name);
+        return it != column.end() && it->second < fields.size() ? &fields[it->second] : nullptr;
+    };
+
+    entries.clear();
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields = split_csv(line);
+        const std::string* name = field(fields, "name");
+        if (name == nullptr || name->empty()) {
+            continue;
+        }
+        FrameIndexEntry entry;
+        entry.name = *name;
+        const std::string* epoch = field(fields, "epoch");
+        const std::string* bytes = field(fields, "bytes");
+        const std::string* luma = field(fields, "luma");
+        const std::string* motion = field(fields, "motion");
+        const std::string* red = field(fields, "red");
+        const std::string* green = field(fields, "green");
+        const std::string* blue = field(fields, "blue");
+        const std::string* phash = field(fields, "phash");
+        const std::string* scene = field(fields, "scene");
+        const std::string* source = field(fields, "source");
+        const std::string* cloud = field(fields, "cloud");
+        try {
+            entry.epoch = epoch ? std::stol(*epoch) : 0;
+            entry.bytes = bytes ? std::stoull(*bytes) : 0;
+            entry.luma = luma ? std::stod(*luma) : 0.0;
+            entry.motion = motion ? std::stod(*motion) : 0.0;
+            entry.red = red ? std::stod(*red) : 0.0;
+            entry.green = green ? std::stod(*green) : 0.0;
+            entry.blue = blue ? std::stod(*blue) : 0.0;
+            entry.phash = phash ? std::stoull(*phash, nullptr, 16) : 0;
+            entry.scene = scene ? std::stoi(*scene) : 0;
+            entry.source = source ? *source : "";
+            entry.cloud = cloud ? std::stod(*cloud) : -1.0;
+        } catch (...) {
+            continue; // torn last line after a power cut
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool append_frame_index(const std::string& day_dir, const FrameIndexEntry& entry) {
+    std::string path = with_slash(day_dir) + FRAME_INDEX_NAME;
+    struct stat st;
+    bool is_new = stat(path.c_str(), &st) != 0 || st.st_size == 0;
+
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (is_new) {
+        file << FRAME_INDEX_HEADER << "\n";
+    }
+    char numbers[160];
+    snprintf(numbers, sizeof(numbers), "%ld,%llu,%.2f,%.3f,%.2f,%.2f,%.2f,%016llx,%d", entry.epoch,
+             static_cast<unsigned long long>(entry.bytes), entry.luma, entry.motion, entry.red, entry.green,
+             entry.blue, static_cast<unsigned long long>(entry.phash), entry.scene);
+    char cloud[16];
+    snprintf(cloud, sizeof(cloud), "%.1f", entry.cloud);
+    file << entry.name << "," << numbers << "," << entry.source << "," << cloud << "\n";
+    return static_cast<bool>(file);
+}
+
+long find_nearest_frame(const std::vector<FrameIndexEntry>& entries, long epoch) {
+    if (entries.empty()) {
+        return -1;
+    }
+    auto after = std::lower_bound(entries.begin(), entries.end(), epoch,
+                                  [](const FrameIndexEntry& e, long t) { return e.epoch < t; });
+    if (after == entries.begin()) {
+        return 0;
+    }
+    if (after == entries.end() || epoch - (after - 1)->epoch <= after->epoch - epoch) {
+        --after;
+    }
+    return after - entries.begin();
+}
+
+FrameIndexer::FrameIndexer() : colour(true), have_previous(false) {
+}
+
+// EXIF thumbnail, else the 1/8 RGB decode (or, without colour, the DC map)
+bool FrameIndexer::measure(const std::string& path, FrameAnalysis& analysis, std::string& error) {
+    if (!load_thumbnail(path, thumb, error, colour)) {
+        return false;
+    }
+    if (thumb.width > 0) {
+        analyse_thumbnail(thumb, analysis, sky);
+        return true;
+    }
+    if (!decode_jpeg_dc_luma(path, luma_map, error)) {
+        return false;
+    }
+    analyse_luma(luma_map, analysis);
+    return true;
+}
+
+void FrameIndexer::prime(const std::string& path) {
+    std::string error;
+    have_previous = measure(path, previous, error);
+}
+
+bool FrameIndexer::add(const std::string& path, long epoch, FrameIndexEntry& entry, std::string& error) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        error = "cannot stat " + path;
+        return false;
+    }
+    if (!measure(path, current, error)) {
+        return false;
+    }
+
+    entry = FrameIndexEntry();
+    entry.name = base_name(path);
+    entry.epoch = epoch;
+    entry.bytes = st.st_size;
+    entry.luma = current.luma;
+    entry.red = current.red;
+    entry.green = current.green;
+    entry.blue = current.blue;
+    entry.phash = current.phash;
+    entry.source = thumb.from_exif ? "exif" : thumb.width > 0 ? "dct8" : "dc";
+    entry.cloud = current.cloud;
+    if (have_previous) {
+        entry.motion = analysis_motion(current, previous);
+        entry.scene = phash_distance(current.phash, previous.phash);
+    }
+
+    std::swap(previous, current);
+    have_previous = true;
+
+    if (!append_frame_index(dir_of(path), entry)) {
+        error = "cannot write " + dir_of(path) + FRAME_INDEX_NAME;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+// frame_index.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_analysis.hpp"
+
+// --- Frame Index ---
+// While capturing, every frame gets a line in the day's frame_index.csv:
+//
+//   name,epoch,bytes,luma,motion,red,green,blue,phash,scene,source,cloud
+//
+//   epoch   capture time (seconds since 1970)
+//   bytes   JPEG size as captured - a proxy for spatial detail (and noise)
+//   luma    mean brightness 0-255
+//   motion  mean absolute luma difference from the previous frame, 0-255,
+//           measured on a 64x48 grid so sensor noise averages out and only
+//           real change (clouds, light) counts
+//   red/green/blue  channel means 0-255 (colour balance)
+//   phash   64-bit difference hash (hex)
+//   scene   phash bits changed since the previous frame (0-64); a jump
+//           means a new scene (camera moved, lights on, lens fogged)
+//   source  "exif" (embedded thumbnail), "dct8" (1/8 scale decode) or "dc"
+//           (DC coefficients only, no colour: red/green/blue are -1)
+//   cloud   cloud cover of the sky region, 0-100 %; -1 when too dark
+//
+// All of it comes from the photo's EXIF thumbnail when it has one (see
+// frame_analysis.hpp), so indexing a photo costs well under a millisecond.
+// The encoder uses it as a free first pass (see rate_plan.hpp). Columns are
+// found by header name, so readers keep working when columns are added.
+
+#define FRAME_INDEX_NAME "frame_index.csv"
+
+struct FrameIndexEntry {
+    std::string name;
+    long epoch;
+    uint64_t bytes;
+    double luma;
+    double motion;
+    double red;
+    double green;
+    double blue;
+    uint64_t phash;
+    int scene;
+    std::string source;
+    double cloud;
+
+    FrameIndexEntry() : epoch(0), bytes(0), luma(0.0), motion(0.0), red(0.0), green(0.0), blue(0.0),
+                        phash(0), scene(0), cloud(-1.0) {}
+};
+
+// Reads day_dir/frame_index.csv. Returns false if there is none.
+bool read_frame_index(const std::string& day_dir, std::vector<FrameIndexEntry>& entries);
+
+// Appends one line (writing the header first if the file is new)
+bool append_frame_index(const std::string& day_dir, const FrameIndexEntry& entry);
+
+// Entry captured closest to `epoch`: a binary search on the epoch column
+// (entries in capture order, as written). -1 if there are none.
+long find_nearest_frame(const std::vector<FrameIndexEntry>& entries, long epoch);
+
+// Measures captured frames and appends them to the index. Keeps the previous
+// frame's analysis for the motion and scene figures.
+class FrameIndexer {
+public:
+    FrameIndexer();
+
+    // Where the sky is, for the cloud column (default: top third)
+    void set_sky_region(const SkyRegion& region) { sky = region; }
+
+    // Without colour, photos with no EXIF thumbnail are measured on their
+    // DC luma map (decode_jpeg_dc_luma) instead of a 1/8 RGB decode: luma,
+    // motion and scene only, for a fraction of the decode time
+    void set_colour(bool enabled) { colour = enabled; }
+
+    // Loads `path` as the previous frame without indexing it (after a
+    // restart, so the next frame's motion isn't measured against nothing)
+    void prime(const std::string& path);
+
+    // Measures `path` (taken at `epoch`) and appends it to its directory's index
+    bool add(const std::string& path, long epoch, FrameIndexEntry& entry, std::string& error);
+
+private:
+    Thumbnail thumb;
+    LumaImage luma_map;
+    SkyRegion sky;
+    bool colour;
+    FrameAnalysis previous;
+    FrameAnalysis current;
+    bool have_previous;
+
+    bool measure(const std::string& path, FrameAnalysis& analysis, std::string& error);
+};
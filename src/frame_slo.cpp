@@ -0,0 +1,108 @@
+// frame_slo.cpp
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_slo.hpp"
+
+// Trailing bytes after EOI that still count as a complete JPEG
+#define SLO_EOI_SEARCH 16
+
+// Ring slots not filled yet
+#define SLO_EMPTY 0xFF
+
+const char* slo_outcome_name(SloOutcome outcome) {
+    switch (outcome) {
+    case SLO_ON_TIME: return "on_time";
+    case SLO_LATE: return "late";
+    case SLO_INVALID: return "invalid";
+    case SLO_MISSED: return "missed";
+    default: return "unknown";
+    }
+}
+
+FrameSlo::FrameSlo(double target, int window_slots)
+    : slo_target(std::min(0.9999, std::max(0.0, target))),
+      ring(static_cast<size_t>(std::max(1, window_slots)), SLO_EMPTY), ring_next(0), expected(0) {
+    for (int i = 0; i < SLO_OUTCOMES; i++) {
+        day[i].store(0, std::memory_order_relaxed);
+        window[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void FrameSlo::start_day(int expected_slots) {
+    expected.store(expected_slots, std::memory_order_relaxed);
+    for (int i = 0; i < SLO_OUTCOMES; i++) {
+        day[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void FrameSlo::record(SloOutcome outcome, int count) {
+    if (count <= 0) {
+        return;
+    }
+    day[outcome].fetch_add(static_cast<uint32_t>(count), std::memory_order_relaxed);
+
+    // A long outage only needs to overwrite the window once
+    count = std::min(count, static_cast<int>(ring.size()));
+    for (int i = 0; i < count; i++) {
+        uint8_t old = ring[ring_next];
+        if (old != SLO_EMPTY) {
+            window[old].fetch_sub(1, std::memory_order_relaxed);
+        }
+        ring[ring_next] = static_cast<uint8_t>(outcome);
+        window[outcome].fetch_add(1, std::memory_order_relaxed);
+        ring_next = (ring_next + 1) % ring.size();
+    }
+}
+
+double FrameSlo::day_ratio() const {
+    uint32_t total = 0;
+    for (int i = 0; i < SLO_OUTCOMES; i++) {
+        total += day_count(static_cast<SloOutcome>(i));
+    }
+    return total > 0 ? static_cast<double>(day_count(SLO_ON_TIME)) / total : 1.0;
+}
+
+double FrameSlo::burn_rate() const {
+    uint32_t total = 0;
+    for (int i = 0; i < SLO_OUTCOMES; i++) {
+        total += window_count(static_cast<SloOutcome>(i));
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    double bad = static_cast<double>(total - window_count(SLO_ON_TIME)) / total;
+    return bad / (1.0 - slo_target);
+}
+
+double FrameSlo::budget_remaining() const {
+    double allowed = (1.0 - slo_target) * expected.load(std::memory_order_relaxed);
+    uint32_t bad = day_count(SLO_LATE) + day_count(SLO_INVALID) + day_count(SLO_MISSED);
+    return allowed - bad;
+}
+
+bool jpeg_file_complete(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    unsigned char head[2];
+    unsigned char tail[SLO_EOI_SEARCH];
+    bool ok = fstat(fd, &st) == 0 && st.st_size >= 4 && pread(fd, head, 2, 0) == 2 && head[0] == 0xFF &&
+              head[1] == 0xD8;
+    if (ok) {
+        ssize_t n = std::min<ssize_t>(SLO_EOI_SEARCH, st.st_size - 2);
+        ok = pread(fd, tail, n, st.st_size - n) == n;
+        bool eoi = false;
+        for (ssize_t i = n - 2; ok && i >= 0 && !eoi; i--) {
+            eoi = tail[i] == 0xFF && tail[i + 1] == 0xD9;
+        }
+        ok = ok && eoi;
+    }
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,68 @@
+// frame_slo.hpp
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Frames-on-Time SLO ---
+// What matters is how many of the day's scheduled slots produced a usable
+// frame close to their time, not how many captures errored. Every slot
+// (start_time + k x interval) ends up as exactly one of:
+//
+//   on time  a valid JPEG was on disk within the deadline after the slot
+//   late     valid, but after the deadline (a gap in the video's rhythm)
+//   invalid  the capture "succeeded" but the file is truncated or not a JPEG
+//   missed   the capture failed, or the loop overran and skipped the slot
+//
+// Counts are kept for the whole day and for a rolling window of the last
+// `window_slots` slots. The burn rate is the window's bad fraction divided by
+// what the target allows (1 - target): at 1.0 the day ends exactly on
+// target, at 10 the day's error budget is gone in a tenth of the day.
+//
+// The capture loop is the only writer. Counters are relaxed atomics, so the
+// status file (or any other thread) can read them at any time without a lock.
+enum SloOutcome { SLO_ON_TIME, SLO_LATE, SLO_INVALID, SLO_MISSED, SLO_OUTCOMES };
+
+// "on_time", "late", "invalid", "missed"
+const char* slo_outcome_name(SloOutcome outcome);
+
+class FrameSlo {
+public:
+    FrameSlo(double target, int window_slots);
+
+    // Clears the day's counts. expected_slots sizes the day's error budget.
+    void start_day(int expected_slots);
+
+    // Records `count` slots with the same outcome
+    void record(SloOutcome outcome, int count = 1);
+
+    uint32_t day_count(SloOutcome outcome) const { return day[outcome].load(std::memory_order_relaxed); }
+    uint32_t window_count(SloOutcome outcome) const { return window[outcome].load(std::memory_order_relaxed); }
+
+    // Fraction of today's recorded slots that were on time (1.0 before any)
+    double day_ratio() const;
+
+    // Bad fraction of the rolling window / (1 - target)
+    double burn_rate() const;
+
+    // Slots that can still go wrong today before the day misses the target
+    // (negative once it has)
+    double budget_remaining() const;
+
+    double target() const { return slo_target; }
+
+private:
+    double slo_target;
+    std::vector<uint8_t> ring; // outcome of each slot in the window
+    size_t ring_next;
+    std::atomic<int> expected;
+    std::atomic<uint32_t> day[SLO_OUTCOMES];
+    std::atomic<uint32_t> window[SLO_OUTCOMES];
+};
+
+// A cheap completeness check on a fresh capture: starts with SOI, ends with
+// EOI (a few bytes of trailing padding are allowed)
+bool jpeg_file_complete(const std::string& path);
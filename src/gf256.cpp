@@ -0,0 +1,367 @@
+// gf256.cpp
+
+#include <utility>
+
+#include "gf256.hpp"
+#include "cpu_features.hpp"
+
+// The GF kernels only need byte shuffles (SSSE3/AVX2 pshufb) and 128/256-bit
+// loads, stores and logic, all of which 32-bit x86 has too
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNELS 1
+#endif
+
+// ============================================================================
+// Field arithmetic
+// ============================================================================
+
+struct GfTables {
+    uint8_t exp[512]; // doubled, so exp[log a + log b] needs no modulo
+    uint8_t log[256];
+};
+
+static GfTables build_tables() {
+    GfTables t;
+    unsigned int x = 1;
+    for (int i = 0; i < 255; i++) {
+        t.exp[i] = static_cast<uint8_t>(x);
+        t.exp[i + 255] = static_cast<uint8_t>(x);
+        t.log[x] = static_cast<uint8_t>(i);
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11d;
+        }
+    }
+    t.exp[510] = t.exp[0];
+    t.exp[511] = t.exp[1];
+    t.log[0] = 0; // unused: zero has no log
+    return t;
+}
+
+static const GfTables& tables() {
+    static const GfTables t = build_tables();
+    return t;
+}
+
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    const GfTables& t = tables();
+    return t.exp[t.log[a] + t.log[b]];
+}
+
+uint8_t gf_inv(uint8_t a) {
+    const GfTables& t = tables();
+    return t.exp[255 - t.log[a]];
+}
+
+// Products of c with every low nibble (lo) and every high nibble (hi)
+static void nibble_tables(uint8_t c, uint8_t* lo, uint8_t* hi) {
+    for (int i = 0; i < 16; i++) {
+        lo[i] = gf_mul(c, static_cast<uint8_t>(i));
+        hi[i] = gf_mul(c, static_cast<uint8_t>(i << 4));
+    }
+}
+
+bool gf_invert_matrix(std::vector<uint8_t>& m, int n) {
+    // Gauss-Jordan on [m | I]
+    std::vector<uint8_t> inv(n * n, 0);
+    for (int i = 0; i < n; i++) {
+        inv[i * n + i] = 1;
+    }
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && m[pivot * n + col] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        if (pivot != col) {
+            for (int j = 0; j < n; j++) {
+                std::swap(m[pivot * n + j], m[col * n + j]);
+                std::swap(inv[pivot * n + j], inv[col * n + j]);
+            }
+        }
+        uint8_t scale = gf_inv(m[col * n + col]);
+        for (int j = 0; j < n; j++) {
+            m[col * n + j] = gf_mul(m[col * n + j], scale);
+            inv[col * n + j] = gf_mul(inv[col * n + j], scale);
+        }
+        for (int row = 0; row < n; row++) {
+            uint8_t factor = m[row * n + col];
+            if (row == col || factor == 0) {
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                m[row * n + j] ^= gf_mul(factor, m[col * n + j]);
+                inv[row * n + j] ^= gf_mul(factor, inv[col * n + j]);
+            }
+        }
+    }
+    m.swap(inv);
+    return true;
+}
+
+// ============================================================================
+// Scalar reference kernels - every SIMD variant must match these exactly
+// ============================================================================
+
+// A full 256-entry product row: one lookup per byte, and small enough for
+// the Pi Zero's 16 KB L1
+static void mul_scalar(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    uint8_t row[256];
+    for (int x = 0; x < 256; x++) {
+        row[x] = gf_mul(c, static_cast<uint8_t>(x));
+    }
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = row[src[i]];
+    }
+}
+
+static void mul_add_scalar(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    if (c == 0) {
+        return;
+    }
+    uint8_t row[256];
+    for (int x = 0; x < 256; x++) {
+        row[x] = gf_mul(c, static_cast<uint8_t>(x));
+    }
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        dst[i] ^= row[src[i]];
+        dst[i + 1] ^= row[src[i + 1]];
+        dst[i + 2] ^= row[src[i + 2]];
+        dst[i + 3] ^= row[src[i + 3]];
+    }
+    for (; i < n; i++) {
+        dst[i] ^= row[src[i]];
+    }
+}
+
+static const GfKernels scalar_kernels = {
+    "scalar",
+    mul_scalar,
+    mul_add_scalar,
+};
+
+// ============================================================================
+// x86: SSE4.1 (PSHUFB is SSSE3, which every SSE4.1 CPU has) and AVX2
+// ============================================================================
+
+#ifdef HAVE_X86_KERNELS
+
+TARGET_SSE41 static inline __m128i mul_vec_sse41(__m128i x, __m128i lo, __m128i hi, __m128i mask) {
+    __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(x, mask));
+    __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+    return _mm_xor_si128(l, h);
+}
+
+TARGET_SSE41 static void mul_region_sse41(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c, bool add) {
+    alignas(16) uint8_t lo_bytes[16];
+    alignas(16) uint8_t hi_bytes[16];
+    nibble_tables(c, lo_bytes, hi_bytes);
+    const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(lo_bytes));
+    const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(hi_bytes));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i p = mul_vec_sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), lo, hi, mask);
+        if (add) {
+            p = _mm_xor_si128(p, _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), p);
+    }
+    if (add) {
+        mul_add_scalar(src + i, dst + i, n - i, c);
+    } else {
+        mul_scalar(src + i, dst + i, n - i, c);
+    }
+}
+
+TARGET_SSE41 static void mul_sse41(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    mul_region_sse41(src, dst, n, c, false);
+}
+
+TARGET_SSE41 static void mul_add_sse41(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    if (c != 0) {
+        mul_region_sse41(src, dst, n, c, true);
+    }
+}
+
+static const GfKernels sse41_kernels = {
+    "sse4.1",
+    mul_sse41,
+    mul_add_sse41,
+};
+
+TARGET_AVX2 static inline __m256i mul_vec_avx2(__m256i x, __m256i lo, __m256i hi, __m256i mask) {
+    __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask));
+    __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+    return _mm256_xor_si256(l, h);
+}
+
+// 64 bytes per step: two independent shuffle chains keep both ports busy
+TARGET_AVX2 static void mul_region_avx2(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c, bool add) {
+    alignas(16) uint8_t lo_bytes[16];
+    alignas(16) uint8_t hi_bytes[16];
+    nibble_tables(c, lo_bytes, hi_bytes);
+    // VPSHUFB looks up within each 128-bit lane, so both lanes get the table
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lo_bytes)));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(hi_bytes)));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m256i p0 = mul_vec_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), lo, hi, mask);
+        __m256i p1 = mul_vec_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32)), lo, hi, mask);
+        if (add) {
+            p0 = _mm256_xor_si256(p0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)));
+            p1 = _mm256_xor_si256(p1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i + 32)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), p0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), p1);
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i p = mul_vec_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), lo, hi, mask);
+        if (add) {
+            p = _mm256_xor_si256(p, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), p);
+    }
+    if (add) {
+        mul_add_scalar(src + i, dst + i, n - i, c);
+    } else {
+        mul_scalar(src + i, dst + i, n - i, c);
+    }
+}
+
+TARGET_AVX2 static void mul_avx2(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    mul_region_avx2(src, dst, n, c, false);
+}
+
+TARGET_AVX2 static void mul_add_avx2(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    if (c != 0) {
+        mul_region_avx2(src, dst, n, c, true);
+    }
+}
+
+static const GfKernels avx2_kernels = {
+    "avx2",
+    mul_avx2,
+    mul_add_avx2,
+};
+
+#endif // HAVE_X86_KERNELS
+
+// ============================================================================
+// ARM NEON (Pi 2/3/4/5 and Zero 2; the original Pi Zero stays scalar)
+// ============================================================================
+
+#ifdef HAVE_NEON_KERNELS
+
+// 16-entry table lookup: one TBL on AArch64, two 8-byte VTBL2s on 32-bit ARM
+static inline uint8x16_t lookup_neon(uint8x16_t table, uint8x16_t index) {
+#if defined(__aarch64__)
+    return vqtbl1q_u8(table, index);
+#else
+    uint8x8x2_t t;
+    t.val[0] = vget_low_u8(table);
+    t.val[1] = vget_high_u8(table);
+    return vcombine_u8(vtbl2_u8(t, vget_low_u8(index)), vtbl2_u8(t, vget_high_u8(index)));
+#endif
+}
+
+static void mul_region_neon(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c, bool add) {
+    uint8_t lo_bytes[16];
+    uint8_t hi_bytes[16];
+    nibble_tables(c, lo_bytes, hi_bytes);
+    const uint8x16_t lo = vld1q_u8(lo_bytes);
+    const uint8x16_t hi = vld1q_u8(hi_bytes);
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(src + i);
+        uint8x16_t p = veorq_u8(lookup_neon(lo, vandq_u8(x, mask)), lookup_neon(hi, vshrq_n_u8(x, 4)));
+        if (add) {
+            p = veorq_u8(p, vld1q_u8(dst + i));
+        }
+        vst1q_u8(dst + i, p);
+    }
+    if (add) {
+        mul_add_scalar(src + i, dst + i, n - i, c);
+    } else {
+        mul_scalar(src + i, dst + i, n - i, c);
+    }
+}
+
+static void mul_neon(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    mul_region_neon(src, dst, n, c, false);
+}
+
+static void mul_add_neon(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c) {
+    if (c != 0) {
+        mul_region_neon(src, dst, n, c, true);
+    }
+}
+
+static const GfKernels neon_kernels = {
+    "neon",
+    mul_neon,
+    mul_add_neon,
+};
+
+#endif // HAVE_NEON_KERNELS
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+const GfKernels* gf_kernels_for(PixelIsa isa) {
+    const CpuFeatures& cpu = cpu_features();
+    (void)cpu;
+
+    switch (isa) {
+        case ISA_SCALAR:
+            return &scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+        case ISA_SSE41:
+            return cpu.sse41 ? &sse41_kernels : nullptr;
+        case ISA_AVX2:
+            return cpu.avx2 ? &avx2_kernels : nullptr;
+#endif
+#ifdef HAVE_NEON_KERNELS
+        case ISA_NEON:
+            return cpu.neon ? &neon_kernels : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const GfKernels& select_kernels() {
+    const PixelIsa preference[] = { ISA_AVX2, ISA_NEON, ISA_SSE41 };
+    for (PixelIsa isa : preference) {
+        const GfKernels* k = gf_kernels_for(isa);
+        if (k != nullptr) {
+            return *k;
+        }
+    }
+    return scalar_kernels;
+}
+
+const GfKernels& gf_kernels() {
+    static const GfKernels& kernels = select_kernels();
+    return kernels;
+}
@@ -0,0 +1,46 @@
+// gf256.hpp
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pixel_kernels.hpp"
+
+// --- GF(256) Arithmetic ---
+// The field the Reed-Solomon parity (parity.hpp) is computed in. Bytes are
+// polynomials over GF(2) modulo x^8 + x^4 + x^3 + x^2 + 1 (0x11d). Addition
+// is XOR, and multiplication uses log/exp tables.
+//
+// Encoding and repair spend all their time multiplying whole buffers by one
+// coefficient. The region kernels do this as two 16-entry table lookups per
+// byte: c * x = c * (x & 15) ^ c * (x & 240). The SIMD variants do those
+// lookups 16/32 bytes at a time with a byte shuffle (PSHUFB / TBL). Like
+// the pixel kernels, each variant must match the scalar reference exactly.
+// gf_kernels() picks the fastest one at runtime, and `make bench` checks and
+// times them all.
+
+uint8_t gf_mul(uint8_t a, uint8_t b);
+
+// Multiplicative inverse; a must not be 0
+uint8_t gf_inv(uint8_t a);
+
+struct GfKernels {
+    const char* name;
+
+    // dst[i] = c * src[i]
+    void (*mul)(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c);
+
+    // dst[i] ^= c * src[i]
+    void (*mul_add)(const uint8_t* src, uint8_t* dst, size_t n, uint8_t c);
+};
+
+// Fastest kernels this CPU supports (chosen once)
+const GfKernels& gf_kernels();
+
+// A specific variant, or nullptr if it isn't compiled in / supported here
+const GfKernels* gf_kernels_for(PixelIsa isa);
+
+// Inverts the n x n matrix m (row major) in place. False if it is singular.
+bool gf_invert_matrix(std::vector<uint8_t>& m, int n);
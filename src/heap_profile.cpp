@@ -0,0 +1,469 @@
+// heap_profile.cpp
+
+#include "heap_profile.hpp"
+
+#ifdef PROFILE_HEAP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <new>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "timelapse.hpp"
+
+// glibc's own allocator, which ours wraps
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+#define HEAP_MAX_STAGES 32
+#define HEAP_STAGE_NAME 32
+#define HEAP_MAX_SITES 128 // per stage
+#define HEAP_TOP_SITES 10
+#define HEAP_MAGIC 0x48454150524f4631ULL
+
+// In front of every block; 32 bytes keeps malloc's 16-byte alignment
+struct BlockHeader {
+    uint64_t magic;
+    void* base; // what __libc_malloc returned
+    size_t size;
+    uint32_t stage;
+    uint32_t reserved;
+};
+
+struct SiteStats {
+    std::atomic<uintptr_t> address;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> bytes;
+};
+
+struct StageStats {
+    char name[HEAP_STAGE_NAME];
+    std::atomic<uint64_t> allocs;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> bytes;
+    std::atomic<int64_t> live;
+    std::atomic<int64_t> peak_live;
+    int64_t live_at_heap_peak;
+    SiteStats sites[HEAP_MAX_SITES];
+    std::atomic<uint64_t> other_site_bytes; // table full
+};
+
+// 0 = not decided yet, 1 = off, 2 = profiling
+static std::atomic<int> heap_state(0);
+static char report_path[256];
+static time_t profile_started;
+
+// Stage 0 collects everything allocated outside a HeapStage
+static StageStats stages[HEAP_MAX_STAGES];
+static std::atomic<int> stage_count(1);
+static std::atomic_flag stage_lock = ATOMIC_FLAG_INIT;
+static std::atomic<int64_t> heap_live(0);
+static std::atomic<int64_t> heap_peak(0);
+static thread_local int current_stage = 0;
+
+static bool profiling() {
+    int state = heap_state.load(std::memory_order_relaxed);
+    if (state == 0) {
+        // getenv doesn't allocate, so this is safe from inside malloc
+        const char* env = getenv("TIMELAPSE_HEAP_PROFILE");
+        if (env != nullptr && *env != '\0' && strcmp(env, "0") != 0) {
+            // "1" means the default name, formatted at exit: localtime
+            // allocates, which isn't allowed here
+            snprintf(report_path, sizeof(report_path), "%s", strcmp(env, "1") == 0 ? "" : env);
+            profile_started = time(nullptr);
+            state = 2;
+        } else {
+            state = 1;
+        }
+        strcpy(stages[0].name, "(untagged)");
+        heap_state.store(state);
+    }
+    return state == 2;
+}
+
+static void record_site(StageStats& stage, uintptr_t site, size_t size) {
+    size_t slot = (site >> 4) % HEAP_MAX_SITES;
+    for (int probe = 0; probe < HEAP_MAX_SITES; probe++) {
+        SiteStats& s = stage.sites[slot];
+        uintptr_t current = s.address.load(std::memory_order_relaxed);
+        if (current == 0 && s.address.compare_exchange_strong(current, site)) {
+            current = site;
+        }
+        if (current == site) {
+            s.count.fetch_add(1, std::memory_order_relaxed);
+            s.bytes.fetch_add(size, std::memory_order_relaxed);
+            return;
+        }
+        slot = (slot + 1) % HEAP_MAX_SITES;
+    }
+    stage.other_site_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static void raise_peak(std::atomic<int64_t>& peak, int64_t value) {
+    int64_t old = peak.load(std::memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value)) {
+    }
+}
+
+static void record_alloc(BlockHeader* header, uintptr_t site) {
+    StageStats& stage = stages[header->stage];
+    int64_t size = static_cast<int64_t>(header->size);
+    stage.allocs.fetch_add(1, std::memory_order_relaxed);
+    stage.bytes.fetch_add(size, std::memory_order_relaxed);
+    raise_peak(stage.peak_live, stage.live.fetch_add(size, std::memory_order_relaxed) + size);
+    record_site(stage, site, header->size);
+
+    int64_t live = heap_live.fetch_add(size, std::memory_order_relaxed) + size;
+    if (live > heap_peak.load(std::memory_order_relaxed)) {
+        raise_peak(heap_peak, live);
+        // Approximate under contention, but good enough to see who holds the peak
+        int count = stage_count.load(std::memory_order_relaxed);
+        for (int i = 0; i < count; i++) {
+            stages[i].live_at_heap_peak = stages[i].live.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static void* profiled_alloc(size_t size, size_t alignment, uintptr_t site) {
+    if (alignment < 16) {
+        alignment = 16;
+    }
+    size_t total = size + sizeof(BlockHeader) + (alignment > 16 ? alignment : 0);
+    if (total < size) {
+        return nullptr;
+    }
+    void* base = __libc_malloc(total);
+    if (base == nullptr) {
+        return nullptr;
+    }
+    uintptr_t user = (reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(user) - 1;
+    header->magic = HEAP_MAGIC;
+    header->base = base;
+    header->size = size;
+    header->stage = current_stage;
+    record_alloc(header, site);
+    return reinterpret_cast<void*>(user);
+}
+
+static BlockHeader* header_of(void* ptr) {
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(ptr) - 1;
+    return header->magic == HEAP_MAGIC ? header : nullptr;
+}
+
+static void profiled_free(void* ptr) {
+    BlockHeader* header = header_of(ptr);
+    if (header == nullptr) {
+        __libc_free(ptr); // allocated before profiling was decided
+        return;
+    }
+    StageStats& stage = stages[header->stage];
+    int64_t size = static_cast<int64_t>(header->size);
+    stage.frees.fetch_add(1, std::memory_order_relaxed);
+    stage.live.fetch_sub(size, std::memory_order_relaxed);
+    heap_live.fetch_sub(size, std::memory_order_relaxed);
+    header->magic = 0;
+    __libc_free(header->base);
+}
+
+static void* aligned(size_t alignment, size_t size, uintptr_t site) {
+    if (!profiling()) {
+        return __libc_memalign(alignment, size);
+    }
+    return profiled_alloc(size, alignment, site);
+}
+
+#define CALLER reinterpret_cast<uintptr_t>(__builtin_return_address(0))
+
+extern "C" {
+
+void* malloc(size_t size) {
+    return profiling() ? profiled_alloc(size, 16, CALLER) : __libc_malloc(size);
+}
+
+void free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (heap_state.load(std::memory_order_relaxed) == 2) {
+        profiled_free(ptr);
+    } else {
+        __libc_free(ptr);
+    }
+}
+
+void* calloc(size_t n, size_t size) {
+    if (!profiling()) {
+        return __libc_calloc(n, size);
+    }
+    if (size != 0 && n > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* ptr = profiled_alloc(n * size, 16, CALLER);
+    if (ptr != nullptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!profiling()) {
+        return __libc_realloc(ptr, size);
+    }
+    if (ptr == nullptr) {
+        return profiled_alloc(size, 16, CALLER);
+    }
+    BlockHeader* header = header_of(ptr);
+    if (header == nullptr) {
+        return __libc_realloc(ptr, size);
+    }
+    if (size == 0) {
+        profiled_free(ptr);
+        return nullptr;
+    }
+    void* resized = profiled_alloc(size, 16, CALLER);
+    if (resized != nullptr) {
+        memcpy(resized, ptr, header->size < size ? header->size : size);
+        profiled_free(ptr);
+    }
+    return resized;
+}
+
+void* reallocarray(void* ptr, size_t n, size_t size) {
+    if (size != 0 && n > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(ptr, n * size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* ptr = aligned(alignment, size, CALLER);
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return aligned(alignment, size, CALLER);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    return aligned(alignment, size, CALLER);
+}
+
+void* valloc(size_t size) {
+    return aligned(sysconf(_SC_PAGESIZE), size, CALLER);
+}
+
+void* pvalloc(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return aligned(page, (size + page - 1) & ~(page - 1), CALLER);
+}
+
+size_t malloc_usable_size(void* ptr) {
+    if (ptr == nullptr) {
+        return 0;
+    }
+    BlockHeader* header = heap_state.load(std::memory_order_relaxed) == 2 ? header_of(ptr) : nullptr;
+    if (header != nullptr) {
+        return header->size;
+    }
+    static size_t (*libc_usable_size)(void*) =
+        reinterpret_cast<size_t (*)(void*)>(dlsym(RTLD_NEXT, "malloc_usable_size"));
+    return libc_usable_size != nullptr ? libc_usable_size(ptr) : 0;
+}
+
+} // extern "C"
+
+// operator new goes through malloc anyway; hooking it directly records the
+// caller instead of libstdc++'s operator new as the site
+static void* new_block(size_t size, uintptr_t site) {
+    for (;;) {
+        void* ptr = profiling() ? profiled_alloc(size, 16, site) : __libc_malloc(size ? size : 1);
+        if (ptr != nullptr) {
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new(size_t size) {
+    return new_block(size, CALLER);
+}
+
+void* operator new[](size_t size) {
+    return new_block(size, CALLER);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return new_block(size, CALLER);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return new_block(size, CALLER);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// --- Stages ---
+
+static int find_or_add_stage(const char* name) {
+    int count = stage_count.load();
+    for (int i = 1; i < count; i++) {
+        if (strncmp(stages[i].name, name, HEAP_STAGE_NAME - 1) == 0) {
+            return i;
+        }
+    }
+
+    while (stage_lock.test_and_set(std::memory_order_acquire)) {
+    }
+    count = stage_count.load();
+    int id = 0;
+    for (int i = 1; i < count; i++) {
+        if (strncmp(stages[i].name, name, HEAP_STAGE_NAME - 1) == 0) {
+            id = i;
+        }
+    }
+    if (id == 0 && count < HEAP_MAX_STAGES) {
+        snprintf(stages[count].name, HEAP_STAGE_NAME, "%s", name);
+        id = count;
+        stage_count.store(count + 1);
+    }
+    stage_lock.clear(std::memory_order_release);
+    return id; // 0 (untagged) once the table is full
+}
+
+HeapStage::HeapStage(const char* name) : previous(current_stage) {
+    if (profiling()) {
+        current_stage = find_or_add_stage(name);
+    }
+}
+
+HeapStage::~HeapStage() {
+    current_stage = previous;
+}
+
+// --- Report ---
+
+static double to_mb(int64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+static void print_site(FILE* out, uintptr_t address, uint64_t bytes, uint64_t count) {
+    Dl_info info;
+    fprintf(out, "    %10.2f MB %9llu x  ", to_mb(bytes), static_cast<unsigned long long>(count));
+    if (dladdr(reinterpret_cast<void*>(address), &info) && info.dli_fname != nullptr) {
+        if (info.dli_sname != nullptr) {
+            fprintf(out, "%s+0x%lx", info.dli_sname,
+                    static_cast<unsigned long>(address - reinterpret_cast<uintptr_t>(info.dli_saddr)));
+        } else {
+            fprintf(out, "?");
+        }
+        // Offset for `addr2line -Cfe <file> <offset>`
+        fprintf(out, "  (%s+0x%lx)\n", info.dli_fname,
+                static_cast<unsigned long>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+    } else {
+        fprintf(out, "0x%lx\n", static_cast<unsigned long>(address));
+    }
+}
+
+static void write_report() {
+    // Snapshot before writing: the report itself allocates
+    int count = stage_count.load();
+    int64_t peak = heap_peak.load();
+    int64_t live = heap_live.load();
+
+    if (report_path[0] == '\0') {
+        struct tm tm;
+        localtime_r(&profile_started, &tm);
+        strftime(report_path, sizeof(report_path), LOGS_PATH "heap_profile_%Y%m%d_%H%M%S.txt", &tm);
+    }
+    FILE* out = fopen(report_path, "w");
+    if (out == nullptr) {
+        fprintf(stderr, "Heap profile: cannot write %s: %s\n", report_path, strerror(errno));
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(out, "# heap profile, pid %d\n", static_cast<int>(getpid()));
+    fprintf(out, "peak_rss_mb=%.2f\n", usage.ru_maxrss / 1024.0);
+    fprintf(out, "heap_peak_mb=%.2f\n", to_mb(peak));
+    fprintf(out, "heap_live_at_exit_mb=%.2f\n\n", to_mb(live));
+
+    fprintf(out, "%-16s %10s %10s %12s %10s %10s %14s\n", "stage", "allocs", "frees", "alloc_mb",
+            "live_mb", "peak_mb", "at_heap_peak");
+    for (int i = 0; i < count; i++) {
+        StageStats& s = stages[i];
+        fprintf(out, "%-16s %10llu %10llu %12.2f %10.2f %10.2f %14.2f\n", s.name,
+                static_cast<unsigned long long>(s.allocs.load()), static_cast<unsigned long long>(s.frees.load()),
+                to_mb(s.bytes.load()), to_mb(s.live.load()), to_mb(s.peak_live.load()), to_mb(s.live_at_heap_peak));
+    }
+
+    for (int i = 0; i < count; i++) {
+        StageStats& s = stages[i];
+        if (s.allocs.load() == 0) {
+            continue;
+        }
+        fprintf(out, "\n[%s] top allocation sites by bytes\n", s.name);
+
+        // Selection of the biggest few; the table is small
+        bool taken[HEAP_MAX_SITES] = {};
+        for (int n = 0; n < HEAP_TOP_SITES; n++) {
+            int best = -1;
+            for (int j = 0; j < HEAP_MAX_SITES; j++) {
+                if (!taken[j] && s.sites[j].address.load() != 0 &&
+                    (best < 0 || s.sites[j].bytes.load() > s.sites[best].bytes.load())) {
+                    best = j;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            taken[best] = true;
+            print_site(out, s.sites[best].address.load(), s.sites[best].bytes.load(), s.sites[best].count.load());
+        }
+        if (s.other_site_bytes.load() > 0) {
+            fprintf(out, "    %10.2f MB (sites that didn't fit the table)\n", to_mb(s.other_site_bytes.load()));
+        }
+    }
+    fclose(out);
+    fprintf(stderr, "Heap profile written to %s\n", report_path);
+}
+
+__attribute__((destructor)) static void heap_profile_at_exit() {
+    if (heap_state.load() == 2) {
+        write_report();
+    }
+}
+
+#endif // PROFILE_HEAP
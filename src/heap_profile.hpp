@@ -0,0 +1,35 @@
+// heap_profile.hpp
+
+#pragma once
+
+// --- Heap Profiling ---
+// Opt-in, to find out which stage drives peak memory on the Pi Zero. Build
+// with `make clean && make PROFILE_HEAP=1`, then run with
+// TIMELAPSE_HEAP_PROFILE=1 (report goes to logs/heap_profile_<time>.txt) or
+// TIMELAPSE_HEAP_PROFILE=<path>. Without the env var the profiling build only
+// pays an extra branch per allocation.
+//
+// malloc/free (and so operator new, OpenCV, libjpeg...) are replaced; every
+// block is charged to the stage that allocated it, even if another stage
+// frees it. Per stage the report has allocation counts, bytes, live and peak
+// live bytes, the live bytes at the moment of the whole heap's peak, and the
+// top allocation sites (return addresses, resolved with dladdr).
+//
+// Stages are set per thread with a scope:
+//
+//   HeapStage stage("decode");
+//
+// Scopes nest; leaving one restores the enclosing stage. Without
+// PROFILE_HEAP HeapStage is an empty object.
+class HeapStage {
+public:
+#ifdef PROFILE_HEAP
+    explicit HeapStage(const char* name);
+    ~HeapStage();
+
+private:
+    int previous;
+#else
+    explicit HeapStage(const char*) {}
+#endif
+};
@@ -0,0 +1,246 @@
+// job_graph.cpp
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+
+#include "job_graph.hpp"
+#include "heap_profile.hpp"
+#include "utils.hpp"
+
+JobGraph::JobGraph(const std::string& state_file, int max_concurrent,
+                   std::function<void(const std::string&)> log)
+    : state_file(state_file), max_concurrent(max_concurrent > 0 ? max_concurrent : 1),
+      log(log), running(0) {
+}
+
+const char* JobGraph::state_name(State state) {
+    switch (state) {
+        case PENDING: return "pending";
+        case RUNNING: return "running";
+        case DONE:    return "done";
+        case FAILED:  return "failed";
+        case SKIPPED: return "skipped";
+    }
+    return "unknown";
+}
+
+void JobGraph::add_job(const std::string& name, const std::vector<std::string>& depends_on,
+                       std::function<bool()> action, int max_attempts, int retry_delay_seconds) {
+    Job job;
+    job.name = name;
+    job.depends_on = depends_on;
+    job.action = action;
+    job.max_attempts = max_attempts > 0 ? max_attempts : 1;
+    job.retry_delay_seconds = retry_delay_seconds;
+    job.state = PENDING;
+    job.attempts = 0;
+    job.next_attempt_epoch = 0;
+    jobs.push_back(job);
+}
+
+void JobGraph::add_command_job(const std::string& name, const std::vector<std::string>& depends_on,
+                               const std::string& command, int max_attempts, int retry_delay_seconds) {
+    auto log_fn = log;
+    add_job(name, depends_on, [command, name, log_fn]() {
+        log_fn("Job '" + name + "' running: " + command);
+        int result = std::system(command.c_str());
+        if (result == -1 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+            int code = (result != -1 && WIFEXITED(result)) ? WEXITSTATUS(result) : -1;
+            log_fn("Job '" + name + "' command failed with exit code " + std::to_string(code));
+            return false;
+        }
+        return true;
+    }, max_attempts, retry_delay_seconds);
+}
+
+JobGraph::Job* JobGraph::find(const std::string& name) {
+    for (Job& job : jobs) {
+        if (job.name == name) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+bool JobGraph::dependencies_done(const Job& job) {
+    for (const std::string& dep : job.depends_on) {
+        Job* d = find(dep);
+        if (d == nullptr || d->state != DONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JobGraph::dependency_failed(const Job& job) {
+    for (const std::string& dep : job.depends_on) {
+        Job* d = find(dep);
+        if (d == nullptr || d->state == FAILED || d->state == SKIPPED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only "done" survives a restart; anything that was running, failed or
+// skipped gets a fresh set of attempts.
+void JobGraph::load_state() {
+    std::ifstream file(state_file);
+    if (!file.is_open()) {
+        return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        std::string name, state;
+        if (!(ss >> name >> state)) {
+            continue;
+        }
+        Job* job = find(name);
+        if (job != nullptr && state == "done") {
+            job->state = DONE;
+            log("Job '" + name + "' already done (from " + state_file + ")");
+        }
+    }
+}
+
+// Called with the mutex held
+void JobGraph::save_state() {
+    std::stringstream ss;
+    for (const Job& job : jobs) {
+        ss << job.name << " " << state_name(job.state) << " " << job.attempts << "\n";
+    }
+    std::string data = ss.str();
+    write_file_atomic(state_file, data.data(), data.size());
+}
+
+void JobGraph::run_job(size_t index) {
+    Job& job = jobs[index];
+
+    bool ok = false;
+    try {
+        HeapStage heap_stage(job.name.c_str());
+        ok = job.action();
+    } catch (const std::exception& e) {
+        log("Job '" + job.name + "' threw: " + e.what());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ok) {
+        job.state = DONE;
+        log("Job '" + job.name + "' done");
+    } else if (job.attempts < job.max_attempts) {
+        job.state = PENDING;
+        job.next_attempt_epoch = std::time(nullptr) + job.retry_delay_seconds;
+        log("Job '" + job.name + "' failed (attempt " + std::to_string(job.attempts) + "/" +
+            std::to_string(job.max_attempts) + "), retrying in " +
+            std::to_string(job.retry_delay_seconds) + " seconds");
+    } else {
+        job.state = FAILED;
+        log("Job '" + job.name + "' failed after " + std::to_string(job.attempts) + " attempts");
+    }
+    running--;
+    save_state();
+    changed.notify_all();
+}
+
+bool JobGraph::run() {
+    std::vector<std::thread> workers;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    load_state();
+    save_state();
+
+    for (;;) {
+        long now = std::time(nullptr);
+        long next_wake = 0;
+        bool waiting = false;
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+            Job& job = jobs[i];
+            if (job.state != PENDING) {
+                continue;
+            }
+
+            if (dependency_failed(job)) {
+                job.state = SKIPPED;
+                log("Job '" + job.name + "' skipped - a dependency failed");
+                save_state();
+                continue;
+            }
+
+            if (!dependencies_done(job)) {
+                waiting = true;
+                continue;
+            }
+
+            if (now < job.next_attempt_epoch) {
+                waiting = true;
+                if (next_wake == 0 || job.next_attempt_epoch < next_wake) {
+                    next_wake = job.next_attempt_epoch;
+                }
+                continue;
+            }
+
+            if (running >= max_concurrent) {
+                waiting = true;
+                continue;
+            }
+
+            job.state = RUNNING;
+            job.attempts++;
+            running++;
+            log("Job '" + job.name + "' started (attempt " + std::to_string(job.attempts) + ")");
+            save_state();
+            workers.emplace_back(&JobGraph::run_job, this, i);
+        }
+
+        if (running == 0 && (!waiting || next_wake == 0)) {
+            // Nothing running and nothing that could ever become ready
+            if (waiting) {
+                for (Job& job : jobs) {
+                    if (job.state == PENDING) {
+                        job.state = FAILED;
+                        log("Job '" + job.name + "' can never run - unknown dependency");
+                    }
+                }
+                save_state();
+            }
+            break;
+        }
+
+        if (next_wake != 0) {
+            changed.wait_for(lock, std::chrono::seconds(next_wake - now));
+        } else {
+            changed.wait(lock);
+        }
+    }
+
+    lock.unlock();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    bool all_done = true;
+    for (const Job& job : jobs) {
+        if (job.state != DONE) {
+            all_done = false;
+        }
+    }
+    return all_done;
+}
+
+std::vector<std::pair<std::string, std::string>> JobGraph::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<std::string, std::string>> states;
+    for (const Job& job : jobs) {
+        states.push_back(std::make_pair(job.name, std::string(state_name(job.state))));
+    }
+    return states;
+}
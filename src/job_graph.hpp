@@ -0,0 +1,71 @@
+// job_graph.hpp
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// --- Job Graph ---
+// Runs the day's pipeline (schedule -> capture -> encode -> backup -> ...)
+// as a dependency graph: a job starts as soon as everything it depends on
+// has finished, instead of waiting for the next cron slot. Failed jobs are
+// retried after a delay, at most max_concurrent jobs run at once, and job
+// states are saved after every change so a restart (e.g. reboot) picks up
+// where the day left off.
+class JobGraph {
+public:
+    enum State { PENDING, RUNNING, DONE, FAILED, SKIPPED };
+
+private:
+    struct Job {
+        std::string name;
+        std::vector<std::string> depends_on;
+        std::function<bool()> action;
+        int max_attempts;
+        int retry_delay_seconds;
+
+        State state;
+        int attempts;
+        long next_attempt_epoch;
+    };
+
+    std::string state_file;
+    int max_concurrent;
+    std::vector<Job> jobs;
+    std::function<void(const std::string&)> log;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    int running;
+
+    Job* find(const std::string& name);
+    bool dependencies_done(const Job& job);
+    bool dependency_failed(const Job& job);
+    void load_state();
+    void save_state();
+    void run_job(size_t index);
+
+public:
+    JobGraph(const std::string& state_file, int max_concurrent,
+             std::function<void(const std::string&)> log);
+
+    // Adds an in-process job. action returns true on success.
+    void add_job(const std::string& name, const std::vector<std::string>& depends_on,
+                 std::function<bool()> action, int max_attempts = 1, int retry_delay_seconds = 60);
+
+    // Adds a job that runs a shell command; exit code 0 means success.
+    void add_command_job(const std::string& name, const std::vector<std::string>& depends_on,
+                         const std::string& command, int max_attempts = 3, int retry_delay_seconds = 300);
+
+    // Runs until every job is done, failed or skipped. Returns true if all succeeded.
+    bool run();
+
+    // Current (name, state) pairs for the status file
+    std::vector<std::pair<std::string, std::string>> snapshot() const;
+
+    static const char* state_name(State state);
+};
@@ -0,0 +1,21 @@
+// jpeg_error.cpp
+
+#include "jpeg_error.hpp"
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    JpegErrorManager* err = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, err->message);
+    longjmp(err->jump, 1);
+}
+
+// Corrupt-data warnings would otherwise go to stderr for every frame;
+// libjpeg still counts them in num_warnings.
+static void jpeg_quiet_message(j_common_ptr) {}
+
+jpeg_error_mgr* jpeg_error_init(JpegErrorManager* err) {
+    jpeg_std_error(&err->pub);
+    err->pub.error_exit = jpeg_error_exit;
+    err->pub.output_message = jpeg_quiet_message;
+    err->message[0] = '\0';
+    return &err->pub;
+}
@@ -0,0 +1,26 @@
+// jpeg_error.hpp
+
+#pragma once
+
+#include <csetjmp>
+#include <cstddef>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+// --- libjpeg error handling ---
+// libjpeg's default error handler calls exit(). Callers instead do
+//
+//   JpegErrorManager err;
+//   cinfo.err = jpeg_error_init(&err);
+//   if (setjmp(err.jump)) { ...clean up, report err.message... }
+//
+// Warnings (corrupt data that libjpeg can decode past) are counted, not
+// printed.
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+jpeg_error_mgr* jpeg_error_init(JpegErrorManager* err);
@@ -2,10 +2,64 @@
 
 #include <iostream>
 #include <exception>
+#include <string>
 #include "timelapse.hpp"
+#include "render_farm.hpp"
+#include "recompress.hpp"
+#include "compare.hpp"
+#include "day_stream.hpp"
+#include "parity.hpp"
+#include "schedule_plan.hpp"
+#include "scrub.hpp"
+#include "timeslice.hpp"
 
-int main() {
+// Tools that don't run a capture day: "timelapse <command> [args...]"
+static int run_command(const std::string& command, int argc, char* argv[]) {
+    if (command == "farm-server") {
+        return run_farm_server(argc, argv);
+    }
+    if (command == "farm-worker") {
+        return run_farm_worker(argc, argv);
+    }
+    if (command == "recompress") {
+        return run_recompress(argc, argv);
+    }
+    if (command == "scrub") {
+        return run_scrub(argc, argv);
+    }
+    if (command == "compare") {
+        return run_compare(argc, argv);
+    }
+    if (command == "timeslice") {
+        return run_timeslice(argc, argv);
+    }
+    if (command == "parity") {
+        return run_parity(argc, argv);
+    }
+    if (command == "repair") {
+        return run_repair(argc, argv);
+    }
+    if (command == "plan") {
+        return run_plan(argc, argv);
+    }
+    if (command == "send-day") {
+        return run_send_day(argc, argv);
+    }
+    if (command == "receive") {
+        return run_receive(argc, argv);
+    }
+
+    std::cerr << "Unknown command: " << command << std::endl;
+    std::cerr << "Commands: farm-server, farm-worker, recompress, scrub, parity, repair, plan, timeslice, compare, send-day, receive (no command = run today's timelapse)" << std::endl;
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
     try {
+        if (argc > 1) {
+            return run_command(argv[1], argc - 2, argv + 2);
+        }
+
         // 1. Instantiate the TimeLapse object (which handles initialization)
         TimeLapse timelapse;
         
@@ -24,4 +78,4 @@ int main() {
 	}
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,71 @@
+// manifest.cpp
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "manifest.hpp"
+#include "utils.hpp"
+
+std::vector<std::string> list_frames(const std::string& day_dir) {
+    std::vector<std::string> frames;
+    for (const std::string& name : list_dir(day_dir)) {
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".jpg") == 0) {
+            frames.push_back(name);
+        }
+    }
+    return frames;
+}
+
+std::vector<std::string> finished_days(const std::string& root) {
+    time_t now = std::time(nullptr);
+    std::stringstream today;
+    today << std::put_time(std::localtime(&now), "%Y%m%d");
+
+    std::vector<std::string> days;
+    for (const std::string& name : list_dir(root)) {
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, "_pics") == 0 &&
+            name.compare(0, today.str().size(), today.str()) != 0) {
+            days.push_back(name);
+        }
+    }
+    return days;
+}
+
+bool read_manifest(const std::string& day_dir, std::vector<ManifestEntry>& entries, const std::string& name) {
+    std::ifstream file(with_slash(day_dir) + name);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    entries.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream ss(line);
+        ManifestEntry entry;
+        if (ss >> entry.hash >> entry.size >> entry.name) {
+            entries.push_back(entry);
+        }
+    }
+    return true;
+}
+
+bool write_manifest(const std::string& day_dir, const std::vector<ManifestEntry>& entries,
+                    const std::string& name) {
+    std::stringstream ss;
+    for (const ManifestEntry& entry : entries) {
+        ss << entry.hash << " " << entry.size << " " << entry.name << "\n";
+    }
+    std::string data = ss.str();
+    return write_file_atomic(with_slash(day_dir) + name, data.data(), data.size());
+}
+
+ManifestEntry* find_manifest_entry(std::vector<ManifestEntry>& entries, const std::string& name) {
+    for (ManifestEntry& entry : entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,43 @@
+// manifest.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Day Manifests ---
+// Every finished day directory can carry a manifest.txt listing its frames,
+// one per line:
+//
+//   <fnv1a hash> <size in bytes> <file name>
+//
+// Tools that rewrite frames (recompress) update it, and tools that check
+// frames (scrub) compare against it. It is always replaced atomically, so a
+// crash leaves either the old or the new manifest, never half of one.
+
+#define MANIFEST_NAME "manifest.txt"
+
+struct ManifestEntry {
+    std::string name;
+    uint64_t size;
+    std::string hash;
+};
+
+// Frames (.jpg) of a day directory, sorted by name
+std::vector<std::string> list_frames(const std::string& day_dir);
+
+// Day directories (*_pics) under root, sorted, except today's
+std::vector<std::string> finished_days(const std::string& root);
+
+// Reads day_dir/manifest.txt (or another file of the same format in dir).
+// Returns false if there is none.
+bool read_manifest(const std::string& day_dir, std::vector<ManifestEntry>& entries,
+                   const std::string& name = MANIFEST_NAME);
+
+// Atomically replaces day_dir/manifest.txt (or dir/name)
+bool write_manifest(const std::string& day_dir, const std::vector<ManifestEntry>& entries,
+                    const std::string& name = MANIFEST_NAME);
+
+// Finds name in entries (nullptr if absent)
+ManifestEntry* find_manifest_entry(std::vector<ManifestEntry>& entries, const std::string& name);
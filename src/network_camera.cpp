@@ -0,0 +1,451 @@
+// network_camera.cpp
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "network_camera.hpp"
+
+#define NET_READ_CHUNK 65536
+
+static long now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Waits until sock is readable/writable or the deadline passes
+static bool wait_socket(int sock, short events, long deadline_ms) {
+    for (;;) {
+        long remaining = deadline_ms - now_ms();
+        if (remaining <= 0) {
+            return false;
+        }
+        pollfd pfd = { sock, events, 0 };
+        int r = poll(&pfd, 1, static_cast<int>(remaining));
+        if (r > 0) {
+            return true;
+        }
+        if (r == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+static std::string base64_encode(const std::string& in) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    while (i + 2 < in.size()) {
+        unsigned int n = (static_cast<unsigned char>(in[i]) << 16) |
+                         (static_cast<unsigned char>(in[i + 1]) << 8) |
+                          static_cast<unsigned char>(in[i + 2]);
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += table[(n >> 6) & 63];
+        out += table[n & 63];
+        i += 3;
+    }
+    if (i + 1 == in.size()) {
+        unsigned int n = static_cast<unsigned char>(in[i]) << 16;
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += "==";
+    } else if (i + 2 == in.size()) {
+        unsigned int n = (static_cast<unsigned char>(in[i]) << 16) |
+                         (static_cast<unsigned char>(in[i + 1]) << 8);
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += table[(n >> 6) & 63];
+        out += '=';
+    }
+    return out;
+}
+
+static std::string to_lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+NetworkCamera::NetworkCamera(const std::string& url, int timeout_ms)
+    : url(url), timeout_ms(timeout_ms), sock(-1), peer_closed(false) {
+}
+
+NetworkCamera::~NetworkCamera() {
+    close();
+}
+
+// http://[user:pass@]host[:port]/path
+bool NetworkCamera::parse_url(std::string& error) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        error = "snapshot_url must start with http:// (https/rtsp are not supported): " + url;
+        return false;
+    }
+
+    std::string rest = url.substr(scheme.size());
+    size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    path = (slash == std::string::npos) ? "/" : rest.substr(slash);
+
+    size_t at = authority.rfind('@');
+    auth_header.clear();
+    if (at != std::string::npos) {
+        auth_header = "Authorization: Basic " + base64_encode(authority.substr(0, at)) + "\r\n";
+        authority = authority.substr(at + 1);
+    }
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos) {
+        host = authority.substr(0, colon);
+        port = authority.substr(colon + 1);
+    } else {
+        host = authority;
+        port = "80";
+    }
+
+    if (host.empty()) {
+        error = "no host in snapshot_url: " + url;
+        return false;
+    }
+    return true;
+}
+
+bool NetworkCamera::open() {
+    std::string error;
+    if (!open(now_ms() + timeout_ms, error)) {
+        std::cerr << "HTTP camera: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Connects within the caller's deadline, so a capture's reconnect doesn't
+// get a timeout of its own
+bool NetworkCamera::open(long deadline_ms, std::string& error) {
+    if (sock >= 0) {
+        return true;
+    }
+    return parse_url(error) && connect_socket(deadline_ms, error);
+}
+
+bool NetworkCamera::connect_socket(long deadline_ms, std::string& error) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = "could not resolve " + host + ": " + gai_strerror(rc);
+        return false;
+    }
+
+    std::string reason; // from the last address tried
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        int s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0) {
+            reason = strerror(errno);
+            continue;
+        }
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+        int r = connect(s, ai->ai_addr, ai->ai_addrlen);
+        if (r != 0 && errno != EINPROGRESS) {
+            reason = strerror(errno);
+        } else if (r != 0 && !wait_socket(s, POLLOUT, deadline_ms)) {
+            reason = "timed out";
+        } else if (r != 0) {
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_error, &len);
+            r = so_error == 0 ? 0 : -1;
+            reason = strerror(so_error);
+        }
+
+        if (r == 0) {
+            int one = 1;
+            setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            sock = s;
+            break;
+        }
+        ::close(s);
+    }
+
+    freeaddrinfo(result);
+    pending.clear();
+    peer_closed = false;
+    if (sock < 0) {
+        error = "could not connect to " + host + ":" + port + (reason.empty() ? "" : ": " + reason);
+        return false;
+    }
+    return true;
+}
+
+void NetworkCamera::close() {
+    if (sock >= 0) {
+        ::close(sock);
+        sock = -1;
+    }
+    pending.clear();
+}
+
+bool NetworkCamera::send_request(long deadline_ms) {
+    std::string request = "GET " + path + " HTTP/1.1\r\n"
+                          "Host: " + host + "\r\n"
+                          "User-Agent: timelapse\r\n"
+                          "Connection: keep-alive\r\n" +
+                          auth_header + "\r\n";
+
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = send(sock, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!wait_socket(sock, POLLOUT, deadline_ms)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Appends whatever the socket has to pending
+bool NetworkCamera::read_some(long deadline_ms, std::string& error) {
+    char buffer[NET_READ_CHUNK];
+    for (;;) {
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            pending.insert(pending.end(), buffer, buffer + n);
+            return true;
+        }
+        if (n == 0) {
+            peer_closed = true;
+            error = "connection closed by camera";
+            return false;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            error = std::string("recv failed: ") + strerror(errno);
+            return false;
+        }
+        if (!wait_socket(sock, POLLIN, deadline_ms)) {
+            error = "timed out after " + std::to_string(timeout_ms) + " ms";
+            return false;
+        }
+    }
+}
+
+bool NetworkCamera::read_line(std::string& line, long deadline_ms, std::string& error) {
+    for (;;) {
+        auto nl = std::find(pending.begin(), pending.end(), '\n');
+        if (nl != pending.end()) {
+            line.assign(pending.begin(), nl);
+            pending.erase(pending.begin(), nl + 1);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return true;
+        }
+        if (pending.size() > 8192) {
+            error = "HTTP header line too long";
+            return false;
+        }
+        if (!read_some(deadline_ms, error)) {
+            return false;
+        }
+    }
+}
+
+// Copies length body bytes to out; length < 0 means "until the camera closes"
+bool NetworkCamera::copy_body(std::ofstream& out, long length, long deadline_ms, std::string& error) {
+    long remaining = length;
+    for (;;) {
+        if (!pending.empty()) {
+            size_t take = pending.size();
+            if (remaining >= 0 && static_cast<long>(take) > remaining) {
+                take = remaining;
+            }
+            out.write(pending.data(), take);
+            pending.erase(pending.begin(), pending.begin() + take);
+            if (remaining >= 0) {
+                remaining -= take;
+            }
+        }
+        if (remaining == 0) {
+            return true;
+        }
+        if (!read_some(deadline_ms, error)) {
+            return length < 0 && peer_closed;
+        }
+    }
+}
+
+bool NetworkCamera::fetch(const std::string& file_path, long deadline_ms, bool& keep_alive, std::string& error) {
+    keep_alive = false;
+
+    if (!send_request(deadline_ms)) {
+        error = "could not send request to " + host;
+        return false;
+    }
+
+    std::string line;
+    if (!read_line(line, deadline_ms, error)) {
+        return false;
+    }
+
+    // HTTP/1.1 200 OK
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) {
+        error = "bad HTTP status line: " + line;
+        return false;
+    }
+    keep_alive = line.compare(0, 8, "HTTP/1.1") == 0;
+    int status_code = std::atoi(line.c_str() + 9);
+
+    long content_length = -1;
+    bool chunked = false;
+    for (;;) {
+        if (!read_line(line, deadline_ms, error)) {
+            return false;
+        }
+        if (line.empty()) {
+            break;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = to_lower(line.substr(0, colon));
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+
+        if (name == "content-length") {
+            content_length = std::atol(value.c_str());
+        } else if (name == "transfer-encoding") {
+            chunked = to_lower(value).find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            std::string v = to_lower(value);
+            if (v.find("close") != std::string::npos) {
+                keep_alive = false;
+            } else if (v.find("keep-alive") != std::string::npos) {
+                keep_alive = true;
+            }
+        }
+    }
+
+    if (status_code != 200) {
+        // Don't bother draining an error body - just start a fresh connection
+        keep_alive = false;
+        error = "camera returned HTTP " + std::to_string(status_code);
+        return false;
+    }
+
+    std::string tmp_path = file_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        keep_alive = false;
+        error = "could not open " + tmp_path;
+        return false;
+    }
+
+    bool ok = true;
+    if (chunked) {
+        for (;;) {
+            if (!read_line(line, deadline_ms, error)) {
+                ok = false;
+                break;
+            }
+            // Hex size, optionally followed by ";extensions". Anything else
+            // is a broken response, not the last chunk.
+            char* end = nullptr;
+            errno = 0;
+            long chunk_size = std::strtol(line.c_str(), &end, 16);
+            if (end == line.c_str() || errno == ERANGE || chunk_size < 0 ||
+                (*end != '\0' && *end != ';' && *end != ' ' && *end != '\t')) {
+                error = "bad chunk size line: " + line;
+                ok = false;
+                break;
+            }
+            if (chunk_size == 0) {
+                // Last chunk, then optional trailers up to an empty line
+                while ((ok = read_line(line, deadline_ms, error)) && !line.empty()) {
+                }
+                break;
+            }
+            if (!copy_body(out, chunk_size, deadline_ms, error) || !read_line(line, deadline_ms, error)) {
+                ok = false;
+                break;
+            }
+        }
+    } else {
+        if (content_length < 0) {
+            keep_alive = false;
+        }
+        ok = copy_body(out, content_length, deadline_ms, error);
+    }
+    out.close();
+
+    if (!ok || !out) {
+        keep_alive = false;
+        if (error.empty()) {
+            error = "could not write " + tmp_path;
+        }
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    // An auth/error page sometimes comes back as 200 - make sure it's a JPEG
+    char magic[2] = {0, 0};
+    std::ifstream check(tmp_path, std::ios::binary);
+    check.read(magic, 2);
+    if (static_cast<unsigned char>(magic[0]) != 0xFF || static_cast<unsigned char>(magic[1]) != 0xD8) {
+        error = "response body is not a JPEG";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    if (std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        error = "could not rename " + tmp_path + ": " + strerror(errno);
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool NetworkCamera::capture(const std::string& path, std::string& error) {
+    long deadline = now_ms() + timeout_ms;
+
+    // A reused connection may have been dropped by the camera while idle;
+    // allow one retry on a fresh connection in that case.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = is_open();
+        if (!open(deadline, error)) {
+            return false;
+        }
+
+        bool keep_alive = false;
+        error.clear();
+        bool ok = fetch(path, deadline, keep_alive, error);
+        if (!ok || !keep_alive) {
+            close();
+        }
+        if (ok || !reused || now_ms() >= deadline) {
+            return ok;
+        }
+    }
+    return false;
+}
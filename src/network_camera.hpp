@@ -0,0 +1,47 @@
+// network_camera.hpp
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "camera_backend.hpp"
+
+// --- HTTP Snapshot Camera ---
+// Fetches JPEG snapshots from an IP camera over one persistent HTTP/1.1
+// keep-alive connection (no process, TCP or auth setup per frame).
+// The body is streamed straight to disk. Plain http:// only.
+class NetworkCamera : public CameraBackend {
+private:
+    std::string url;
+    std::string host;
+    std::string port;
+    std::string path;
+    std::string auth_header;
+    int timeout_ms;
+    int sock;
+    bool peer_closed;
+
+    // Bytes read past the end of the headers/previous chunk
+    std::vector<char> pending;
+
+    bool parse_url(std::string& error);
+    bool open(long deadline_ms, std::string& error);
+    bool connect_socket(long deadline_ms, std::string& error);
+    bool send_request(long deadline_ms);
+    bool read_some(long deadline_ms, std::string& error);
+    bool read_line(std::string& line, long deadline_ms, std::string& error);
+    bool copy_body(std::ofstream& out, long length, long deadline_ms, std::string& error);
+    bool fetch(const std::string& file_path, long deadline_ms, bool& keep_alive, std::string& error);
+
+public:
+    NetworkCamera(const std::string& url, int timeout_ms = 5000);
+    ~NetworkCamera();
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override { return sock >= 0; }
+    bool capture(const std::string& path, std::string& error) override;
+    std::string name() const override { return "http"; }
+};
@@ -0,0 +1,638 @@
+// parity.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "parity.hpp"
+#include "gf256.hpp"
+#include "manifest.hpp"
+#include "stage_times.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+#define PARITY_MAGIC "timelapse-parity 1"
+// Parity shards start on a block boundary after the header
+#define PARITY_ALIGN 4096
+
+// Read size for frames, as in the scrubber
+#define PARITY_READ_SIZE (1 << 20)
+
+// Coefficient rows are bytes: data + parity shards of a group must fit in 256
+#define PARITY_MAX_SHARDS 256
+
+struct ParityOptions {
+    std::string root;
+    std::string day;
+    int shards;
+    int group_size;
+    double max_mb_per_s;
+    int max_minutes;
+    bool idle;
+};
+
+// What a group file's header says
+struct ParityGroup {
+    int index;
+    int shards;
+    uint64_t shard_size;
+    uint64_t offset;
+    std::vector<std::string> parity_hashes;
+    std::vector<ManifestEntry> frames;
+};
+
+static void parity_usage() {
+    std::cerr << "Usage: timelapse parity [--root DIR] [--day NAME] [--shards N] [--group N]\n"
+                 "                        [--max-mb-per-s N] [--max-minutes N] [--no-idle]\n";
+}
+
+static void repair_usage() {
+    std::cerr << "Usage: timelapse repair DAY_DIR [--dry-run] [--max-mb-per-s N] [--no-idle]\n";
+}
+
+static std::string group_path(const std::string& day_dir, int index) {
+    char name[32];
+    snprintf(name, sizeof(name), "group_%04d.par", index);
+    return with_slash(day_dir) + PARITY_DIR "/" + name;
+}
+
+static std::vector<std::string> group_files(const std::string& day_dir) {
+    std::vector<std::string> files;
+    for (const std::string& name : list_dir(with_slash(day_dir) + PARITY_DIR)) {
+        if (name.compare(0, 6, "group_") == 0 && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".par") == 0) {
+            files.push_back(name);
+        }
+    }
+    return files;
+}
+
+bool has_parity(const std::string& day_dir) {
+    return !group_files(day_dir).empty();
+}
+
+// Generator row of parity shard r for data shard j, with k data shards: a
+// Cauchy matrix 1 / (x_r + y_j) with x_r = k + r and y_j = j, so every
+// square submatrix of [I; C] is invertible
+static uint8_t parity_coef(int k, int r, int j) {
+    return gf_inv(static_cast<uint8_t>((k + r) ^ j));
+}
+
+// Reads a whole file with large sequential reads under the rate limit and
+// drops its pages afterwards. False if it can't be opened or read.
+static bool read_frame(const std::string& path, RateLimiter& limiter, std::vector<uint8_t>& data, uint64_t& size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    data.resize(st.st_size);
+
+    size = 0;
+    bool ok = true;
+    while (size < data.size()) {
+        size_t want = std::min<size_t>(PARITY_READ_SIZE, data.size() - size);
+        ssize_t n = read(fd, data.data() + size, want);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ok = false; // EIO: the card can't read this block at all
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+        limiter.consume(n);
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return ok;
+}
+
+static bool pread_all(int fd, uint8_t* data, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, data + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+static bool read_group_header(const std::string& path, ParityGroup& group) {
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != PARITY_MAGIC) {
+        return false;
+    }
+
+    std::string word;
+    if (!(file >> word >> group.index) || word != "group" || !(file >> word >> group.shards) || word != "parity" ||
+        !(file >> word >> group.shard_size) || word != "shard" || !(file >> word >> group.offset) ||
+        word != "offset") {
+        return false;
+    }
+    group.parity_hashes.clear();
+    group.frames.clear();
+    while (file >> word) {
+        if (word == "p") {
+            std::string hash;
+            file >> hash;
+            group.parity_hashes.push_back(hash);
+        } else if (word == "f") {
+            ManifestEntry entry;
+            file >> entry.hash >> entry.size >> entry.name;
+            group.frames.push_back(entry);
+        } else if (word == "end") {
+            return static_cast<int>(group.parity_hashes.size()) == group.shards && !group.frames.empty() &&
+                   group.shards + group.frames.size() <= PARITY_MAX_SHARDS;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Writes header + parity shards to a temporary file, fsyncs it and renames
+// it into place
+static bool write_group(const std::string& path, ParityGroup& group, const std::vector<std::vector<uint8_t>>& parity) {
+    std::stringstream ss;
+    ss << PARITY_MAGIC << "\n";
+    for (;;) {
+        std::stringstream body;
+        body << "group " << group.index << " parity " << group.shards << " shard " << group.shard_size << " offset "
+             << group.offset << "\n";
+        for (const std::string& hash : group.parity_hashes) {
+            body << "p " << hash << "\n";
+        }
+        for (const ManifestEntry& entry : group.frames) {
+            body << "f " << entry.hash << " " << entry.size << " " << entry.name << "\n";
+        }
+        body << "end\n";
+        uint64_t size = ss.str().size() + body.str().size();
+        uint64_t offset = (size + PARITY_ALIGN - 1) / PARITY_ALIGN * PARITY_ALIGN;
+        if (offset == group.offset) {
+            ss << body.str();
+            break;
+        }
+        group.offset = offset; // the offset is part of the header: settle it
+    }
+    std::string header = ss.str();
+    header.resize(group.offset, '\0');
+
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_all(fd, reinterpret_cast<const uint8_t*>(header.data()), header.size());
+    for (size_t r = 0; ok && r < parity.size(); r++) {
+        ok = write_all(fd, parity[r].data(), parity[r].size());
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Up to date: same layout and the same frames (name, size, hash) as now
+static bool group_current(const std::string& path, int shards, const std::vector<ManifestEntry>& frames) {
+    ParityGroup group;
+    if (!read_group_header(path, group) || group.shards != shards || group.frames.size() != frames.size()) {
+        return false;
+    }
+    for (size_t j = 0; j < frames.size(); j++) {
+        if (frames[j].hash.empty() || group.frames[j].name != frames[j].name ||
+            group.frames[j].size != frames[j].size || group.frames[j].hash != frames[j].hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Encodes one group. Frames without a hash (no manifest yet) get the one
+// read now; a frame that doesn't match its manifest entry stops the group.
+static bool encode_group(const std::string& dir, int index, std::vector<ManifestEntry>& frames, int shards,
+                         RateLimiter& limiter, std::vector<uint8_t>& data, std::string& problem) {
+    StageTimer timer("parity");
+    const GfKernels& gf = gf_kernels();
+    const int k = static_cast<int>(frames.size());
+
+    uint64_t shard_size = 0;
+    for (const ManifestEntry& entry : frames) {
+        shard_size = std::max(shard_size, entry.size);
+    }
+    std::vector<std::vector<uint8_t>> parity(shards, std::vector<uint8_t>(shard_size, 0));
+
+    for (int j = 0; j < k; j++) {
+        ManifestEntry& entry = frames[j];
+        uint64_t size = 0;
+        if (!read_frame(dir + entry.name, limiter, data, size)) {
+            problem = "UNREADABLE " + entry.name;
+            return false;
+        }
+        std::string hash = hash_to_hex(hash_bytes(reinterpret_cast<const char*>(data.data()), size));
+        if (!entry.hash.empty() && (hash != entry.hash || size != entry.size)) {
+            problem = "CORRUPT " + entry.name + " (does not match " MANIFEST_NAME ")";
+            return false;
+        }
+        if (size > shard_size) {
+            problem = "CHANGED " + entry.name + " (grew while encoding)";
+            return false;
+        }
+        entry.hash = hash;
+        entry.size = size;
+        for (int r = 0; r < shards; r++) {
+            gf.mul_add(data.data(), parity[r].data(), size, parity_coef(k, r, j));
+        }
+    }
+
+    ParityGroup group;
+    group.index = index;
+    group.shards = shards;
+    group.shard_size = shard_size;
+    group.offset = 0;
+    group.frames = frames;
+    for (const std::vector<uint8_t>& shard : parity) {
+        group.parity_hashes.push_back(hash_to_hex(hash_bytes(reinterpret_cast<const char*>(shard.data()), shard.size())));
+    }
+    if (!write_group(group_path(dir, index), group, parity)) {
+        problem = "cannot write " + group_path(dir, index);
+        return false;
+    }
+    limiter.consume(shard_size * shards);
+    return true;
+}
+
+// Brings one day's parity up to date. Returns false if the time ran out.
+static bool parity_day(const std::string& dir, const ParityOptions& opts, RateLimiter& limiter,
+                       std::vector<uint8_t>& data, std::chrono::steady_clock::time_point deadline,
+                       int& groups_written, int& groups_failed) {
+    std::vector<ManifestEntry> frames;
+    bool have_manifest = read_manifest(dir, frames);
+    if (!have_manifest) {
+        for (const std::string& name : list_frames(dir)) {
+            struct stat st;
+            if (stat((dir + name).c_str(), &st) == 0) {
+                frames.push_back({ name, static_cast<uint64_t>(st.st_size), "" });
+            }
+        }
+    }
+    if (frames.empty()) {
+        return true;
+    }
+    create_dir(dir + PARITY_DIR);
+
+    const int groups = static_cast<int>((frames.size() + opts.group_size - 1) / opts.group_size);
+    int written = 0;
+    int failed = 0;
+    bool out_of_time = false;
+    for (int g = 0; g < groups && !out_of_time; g++) {
+        auto first = frames.begin() + static_cast<size_t>(g) * opts.group_size;
+        auto last = frames.begin() + std::min(frames.size(), static_cast<size_t>(g + 1) * opts.group_size);
+        std::vector<ManifestEntry> members(first, last);
+        if (group_current(group_path(dir, g), opts.shards, members)) {
+            continue;
+        }
+
+        std::string problem;
+        if (encode_group(dir, g, members, opts.shards, limiter, data, problem)) {
+            std::copy(members.begin(), members.end(), first); // hashes for a new manifest
+            written++;
+        } else {
+            failed++;
+            archive_log("Parity: " + problem + " in " + dir + ", group " + std::to_string(g) +
+                        " left without parity (check it with scrub/repair)");
+        }
+        out_of_time = opts.max_minutes > 0 && std::chrono::steady_clock::now() >= deadline;
+    }
+    if (out_of_time) {
+        groups_written += written;
+        groups_failed += failed;
+        return false;
+    }
+
+    // Frames removed since the last run leave groups past the end
+    for (const std::string& name : group_files(dir)) {
+        if (std::atoi(name.c_str() + 6) >= groups) {
+            std::remove((dir + PARITY_DIR "/" + name).c_str());
+        }
+    }
+
+    if (!have_manifest) {
+        std::vector<ManifestEntry> hashed;
+        for (const ManifestEntry& entry : frames) {
+            if (!entry.hash.empty()) {
+                hashed.push_back(entry);
+            }
+        }
+        write_manifest(dir, hashed);
+        archive_log("Parity: no manifest in " + dir + ", created one for " + std::to_string(hashed.size()) +
+                    " frames");
+    }
+    if (written > 0 || failed > 0) {
+        archive_log("Parity: " + dir + ": " + std::to_string(written) + " of " + std::to_string(groups) +
+                    " groups encoded, " + std::to_string(failed) + " failed");
+    }
+    groups_written += written;
+    groups_failed += failed;
+    return true;
+}
+
+int run_parity(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+
+    ParityOptions opts;
+    opts.root = PICS_PATH;
+    opts.shards = std::stoi(config_value(config, "parity_shards", "0"));
+    opts.group_size = std::stoi(config_value(config, "parity_group", "32"));
+    opts.max_mb_per_s = std::stod(config_value(config, "parity_max_mb_per_s", "4"));
+    opts.max_minutes = 0;
+    opts.idle = true;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--root" && has_value) {
+            opts.root = argv[++i];
+        } else if (arg == "--day" && has_value) {
+            opts.day = argv[++i];
+        } else if (arg == "--shards" && has_value) {
+            opts.shards = std::stoi(argv[++i]);
+        } else if (arg == "--group" && has_value) {
+            opts.group_size = std::stoi(argv[++i]);
+        } else if (arg == "--max-mb-per-s" && has_value) {
+            opts.max_mb_per_s = std::stod(argv[++i]);
+        } else if (arg == "--max-minutes" && has_value) {
+            opts.max_minutes = std::stoi(argv[++i]);
+        } else if (arg == "--no-idle") {
+            opts.idle = false;
+        } else {
+            parity_usage();
+            return 2;
+        }
+    }
+    if (opts.shards <= 0) {
+        std::cout << "Parity is off (parity_shards = 0)" << std::endl;
+        return 0;
+    }
+    if (opts.group_size < 1 || opts.shards + opts.group_size > PARITY_MAX_SHARDS) {
+        std::cerr << "parity_group + parity_shards must be between 2 and " << PARITY_MAX_SHARDS << std::endl;
+        return 2;
+    }
+    opts.root = with_slash(opts.root);
+
+    if (opts.idle) {
+        set_idle_priority();
+    }
+
+    // --day also takes today's directory (the job graph encodes it right
+    // after the video). Otherwise newest first: those aren't on the NAS yet.
+    std::vector<std::string> days;
+    if (!opts.day.empty()) {
+        days.push_back(opts.day);
+    } else {
+        days = finished_days(opts.root);
+        std::reverse(days.begin(), days.end());
+    }
+
+    RateLimiter limiter(opts.max_mb_per_s * 1024 * 1024);
+    std::vector<uint8_t> data;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(opts.max_minutes);
+    int groups_written = 0;
+    int groups_failed = 0;
+    bool finished = true;
+    for (const std::string& day : days) {
+        std::string dir = with_slash(opts.root + day);
+        if (!parity_day(dir, opts, limiter, data, deadline, groups_written, groups_failed)) {
+            archive_log("Parity: time limit reached in " + dir + ", will carry on next run");
+            finished = false;
+            break;
+        }
+    }
+
+    std::string error;
+    if (!append_stage_times(STAGE_TIMES_FILE, "parity", error)) {
+        archive_log("Parity: " + error);
+    }
+    if (groups_written > 0 || groups_failed > 0 || !finished) {
+        archive_log("Parity: " + std::to_string(groups_written) + " groups encoded, " +
+                    std::to_string(groups_failed) + " failed (" + gf_kernels().name + " kernels)");
+    }
+    return groups_failed > 0 ? 1 : 0;
+}
+
+// Checks one group and rebuilds its damaged frames. Returns false if some
+// couldn't be rebuilt.
+static bool repair_group(const std::string& dir, const std::string& file, std::vector<ManifestEntry>& manifest,
+                         bool dry_run, RateLimiter& limiter, std::vector<uint8_t>& data, int& repaired) {
+    std::string path = dir + PARITY_DIR "/" + file;
+    ParityGroup group;
+    if (!read_group_header(path, group)) {
+        archive_log("Repair: " + path + " is damaged, its frames can't be checked");
+        return false;
+    }
+    for (const ManifestEntry& entry : group.frames) {
+        ManifestEntry* current = find_manifest_entry(manifest, entry.name);
+        if (current != nullptr && (current->hash != entry.hash || current->size != entry.size)) {
+            archive_log("Repair: " + path + " is out of date (" + entry.name + " changed since), run "
+                        "timelapse parity first");
+            return true;
+        }
+    }
+
+    // Which frames and parity shards are intact
+    const int k = static_cast<int>(group.frames.size());
+    std::vector<int> bad;
+    for (int j = 0; j < k; j++) {
+        const ManifestEntry& entry = group.frames[j];
+        uint64_t size = 0;
+        if (!read_frame(dir + entry.name, limiter, data, size) || size != entry.size ||
+            hash_to_hex(hash_bytes(reinterpret_cast<const char*>(data.data()), size)) != entry.hash) {
+            bad.push_back(j);
+        }
+    }
+    if (bad.empty()) {
+        return true;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    std::vector<int> good_parity;
+    for (int r = 0; fd >= 0 && r < group.shards; r++) {
+        data.resize(group.shard_size);
+        if (pread_all(fd, data.data(), group.shard_size, group.offset + r * group.shard_size) &&
+            hash_to_hex(hash_bytes(reinterpret_cast<const char*>(data.data()), group.shard_size)) ==
+                group.parity_hashes[r]) {
+            good_parity.push_back(r);
+        }
+        limiter.consume(group.shard_size);
+    }
+
+    std::string names;
+    for (int j : bad) {
+        names += " " + group.frames[j].name;
+    }
+    if (bad.size() > good_parity.size()) {
+        archive_log("Repair: " + std::to_string(bad.size()) + " damaged frames in " + file + " but only " +
+                    std::to_string(good_parity.size()) + " usable parity shards, restore from the NAS:" + names);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    if (dry_run) {
+        archive_log("Repair: would rebuild" + names + " in " + dir);
+        close(fd);
+        return true;
+    }
+
+    // Solve with the intact frames plus as many intact parity shards as
+    // there are damaged frames: rows of the generator matrix they came from
+    StageTimer timer("repair");
+    std::vector<int> rows; // 0..k-1: frame, k + r: parity shard r
+    for (int j = 0; j < k; j++) {
+        if (std::find(bad.begin(), bad.end(), j) == bad.end()) {
+            rows.push_back(j);
+        }
+    }
+    for (size_t i = 0; i < bad.size(); i++) {
+        rows.push_back(k + good_parity[i]);
+    }
+    std::vector<uint8_t> matrix(k * k, 0);
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            matrix[i * k + j] = rows[i] < k ? (rows[i] == j) : parity_coef(k, rows[i] - k, j);
+        }
+    }
+    if (!gf_invert_matrix(matrix, k)) {
+        archive_log("Repair: singular matrix for " + file + " (this is a bug)");
+        close(fd);
+        return false;
+    }
+
+    // frame[j] = sum over rows i of inverse[j][i] * shard[i]
+    const GfKernels& gf = gf_kernels();
+    std::vector<std::vector<uint8_t>> rebuilt(bad.size(), std::vector<uint8_t>(group.shard_size, 0));
+    bool ok = true;
+    for (int i = 0; ok && i < k; i++) {
+        uint64_t size = 0;
+        if (rows[i] < k) {
+            ok = read_frame(dir + group.frames[rows[i]].name, limiter, data, size) &&
+                 size == group.frames[rows[i]].size;
+        } else {
+            size = group.shard_size;
+            data.resize(size);
+            ok = pread_all(fd, data.data(), size, group.offset + (rows[i] - k) * group.shard_size);
+            limiter.consume(size);
+        }
+        for (size_t b = 0; ok && b < bad.size(); b++) {
+            gf.mul_add(data.data(), rebuilt[b].data(), size, matrix[bad[b] * k + i]);
+        }
+    }
+    close(fd);
+    if (!ok) {
+        archive_log("Repair: a shard of " + file + " stopped reading back during the repair, try again");
+        return false;
+    }
+
+    for (size_t b = 0; b < bad.size(); b++) {
+        const ManifestEntry& entry = group.frames[bad[b]];
+        std::string hash = hash_to_hex(hash_bytes(reinterpret_cast<const char*>(rebuilt[b].data()), entry.size));
+        // A new file (new blocks) replaces the damaged one
+        if (hash != entry.hash ||
+            !write_file_atomic(dir + entry.name, reinterpret_cast<const char*>(rebuilt[b].data()), entry.size, true)) {
+            archive_log("Repair: could not rebuild " + dir + entry.name);
+            ok = false;
+            continue;
+        }
+        archive_log("Repair: rebuilt " + dir + entry.name);
+        repaired++;
+    }
+    return ok;
+}
+
+int run_repair(int argc, char* argv[]) {
+    std::string dir;
+    bool dry_run = false;
+    bool idle = true;
+    double max_mb_per_s = 0;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--dry-run") {
+            dry_run = true;
+        } else if (arg == "--max-mb-per-s" && has_value) {
+            max_mb_per_s = std::stod(argv[++i]);
+        } else if (arg == "--no-idle") {
+            idle = false;
+        } else if (arg[0] != '-' && dir.empty()) {
+            dir = arg;
+        } else {
+            repair_usage();
+            return 2;
+        }
+    }
+    if (dir.empty()) {
+        repair_usage();
+        return 2;
+    }
+    // A bare day name means the one in pics/
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 && dir.find('/') == std::string::npos) {
+        dir = PICS_PATH + dir;
+    }
+    dir = with_slash(dir);
+
+    std::vector<std::string> files = group_files(dir);
+    if (files.empty()) {
+        std::cerr << "No parity in " << dir << " (see timelapse parity)" << std::endl;
+        return 1;
+    }
+    if (idle) {
+        set_idle_priority();
+    }
+
+    std::vector<ManifestEntry> manifest;
+    read_manifest(dir, manifest);
+    RateLimiter limiter(max_mb_per_s * 1024 * 1024);
+    std::vector<uint8_t> data;
+    int repaired = 0;
+    int unrepaired_groups = 0;
+    for (const std::string& file : files) {
+        if (!repair_group(dir, file, manifest, dry_run, limiter, data, repaired)) {
+            unrepaired_groups++;
+        }
+    }
+
+    archive_log("Repair: " + dir + ": " + std::to_string(files.size()) + " groups checked, " +
+                std::to_string(repaired) + " frames rebuilt" +
+                (unrepaired_groups > 0 ? ", " + std::to_string(unrepaired_groups) + " groups NOT repaired" : ""));
+    return unrepaired_groups > 0 ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+// parity.hpp
+
+#pragma once
+
+#include <string>
+
+// --- Frame Parity ---
+// A day lives only on the SD card until the NAS copy is verified. One bad
+// block in that time destroys the frame it falls in. The scrubber can find
+// such a frame, but only the NAS can restore it. "timelapse parity" adds
+// Reed-Solomon parity to each finished day, so damaged frames can be rebuilt
+// on the Pi itself with "timelapse repair".
+//
+// A day's frames (in manifest order) are cut into groups of parity_group.
+// Each group gets parity_shards parity shards, each as long as the group's
+// largest frame; shorter frames count as zero-padded. Any parity_shards
+// damaged or missing frames of a group can be rebuilt from the rest. The
+// code is systematic (the frames themselves are unchanged) with a Cauchy
+// generator matrix over GF(256) (gf256.hpp), so every combination of
+// surviving shards can be solved. 32 + 2 costs about 6% of the day's size.
+//
+// Each group is one file, <day>/parity/group_NNNN.par: a text header, then
+// the parity shards from offset `offset` on:
+//
+//   timelapse-parity 1
+//   group <n> parity <shards> shard <bytes> offset <bytes>
+//   p <hash of parity shard 0>
+//   ...
+//   f <hash> <size> <name>        one per frame, as in manifest.txt
+//   ...
+//   end
+//
+// Frames are checked against manifest.txt while they are encoded. A group
+// with a frame that no longer matches is not encoded (repair it first), so
+// parity never covers bad data. A group whose frames changed on purpose
+// (recompress) is stale and gets rebuilt on the next run. Days without a
+// manifest get one from the same pass.
+//
+// Like the scrubber, encoding runs at idle priority under a read-rate cap,
+// one frame at a time with large sequential reads.
+
+#define PARITY_DIR "parity"
+
+// True if day_dir has parity files
+bool has_parity(const std::string& day_dir);
+
+// Command line entry points: "timelapse parity ..." / "timelapse repair ..."
+int run_parity(int argc, char* argv[]);
+int run_repair(int argc, char* argv[]);
@@ -0,0 +1,545 @@
+// pixel_kernels.cpp
+
+#include <algorithm>
+#include <cstring>
+
+#include "pixel_kernels.hpp"
+#include "cpu_features.hpp"
+
+// x86-64 only: the kernels use 64-bit lane moves (_mm_cvtsi128_si64,
+// _mm_extract_epi64) that 32-bit x86 doesn't have
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNELS 1
+#endif
+
+// ============================================================================
+// Scalar reference kernels - every SIMD variant must match these exactly
+// ============================================================================
+
+static void apply_lut_scalar(const uint8_t* src, uint8_t* dst, size_t n, const uint8_t* lut) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        dst[i] = lut[src[i]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+    }
+    for (; i < n; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+static void blend_scalar(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n, int weight) {
+    const unsigned int wb = weight;
+    const unsigned int wa = 256 - weight;
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = static_cast<uint8_t>((a[i] * wa + b[i] * wb + 128) >> 8);
+    }
+}
+
+static void absdiff_scalar(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+}
+
+static uint64_t sad_scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return sum;
+}
+
+// Four sub-histograms so runs of equal bytes (sky!) don't serialise on one
+// counter. Fast enough that the SIMD sets use it too, along with the LUT.
+static void histogram_scalar(const uint8_t* src, size_t n, uint32_t* hist) {
+    uint32_t sub[4][256];
+    memset(sub, 0, sizeof(sub));
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sub[0][src[i]]++;
+        sub[1][src[i + 1]]++;
+        sub[2][src[i + 2]]++;
+        sub[3][src[i + 3]]++;
+    }
+    for (; i < n; i++) {
+        sub[0][src[i]]++;
+    }
+    for (int v = 0; v < 256; v++) {
+        hist[v] += sub[0][v] + sub[1][v] + sub[2][v] + sub[3][v];
+    }
+}
+
+static void channel_gains_scalar(const uint8_t* src, uint8_t* dst, size_t pixels, const uint16_t* gains) {
+    for (size_t p = 0; p < pixels; p++) {
+        for (int c = 0; c < 3; c++) {
+            unsigned int v = (src[p * 3 + c] * static_cast<unsigned int>(gains[c])) >> 8;
+            dst[p * 3 + c] = static_cast<uint8_t>(v > 255 ? 255 : v);
+        }
+    }
+}
+
+static void max_stack_scalar(const uint8_t* src, uint8_t* dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = std::max(dst[i], src[i]);
+    }
+}
+
+static void sky_counts_scalar(const uint8_t* rgb, size_t pixels, int min_sum, int ratio_q8, uint32_t* counts) {
+    uint32_t lit = 0;
+    uint32_t cloudy = 0;
+    for (size_t p = 0; p < pixels; p++) {
+        const uint8_t* px = rgb + p * 3;
+        if (px[0] + px[1] + px[2] >= min_sum) {
+            lit++;
+            cloudy += (px[0] << 8) >= px[2] * ratio_q8 ? 1 : 0;
+        }
+    }
+    counts[0] += lit;
+    counts[1] += cloudy;
+}
+
+static const PixelKernels scalar_kernels = {
+    "scalar",
+    apply_lut_scalar,
+    blend_scalar,
+    absdiff_scalar,
+    sad_scalar,
+    histogram_scalar,
+    channel_gains_scalar,
+    max_stack_scalar,
+    sky_counts_scalar,
+};
+
+// ============================================================================
+// x86: SSE4.1 and AVX2 (compiled with target attributes, picked at runtime)
+// ============================================================================
+
+#ifdef HAVE_X86_KERNELS
+
+TARGET_SSE41 static void blend_sse41(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n, int weight) {
+    const __m128i wa = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i wb = _mm_set1_epi16(static_cast<short>(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_scalar(a + i, b + i, dst + i, n - i, weight);
+}
+
+TARGET_SSE41 static void absdiff_sse41(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), d);
+    }
+    absdiff_scalar(a + i, b + i, dst + i, n - i);
+}
+
+TARGET_SSE41 static uint64_t sad_sse41(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    uint64_t sum = static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+                   static_cast<uint64_t>(_mm_extract_epi64(acc, 1));
+    return sum + sad_scalar(a + i, b + i, n - i);
+}
+
+// 48 bytes (16 pixels) per step: 6 vectors of 8 lanes, each with the gain of
+// the channel at that byte position.
+TARGET_SSE41 static void channel_gains_sse41(const uint8_t* src, uint8_t* dst, size_t pixels, const uint16_t* gains) {
+    __m128i g[6];
+    for (int v = 0; v < 6; v++) {
+        uint16_t lanes[8];
+        for (int j = 0; j < 8; j++) {
+            lanes[j] = gains[(v * 8 + j) % 3];
+        }
+        g[v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+    }
+    const __m128i max_value = _mm_set1_epi16(255);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t n = pixels * 3;
+    size_t i = 0;
+    for (; i + 48 <= n; i += 48) {
+        for (int c = 0; c < 3; c++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + c * 16));
+            // (src << 8) * gain >> 16 == (src * gain) >> 8
+            __m128i lo = _mm_mulhi_epu16(_mm_slli_epi16(_mm_unpacklo_epi8(v, zero), 8), g[c * 2]);
+            __m128i hi = _mm_mulhi_epu16(_mm_slli_epi16(_mm_unpackhi_epi8(v, zero), 8), g[c * 2 + 1]);
+            lo = _mm_min_epu16(lo, max_value);
+            hi = _mm_min_epu16(hi, max_value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + c * 16), _mm_packus_epi16(lo, hi));
+        }
+    }
+    channel_gains_scalar(src + i, dst + i, (n - i) / 3, gains);
+}
+
+TARGET_SSE41 static void max_stack_sse41(const uint8_t* src, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(s, d));
+    }
+    max_stack_scalar(src + i, dst + i, n - i);
+}
+
+// 16 pixels (48 bytes) per step: pshufb gathers each channel from the three
+// vectors, then the tests run in 16-bit lanes and the masks are counted
+TARGET_SSE41 static void sky_counts_sse41(const uint8_t* rgb, size_t pixels, int min_sum, int ratio_q8,
+                                          uint32_t* counts) {
+    __m128i gather[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 3; v++) {
+            int8_t lanes[16];
+            for (int j = 0; j < 16; j++) {
+                int index = j * 3 + c;
+                lanes[j] = static_cast<int8_t>(index / 16 == v ? index % 16 : -128);
+            }
+            gather[c][v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+        }
+    }
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i threshold = _mm_set1_epi16(static_cast<short>(min_sum - 1));
+    const __m128i ratio = _mm_set1_epi16(static_cast<short>(ratio_q8));
+
+    uint64_t lit = 0;
+    uint64_t cloudy = 0;
+    size_t p = 0;
+    while (p + 16 <= pixels) {
+        // Byte counters (mask = -1 per hit) gain at most 1 per step: flush every 255
+        __m128i lit_acc = zero;
+        __m128i cloud_acc = zero;
+        for (int step = 0; step < 255 && p + 16 <= pixels; step++, p += 16) {
+            __m128i v[3];
+            for (int i = 0; i < 3; i++) {
+                v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + p * 3 + i * 16));
+            }
+            __m128i ch[3];
+            for (int c = 0; c < 3; c++) {
+                ch[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[0], gather[c][0]),
+                                                  _mm_shuffle_epi8(v[1], gather[c][1])),
+                                     _mm_shuffle_epi8(v[2], gather[c][2]));
+            }
+            __m128i lit_mask[2];
+            __m128i cloud_mask[2];
+            for (int half = 0; half < 2; half++) {
+                __m128i r = half ? _mm_unpackhi_epi8(ch[0], zero) : _mm_unpacklo_epi8(ch[0], zero);
+                __m128i g = half ? _mm_unpackhi_epi8(ch[1], zero) : _mm_unpacklo_epi8(ch[1], zero);
+                __m128i b = half ? _mm_unpackhi_epi8(ch[2], zero) : _mm_unpacklo_epi8(ch[2], zero);
+                lit_mask[half] = _mm_cmpgt_epi16(_mm_add_epi16(_mm_add_epi16(r, g), b), threshold);
+                // r * 256 >= b * ratio, unsigned 16-bit (both at most 65280)
+                __m128i r256 = _mm_slli_epi16(r, 8);
+                cloud_mask[half] = _mm_and_si128(
+                    _mm_cmpeq_epi16(_mm_max_epu16(r256, _mm_mullo_epi16(b, ratio)), r256), lit_mask[half]);
+            }
+            lit_acc = _mm_sub_epi8(lit_acc, _mm_packs_epi16(lit_mask[0], lit_mask[1]));
+            cloud_acc = _mm_sub_epi8(cloud_acc, _mm_packs_epi16(cloud_mask[0], cloud_mask[1]));
+        }
+        __m128i lit_sum = _mm_sad_epu8(lit_acc, zero);
+        __m128i cloud_sum = _mm_sad_epu8(cloud_acc, zero);
+        lit += _mm_cvtsi128_si64(lit_sum) + _mm_extract_epi64(lit_sum, 1);
+        cloudy += _mm_cvtsi128_si64(cloud_sum) + _mm_extract_epi64(cloud_sum, 1);
+    }
+    counts[0] += static_cast<uint32_t>(lit);
+    counts[1] += static_cast<uint32_t>(cloudy);
+    sky_counts_scalar(rgb + p * 3, pixels - p, min_sum, ratio_q8, counts);
+}
+
+static const PixelKernels sse41_kernels = {
+    "sse4.1",
+    apply_lut_scalar, // a 16-table pshufb lookup measured slower than the scalar gather
+    blend_sse41,
+    absdiff_sse41,
+    sad_sse41,
+    histogram_scalar,
+    channel_gains_sse41,
+    max_stack_sse41,
+    sky_counts_sse41,
+};
+
+TARGET_AVX2 static void blend_avx2(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n, int weight) {
+    const __m256i wa = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i wb = _mm256_set1_epi16(static_cast<short>(weight));
+    const __m256i round = _mm256_set1_epi16(128);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i out[2];
+        for (int h = 0; h < 2; h++) {
+            __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + h * 16)));
+            __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + h * 16)));
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(va, wa), _mm256_mullo_epi16(vb, wb));
+            out[h] = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 8);
+        }
+        // packus works per 128-bit lane; put the quadwords back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(out[0], out[1]), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    blend_scalar(a + i, b + i, dst + i, n - i, weight);
+}
+
+TARGET_AVX2 static void absdiff_avx2(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), d);
+    }
+    absdiff_scalar(a + i, b + i, dst + i, n - i);
+}
+
+TARGET_AVX2 static uint64_t sad_avx2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sad_scalar(a + i, b + i, n - i);
+}
+
+// 96 bytes (32 pixels) per step: 6 vectors of 16 lanes
+TARGET_AVX2 static void channel_gains_avx2(const uint8_t* src, uint8_t* dst, size_t pixels, const uint16_t* gains) {
+    __m256i g[6];
+    for (int v = 0; v < 6; v++) {
+        uint16_t lanes[16];
+        for (int j = 0; j < 16; j++) {
+            lanes[j] = gains[(v * 16 + j) % 3];
+        }
+        g[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+    }
+    const __m256i max_value = _mm256_set1_epi16(255);
+
+    size_t n = pixels * 3;
+    size_t i = 0;
+    for (; i + 96 <= n; i += 96) {
+        for (int c = 0; c < 3; c++) {
+            __m256i out[2];
+            for (int h = 0; h < 2; h++) {
+                __m256i v = _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + c * 32 + h * 16)));
+                __m256i r = _mm256_mulhi_epu16(_mm256_slli_epi16(v, 8), g[c * 2 + h]);
+                out[h] = _mm256_min_epu16(r, max_value);
+            }
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(out[0], out[1]), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + c * 32), packed);
+        }
+    }
+    channel_gains_scalar(src + i, dst + i, (n - i) / 3, gains);
+}
+
+TARGET_AVX2 static void max_stack_avx2(const uint8_t* src, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(s, d));
+    }
+    max_stack_scalar(src + i, dst + i, n - i);
+}
+
+static const PixelKernels avx2_kernels = {
+    "avx2",
+    apply_lut_scalar,
+    blend_avx2,
+    absdiff_avx2,
+    sad_avx2,
+    histogram_scalar,
+    channel_gains_avx2,
+    max_stack_avx2,
+    sky_counts_sse41,
+};
+
+#endif // HAVE_X86_KERNELS
+
+// ============================================================================
+// ARM NEON (Pi 2/3/4/5 and Zero 2; the original Pi Zero stays scalar)
+// ============================================================================
+
+#ifdef HAVE_NEON_KERNELS
+
+static void blend_neon(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n, int weight) {
+    const uint16_t wa = static_cast<uint16_t>(256 - weight);
+    const uint16_t wb = static_cast<uint16_t>(weight);
+    const uint16x8_t round = vdupq_n_u16(128);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_low_u8(va)), wa), vmovl_u8(vget_low_u8(vb)), wb);
+        uint16x8_t hi = vmlaq_n_u16(vmulq_n_u16(vmovl_u8(vget_high_u8(va)), wa), vmovl_u8(vget_high_u8(vb)), wb);
+        lo = vshrq_n_u16(vaddq_u16(lo, round), 8);
+        hi = vshrq_n_u16(vaddq_u16(hi, round), 8);
+        vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+    blend_scalar(a + i, b + i, dst + i, n - i, weight);
+}
+
+static void absdiff_neon(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    absdiff_scalar(a + i, b + i, dst + i, n - i);
+}
+
+static uint64_t sad_neon(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint64x2_t total = vdupq_n_u64(0);
+    size_t i = 0;
+    while (i + 16 <= n) {
+        // 16-bit lanes gain at most 510 per step: flush to 32/64 bits every 128 steps
+        uint16x8_t acc16 = vdupq_n_u16(0);
+        for (int step = 0; step < 128 && i + 16 <= n; step++, i += 16) {
+            acc16 = vpadalq_u8(acc16, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        }
+        total = vpadalq_u32(total, vpaddlq_u16(acc16));
+    }
+    return vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1) + sad_scalar(a + i, b + i, n - i);
+}
+
+// vld3 splits 16 interleaved pixels into per-channel vectors
+static void channel_gains_neon(const uint8_t* src, uint8_t* dst, size_t pixels, const uint16_t* gains) {
+    size_t p = 0;
+    for (; p + 16 <= pixels; p += 16) {
+        uint8x16x3_t px = vld3q_u8(src + p * 3);
+        for (int c = 0; c < 3; c++) {
+            uint16x8_t lo = vmovl_u8(vget_low_u8(px.val[c]));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(px.val[c]));
+            uint16x4_t g = vdup_n_u16(gains[c]);
+            // (src * gain) >> 8 in 32 bits, then saturate to 8 bits
+            uint16x8_t rlo = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(lo), g), 8),
+                                          vshrn_n_u32(vmull_u16(vget_high_u16(lo), g), 8));
+            uint16x8_t rhi = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(hi), g), 8),
+                                          vshrn_n_u32(vmull_u16(vget_high_u16(hi), g), 8));
+            px.val[c] = vcombine_u8(vqmovn_u16(rlo), vqmovn_u16(rhi));
+        }
+        vst3q_u8(dst + p * 3, px);
+    }
+    channel_gains_scalar(src + p * 3, dst + p * 3, pixels - p, gains);
+}
+
+static void max_stack_neon(const uint8_t* src, uint8_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(dst + i, vmaxq_u8(vld1q_u8(src + i), vld1q_u8(dst + i)));
+    }
+    max_stack_scalar(src + i, dst + i, n - i);
+}
+
+// vld3 deinterleaves 16 pixels; masks are counted by accumulating their top bit
+static void sky_counts_neon(const uint8_t* rgb, size_t pixels, int min_sum, int ratio_q8, uint32_t* counts) {
+    const uint16x8_t threshold = vdupq_n_u16(static_cast<uint16_t>(min_sum));
+    const uint16x8_t ratio = vdupq_n_u16(static_cast<uint16_t>(ratio_q8));
+    uint32x4_t lit_acc = vdupq_n_u32(0);
+    uint32x4_t cloud_acc = vdupq_n_u32(0);
+
+    size_t p = 0;
+    for (; p + 16 <= pixels; p += 16) {
+        uint8x16x3_t px = vld3q_u8(rgb + p * 3);
+        for (int half = 0; half < 2; half++) {
+            uint16x8_t r = vmovl_u8(half ? vget_high_u8(px.val[0]) : vget_low_u8(px.val[0]));
+            uint16x8_t g = vmovl_u8(half ? vget_high_u8(px.val[1]) : vget_low_u8(px.val[1]));
+            uint16x8_t b = vmovl_u8(half ? vget_high_u8(px.val[2]) : vget_low_u8(px.val[2]));
+            uint16x8_t lit = vcgeq_u16(vaddq_u16(vaddq_u16(r, g), b), threshold);
+            uint16x8_t cloud = vandq_u16(vcgeq_u16(vshlq_n_u16(r, 8), vmulq_u16(b, ratio)), lit);
+            lit_acc = vpadalq_u16(lit_acc, vshrq_n_u16(lit, 15));
+            cloud_acc = vpadalq_u16(cloud_acc, vshrq_n_u16(cloud, 15));
+        }
+    }
+    counts[0] += vgetq_lane_u32(lit_acc, 0) + vgetq_lane_u32(lit_acc, 1) + vgetq_lane_u32(lit_acc, 2) +
+                 vgetq_lane_u32(lit_acc, 3);
+    counts[1] += vgetq_lane_u32(cloud_acc, 0) + vgetq_lane_u32(cloud_acc, 1) + vgetq_lane_u32(cloud_acc, 2) +
+                 vgetq_lane_u32(cloud_acc, 3);
+    sky_counts_scalar(rgb + p * 3, pixels - p, min_sum, ratio_q8, counts);
+}
+
+static const PixelKernels neon_kernels = {
+    "neon",
+    apply_lut_scalar,
+    blend_neon,
+    absdiff_neon,
+    sad_neon,
+    histogram_scalar,
+    channel_gains_neon,
+    max_stack_neon,
+    sky_counts_neon,
+};
+
+#endif // HAVE_NEON_KERNELS
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+const PixelKernels* pixel_kernels_for(PixelIsa isa) {
+    const CpuFeatures& cpu = cpu_features();
+    (void)cpu;
+
+    switch (isa) {
+        case ISA_SCALAR:
+            return &scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+        case ISA_SSE41:
+            return cpu.sse41 ? &sse41_kernels : nullptr;
+        case ISA_AVX2:
+            return cpu.avx2 ? &avx2_kernels : nullptr;
+#endif
+#ifdef HAVE_NEON_KERNELS
+        case ISA_NEON:
+            return cpu.neon ? &neon_kernels : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const PixelKernels& select_kernels() {
+    const PixelIsa preference[] = { ISA_AVX2, ISA_NEON, ISA_SSE41 };
+    for (PixelIsa isa : preference) {
+        const PixelKernels* k = pixel_kernels_for(isa);
+        if (k != nullptr) {
+            return *k;
+        }
+    }
+    return scalar_kernels;
+}
+
+const PixelKernels& pixel_kernels() {
+    static const PixelKernels& kernels = select_kernels();
+    return kernels;
+}
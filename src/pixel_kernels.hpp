@@ -0,0 +1,53 @@
+// pixel_kernels.hpp
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --- Pixel Kernels ---
+// The per-pixel loops the video stage needs (deflicker LUTs, blending,
+// frame differences, histograms, colour gains, max-stacks, sky counts). Each kernel has
+// a scalar reference plus SSE4.1/AVX2 (x86) and NEON (ARM) variants where
+// they beat it, which must produce bit-identical output. pixel_kernels()
+// picks the fastest set the CPU supports at runtime; `make bench` checks and
+// times every variant.
+
+enum PixelIsa { ISA_SCALAR, ISA_SSE41, ISA_AVX2, ISA_NEON };
+
+struct PixelKernels {
+    const char* name;
+
+    // dst[i] = lut[src[i]]
+    void (*apply_lut)(const uint8_t* src, uint8_t* dst, size_t n, const uint8_t* lut);
+
+    // dst = (a * (256 - weight) + b * weight + 128) >> 8, weight in 0..256
+    void (*blend)(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n, int weight);
+
+    // dst = |a - b|
+    void (*absdiff)(const uint8_t* a, const uint8_t* b, uint8_t* dst, size_t n);
+
+    // Sum of |a - b| (motion energy between two frames)
+    uint64_t (*sad)(const uint8_t* a, const uint8_t* b, size_t n);
+
+    // hist[v] += number of bytes equal to v (hist is not cleared)
+    void (*histogram)(const uint8_t* src, size_t n, uint32_t* hist);
+
+    // Interleaved 3-channel pixels: dst = min(255, (src * gains[c]) >> 8),
+    // gains in Q8 (256 = 1.0). dst may equal src.
+    void (*channel_gains)(const uint8_t* src, uint8_t* dst, size_t pixels, const uint16_t* gains);
+
+    // dst = max(dst, src) (max-stack / star trails)
+    void (*max_stack)(const uint8_t* src, uint8_t* dst, size_t n);
+
+    // Interleaved RGB: counts[0] += pixels with r + g + b >= min_sum (lit),
+    // counts[1] += lit pixels with r * 256 >= b * ratio_q8, i.e. grey or
+    // white rather than blue (cloud). ratio_q8 in 0..256.
+    void (*sky_counts)(const uint8_t* rgb, size_t pixels, int min_sum, int ratio_q8, uint32_t* counts);
+};
+
+// Fastest kernels this CPU supports (chosen once)
+const PixelKernels& pixel_kernels();
+
+// A specific variant, or nullptr if it isn't compiled in / supported here
+const PixelKernels* pixel_kernels_for(PixelIsa isa);
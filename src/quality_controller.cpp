@@ -0,0 +1,66 @@
+// quality_controller.cpp
+
+#include <algorithm>
+
+#include "quality_controller.hpp"
+
+// Weight of the newest frame in the running average (~last 10 frames)
+#define QUALITY_EWMA_ALPHA 0.1
+
+// No change while the average is within this fraction of the allowance
+#define QUALITY_DEADBAND 0.05
+
+QualityController::QualityController(int initial_quality, int min_quality, int max_quality,
+                                     int step, int adjust_every)
+    : min_quality(std::max(1, std::min(min_quality, max_quality))),
+      max_quality(std::min(100, std::max(min_quality, max_quality))),
+      step(std::max(1, step)), adjust_every(std::max(1, adjust_every)),
+      expected_frames(0), frames(0), budget_bytes(0), used_bytes(0),
+      average_frame_bytes(0.0), frames_since_adjust(0) {
+    current_quality = std::max(this->min_quality, std::min(this->max_quality, initial_quality));
+}
+
+void QualityController::start_day(int expected_frames, uint64_t budget_bytes,
+                                  int frames_so_far, uint64_t bytes_so_far) {
+    this->expected_frames = expected_frames;
+    this->budget_bytes = budget_bytes;
+    frames = frames_so_far;
+    used_bytes = bytes_so_far;
+    average_frame_bytes = frames_so_far > 0 ? static_cast<double>(bytes_so_far) / frames_so_far : 0.0;
+    frames_since_adjust = 0;
+}
+
+double QualityController::allowance() const {
+    int remaining_frames = std::max(1, expected_frames - frames);
+    double remaining_bytes = budget_bytes > used_bytes ? static_cast<double>(budget_bytes - used_bytes) : 0.0;
+    return remaining_bytes / remaining_frames;
+}
+
+bool QualityController::record_frame(uint64_t bytes) {
+    frames++;
+    used_bytes += bytes;
+    if (average_frame_bytes <= 0.0) {
+        average_frame_bytes = static_cast<double>(bytes);
+    } else {
+        average_frame_bytes += QUALITY_EWMA_ALPHA * (static_cast<double>(bytes) - average_frame_bytes);
+    }
+
+    if (budget_bytes == 0 || ++frames_since_adjust < adjust_every) {
+        return false;
+    }
+    frames_since_adjust = 0;
+
+    double target = allowance();
+    int next = current_quality;
+    if (average_frame_bytes > target * (1.0 + QUALITY_DEADBAND)) {
+        next = std::max(min_quality, current_quality - step);
+    } else if (average_frame_bytes < target * (1.0 - QUALITY_DEADBAND)) {
+        next = std::min(max_quality, current_quality + step);
+    }
+
+    if (next == current_quality) {
+        return false;
+    }
+    current_quality = next;
+    return true;
+}
@@ -0,0 +1,47 @@
+// quality_controller.hpp
+
+#pragma once
+
+#include <cstdint>
+
+// --- Adaptive JPEG Quality ---
+// Keeps a day's photos close to a byte budget (expected_photos x target
+// frame size) so disk runway and backup time are predictable, whatever the
+// sky does. After every frame it compares the recent average frame size with
+// what the rest of the budget allows per remaining frame, and moves the JPEG
+// quality by at most `step` every `adjust_every` frames - a slow drift
+// rather than visible jumps between neighbouring frames.
+class QualityController {
+public:
+    QualityController(int initial_quality, int min_quality, int max_quality,
+                      int step, int adjust_every);
+
+    // Sets the day's budget; frames/bytes already on disk (after a restart)
+    // count against it.
+    void start_day(int expected_frames, uint64_t budget_bytes,
+                   int frames_so_far, uint64_t bytes_so_far);
+
+    // Records a captured frame. Returns true when the quality changed.
+    bool record_frame(uint64_t bytes);
+
+    int quality() const { return current_quality; }
+    uint64_t bytes_used() const { return used_bytes; }
+    uint64_t budget() const { return budget_bytes; }
+
+    // Per-frame allowance for the rest of the day
+    double allowance() const;
+
+private:
+    int current_quality;
+    int min_quality;
+    int max_quality;
+    int step;
+    int adjust_every;
+
+    int expected_frames;
+    int frames;
+    uint64_t budget_bytes;
+    uint64_t used_bytes;
+    double average_frame_bytes;
+    int frames_since_adjust;
+};
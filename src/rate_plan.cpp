@@ -0,0 +1,130 @@
+// rate_plan.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+
+#include "rate_plan.hpp"
+#include "utils.hpp"
+
+#define RATE_QCOMP 0.6
+#define RATE_MIN_MULTIPLIER 0.4
+#define RATE_MAX_MULTIPLIER 2.5
+
+// Floor for motion, so a perfectly still segment still gets some bits
+#define RATE_MIN_MOTION 0.25
+
+// Container and audio-less muxing overhead
+#define RATE_OVERHEAD 0.98
+
+// Clamp-and-rescale passes, and how close to an average of 1 is enough
+#define RATE_NORMALISE_PASSES 8
+#define RATE_NORMALISE_TOLERANCE 0.002
+
+// Multipliers this close to 1.0 aren't worth a zone
+#define RATE_ZONE_THRESHOLD 0.05
+
+RatePlan plan_rate(const std::vector<std::string>& frames, const std::vector<FrameIndexEntry>& index,
+                   int fps, double target_mb, int zone_frames) {
+    RatePlan plan;
+    if (frames.empty() || fps <= 0) {
+        return plan;
+    }
+
+    double seconds = static_cast<double>(frames.size()) / fps;
+    plan.bitrate_kbps = std::max(100, static_cast<int>(target_mb * 8 * 1024 * 1024 / seconds / 1000 * RATE_OVERHEAD));
+    if (zone_frames <= 0) {
+        return plan;
+    }
+
+    std::unordered_map<std::string, const FrameIndexEntry*> by_name;
+    double mean_bytes = 0.0;
+    for (const FrameIndexEntry& entry : index) {
+        by_name[entry.name] = &entry;
+        mean_bytes += entry.bytes;
+    }
+    if (index.empty() || mean_bytes <= 0.0) {
+        return plan;
+    }
+    mean_bytes /= index.size();
+
+    // Per-frame complexity; -1 = not in the index
+    std::vector<double> complexity(frames.size(), -1.0);
+    std::vector<double> known;
+    for (size_t i = 0; i < frames.size(); i++) {
+        auto it = by_name.find(base_name(frames[i]));
+        if (it == by_name.end()) {
+            continue;
+        }
+        const FrameIndexEntry& entry = *it->second;
+        complexity[i] = std::max(entry.motion, RATE_MIN_MOTION) * std::sqrt(entry.bytes / mean_bytes);
+        known.push_back(complexity[i]);
+    }
+    plan.indexed_frames = static_cast<int>(known.size());
+    if (known.empty()) {
+        return plan;
+    }
+    std::nth_element(known.begin(), known.begin() + known.size() / 2, known.end());
+    double median = known[known.size() / 2];
+    for (double& c : complexity) {
+        if (c < 0.0) {
+            c = median;
+        }
+    }
+
+    // Segment complexities and their frame-weighted mean
+    size_t segment_count = (frames.size() + zone_frames - 1) / zone_frames;
+    std::vector<double> segment(segment_count, 0.0);
+    std::vector<int> segment_frames(segment_count, 0);
+    double mean = 0.0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        segment[i / zone_frames] += complexity[i];
+        segment_frames[i / zone_frames]++;
+        mean += complexity[i];
+    }
+    mean /= frames.size();
+
+    std::vector<double> multiplier(segment_count);
+    for (size_t s = 0; s < segment_count; s++) {
+        multiplier[s] = std::pow(segment[s] / segment_frames[s] / mean, RATE_QCOMP);
+    }
+    auto clamped = [](double m) { return std::min(RATE_MAX_MULTIPLIER, std::max(RATE_MIN_MULTIPLIER, m)); };
+
+    // Normalise so the plan averages out at the target bitrate. Clamping
+    // moves the average again (a busy stretch capped at the maximum leaves
+    // bits unspent), so rescale the unclamped segments until it holds.
+    double scale = 1.0;
+    for (int pass = 0; pass < RATE_NORMALISE_PASSES; pass++) {
+        double weighted = 0.0;
+        for (size_t s = 0; s < segment_count; s++) {
+            weighted += clamped(multiplier[s] * scale) * segment_frames[s];
+        }
+        if (std::fabs(weighted - frames.size()) < RATE_NORMALISE_TOLERANCE * frames.size()) {
+            break;
+        }
+        scale *= frames.size() / weighted;
+    }
+
+    plan.min_multiplier = RATE_MAX_MULTIPLIER;
+    plan.max_multiplier = RATE_MIN_MULTIPLIER;
+    for (size_t s = 0; s < segment_count; s++) {
+        double m = clamped(multiplier[s] * scale);
+        plan.min_multiplier = std::min(plan.min_multiplier, m);
+        plan.max_multiplier = std::max(plan.max_multiplier, m);
+        if (std::fabs(m - 1.0) < RATE_ZONE_THRESHOLD) {
+            continue;
+        }
+
+        int start = static_cast<int>(s * zone_frames);
+        int end = start + segment_frames[s] - 1;
+        char zone[48];
+        snprintf(zone, sizeof(zone), "%d,%d,b=%.2f", start, end, m);
+        if (!plan.zones.empty()) {
+            plan.zones += "/";
+        }
+        plan.zones += zone;
+        plan.zone_count++;
+    }
+    return plan;
+}
@@ -0,0 +1,39 @@
+// rate_plan.hpp
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "frame_index.hpp"
+
+// --- Complexity-Driven Rate Control ---
+// Constant-quality (CRF) encoding spends bits on whatever x264 finds hard,
+// and noisy twilight frames look hard even though nothing moves. With
+// rate_control = target_size the capture-time frame index stands in for a
+// first pass: the video gets an average bitrate for the target file size,
+// and x264 zones scale that bitrate up for busy stretches (fast clouds,
+// changing light) and down for static or merely noisy ones.
+//
+// Per frame, complexity = motion x sqrt(bytes / mean bytes): motion from the
+// 1/8 scale luma (noise averaged away) drives it, JPEG size (detail) shapes
+// it. Segments of `zone_frames` frames get bitrate multipliers of
+// (segment complexity / mean)^0.6 - the same compression of differences
+// x264's qcomp uses - clamped to 0.4-2.5 and normalised to average 1
+// (rescaling the unclamped segments until the clamp no longer moves it).
+
+struct RatePlan {
+    int bitrate_kbps;
+    std::string zones;  // for -x264-params zones=...; empty = flat bitrate
+    int zone_count;     // zones that differ from 1.0 enough to be listed
+    int indexed_frames; // frames found in the index
+    double min_multiplier;
+    double max_multiplier;
+
+    RatePlan() : bitrate_kbps(0), zone_count(0), indexed_frames(0), min_multiplier(1.0), max_multiplier(1.0) {}
+};
+
+// frames: paths or names of the frames to encode, in encode order. Frames
+// missing from the index get the median complexity.
+RatePlan plan_rate(const std::vector<std::string>& frames, const std::vector<FrameIndexEntry>& index,
+                   int fps, double target_mb, int zone_frames);
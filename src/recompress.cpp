@@ -0,0 +1,425 @@
+// recompress.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <utime.h>
+#include <vector>
+
+#include "recompress.hpp"
+#include "jpeg_error.hpp"
+#include "manifest.hpp"
+#include "stage_times.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+bool parse_recompress_mode(const std::string& name, RecompressMode& mode) {
+    if (name == "optimize") {
+        mode = RECOMPRESS_OPTIMIZE;
+    } else if (name == "progressive") {
+        mode = RECOMPRESS_PROGRESSIVE;
+    } else if (name == "arithmetic") {
+        mode = RECOMPRESS_ARITHMETIC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool read_whole_file(const std::string& path, std::vector<unsigned char>& data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    return static_cast<bool>(file);
+}
+
+// Same rule as jpegtran: keep every saved marker except a JFIF APP0 or
+// Adobe APP14 that the encoder writes itself.
+static void copy_markers(jpeg_decompress_struct& src, jpeg_compress_struct& dst) {
+    for (jpeg_saved_marker_ptr m = src.marker_list; m != nullptr; m = m->next) {
+        if (dst.write_JFIF_header && m->marker == JPEG_APP0 && m->data_length >= 5 &&
+            memcmp(m->data, "JFIF", 5) == 0) {
+            continue;
+        }
+        if (dst.write_Adobe_marker && m->marker == JPEG_APP0 + 14 && m->data_length >= 5 &&
+            memcmp(m->data, "Adobe", 5) == 0) {
+            continue;
+        }
+        jpeg_write_marker(&dst, m->marker, m->data, m->data_length);
+    }
+}
+
+// Every quantised DCT coefficient of every component must match
+static bool same_coefficients(jpeg_decompress_struct& a, jvirt_barray_ptr* a_coefs,
+                              jpeg_decompress_struct& b, jvirt_barray_ptr* b_coefs) {
+    if (a.num_components != b.num_components || a.image_width != b.image_width ||
+        a.image_height != b.image_height) {
+        return false;
+    }
+
+    for (int c = 0; c < a.num_components; c++) {
+        jpeg_component_info& ca = a.comp_info[c];
+        jpeg_component_info& cb = b.comp_info[c];
+        if (ca.width_in_blocks != cb.width_in_blocks || ca.height_in_blocks != cb.height_in_blocks ||
+            ca.quant_table == nullptr || cb.quant_table == nullptr ||
+            memcmp(ca.quant_table->quantval, cb.quant_table->quantval, sizeof(ca.quant_table->quantval)) != 0) {
+            return false;
+        }
+
+        for (JDIMENSION row = 0; row < ca.height_in_blocks; row++) {
+            JBLOCKARRAY ra = (*a.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&a), a_coefs[c], row, 1, FALSE);
+            JBLOCKARRAY rb = (*b.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&b), b_coefs[c], row, 1, FALSE);
+            if (memcmp(ra[0], rb[0], ca.width_in_blocks * sizeof(JBLOCK)) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The libjpeg half of recompress_jpeg_file: lossless transcode of input's
+// coefficients into *output (malloc'ed; the caller frees it, also on
+// failure), then a read-back check. This function calls setjmp, so nothing
+// that a libjpeg error must still see lives in it: the output buffer and
+// results belong to the caller.
+static bool transcode_coefficients(const std::vector<unsigned char>& input, RecompressMode mode,
+                                   unsigned char** output, unsigned long* output_size, bool* same,
+                                   std::string& error) {
+    jpeg_decompress_struct src;
+    jpeg_decompress_struct check;
+    jpeg_compress_struct dst;
+    JpegErrorManager err;
+    src.err = jpeg_error_init(&err);
+    dst.err = src.err;
+    check.err = src.err;
+    jpeg_create_decompress(&src);
+    jpeg_create_compress(&dst);
+    jpeg_create_decompress(&check);
+
+    if (setjmp(err.jump)) {
+        error = err.message;
+        jpeg_destroy_decompress(&check);
+        jpeg_destroy_compress(&dst);
+        jpeg_destroy_decompress(&src);
+        return false;
+    }
+
+    // 1. Read the coefficients (no IDCT - nothing is decoded to pixels)
+    jpeg_mem_src(&src, input.data(), input.size());
+    jpeg_save_markers(&src, JPEG_COM, 0xFFFF);
+    for (int m = 0; m < 16; m++) {
+        jpeg_save_markers(&src, JPEG_APP0 + m, 0xFFFF);
+    }
+    jpeg_read_header(&src, TRUE);
+    jvirt_barray_ptr* coefs = jpeg_read_coefficients(&src);
+
+    // 2. Write them back with new entropy coding
+    jpeg_copy_critical_parameters(&src, &dst);
+    switch (mode) {
+        case RECOMPRESS_OPTIMIZE:
+            dst.optimize_coding = TRUE;
+            break;
+        case RECOMPRESS_PROGRESSIVE:
+            dst.optimize_coding = TRUE;
+            jpeg_simple_progression(&dst);
+            break;
+        case RECOMPRESS_ARITHMETIC:
+            dst.arith_code = TRUE;
+            dst.optimize_coding = FALSE;
+            break;
+    }
+    jpeg_mem_dest(&dst, output, output_size);
+    jpeg_write_coefficients(&dst, coefs);
+    copy_markers(src, dst);
+    jpeg_finish_compress(&dst);
+
+    // 3. Read the result back and compare coefficients
+    jpeg_mem_src(&check, *output, *output_size);
+    jpeg_read_header(&check, TRUE);
+    jvirt_barray_ptr* check_coefs = jpeg_read_coefficients(&check);
+    *same = same_coefficients(src, coefs, check, check_coefs);
+
+    jpeg_destroy_decompress(&check);
+    jpeg_destroy_compress(&dst);
+    jpeg_destroy_decompress(&src);
+    return true;
+}
+
+RecompressResult recompress_jpeg_file(const std::string& path, RecompressMode mode,
+                                      const ManifestEntry* expected) {
+    StageTimer timer("recompress");
+    RecompressResult result;
+    result.ok = false;
+    result.replaced = false;
+    result.corrupt = false;
+    result.old_size = 0;
+    result.new_size = 0;
+
+    std::vector<unsigned char> input;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !read_whole_file(path, input)) {
+        result.error = "cannot read " + path;
+        return result;
+    }
+    result.old_size = input.size();
+    {
+        StageTimer hash_timer("hash");
+        result.hash = hash_to_hex(hash_bytes(reinterpret_cast<const char*>(input.data()), input.size()));
+    }
+
+    // Re-encoding a damaged frame would verify against the same damaged
+    // input and give it a new "good" hash - leave it for scrub/repair
+    if (expected != nullptr && (expected->size != input.size() || expected->hash != result.hash)) {
+        result.corrupt = true;
+        result.error = "CORRUPT " + path + " (does not match " MANIFEST_NAME ") - left as it was";
+        return result;
+    }
+
+    unsigned char* output = nullptr;
+    unsigned long output_size = 0;
+    bool same = false;
+    std::string error;
+    if (!transcode_coefficients(input, mode, &output, &output_size, &same, error)) {
+        result.error = path + ": " + error;
+        free(output);
+        return result;
+    }
+
+    result.new_size = output_size;
+    if (!same) {
+        result.error = path + ": recompressed coefficients differ - original kept";
+        free(output);
+        return result;
+    }
+
+    // 4. Replace the original only if it got smaller, keeping its timestamps
+    result.ok = true;
+    if (output_size < input.size()) {
+        if (write_file_atomic(path, reinterpret_cast<const char*>(output), output_size, true)) {
+            struct utimbuf times;
+            times.actime = st.st_atime;
+            times.modtime = st.st_mtime;
+            utime(path.c_str(), &times);
+            result.replaced = true;
+            StageTimer hash_timer("hash");
+            result.hash = hash_to_hex(hash_bytes(reinterpret_cast<const char*>(output), output_size));
+        } else {
+            result.ok = false;
+            result.error = "could not write " + path;
+        }
+    }
+    free(output);
+    return result;
+}
+
+// --- Command line ---
+
+struct RecompressOptions {
+    RecompressMode mode;
+    std::string mode_name;
+    int threads;
+    bool idle;
+    double max_mb_per_s;
+    bool all_days;
+    std::vector<std::string> day_dirs;
+};
+
+static void recompress_usage() {
+    std::cerr << "Usage: timelapse recompress [--mode optimize|progressive|arithmetic] [--threads N]\n"
+              << "         [--idle] [--max-mb-per-s N] (--all | PICS_DAY_DIR...)\n";
+}
+
+// Finished day directories under pics/: everything except today's and the
+// ones already done
+static std::vector<std::string> completed_days() {
+    time_t now = std::time(nullptr);
+    std::stringstream today;
+    today << std::put_time(std::localtime(&now), "%Y%m%d");
+
+    std::vector<std::string> days;
+    for (const std::string& name : list_dir(PICS_PATH)) {
+        std::string dir = std::string(PICS_PATH) + name + "/";
+        struct stat st;
+        if (name.size() < 5 || name.compare(name.size() - 5, 5, "_pics") != 0 ||
+            name.compare(0, today.str().size(), today.str()) == 0 ||
+            stat((dir + RECOMPRESS_MARKER).c_str(), &st) == 0) {
+            continue;
+        }
+        days.push_back(dir);
+    }
+    return days;
+}
+
+// Recompresses every frame of one day with a pool of threads, then writes
+// the day's manifest and marker. Frames listed in an existing manifest must
+// still match it; only the entries of frames that did and were rewritten
+// (or had none) change. Returns false if any frame failed.
+static bool recompress_day(const std::string& day_dir, const RecompressOptions& opts, RateLimiter& limiter,
+                           uint64_t& total_before, uint64_t& total_after) {
+    std::string dir = day_dir.back() == '/' ? day_dir : day_dir + "/";
+    std::vector<std::string> frames = list_frames(dir);
+    if (frames.empty()) {
+        archive_log("Recompress: no frames in " + dir);
+        return true;
+    }
+
+    std::vector<ManifestEntry> manifest;
+    read_manifest(dir, manifest);
+    std::vector<const ManifestEntry*> expected(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        expected[i] = find_manifest_entry(manifest, frames[i]);
+    }
+
+    std::vector<RecompressResult> results(frames.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < frames.size(); i = next++) {
+            results[i] = recompress_jpeg_file(dir + frames[i], opts.mode, expected[i]);
+            limiter.consume(results[i].old_size);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < opts.threads; t++) {
+        pool.emplace_back(worker);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    uint64_t before = 0, after = 0;
+    int replaced = 0, failed = 0, corrupt = 0;
+    std::vector<ManifestEntry> added;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const RecompressResult& r = results[i];
+        if (!r.ok) {
+            archive_log("Recompress: " + r.error);
+            failed++;
+        }
+        if (r.corrupt) {
+            // Its old entry stays, so scrub keeps reporting it
+            corrupt++;
+            continue;
+        }
+        if (r.hash.empty()) {
+            continue;
+        }
+        before += r.old_size;
+        after += r.replaced ? r.new_size : r.old_size;
+        replaced += r.replaced ? 1 : 0;
+        ManifestEntry entry = { frames[i], r.replaced ? r.new_size : r.old_size, r.hash };
+        ManifestEntry* existing = find_manifest_entry(manifest, frames[i]);
+        if (existing != nullptr) {
+            *existing = entry;
+        } else {
+            added.push_back(entry);
+        }
+    }
+    manifest.insert(manifest.end(), added.begin(), added.end());
+    total_before += before;
+    total_after += after;
+
+    if (!write_manifest(dir, manifest)) {
+        archive_log("Recompress: could not write manifest in " + dir);
+        return false;
+    }
+
+    double saved = before > 0 ? 100.0 * (before - after) / before : 0.0;
+    std::stringstream ss;
+    ss << "Recompress (" << opts.mode_name << "): " << dir << " " << replaced << "/" << frames.size()
+       << " frames smaller, " << before / (1024 * 1024) << " MB -> " << after / (1024 * 1024) << " MB ("
+       << std::fixed << std::setprecision(1) << saved << "% saved)";
+    if (failed > 0) {
+        ss << ", " << failed << " failed";
+    }
+    if (corrupt > 0) {
+        ss << " (" << corrupt << " CORRUPT, left for scrub/repair)";
+    }
+    archive_log(ss.str());
+
+    if (failed > 0) {
+        return false;
+    }
+    std::ofstream marker(dir + RECOMPRESS_MARKER);
+    marker << opts.mode_name << "\n";
+    return true;
+}
+
+int run_recompress(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+
+    RecompressOptions opts;
+    opts.mode_name = config_value(config, "recompress_mode", "optimize");
+    opts.threads = std::stoi(config_value(config, "recompress_threads", "0"));
+    opts.idle = config_value(config, "recompress_idle", "true") == "true";
+    opts.max_mb_per_s = std::stod(config_value(config, "recompress_max_mb_per_s", "0"));
+    opts.all_days = false;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--mode" && has_value) {
+            opts.mode_name = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            opts.threads = std::stoi(argv[++i]);
+        } else if (arg == "--idle") {
+            opts.idle = true;
+        } else if (arg == "--max-mb-per-s" && has_value) {
+            opts.max_mb_per_s = std::stod(argv[++i]);
+        } else if (arg == "--all") {
+            opts.all_days = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            opts.day_dirs.push_back(arg);
+        } else {
+            recompress_usage();
+            return 2;
+        }
+    }
+
+    if (!parse_recompress_mode(opts.mode_name, opts.mode) || (opts.all_days == !opts.day_dirs.empty())) {
+        recompress_usage();
+        return 2;
+    }
+    if (opts.threads <= 0) {
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (opts.idle) {
+        set_idle_priority();
+    }
+    if (opts.all_days) {
+        opts.day_dirs = completed_days();
+    }
+
+    RateLimiter limiter(opts.max_mb_per_s * 1024 * 1024);
+    uint64_t before = 0, after = 0;
+    bool ok = true;
+    for (const std::string& day : opts.day_dirs) {
+        if (!recompress_day(day, opts, limiter, before, after)) {
+            ok = false;
+        }
+    }
+
+    std::string error;
+    if (!append_stage_times(STAGE_TIMES_FILE, "recompress", error)) {
+        archive_log("Recompress: " + error);
+    }
+
+    if (opts.day_dirs.size() > 1) {
+        archive_log("Recompress finished: " + std::to_string(opts.day_dirs.size()) + " days, " +
+                    std::to_string((before - after) / (1024 * 1024)) + " MB saved");
+    }
+    return ok ? 0 : 1;
+}
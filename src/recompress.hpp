@@ -0,0 +1,47 @@
+// recompress.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "manifest.hpp"
+
+// --- Lossless Recompression ---
+// Cameras write JPEGs with generic Huffman tables. Re-encoding the DCT
+// coefficients unchanged with tables optimised for each frame (optionally
+// progressive, or arithmetic coded) saves 10-20% with exactly the same
+// decoded pixels. Each result is read back and its coefficients compared
+// with the original before the original is replaced.
+//
+// "timelapse recompress" runs this over finished days, in parallel, and
+// writes each day's manifest.txt (hash/size of every frame) as it goes. A
+// frame that already has a manifest entry is checked against it first: one
+// that no longer matches (rotted since scrub or parity recorded it) is left
+// alone and keeps its entry, so scrub and repair still see it as CORRUPT.
+// A .recompressed marker in the day directory means the day is done.
+
+#define RECOMPRESS_MARKER ".recompressed"
+
+enum RecompressMode { RECOMPRESS_OPTIMIZE, RECOMPRESS_PROGRESSIVE, RECOMPRESS_ARITHMETIC };
+
+struct RecompressResult {
+    bool ok;          // false = file unreadable or verification failed (left as it was)
+    bool replaced;    // true = smaller file written in place
+    bool corrupt;     // true = didn't match its manifest entry (not touched)
+    uint64_t old_size;
+    uint64_t new_size;
+    std::string hash; // FNV-1a of the file now on disk
+    std::string error;
+};
+
+// "optimize" / "progressive" / "arithmetic"; false if unknown
+bool parse_recompress_mode(const std::string& name, RecompressMode& mode);
+
+// Recompresses one frame in place (only if that makes it smaller). With an
+// expected entry, a file whose size or hash differs is left as it is.
+RecompressResult recompress_jpeg_file(const std::string& path, RecompressMode mode,
+                                      const ManifestEntry* expected = nullptr);
+
+// Command line entry point: "timelapse recompress ..."
+int run_recompress(int argc, char* argv[]);
@@ -0,0 +1,512 @@
+// render_farm.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utime.h>
+
+#include "render_farm.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+#define FARM_LOG LOGS_PATH "render_farm.log"
+
+static void farm_log(const std::string& message) {
+    log_message(FARM_LOG, message);
+}
+
+static bool read_file(const std::string& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize(file.tellg());
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    return static_cast<bool>(file);
+}
+
+static bool starts_with(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+static FarmOptions default_farm_options() {
+    auto config = read_config(CONFIG_FILE);
+
+    FarmOptions opts;
+    opts.spool_dir = config_value(config, "farm_spool_dir", "farm");
+    opts.ffmpeg_command = config_value(config, "ffmpeg_command", "ffmpeg");
+    opts.segment_frames = std::stoi(config_value(config, "farm_segment_frames", "250"));
+    opts.lease_seconds = std::stoi(config_value(config, "farm_lease_seconds", "120"));
+    opts.fps = std::stoi(config_value(config, "farm_fps", "25"));
+    opts.max_attempts = std::stoi(config_value(config, "farm_max_attempts", "3"));
+    opts.timeout_seconds = std::stoi(config_value(config, "farm_timeout_seconds", "0"));
+    opts.every_nth_frame = 1;
+    opts.exit_when_idle = false;
+
+    char hostname[64] = "worker";
+    gethostname(hostname, sizeof(hostname) - 1);
+    opts.worker_id = std::string(hostname) + "-" + std::to_string(getpid());
+    return opts;
+}
+
+// Appends an attempt line ("failed ..." / "expired ...") to a task file
+static void record_attempt(const std::string& task_file, const std::string& line) {
+    std::ofstream file(task_file, std::ios::app);
+    file << line << "\n";
+}
+
+// Number of attempts recorded in a task file; the last one goes to last_attempt
+static int count_attempts(const std::string& task_file, std::string& last_attempt) {
+    std::ifstream file(task_file);
+    std::string line;
+    int attempts = 0;
+    while (std::getline(file, line)) {
+        if (starts_with(line, "failed ") || starts_with(line, "expired ")) {
+            attempts++;
+            last_attempt = line;
+        }
+    }
+    return attempts;
+}
+
+static bool make_spool_dirs(const std::string& spool) {
+    const char* subdirs[] = { "", "/objects", "/tasks", "/tasks/pending", "/tasks/leased",
+                              "/tasks/done", "/segments" };
+    for (const char* sub : subdirs) {
+        if (!create_dir(spool + sub)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Server ---
+
+static void farm_server_usage() {
+    std::cerr << "Usage: timelapse farm-server -o OUTPUT.mp4 [--job NAME] [--spool DIR]\n"
+              << "         [--segment-frames N] [--lease-seconds N] [--every N] [--fps N]\n"
+              << "         [--max-attempts N] [--timeout SECONDS] PICS_DIR...\n";
+}
+
+// Copies a frame into objects/ under its content hash (once per farm)
+static std::string publish_frame(const std::string& spool, const std::string& frame) {
+    std::vector<char> data;
+    if (!read_file(frame, data)) {
+        return "";
+    }
+    std::string hash = hash_to_hex(hash_bytes(data.data(), data.size()));
+    std::string object = spool + "/objects/" + hash + ".jpg";
+    if (!file_exists(object) && !write_file_atomic(object, data.data(), data.size())) {
+        return "";
+    }
+    return hash;
+}
+
+// Moves leases whose heartbeat stopped back to pending
+static void requeue_stale_leases(const FarmOptions& opts) {
+    std::string leased_dir = opts.spool_dir + "/tasks/leased/";
+    time_t now = std::time(nullptr);
+
+    for (const std::string& name : list_dir(leased_dir)) {
+        if (!starts_with(name, opts.job_name + "_")) {
+            continue;
+        }
+        struct stat st;
+        if (stat((leased_dir + name).c_str(), &st) != 0 || now - st.st_mtime <= opts.lease_seconds) {
+            continue;
+        }
+
+        // <task>.<worker id>
+        size_t dot = name.find('.');
+        std::string task = name.substr(0, dot);
+        std::string worker = dot == std::string::npos ? "?" : name.substr(dot + 1);
+        record_attempt(leased_dir + name, "expired " + worker);
+        if (std::rename((leased_dir + name).c_str(), (opts.spool_dir + "/tasks/pending/" + task).c_str()) == 0) {
+            farm_log("Lease on " + task + " expired (worker " + worker + " silent for " +
+                     std::to_string(now - st.st_mtime) + "s) - re-queued");
+        }
+    }
+}
+
+static bool concat_segments(const FarmOptions& opts, const std::vector<std::string>& tasks) {
+    char cwd[4096];
+    std::string spool_abs = opts.spool_dir;
+    if (spool_abs[0] != '/' && getcwd(cwd, sizeof(cwd)) != nullptr) {
+        spool_abs = std::string(cwd) + "/" + spool_abs;
+    }
+
+    std::string list_file = opts.spool_dir + "/" + opts.job_name + "_concat.txt";
+    std::stringstream list;
+    for (const std::string& task : tasks) {
+        list << "file '" << spool_abs << "/segments/" << task << ".mp4'\n";
+    }
+    std::string data = list.str();
+    if (!write_file_atomic(list_file, data.data(), data.size())) {
+        farm_log("Could not write " + list_file);
+        return false;
+    }
+
+    // Stream copy - no re-encode, so this takes seconds even for long renders
+    std::string command = opts.ffmpeg_command + " -y -loglevel error -f concat -safe 0 -i '" +
+                          list_file + "' -c copy '" + opts.output_file + "'";
+    farm_log("Concatenating " + std::to_string(tasks.size()) + " segments: " + command);
+    int result = std::system(command.c_str());
+    return result != -1 && WIFEXITED(result) && WEXITSTATUS(result) == 0;
+}
+
+int run_farm_server(int argc, char* argv[]) {
+    FarmOptions opts = default_farm_options();
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-o" && has_value) {
+            opts.output_file = argv[++i];
+        } else if (arg == "--job" && has_value) {
+            opts.job_name = argv[++i];
+        } else if (arg == "--spool" && has_value) {
+            opts.spool_dir = argv[++i];
+        } else if (arg == "--segment-frames" && has_value) {
+            opts.segment_frames = std::stoi(argv[++i]);
+        } else if (arg == "--lease-seconds" && has_value) {
+            opts.lease_seconds = std::stoi(argv[++i]);
+        } else if (arg == "--every" && has_value) {
+            opts.every_nth_frame = std::stoi(argv[++i]);
+        } else if (arg == "--fps" && has_value) {
+            opts.fps = std::stoi(argv[++i]);
+        } else if (arg == "--max-attempts" && has_value) {
+            opts.max_attempts = std::stoi(argv[++i]);
+        } else if (arg == "--timeout" && has_value) {
+            opts.timeout_seconds = std::stoi(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-') {
+            opts.frame_dirs.push_back(arg);
+        } else {
+            farm_server_usage();
+            return 2;
+        }
+    }
+
+    if (opts.output_file.empty() || opts.frame_dirs.empty() || opts.segment_frames <= 0 ||
+        opts.every_nth_frame <= 0 || opts.max_attempts <= 0 || opts.timeout_seconds < 0) {
+        farm_server_usage();
+        return 2;
+    }
+    if (opts.job_name.empty()) {
+        // Job name from the output file: videos/foo.mp4 -> foo
+        std::string base = opts.output_file.substr(opts.output_file.find_last_of('/') + 1);
+        opts.job_name = base.substr(0, base.find('.'));
+    }
+    std::replace(opts.job_name.begin(), opts.job_name.end(), '.', '-');
+
+    if (!make_spool_dirs(opts.spool_dir)) {
+        farm_log("Could not create spool directory " + opts.spool_dir);
+        return 1;
+    }
+
+    // 1. Collect frames, oldest day first
+    std::vector<std::string> frames;
+    for (const std::string& dir : opts.frame_dirs) {
+        std::string prefix = dir.back() == '/' ? dir : dir + "/";
+        for (const std::string& name : list_dir(dir)) {
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".jpg") == 0) {
+                frames.push_back(prefix + name);
+            }
+        }
+    }
+    std::vector<std::string> selected;
+    for (size_t i = 0; i < frames.size(); i += opts.every_nth_frame) {
+        selected.push_back(frames[i]);
+    }
+    if (selected.empty()) {
+        farm_log("No frames found - nothing to render");
+        return 1;
+    }
+
+    cv::Mat first = cv::imread(selected[0]);
+    if (first.empty()) {
+        farm_log("Could not read first frame " + selected[0]);
+        return 1;
+    }
+
+    farm_log("Job " + opts.job_name + ": " + std::to_string(selected.size()) + " frames from " +
+             std::to_string(opts.frame_dirs.size()) + " directories, " +
+             std::to_string(opts.segment_frames) + " frames per segment");
+
+    // 2. Publish frames by content hash and 3. write the segment tasks
+    std::vector<std::string> tasks;
+    for (size_t start = 0; start < selected.size(); start += opts.segment_frames) {
+        std::stringstream name;
+        name << opts.job_name << "_" << std::setfill('0') << std::setw(5) << tasks.size();
+        std::string task = name.str();
+        tasks.push_back(task);
+
+        // Restarted server: don't re-queue what's already done or leased
+        bool leased = false;
+        for (const std::string& l : list_dir(opts.spool_dir + "/tasks/leased")) {
+            leased = leased || starts_with(l, task + ".");
+        }
+        if (leased || file_exists(opts.spool_dir + "/tasks/done/" + task)) {
+            continue;
+        }
+
+        std::stringstream body;
+        body << "job " << opts.job_name << "\n"
+             << "fps " << opts.fps << "\n"
+             << "size " << first.cols << " " << first.rows << "\n";
+        size_t end = std::min(selected.size(), start + opts.segment_frames);
+        for (size_t i = start; i < end; i++) {
+            std::string hash = publish_frame(opts.spool_dir, selected[i]);
+            if (hash.empty()) {
+                farm_log("Skipping unreadable frame " + selected[i]);
+                continue;
+            }
+            body << "frame " << hash << "\n";
+        }
+
+        std::string data = body.str();
+        if (!write_file_atomic(opts.spool_dir + "/tasks/pending/" + task, data.data(), data.size())) {
+            farm_log("Could not write task " + task);
+            return 1;
+        }
+    }
+    farm_log("Queued " + std::to_string(tasks.size()) + " segment tasks in " + opts.spool_dir);
+
+    // 4. Watch leases until every segment is done, a task has used up its
+    // attempts or the timeout has passed
+    auto start = std::chrono::steady_clock::now();
+    size_t last_done = 0;
+    std::string failure;
+    for (;;) {
+        size_t done = 0;
+        for (const std::string& task : tasks) {
+            if (file_exists(opts.spool_dir + "/tasks/done/" + task)) {
+                done++;
+                continue;
+            }
+            std::string last_attempt;
+            int attempts = count_attempts(opts.spool_dir + "/tasks/pending/" + task, last_attempt);
+            if (attempts >= opts.max_attempts && failure.empty()) {
+                failure = "task " + task + " failed " + std::to_string(attempts) + " times (last: " +
+                          last_attempt + ")";
+            }
+        }
+        if (done != last_done) {
+            farm_log("Progress: " + std::to_string(done) + "/" + std::to_string(tasks.size()) + " segments");
+            last_done = done;
+        }
+        if (done == tasks.size()) {
+            break;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (failure.empty() && opts.timeout_seconds > 0 && elapsed.count() > opts.timeout_seconds) {
+            failure = "timed out after " + format_duration(elapsed.count()) + " with " +
+                      std::to_string(done) + "/" + std::to_string(tasks.size()) + " segments done";
+        }
+        if (!failure.empty()) {
+            // Take the job's pending tasks off the queue so workers don't keep
+            // retrying them; a restarted server queues them again
+            for (const std::string& task : tasks) {
+                std::remove((opts.spool_dir + "/tasks/pending/" + task).c_str());
+            }
+            farm_log("Giving up on job " + opts.job_name + ": " + failure);
+            return 1;
+        }
+        requeue_stale_leases(opts);
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+
+    // 5. Stream-copy concat
+    if (!concat_segments(opts, tasks)) {
+        farm_log("Concat failed for " + opts.output_file);
+        return 1;
+    }
+    farm_log("Render farm job " + opts.job_name + " finished: " + opts.output_file);
+    return 0;
+}
+
+// --- Worker ---
+
+static void farm_worker_usage() {
+    std::cerr << "Usage: timelapse farm-worker [--spool DIR] [--id NAME] [--exit-when-idle]\n";
+}
+
+// Renders one claimed task. Returns true if the segment was written.
+static bool render_task(const FarmOptions& opts, const std::string& task) {
+    std::string lease = opts.spool_dir + "/tasks/leased/" + task + "." + opts.worker_id;
+
+    std::ifstream file(lease);
+    std::string key;
+    int fps = opts.fps, width = 0, height = 0;
+    std::vector<std::string> hashes;
+    while (file >> key) {
+        if (key == "fps") {
+            file >> fps;
+        } else if (key == "size") {
+            file >> width >> height;
+        } else if (key == "frame") {
+            std::string hash;
+            file >> hash;
+            hashes.push_back(hash);
+        } else {
+            std::string ignored;
+            std::getline(file, ignored);
+        }
+    }
+    file.close();
+
+    // Heartbeat: keep touching the lease while we work. If it has vanished
+    // the server gave the task to someone else, so stop.
+    std::atomic<bool> finished(false);
+    std::atomic<bool> lost(false);
+    std::thread heartbeat([&]() {
+        int beat_ms = std::max(1, opts.lease_seconds / 3) * 1000;
+        while (!finished) {
+            for (int waited = 0; waited < beat_ms && !finished; waited += 200) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            if (!finished && utime(lease.c_str(), nullptr) != 0) {
+                lost = true;
+            }
+        }
+    });
+
+    std::string segment = opts.spool_dir + "/segments/" + task + ".mp4";
+    std::string tmp_segment = opts.spool_dir + "/segments/" + task + "." + opts.worker_id + ".tmp.mp4";
+    cv::Size frame_size(width, height);
+    cv::VideoWriter writer(tmp_segment, cv::VideoWriter::fourcc('m','p','4','v'), fps, frame_size);
+
+    // A segment with a frame missing is a failed task, not a shorter segment
+    std::string failure;
+    if (hashes.empty()) {
+        failure = "no frames in the task";
+    } else if (!writer.isOpened()) {
+        failure = "could not open " + tmp_segment;
+    }
+    std::vector<char> data;
+    for (size_t i = 0; failure.empty() && i < hashes.size() && !lost; i++) {
+        // Fetch by content hash and check the copy we got is intact
+        std::string object = opts.spool_dir + "/objects/" + hashes[i] + ".jpg";
+        if (!read_file(object, data) || hash_to_hex(hash_bytes(data.data(), data.size())) != hashes[i]) {
+            failure = "frame " + hashes[i] + " missing or corrupt";
+            break;
+        }
+        cv::Mat image = cv::imdecode(data, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            failure = "frame " + hashes[i] + " does not decode";
+            break;
+        }
+        if (image.cols != width || image.rows != height) {
+            cv::resize(image, image, frame_size);
+        }
+        writer.write(image);
+    }
+    writer.release();
+
+    // cv::VideoWriter::write has no result: a writer that failed along the
+    // way leaves an empty (or no) file behind
+    struct stat st;
+    if (failure.empty() && !lost && (stat(tmp_segment.c_str(), &st) != 0 || st.st_size == 0)) {
+        failure = "encoder wrote nothing to " + tmp_segment;
+    }
+
+    finished = true;
+    heartbeat.join();
+
+    if (!failure.empty() || lost) {
+        std::remove(tmp_segment.c_str());
+        if (lost) {
+            farm_log("Lost lease on " + task + " - dropping it");
+        } else {
+            farm_log("Could not render " + task + " (" + failure + "), returning it to the queue");
+            record_attempt(lease, "failed " + opts.worker_id + " " + failure);
+            std::rename(lease.c_str(), (opts.spool_dir + "/tasks/pending/" + task).c_str());
+        }
+        return false;
+    }
+
+    if (std::rename(tmp_segment.c_str(), segment.c_str()) != 0 ||
+        std::rename(lease.c_str(), (opts.spool_dir + "/tasks/done/" + task).c_str()) != 0) {
+        // Re-leased at the last moment: the other worker writes the same segment
+        farm_log("Could not complete " + task + ": " + strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int run_farm_worker(int argc, char* argv[]) {
+    FarmOptions opts = default_farm_options();
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--spool" && i + 1 < argc) {
+            opts.spool_dir = argv[++i];
+        } else if (arg == "--id" && i + 1 < argc) {
+            opts.worker_id = argv[++i];
+        } else if (arg == "--exit-when-idle") {
+            opts.exit_when_idle = true;
+        } else {
+            farm_worker_usage();
+            return 2;
+        }
+    }
+    std::replace(opts.worker_id.begin(), opts.worker_id.end(), '.', '-');
+
+    if (!make_spool_dirs(opts.spool_dir)) {
+        farm_log("Could not create spool directory " + opts.spool_dir);
+        return 1;
+    }
+    farm_log("Worker " + opts.worker_id + " watching " + opts.spool_dir);
+
+    int rendered = 0;
+    for (;;) {
+        // Claim the first pending task we can rename into our lease
+        std::string claimed;
+        std::string pending_dir = opts.spool_dir + "/tasks/pending/";
+        for (const std::string& task : list_dir(pending_dir)) {
+            std::string lease = opts.spool_dir + "/tasks/leased/" + task + "." + opts.worker_id;
+            if (std::rename((pending_dir + task).c_str(), lease.c_str()) == 0) {
+                // rename keeps the old mtime - start the heartbeat from now
+                utime(lease.c_str(), nullptr);
+                claimed = task;
+                break;
+            }
+        }
+
+        if (claimed.empty()) {
+            if (opts.exit_when_idle) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (render_task(opts, claimed)) {
+            rendered++;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            farm_log("Worker " + opts.worker_id + " rendered " + claimed + " in " +
+                     format_duration(elapsed.count()));
+        } else {
+            // Don't claim the failed task straight back: give the server time
+            // to count the attempt (and other workers a turn at it)
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+        }
+    }
+
+    farm_log("Worker " + opts.worker_id + " idle, exiting after " + std::to_string(rendered) + " segments");
+    return 0;
+}
@@ -0,0 +1,48 @@
+// render_farm.hpp
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --- Render Farm ---
+// Splits a long render (a backlog of days, or a months-long compilation)
+// into segment tasks that several machines render in parallel.
+//
+// Everything goes through a spool directory shared by all machines (a NAS
+// mount, or a local directory when testing with several local processes):
+//
+//   objects/<hash>.jpg         frames, stored once by content hash
+//   tasks/pending/<task>       segment tasks waiting for a worker
+//   tasks/leased/<task>.<id>   claimed by worker <id>; mtime is its heartbeat
+//   tasks/done/<task>          finished
+//   segments/<task>.mp4        rendered segments
+//
+// Workers claim a task with an atomic rename and touch the lease while they
+// render. The server puts leases whose heartbeat is older than lease_seconds
+// back into pending, and once every task is done stream-copies the segments
+// into the final video with ffmpeg's concat demuxer.
+//
+// Each expired lease and each failed render appends an "expired"/"failed"
+// line to the task file. The server gives up on the job (exit 1) once a task
+// has used max_attempts, or when timeout_seconds (0 = none) have passed.
+
+struct FarmOptions {
+    std::string spool_dir;
+    std::string job_name;
+    std::string output_file;
+    std::vector<std::string> frame_dirs;
+    std::string worker_id;
+    std::string ffmpeg_command;
+    int segment_frames;
+    int lease_seconds;
+    int every_nth_frame;
+    int fps;
+    int max_attempts;
+    int timeout_seconds;
+    bool exit_when_idle;
+};
+
+// Command line entry points: "timelapse farm-server ..." / "timelapse farm-worker ..."
+int run_farm_server(int argc, char* argv[]);
+int run_farm_worker(int argc, char* argv[]);
@@ -0,0 +1,381 @@
+// schedule_plan.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "schedule_plan.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+// Stages of the capture program that make up the day's encode
+static const char* const ENCODE_STAGES[] = { "video_setup", "decode", "filter", "encode" };
+
+static void plan_usage() {
+    std::cerr << "Usage: timelapse plan [--date YYYY-MM-DD] [--dry-run]\n";
+}
+
+static double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+// "HH:MM:SS" -> seconds since midnight, -1 if malformed
+static long clock_seconds(const std::string& time) {
+    int h = 0, m = 0, s = 0;
+    if (std::sscanf(time.c_str(), "%d:%d:%d", &h, &m, &s) != 3) {
+        return -1;
+    }
+    return h * 3600L + m * 60L + s;
+}
+
+PlanOptions plan_options_from_config(const std::map<std::string, std::string>& config) {
+    PlanOptions options;
+    options.min_interval = std::stoi(config_value(config, "min_interval_seconds", "10"));
+    options.max_interval = std::stoi(config_value(config, "max_interval_seconds", "120"));
+    options.fps = std::stoi(config_value(config, "target_fps", "25"));
+    options.slo_deadline_ms = std::stoi(config_value(config, "slo_deadline_ms", "3000"));
+    options.margin = std::stod(config_value(config, "plan_margin", "0.2"));
+    options.encode_window_minutes = std::stoi(config_value(config, "plan_encode_window_minutes", "180"));
+    options.history_days = std::stoi(config_value(config, "plan_history_days", "7"));
+    return options;
+}
+
+bool append_capture_latency(const std::string& path, std::vector<float> latencies_ms, std::string& error) {
+    if (latencies_ms.empty()) {
+        return true;
+    }
+    std::sort(latencies_ms.begin(), latencies_ms.end());
+    auto quantile = [&](double q) {
+        return latencies_ms[static_cast<size_t>(q * (latencies_ms.size() - 1) + 0.5)];
+    };
+
+    struct stat st;
+    bool is_new = stat(path.c_str(), &st) != 0 || st.st_size == 0;
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (is_new) {
+        file << "day,captures,p50_ms,p90_ms,p99_ms,max_ms\n";
+    }
+
+    char day[16];
+    std::time_t now = std::time(nullptr);
+    std::strftime(day, sizeof(day), "%Y-%m-%d", std::localtime(&now));
+    char numbers[96];
+    snprintf(numbers, sizeof(numbers), "%zu,%.0f,%.0f,%.0f,%.0f", latencies_ms.size(), quantile(0.50),
+             quantile(0.90), quantile(0.99), latencies_ms.back());
+    file << day << "," << numbers << "\n";
+    if (!file) {
+        error = "write failed for " + path;
+        return false;
+    }
+    return true;
+}
+
+PlanTelemetry load_plan_telemetry(const std::string& latency_path, const std::string& stage_times_path,
+                                  int history_days, const std::string& today) {
+    PlanTelemetry telemetry = { 0, 0.0, 0.0, 0, 0.0 };
+    std::string line;
+
+    // Capture: one row per run; a day restarted mid-capture has several,
+    // the one with the most captures stands for it
+    std::map<std::string, std::vector<std::string>> latency_days;
+    std::ifstream latency(latency_path);
+    while (std::getline(latency, line)) {
+        std::vector<std::string> f = split_csv(line);
+        if (f.size() < 6 || f[0] == "day" || f[0] >= today) {
+            continue;
+        }
+        auto it = latency_days.find(f[0]);
+        if (it == latency_days.end() || std::atol(f[1].c_str()) > std::atol(it->second[1].c_str())) {
+            latency_days[f[0]] = f;
+        }
+    }
+    std::vector<double> p50s;
+    for (auto it = latency_days.rbegin(); it != latency_days.rend() && static_cast<int>(p50s.size()) < history_days;
+         ++it) {
+        p50s.push_back(std::atof(it->second[2].c_str()));
+        telemetry.capture_p99_ms = std::max(telemetry.capture_p99_ms, std::atof(it->second[4].c_str()));
+    }
+    telemetry.capture_days = static_cast<int>(p50s.size());
+    telemetry.capture_p50_ms = median(p50s);
+
+    // Encode: wall time of the encode stages over frames decoded, per day
+    struct EncodeDay {
+        double wall_seconds;
+        double frames;
+    };
+    std::map<std::string, EncodeDay> encode_days;
+    std::ifstream stages(stage_times_path);
+    while (std::getline(stages, line)) {
+        std::vector<std::string> f = split_csv(line);
+        if (f.size() < 6 || f[1] != "timelapse" || f[0] >= today ||
+            std::find(std::begin(ENCODE_STAGES), std::end(ENCODE_STAGES), f[2]) == std::end(ENCODE_STAGES)) {
+            continue;
+        }
+        EncodeDay& day = encode_days[f[0]];
+        day.wall_seconds += std::atof(f[4].c_str());
+        if (f[2] == "decode") {
+            day.frames += std::atof(f[3].c_str());
+        }
+    }
+    std::vector<double> rates;
+    for (auto it = encode_days.rbegin(); it != encode_days.rend() && static_cast<int>(rates.size()) < history_days;
+         ++it) {
+        if (it->second.frames > 0) {
+            rates.push_back(it->second.wall_seconds / it->second.frames);
+        }
+    }
+    telemetry.encode_days = static_cast<int>(rates.size());
+    telemetry.encode_seconds_per_frame = median(rates);
+    return telemetry;
+}
+
+SchedulePlan solve_schedule(long window_seconds, int requested_interval, const PlanOptions& options,
+                            const PlanTelemetry& telemetry) {
+    SchedulePlan plan;
+    plan.requested_interval = requested_interval;
+    plan.interval_seconds = std::max(requested_interval, std::max(options.min_interval, 1));
+    plan.limited_by = "target";
+    plan.encode_minutes = 0.0;
+
+    // Frames land on time only if the slowest captures end before the next slot
+    if (telemetry.capture_days > 0) {
+        int capture_floor = static_cast<int>(std::ceil(telemetry.capture_p99_ms * (1.0 + options.margin) / 1000.0));
+        if (capture_floor > plan.interval_seconds) {
+            plan.interval_seconds = capture_floor;
+            plan.limited_by = "capture";
+        }
+        if (telemetry.capture_p99_ms > options.slo_deadline_ms) {
+            plan.warnings.push_back("capture p99 of " + std::to_string(static_cast<int>(telemetry.capture_p99_ms)) +
+                                    " ms is over slo_deadline_ms (" + std::to_string(options.slo_deadline_ms) +
+                                    "): some frames will be late at any interval");
+        }
+    }
+
+    // The encode has to fit its window
+    if (telemetry.encode_days > 0 && telemetry.encode_seconds_per_frame > 0.0) {
+        double frame_cost = telemetry.encode_seconds_per_frame * (1.0 + options.margin);
+        long max_frames = static_cast<long>(options.encode_window_minutes * 60.0 / frame_cost);
+        if (max_frames < 1) {
+            plan.warnings.push_back("plan_encode_window_minutes is too short for a single frame");
+        } else if (window_seconds / plan.interval_seconds > max_frames) {
+            plan.interval_seconds = static_cast<int>((window_seconds + max_frames - 1) / max_frames);
+            while (window_seconds / plan.interval_seconds > max_frames) {
+                plan.interval_seconds++;
+            }
+            plan.limited_by = "encode";
+        }
+    }
+
+    if (plan.interval_seconds > options.max_interval) {
+        plan.warnings.push_back("the " + plan.limited_by + " limit needs " + std::to_string(plan.interval_seconds) +
+                                " s, over max_interval_seconds (" + std::to_string(options.max_interval) + ")");
+    }
+
+    plan.frames = static_cast<int>(window_seconds / plan.interval_seconds);
+    if (telemetry.encode_days > 0) {
+        plan.encode_minutes = plan.frames * telemetry.encode_seconds_per_frame / 60.0;
+    }
+    return plan;
+}
+
+// Value after "<prefix>" on a schedule line, e.g. "Interval: 20 seconds" -> "20 seconds"
+static bool line_value(const std::string& line, const std::string& prefix, std::string& value) {
+    if (line.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    value = line.substr(prefix.size());
+    return true;
+}
+
+bool plan_schedule_file(const std::string& path, const PlanOptions& options, const PlanTelemetry& telemetry,
+                        bool replan, bool dry_run, std::vector<std::string>& report, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    std::string value;
+    std::string start;
+    std::string end;
+    int interval = 0;
+    int requested = 0;
+    bool planned = false;
+    while (std::getline(file, line)) {
+        if (line_value(line, "Start: ", value)) {
+            start = value;
+        } else if (line_value(line, "End: ", value)) {
+            end = value;
+        } else if (line_value(line, "Interval: ", value)) {
+            interval = std::atoi(value.c_str());
+        } else if (line_value(line, "Requested interval: ", value)) {
+            requested = std::atoi(value.c_str());
+        } else if (line == "Predicted cost:") {
+            planned = true;
+        }
+        lines.push_back(line);
+    }
+    file.close();
+
+    long start_s = clock_seconds(start);
+    long end_s = clock_seconds(end);
+    if (start_s < 0 || end_s < 0 || interval <= 0) {
+        error = "no Start/End/Interval in " + path;
+        return false;
+    }
+    if (planned && !replan) {
+        report.push_back("Schedule already planned (interval " + std::to_string(interval) + " s)");
+        return true;
+    }
+    if (requested <= 0) {
+        requested = interval; // first plan: the interval scheduler.py chose
+    }
+    long window = end_s > start_s ? end_s - start_s : end_s + 86400 - start_s;
+
+    SchedulePlan plan = solve_schedule(window, requested, options, telemetry);
+
+    char text[160];
+    std::vector<std::string> cost;
+    cost.push_back("Predicted cost:");
+    cost.push_back("Requested interval: " + std::to_string(plan.requested_interval) + " seconds");
+    cost.push_back("Limited by: " + plan.limited_by);
+    if (telemetry.capture_days > 0) {
+        snprintf(text, sizeof(text), "Capture latency: p50 %.0f ms, p99 %.0f ms (%d days)", telemetry.capture_p50_ms,
+                 telemetry.capture_p99_ms, telemetry.capture_days);
+        cost.push_back(text);
+        snprintf(text, sizeof(text), "Capture busy: %.0f%% of each interval",
+                 100.0 * telemetry.capture_p50_ms / 1000.0 / plan.interval_seconds);
+        cost.push_back(text);
+    } else {
+        cost.push_back("Capture latency: no data yet");
+    }
+    if (telemetry.encode_days > 0) {
+        long done = (end_s + static_cast<long>(plan.encode_minutes * 60.0)) % 86400;
+        snprintf(text, sizeof(text), "Encode: %.3f s/frame (%d days), %.1f minutes, done by %02ld:%02ld",
+                 telemetry.encode_seconds_per_frame, telemetry.encode_days, plan.encode_minutes, done / 3600,
+                 done / 60 % 60);
+        cost.push_back(text);
+    } else {
+        cost.push_back("Encode: no data yet");
+    }
+    cost.push_back("Encode window: " + std::to_string(options.encode_window_minutes) + " minutes");
+    for (const std::string& warning : plan.warnings) {
+        cost.push_back("Warning: " + warning);
+    }
+
+    // Rewrite the planned values, drop an old cost block, and put the new
+    // one in front of the file names
+    std::vector<std::string> out;
+    bool in_old_block = false;
+    bool inserted = false;
+    for (const std::string& l : lines) {
+        if (l == "Predicted cost:") {
+            in_old_block = true;
+            continue;
+        }
+        if (in_old_block) {
+            in_old_block = !l.empty();
+            continue;
+        }
+        if (!inserted && l.compare(0, 17, "Filename prefix: ") == 0) {
+            out.insert(out.end(), cost.begin(), cost.end());
+            out.push_back("");
+            inserted = true;
+        }
+        if (line_value(l, "Interval: ", value)) {
+            out.push_back("Interval: " + std::to_string(plan.interval_seconds) + " seconds");
+        } else if (line_value(l, "Expected photos: ", value)) {
+            out.push_back("Expected photos: " + std::to_string(plan.frames));
+        } else if (line_value(l, "Expected video length: ", value)) {
+            snprintf(text, sizeof(text), "Expected video length: %.1f seconds",
+                     options.fps > 0 ? static_cast<double>(plan.frames) / options.fps : 0.0);
+            out.push_back(text);
+        } else {
+            out.push_back(l);
+        }
+    }
+    if (!inserted) {
+        out.push_back("");
+        out.insert(out.end(), cost.begin(), cost.end());
+    }
+
+    report.push_back("Plan: interval " + std::to_string(requested) + " -> " + std::to_string(plan.interval_seconds) +
+                     " s (limited by " + plan.limited_by + "), " + std::to_string(plan.frames) + " photos");
+    report.insert(report.end(), cost.begin() + 3, cost.end());
+    if (dry_run) {
+        return true;
+    }
+
+    std::string data;
+    for (const std::string& l : out) {
+        data += l + "\n";
+    }
+    if (!write_file_atomic(path, data.data(), data.size())) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+int run_plan(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+
+    std::time_t now = std::time(nullptr);
+    char today[16];
+    std::strftime(today, sizeof(today), "%Y-%m-%d", std::localtime(&now));
+    std::string date = today;
+    bool dry_run = false;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--date" && has_value) {
+            date = argv[++i];
+        } else if (arg == "--dry-run") {
+            dry_run = true;
+        } else {
+            plan_usage();
+            return 2;
+        }
+    }
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-') {
+        plan_usage();
+        return 2;
+    }
+
+    std::string path = std::string(SCHEDULES_PATH) + date.substr(0, 4) + date.substr(5, 2) + date.substr(8, 2) + "_" +
+                       config_value(config, "id", "UndefinedDeviceID") + "_schedule.txt";
+    PlanOptions options = plan_options_from_config(config);
+    PlanTelemetry telemetry =
+        load_plan_telemetry(CAPTURE_LATENCY_FILE, STAGE_TIMES_FILE, options.history_days, date);
+
+    std::vector<std::string> report;
+    std::string error;
+    if (!plan_schedule_file(path, options, telemetry, true, dry_run, report, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    for (const std::string& line : report) {
+        std::cout << line << std::endl;
+    }
+    if (!dry_run) {
+        std::cout << "Planned " << path << std::endl;
+    }
+    return 0;
+}
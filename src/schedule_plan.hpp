@@ -0,0 +1,88 @@
+// schedule_plan.hpp
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// --- Schedule Planner ---
+// scheduler.py picks the interval from the daylight window and the target
+// video length alone. On a Pi Zero a capture takes 1-3 s, and the encode
+// time grows with the frame count, so that interval can be too short for
+// frames to land on time, or give more frames than can be encoded before
+// the night's backup. "timelapse plan" takes the schedule scheduler.py
+// wrote and re-solves its interval against what past days measured:
+//
+//   capture  logs/capture_latency.csv: quantiles of each day's capture
+//            latency. The interval must be longer than the worst daily p99
+//            (plus plan_margin), or slow captures run into the next slot.
+//   encode   logs/stage_times.csv: seconds per frame of the day's encode
+//            (video_setup + decode + filter + encode wall time / frames),
+//            median over the days. frames x that (plus plan_margin) must
+//            fit in plan_encode_window_minutes after the capture ends.
+//
+// The interval is the longest of the requested one and the two limits, and
+// the frame count follows from it. A limit above max_interval_seconds still
+// wins (a late or unencoded frame is worse than a shorter video), with a
+// warning. Without telemetry (a new camera), the requested schedule stands.
+//
+// The result goes back into the schedule file: Interval, Expected photos
+// and Expected video length are rewritten, and a "Predicted cost:" block
+// records the requested interval, the deciding limit, the measured costs
+// and the predicted encode time. The capture program plans a schedule the
+// first time it loads it; a planned schedule is left alone after that
+// (changing the interval mid-day would move every slot), unless the
+// command is run again by hand.
+
+struct PlanTelemetry {
+    int capture_days;        // days with capture latency data (0 = none)
+    double capture_p50_ms;   // median of the daily p50s
+    double capture_p99_ms;   // worst daily p99
+    int encode_days;         // days with encode stage times (0 = none)
+    double encode_seconds_per_frame; // median of the daily values
+};
+
+struct PlanOptions {
+    int min_interval;  // [SCHEDULER] min/max_interval_seconds
+    int max_interval;
+    int fps;           // target_fps, for the video length
+    int slo_deadline_ms;
+    double margin;     // plan_margin: 0.2 = plan for 20% slower than measured
+    int encode_window_minutes;
+    int history_days;  // plan_history_days
+};
+
+struct SchedulePlan {
+    int requested_interval;
+    int interval_seconds;
+    int frames;
+    std::string limited_by; // "target", "capture" or "encode"
+    double encode_minutes;  // predicted, 0 without encode data
+    std::vector<std::string> warnings;
+};
+
+// Plan options from the config file's keys (read_config)
+PlanOptions plan_options_from_config(const std::map<std::string, std::string>& config);
+
+// Appends "day,captures,p50_ms,p90_ms,p99_ms,max_ms" for today (header
+// written when the file is new). Nothing is written without latencies.
+bool append_capture_latency(const std::string& path, std::vector<float> latencies_ms, std::string& error);
+
+// Costs measured on the last history_days days before `today` (YYYY-MM-DD)
+PlanTelemetry load_plan_telemetry(const std::string& latency_path, const std::string& stage_times_path,
+                                  int history_days, const std::string& today);
+
+// Solves the interval for a capture window of window_seconds
+SchedulePlan solve_schedule(long window_seconds, int requested_interval, const PlanOptions& options,
+                            const PlanTelemetry& telemetry);
+
+// Plans the schedule file at path and rewrites it (unless dry_run). With
+// replan false, a file that already has a plan is left as it is. Lines
+// describing the plan are added to `report`. False if the file can't be
+// read, parsed or written (error says why).
+bool plan_schedule_file(const std::string& path, const PlanOptions& options, const PlanTelemetry& telemetry,
+                        bool replan, bool dry_run, std::vector<std::string>& report, std::string& error);
+
+// Command line entry point: "timelapse plan ..."
+int run_plan(int argc, char* argv[]);
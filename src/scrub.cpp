@@ -0,0 +1,312 @@
+// scrub.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "scrub.hpp"
+#include "manifest.hpp"
+#include "parity.hpp"
+#include "stage_times.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+#define SCRUB_STATE LOGS_PATH "scrub.state"
+#define SCRUB_REPORT LOGS_PATH "scrub_report.txt"
+// Baseline hashes of state.current_day so far, when a run stopped part way
+// through a day without a manifest
+#define SCRUB_BASELINE "scrub_baseline.txt"
+// Read size for hashing: big enough for the disk to stream, small enough
+// that the rate limiter stays smooth
+#define SCRUB_READ_SIZE (1 << 20)
+
+// Save progress after this many frames
+#define SCRUB_SAVE_EVERY 50
+
+struct ScrubOptions {
+    std::string root;
+    double max_mb_per_s;
+    int max_minutes;
+    bool idle;
+    std::string nas_host;
+    std::string nas_module;
+    std::string device_id;
+};
+
+// Progress of the current pass over all days
+struct ScrubState {
+    long pass_started;
+    std::set<std::string> days_done;
+    std::string current_day;
+    size_t current_index;
+};
+
+static void scrub_usage() {
+    std::cerr << "Usage: timelapse scrub [--root DIR] [--max-mb-per-s N] [--max-minutes N] [--no-idle]\n";
+}
+
+static void load_scrub_state(ScrubState& state) {
+    state.pass_started = 0;
+    state.current_index = 0;
+    std::ifstream file(SCRUB_STATE);
+    std::string key;
+    while (file >> key) {
+        if (key == "pass_started") {
+            file >> state.pass_started;
+        } else if (key == "done") {
+            std::string day;
+            file >> day;
+            state.days_done.insert(day);
+        } else if (key == "current") {
+            file >> state.current_day >> state.current_index;
+        } else {
+            std::string ignored;
+            std::getline(file, ignored);
+        }
+    }
+}
+
+static void save_scrub_state(const ScrubState& state) {
+    std::stringstream ss;
+    ss << "pass_started " << state.pass_started << "\n";
+    for (const std::string& day : state.days_done) {
+        ss << "done " << day << "\n";
+    }
+    if (!state.current_day.empty()) {
+        ss << "current " << state.current_day << " " << state.current_index << "\n";
+    }
+    std::string data = ss.str();
+    write_file_atomic(SCRUB_STATE, data.data(), data.size());
+}
+
+// Hashes a file with big sequential reads, under the rate limit, and drops
+// its pages from the cache afterwards. Returns false if it can't be read.
+static bool scrub_hash_file(const std::string& path, RateLimiter& limiter, std::vector<char>& buffer,
+                            std::string& hash, uint64_t& size) {
+    StageTimer timer("hash");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ok = false; // EIO: the card can't read this block at all
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        h = hash_bytes(buffer.data(), n, h);
+        size += n;
+        limiter.consume(n);
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    hash = hash_to_hex(h);
+    return ok;
+}
+
+static void report_bad_frame(const ScrubOptions& opts, const std::string& day, const std::string& frame,
+                             const std::string& problem) {
+    time_t now = std::time(nullptr);
+    std::stringstream ts;
+    ts << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S");
+
+    std::string local = opts.root + day + "/" + frame;
+    std::ofstream report(SCRUB_REPORT, std::ios::app);
+    report << "[" << ts.str() << "] " << problem << " " << local << "\n";
+    if (!opts.nas_host.empty()) {
+        report << "    restore: rsync rsync://" << opts.nas_host << "/" << opts.nas_module << "/"
+               << opts.device_id << "/" << day << "/" << frame << " " << local << "\n";
+    }
+    if (has_parity(opts.root + day)) {
+        report << "    repair:  ./programs/timelapse repair " << opts.root << day << "\n";
+    }
+    archive_log("Scrub: " + problem + " " + local);
+}
+
+int run_scrub(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+
+    ScrubOptions opts;
+    opts.root = PICS_PATH;
+    opts.max_mb_per_s = std::stod(config_value(config, "scrub_max_mb_per_s", "2"));
+    opts.max_minutes = std::stoi(config_value(config, "scrub_max_minutes", "0"));
+    opts.idle = true;
+    opts.nas_host = config_value(config, "nas_host", "");
+    opts.nas_module = config_value(config, "nas_module", "timelapse");
+    opts.device_id = config_value(config, "id", "");
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--root" && has_value) {
+            opts.root = argv[++i];
+        } else if (arg == "--max-mb-per-s" && has_value) {
+            opts.max_mb_per_s = std::stod(argv[++i]);
+        } else if (arg == "--max-minutes" && has_value) {
+            opts.max_minutes = std::stoi(argv[++i]);
+        } else if (arg == "--no-idle") {
+            opts.idle = false;
+        } else {
+            scrub_usage();
+            return 2;
+        }
+    }
+    if (opts.root.back() != '/') {
+        opts.root += "/";
+    }
+
+    if (opts.idle) {
+        set_idle_priority();
+    }
+
+    ScrubState state;
+    load_scrub_state(state);
+    if (state.pass_started == 0) {
+        state.pass_started = std::time(nullptr);
+        archive_log("Scrub: starting a new pass over " + opts.root);
+    } else {
+        archive_log("Scrub: resuming pass (" + std::to_string(state.days_done.size()) + " days already checked)");
+    }
+
+    RateLimiter limiter(opts.max_mb_per_s * 1024 * 1024);
+    std::vector<char> buffer(SCRUB_READ_SIZE);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(opts.max_minutes);
+    int bad_frames = 0;
+    int frames_checked = 0;
+    uint64_t bytes_checked = 0;
+    bool out_of_time = false;
+
+    for (const std::string& day : finished_days(opts.root)) {
+        if (state.days_done.count(day)) {
+            continue;
+        }
+        std::string dir = opts.root + day + "/";
+
+        std::vector<ManifestEntry> manifest;
+        bool have_manifest = read_manifest(dir, manifest);
+        if (!have_manifest) {
+            // First scrub of this day: record a baseline. It takes as long
+            // as a verify, so it keeps to the same deadline and resumes from
+            // the hashes saved in logs/ when it is cut short.
+            std::vector<std::string> frames = list_frames(dir);
+            size_t start = 0;
+            if (state.current_day == day && read_manifest(LOGS_PATH, manifest, SCRUB_BASELINE)) {
+                start = std::min(state.current_index, frames.size());
+            }
+            for (size_t i = start; i < frames.size(); i++) {
+                ManifestEntry entry;
+                entry.name = frames[i];
+                if (scrub_hash_file(dir + frames[i], limiter, buffer, entry.hash, entry.size)) {
+                    manifest.push_back(entry);
+                    bytes_checked += entry.size;
+                } else {
+                    bad_frames++;
+                    report_bad_frame(opts, day, frames[i], "UNREADABLE");
+                }
+                frames_checked++;
+
+                bool stop = opts.max_minutes > 0 && std::chrono::steady_clock::now() >= deadline;
+                if (stop || frames_checked % SCRUB_SAVE_EVERY == 0) {
+                    write_manifest(LOGS_PATH, manifest, SCRUB_BASELINE);
+                    state.current_day = day;
+                    state.current_index = i + 1;
+                    save_scrub_state(state);
+                }
+                if (stop) {
+                    out_of_time = true;
+                    break;
+                }
+            }
+            if (out_of_time) {
+                break;
+            }
+            write_manifest(dir, manifest);
+            std::remove((std::string(LOGS_PATH) + SCRUB_BASELINE).c_str());
+            archive_log("Scrub: no manifest in " + dir + ", created one for " +
+                        std::to_string(manifest.size()) + " frames");
+        } else {
+            size_t start = state.current_day == day ? state.current_index : 0;
+            for (size_t i = start; i < manifest.size(); i++) {
+                const ManifestEntry& entry = manifest[i];
+                std::string hash;
+                uint64_t size = 0;
+                struct stat st;
+
+                if (stat((dir + entry.name).c_str(), &st) != 0) {
+                    bad_frames++;
+                    report_bad_frame(opts, day, entry.name, "MISSING");
+                } else if (!scrub_hash_file(dir + entry.name, limiter, buffer, hash, size)) {
+                    bad_frames++;
+                    report_bad_frame(opts, day, entry.name, "UNREADABLE");
+                } else if (size != entry.size || hash != entry.hash) {
+                    bad_frames++;
+                    report_bad_frame(opts, day, entry.name, "CORRUPT (expected " + entry.hash + " " +
+                                     std::to_string(entry.size) + " bytes, got " + hash + " " +
+                                     std::to_string(size) + " bytes)");
+                }
+                bytes_checked += size;
+                frames_checked++;
+
+                if (opts.max_minutes > 0 && std::chrono::steady_clock::now() >= deadline) {
+                    state.current_day = day;
+                    state.current_index = i + 1;
+                    out_of_time = true;
+                    break;
+                }
+                if (frames_checked % SCRUB_SAVE_EVERY == 0) {
+                    state.current_day = day;
+                    state.current_index = i + 1;
+                    save_scrub_state(state);
+                }
+            }
+        }
+
+        if (out_of_time) {
+            break;
+        }
+        state.days_done.insert(day);
+        state.current_day.clear();
+        state.current_index = 0;
+        save_scrub_state(state);
+    }
+
+    std::string summary = "Scrub: checked " + std::to_string(frames_checked) + " frames (" +
+                          std::to_string(bytes_checked / (1024 * 1024)) + " MB), " +
+                          std::to_string(bad_frames) + " bad";
+    if (out_of_time) {
+        save_scrub_state(state);
+        archive_log(summary + " - time limit reached, will resume from " + state.current_day);
+    } else {
+        // Pass complete: the next run starts a new one
+        std::remove(SCRUB_STATE);
+        archive_log(summary + " - pass complete");
+    }
+
+    if (bad_frames > 0) {
+        archive_log("Scrub: see " + std::string(SCRUB_REPORT) + " for frames to restore from the NAS");
+    }
+    return bad_frames > 0 ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+// scrub.hpp
+
+#pragma once
+
+// --- Archive Scrubber ---
+// SD cards and cheap NAS disks corrupt data silently. "timelapse scrub"
+// walks finished day directories, re-hashes every frame and compares it with
+// the day's manifest.txt. Corrupt or missing frames are written to
+// logs/scrub_report.txt, each with the rsync command that restores it from
+// the NAS copy.
+//
+// Scrubbing has to stay out of the capture's way:
+//   - idle CPU/I-O priority and a bandwidth cap (scrub_max_mb_per_s)
+//   - large sequential reads with posix_fadvise, and the pages it read are
+//     dropped afterwards, so the page cache keeps what capture needs
+//   - progress is saved to logs/scrub.state, so a run stopped by
+//     --max-minutes (or killed) carries on where it left off next time
+//
+// Days without a manifest get one built from their current contents (the
+// baseline later scrubs check against). Building it reads as much as a
+// scrub, so it stops at the same deadline and resumes the same way.
+
+// Command line entry point: "timelapse scrub ..."
+int run_scrub(int argc, char* argv[]);
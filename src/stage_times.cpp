@@ -0,0 +1,146 @@
+// stage_times.cpp
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+
+#include "stage_times.hpp"
+
+#define STAGE_MAX 32
+#define STAGE_NAME 32
+
+struct StageTotals {
+    char name[STAGE_NAME];
+    std::atomic<uint64_t> calls;
+    std::atomic<int64_t> wall_ns;
+    std::atomic<int64_t> cpu_ns;
+};
+
+static StageTotals stages[STAGE_MAX];
+static std::atomic<int> stage_count(0);
+static std::mutex stage_mutex; // only taken to add a stage
+static thread_local StageTimer* current_timer = nullptr;
+
+static int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Stages are few, so a scan beats hashing. Null when the table is full.
+static StageTotals* find_stage(const char* name) {
+    int count = stage_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(stages[i].name, name, STAGE_NAME - 1) == 0) {
+            return &stages[i];
+        }
+    }
+    std::lock_guard<std::mutex> lock(stage_mutex);
+    count = stage_count.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(stages[i].name, name, STAGE_NAME - 1) == 0) {
+            return &stages[i];
+        }
+    }
+    if (count == STAGE_MAX) {
+        return nullptr;
+    }
+    snprintf(stages[count].name, STAGE_NAME, "%s", name);
+    stage_count.store(count + 1, std::memory_order_release);
+    return &stages[count];
+}
+
+StageTimer::StageTimer(const char* name) : stage(find_stage(name)), parent(current_timer) {
+    wall_mark = clock_ns(CLOCK_MONOTONIC);
+    cpu_mark = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    if (parent != nullptr) {
+        parent->charge(wall_mark, cpu_mark);
+    }
+    if (stage != nullptr) {
+        stage->calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    current_timer = this;
+}
+
+StageTimer::~StageTimer() {
+    int64_t wall = clock_ns(CLOCK_MONOTONIC);
+    int64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    charge(wall, cpu);
+    current_timer = parent;
+    if (parent != nullptr) {
+        // The enclosing stage resumes from here
+        parent->wall_mark = wall;
+        parent->cpu_mark = cpu;
+    }
+}
+
+void StageTimer::charge(int64_t wall_now, int64_t cpu_now) {
+    if (stage != nullptr) {
+        stage->wall_ns.fetch_add(wall_now - wall_mark, std::memory_order_relaxed);
+        stage->cpu_ns.fetch_add(cpu_now - cpu_mark, std::memory_order_relaxed);
+    }
+    wall_mark = wall_now;
+    cpu_mark = cpu_now;
+}
+
+std::vector<StageTime> stage_times() {
+    std::vector<StageTime> times;
+    int count = stage_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        StageTime t;
+        t.name = stages[i].name;
+        t.calls = stages[i].calls.load(std::memory_order_relaxed);
+        t.wall_seconds = stages[i].wall_ns.load(std::memory_order_relaxed) / 1e9;
+        t.cpu_seconds = stages[i].cpu_ns.load(std::memory_order_relaxed) / 1e9;
+        times.push_back(t);
+    }
+    return times;
+}
+
+bool append_stage_times(const std::string& path, const std::string& program, std::string& error) {
+    std::vector<StageTime> times = stage_times();
+    if (times.empty()) {
+        return true;
+    }
+    struct stat st;
+    bool is_new = stat(path.c_str(), &st) != 0 || st.st_size == 0;
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (is_new) {
+        file << "day,program,stage,calls,wall_s,cpu_s\n";
+    }
+
+    char day[16];
+    std::time_t now = std::time(nullptr);
+    std::strftime(day, sizeof(day), "%Y-%m-%d", std::localtime(&now));
+    for (const StageTime& t : times) {
+        char numbers[96];
+        snprintf(numbers, sizeof(numbers), "%llu,%.3f,%.3f", static_cast<unsigned long long>(t.calls),
+                 t.wall_seconds, t.cpu_seconds);
+        file << day << "," << program << "," << t.name << "," << numbers << "\n";
+    }
+    if (!file) {
+        error = "write failed for " + path;
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> format_stage_times() {
+    std::vector<std::string> lines;
+    for (const StageTime& t : stage_times()) {
+        char line[160];
+        snprintf(line, sizeof(line), "%-12s %6llux %9.2f s wall, %9.2f s CPU (%3.0f%%)", t.name.c_str(),
+                 static_cast<unsigned long long>(t.calls), t.wall_seconds, t.cpu_seconds,
+                 t.wall_seconds > 0.0 ? 100.0 * t.cpu_seconds / t.wall_seconds : 0.0);
+        lines.push_back(line);
+    }
+    return lines;
+}
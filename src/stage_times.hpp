@@ -0,0 +1,58 @@
+// stage_times.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Stage CPU Times ---
+// "Time to encode" is wall time: on the Pi Zero, much of it can be spent
+// waiting on the SD card rather than computing. Each pipeline stage
+// therefore adds up both its wall time and the CPU time of the thread that
+// ran it (CLOCK_THREAD_CPUTIME_ID). A stage whose CPU time is close to its
+// wall time is CPU-bound (faster code helps). One with little CPU for its
+// wall time is waiting on I/O (fewer or larger writes help).
+//
+// Stages are scopes, like HeapStage:
+//
+//   StageTimer timer("decode");
+//
+// Times are exclusive: while a nested stage runs, the enclosing one is
+// paused, so the stages of a run add up to its total. CPU time of child
+// processes (capture_command, ffmpeg) isn't the thread's, so their stages
+// show up as mostly wall time. Totals are per process, which is one day for
+// the capture program; threads may time stages concurrently.
+class StageTimer {
+public:
+    explicit StageTimer(const char* name);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    struct StageTotals* stage;
+    StageTimer* parent;
+    int64_t wall_mark; // ns, steady clock
+    int64_t cpu_mark;  // ns, this thread's CPU clock
+
+    void charge(int64_t wall_now, int64_t cpu_now);
+};
+
+struct StageTime {
+    std::string name;
+    uint64_t calls;
+    double wall_seconds;
+    double cpu_seconds;
+};
+
+// Totals so far, in the order stages were first entered
+std::vector<StageTime> stage_times();
+
+// Appends one "day,program,stage,calls,wall_s,cpu_s" line per stage to a
+// CSV (header written when the file is new). day is today's local date.
+bool append_stage_times(const std::string& path, const std::string& program, std::string& error);
+
+// "decode   812x   95.30 s wall,   90.10 s CPU ( 95%)" per stage, for the log
+std::vector<std::string> format_stage_times();
@@ -0,0 +1,278 @@
+// storage_bench.cpp
+//
+// Capture/render storage benchmark: `make storage-bench` builds
+// programs/timelapse_storage_bench. Meant to be run under the fault shim
+// (programs/fault_bench.sh does that for each fault profile) to see how the
+// pipeline behaves on a slow or failing SD card.
+//
+//   capture: writes a synthetic 1080p JPEG every --interval-ms with
+//            write_file_atomic, exactly as the V4L2 MJPEG path saves frames,
+//            and measures save latency and how late each shot started
+//   render:  decodes the frames back with decode_jpeg_yuv420 and runs the
+//            deflicker filter (and ffmpeg with --encode), measuring fps
+//
+// Results are printed as key=value lines so runs can be diffed.
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jpeg_error.hpp"
+#include "utils.hpp"
+#include "video_encoder.hpp"
+#include "video_filters.hpp"
+#include "yuv_frame.hpp"
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+
+struct StorageBenchOptions {
+    std::string dir;
+    int frames;
+    int interval_ms;
+    bool durable;
+    bool encode;
+};
+
+static void storage_bench_usage() {
+    std::cerr << "Usage: timelapse_storage_bench [--dir DIR] [--frames N] [--interval-ms N] [--durable] [--encode]\n";
+}
+
+// A gradient with some noise, so the JPEG is about the size of a real frame.
+// buffer/size and the row are owned by make_test_jpeg: libjpeg writes them
+// after setjmp, and a longjmp would skip the row's destructor.
+static bool compress_test_image(std::vector<unsigned char>& row, unsigned char** buffer, unsigned long* size) {
+    uint32_t x = 12345;
+
+    jpeg_compress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+    if (setjmp(err.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        std::cerr << "Test JPEG: " << err.message << std::endl;
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, buffer, size);
+    cinfo.image_width = BENCH_WIDTH;
+    cinfo.image_height = BENCH_HEIGHT;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        int y = cinfo.next_scanline;
+        for (int i = 0; i < BENCH_WIDTH; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            int noise = static_cast<int>(x >> 28) - 8;
+            row[i * 3 + 0] = static_cast<unsigned char>(std::min(255, std::max(0, i * 255 / BENCH_WIDTH + noise)));
+            row[i * 3 + 1] = static_cast<unsigned char>(std::min(255, std::max(0, y * 255 / BENCH_HEIGHT + noise)));
+            row[i * 3 + 2] = static_cast<unsigned char>(std::min(255, std::max(0, 128 + noise * 2)));
+        }
+        JSAMPROW rows[1] = { row.data() };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+static bool make_test_jpeg(std::vector<unsigned char>& jpeg) {
+    std::vector<unsigned char> row(BENCH_WIDTH * 3);
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+
+    bool ok = compress_test_image(row, &buffer, &size);
+    if (ok) {
+        jpeg.assign(buffer, buffer + size);
+    }
+    free(buffer);
+    return ok;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static double mean(const std::vector<double>& values) {
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    return values.empty() ? 0.0 : sum / values.size();
+}
+
+static void print_stats(const std::string& prefix, const std::vector<double>& values) {
+    printf("%s_mean=%.2f\n", prefix.c_str(), mean(values));
+    printf("%s_p50=%.2f\n", prefix.c_str(), percentile(values, 0.50));
+    printf("%s_p95=%.2f\n", prefix.c_str(), percentile(values, 0.95));
+    printf("%s_p99=%.2f\n", prefix.c_str(), percentile(values, 0.99));
+    printf("%s_max=%.2f\n", prefix.c_str(), values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()));
+}
+
+// Shots are scheduled on a fixed grid like the capture loop; a save that
+// overruns the interval makes the next shot late (or skips it entirely).
+static void run_capture_phase(const StorageBenchOptions& opts, const std::vector<unsigned char>& jpeg) {
+    using clock = std::chrono::steady_clock;
+    std::vector<double> latency_ms;
+    std::vector<double> late_ms;
+    int failed = 0;
+    int missed_slots = 0;
+    std::string last_error;
+
+    auto start = clock::now();
+    auto interval = std::chrono::milliseconds(opts.interval_ms);
+    for (int i = 0; i < opts.frames; i++) {
+        auto slot = start + i * interval;
+        auto now = clock::now();
+        if (now < slot) {
+            std::this_thread::sleep_until(slot);
+        } else if (now - slot >= interval) {
+            missed_slots++;
+        }
+
+        auto t0 = clock::now();
+        char name[32];
+        snprintf(name, sizeof(name), "frame_%05d.jpg", i);
+        errno = 0;
+        bool ok = write_file_atomic(opts.dir + name, reinterpret_cast<const char*>(jpeg.data()), jpeg.size(),
+                                    opts.durable);
+        auto t1 = clock::now();
+
+        late_ms.push_back(std::chrono::duration<double, std::milli>(t0 - slot).count());
+        latency_ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        if (!ok) {
+            failed++;
+            last_error = errno ? strerror(errno) : "unknown";
+        }
+    }
+
+    int leftover_tmp = 0;
+    for (const std::string& file : list_dir(opts.dir)) {
+        if (file.size() > 4 && file.compare(file.size() - 4, 4, ".tmp") == 0) {
+            leftover_tmp++;
+        }
+    }
+
+    printf("capture_frames=%d\n", opts.frames);
+    printf("capture_failed=%d\n", failed);
+    printf("capture_missed_slots=%d\n", missed_slots);
+    printf("capture_leftover_tmp=%d\n", leftover_tmp);
+    if (!last_error.empty()) {
+        printf("capture_last_error=%s\n", last_error.c_str());
+    }
+    print_stats("capture_latency_ms", latency_ms);
+    print_stats("capture_late_ms", late_ms);
+}
+
+static void run_render_phase(const StorageBenchOptions& opts) {
+    using clock = std::chrono::steady_clock;
+    std::vector<std::string> frames;
+    for (const std::string& file : list_dir(opts.dir)) {
+        if (file.size() > 4 && file.compare(file.size() - 4, 4, ".jpg") == 0) {
+            frames.push_back(file);
+        }
+    }
+
+    YuvFrame frame;
+    DeflickerFilter deflicker(10);
+    YuvVideoWriter writer;
+    std::string error;
+    std::string last_error;
+    int decode_errors = 0;
+    int encode_errors = 0;
+    int rendered = 0;
+
+    auto start = clock::now();
+    for (const std::string& file : frames) {
+        if (!decode_jpeg_yuv420(opts.dir + file, frame, error)) {
+            decode_errors++;
+            last_error = error;
+            continue;
+        }
+        deflicker.apply(frame);
+        if (opts.encode && !writer.is_open() &&
+            !writer.open(opts.dir + "bench.mp4", frame.width, frame.height, 30, "ffmpeg", "ultrafast", 23, error)) {
+            encode_errors++;
+            last_error = error;
+        }
+        if (writer.is_open() && !writer.write(frame)) {
+            encode_errors++;
+        }
+        rendered++;
+    }
+    if (writer.is_open() && !writer.close()) {
+        encode_errors++;
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    printf("render_frames=%d\n", rendered);
+    printf("render_decode_errors=%d\n", decode_errors);
+    printf("render_encode_errors=%d\n", encode_errors);
+    if (!last_error.empty()) {
+        printf("render_last_error=%s\n", last_error.c_str());
+    }
+    printf("render_fps=%.2f\n", seconds > 0.0 ? rendered / seconds : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+    StorageBenchOptions opts;
+    opts.dir = "/tmp/timelapse_storage_bench/";
+    opts.frames = 100;
+    opts.interval_ms = 100;
+    opts.durable = false;
+    opts.encode = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--dir" && has_value) {
+            opts.dir = argv[++i];
+        } else if (arg == "--frames" && has_value) {
+            opts.frames = std::stoi(argv[++i]);
+        } else if (arg == "--interval-ms" && has_value) {
+            opts.interval_ms = std::stoi(argv[++i]);
+        } else if (arg == "--durable") {
+            opts.durable = true;
+        } else if (arg == "--encode") {
+            opts.encode = true;
+        } else {
+            storage_bench_usage();
+            return 2;
+        }
+    }
+    if (opts.dir.back() != '/') {
+        opts.dir += "/";
+    }
+    if (!create_dir(opts.dir)) {
+        std::cerr << "Cannot create " << opts.dir << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> jpeg;
+    if (!make_test_jpeg(jpeg)) {
+        return 1;
+    }
+    printf("frame_bytes=%zu\n", jpeg.size());
+    printf("interval_ms=%d\n", opts.interval_ms);
+
+    run_capture_phase(opts, jpeg);
+    run_render_phase(opts);
+    return 0;
+}
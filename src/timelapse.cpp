@@ -23,16 +23,44 @@
 #include <thread>
 #include <cstring> // For strerror
 #include <string>
+#include <dirent.h>
+#include <mutex>
 
 #include "timelapse.hpp"
 #include "utils.hpp"
+#include "v4l2_camera.hpp"
+#include "network_camera.hpp"
+#include "job_graph.hpp"
+#include "yuv_frame.hpp"
+#include "video_filters.hpp"
+#include "video_encoder.hpp"
+#include "heap_profile.hpp"
+#include "stage_times.hpp"
+#include "rate_plan.hpp"
+#include "manifest.hpp"
+#include "schedule_plan.hpp"
+#include "timeslice.hpp"
 
 const char* CONFIG_FILE = "conf/timelapse.conf";
 
 // constructor
-TimeLapse::TimeLapse() : photo_count(0), capture_errors(0),
-    last_capture_duration_ms(0), last_capture_success(false),
-    last_capture_epoch(0) {
+TimeLapse::TimeLapse() : photo_count(0), capture_backend("command"),
+    network_timeout_ms(5000), resolution_width(1920), resolution_height(1080),
+    interval_seconds(0), expected_photos(0),
+    job_graph_enabled(false), max_concurrent_jobs(2), job_retries(3), job_retry_delay_seconds(300),
+    scheduler_command("python3 ./programs/scheduler.py"), recompress_enabled(false), parity_shards(0), day_prepared(false), job_graph(nullptr),
+    adaptive_quality(false), jpeg_quality(90), min_jpeg_quality(60), max_jpeg_quality(95),
+    quality_step(2), quality_adjust_every(10), target_frame_kb(400),
+    capture_health_enabled(true), health_cusum_threshold(8.0), health_error_threshold(0.25),
+    health_cooldown_frames(10), camera_restart_idle_seconds(5), camera_alarm_logged(false),
+    slo_target(0.99), slo_deadline_ms(3000), slo_window_slots(60),
+    backlog_enabled(true), backlog_days(7), backlog_max_attempts(3), backlog_max_temp_c(70.0),
+    backlog_margin_minutes(15), backlog_deadline("02:30:00"), plan_enabled(true), frame_index_enabled(true),
+    encoder("ffmpeg"), ffmpeg_command("ffmpeg"), x264_preset("veryfast"), x264_crf(23),
+    deflicker_enabled(false), deflicker_window(15), rate_control("crf"), target_video_mb(50), rate_zone_frames(25),
+    render_mode("normal"), slitscan_depth(50), slitscan_axis("columns"), timeslice_slices(0), timeslice_quality(90),
+    capture_errors(0), last_capture_duration_ms(0), last_capture_success(false),
+    last_capture_epoch(0), last_cloud_cover(-1.0) {
     // 1. Ensure directories exist
     if (!create_dir(LOGS_PATH)) {
          throw std::runtime_error("Failed to create logs directory: " + std::string(LOGS_PATH));
@@ -51,16 +79,36 @@ TimeLapse::TimeLapse() : photo_count(0), capture_errors(0),
         throw std::runtime_error("Failed to load configuration");
     }
 
-    // 3. Load schedule
-    if (!load_today_schedule()) {
+    // 2b. Open the native camera backend, if one is configured
+    open_camera_backend();
+    if (capture_health_enabled) {
+        health.reset(new CaptureHealthMonitor(health_cusum_threshold, health_error_threshold,
+                                              health_cooldown_frames));
+    }
+    slo.reset(new FrameSlo(slo_target, slo_window_slots));
+    if (backlog_enabled) {
+        backlog.reset(new EncodeBacklog(BACKLOG_FILE, backlog_max_attempts));
+    }
+
+    // 3. Load schedule (the job graph does this in its "schedule" job instead,
+    //    generating the schedule first if it is missing)
+    set_filename_prefix();
+    if (!job_graph_enabled && !prepare_day()) {
         throw std::runtime_error("Failed to load schedule");
     }
-    
+}
+
+// Loads today's schedule, creates the output directory and picks up any
+// photos already taken today (e.g. after a reboot mid-capture).
+bool TimeLapse::prepare_day() {
+    if (plan_enabled) {
+        plan_today_schedule();
+    }
+    if (!load_today_schedule()) {
+        return false;
+    }
+
     // 4. Set up output directory
-    auto timestamp = get_timestamp();
-    std::string clean_date = date_str;
-    std::replace(clean_date.begin(), clean_date.end(), '-', '_');
-    
 	output_dir = std::string(PICS_PATH) + filename_prefix + "_pics/";
     if (!create_dir(output_dir)) {
         throw std::runtime_error("Failed to create output directory: " + output_dir);
@@ -72,6 +120,126 @@ TimeLapse::TimeLapse() : photo_count(0), capture_errors(0),
     log_status("  Capture: " + start_time + " to " + end_time);
     log_status("  Interval: " + std::to_string(interval_seconds) + " seconds");
     log_status("  Expected photos: " + std::to_string(expected_photos));
+
+    load_existing_photos();
+    start_quality_controller();
+    if (frame_index_enabled && !photo_files.empty()) {
+        frame_indexer.prime(photo_files.back());
+    }
+    return true;
+}
+
+// Budget for the day = expected_photos x target_frame_kb. Photos already on
+// disk from earlier today count against it.
+void TimeLapse::start_quality_controller() {
+    if (!adaptive_quality) {
+        return;
+    }
+
+    quality.reset(new QualityController(jpeg_quality, min_jpeg_quality, max_jpeg_quality,
+                                        quality_step, quality_adjust_every));
+
+    uint64_t existing_bytes = 0;
+    for (const std::string& file : photo_files) {
+        struct stat st;
+        if (stat(file.c_str(), &st) == 0) {
+            existing_bytes += st.st_size;
+        }
+    }
+    uint64_t budget = static_cast<uint64_t>(expected_photos) * target_frame_kb * 1024;
+    quality->start_day(expected_photos, budget, static_cast<int>(photo_files.size()), existing_bytes);
+
+    if (camera && !camera->set_quality(quality->quality())) {
+        log_status("Warning: camera backend '" + camera->name() + "' can't change JPEG quality - adaptive quality disabled");
+        quality.reset();
+        return;
+    }
+
+    log_status("Adaptive quality: budget " + std::to_string(budget / (1024 * 1024)) + " MB for " +
+               std::to_string(expected_photos) + " photos, starting at quality " +
+               std::to_string(quality->quality()));
+}
+
+// Feeds the size of a new photo to the controller and passes any quality
+// change on to the camera backend (the command backend picks it up from
+// run_capture_command).
+void TimeLapse::update_quality(const std::string& filename) {
+    if (!quality) {
+        return;
+    }
+
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return;
+    }
+
+    int before = quality->quality();
+    if (!quality->record_frame(st.st_size)) {
+        return;
+    }
+
+    log_status("Adaptive quality: " + std::to_string(before) + " -> " + std::to_string(quality->quality()) +
+               " (" + std::to_string(quality->bytes_used() / 1024) + " KB used, " +
+               std::to_string(static_cast<long>(quality->allowance() / 1024)) + " KB/frame left in budget)");
+    if (camera && !camera->set_quality(quality->quality())) {
+        log_status("Warning: camera backend '" + camera->name() + "' rejected JPEG quality " +
+                   std::to_string(quality->quality()) + " - adaptive quality disabled");
+        quality.reset();
+    }
+}
+
+// Adds a new photo to the day's frame index (brightness, size, motion since
+// the previous photo) - the encoder's first pass for rate_control = target_size
+void TimeLapse::index_frame(const std::string& filename) {
+    if (!frame_index_enabled) {
+        return;
+    }
+    StageTimer timer("index");
+    FrameIndexEntry entry;
+    std::string error;
+    if (!frame_indexer.add(filename, last_capture_epoch, entry, error)) {
+        log_status("Frame index: " + error);
+        return;
+    }
+    last_cloud_cover = entry.cloud;
+}
+
+// Rebuilds photo_files from output_dir so a restarted run keeps numbering
+// where it stopped and the encode still sees the earlier frames.
+void TimeLapse::load_existing_photos() {
+    DIR* dir = opendir(output_dir.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > filename_prefix.size() + 4 &&
+            name.compare(0, filename_prefix.size(), filename_prefix) == 0 &&
+            name.compare(name.size() - 4, 4, ".jpg") == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+
+    if (names.empty()) {
+        return;
+    }
+
+    std::sort(names.begin(), names.end());
+    photo_files.clear();
+    for (const std::string& name : names) {
+        photo_files.push_back(output_dir + name);
+        std::string number = name.substr(filename_prefix.size(), name.size() - filename_prefix.size() - 4);
+        try {
+            photo_count = std::max(photo_count, std::stoi(number));
+        } catch (...) {
+        }
+    }
+
+    log_status("Found " + std::to_string(photo_files.size()) + " photos from earlier today, continuing from #" +
+               std::to_string(photo_count + 1));
 }
 
 // Private methods implementations
@@ -84,6 +252,11 @@ std::string TimeLapse::get_timestamp() {
 }
 
 void TimeLapse::log_status(const std::string& message) {
+    // Jobs may log from several threads at once
+    static std::mutex log_mutex;
+    StageTimer timer("log");
+    std::lock_guard<std::mutex> lock(log_mutex);
+
     auto timestamp = get_timestamp();
     
     // Log to STDOUT
@@ -99,16 +272,14 @@ void TimeLapse::log_status(const std::string& message) {
 }
 
 void TimeLapse::write_status_file(const std::string& status) {
+    StageTimer timer("status");
+    std::lock_guard<std::mutex> lock(status_mutex);
+
     auto now = std::chrono::system_clock::now();
     auto epoch = std::chrono::duration_cast<std::chrono::seconds>(
         now.time_since_epoch()).count();
 
-    std::ofstream f(STATUS_FILE);
-    if (!f.is_open()) {
-        log_status("Warning: Could not write status file");
-        return;
-    }
-
+    std::stringstream f;
     f << "{\n"
       << "  \"status\": \"" << status << "\",\n"
       << "  \"device_id\": \"" << device_id << "\",\n"
@@ -122,9 +293,73 @@ void TimeLapse::write_status_file(const std::string& status) {
       << "  \"start_time\": \"" << start_time << "\",\n"
       << "  \"end_time\": \"" << end_time << "\",\n"
       << "  \"interval_seconds\": " << interval_seconds << ",\n"
-      << "  \"updated_at\": " << epoch << "\n"
+      << "  \"cloud_cover\": " << last_cloud_cover << ",\n";
+
+    if (quality) {
+        f << "  \"jpeg_quality\": " << quality->quality() << ",\n"
+          << "  \"bytes_today\": " << quality->bytes_used() << ",\n"
+          << "  \"byte_budget\": " << quality->budget() << ",\n";
+    }
+
+    if (health) {
+        f << "  \"capture_latency_ewma_ms\": " << health->latency_ms() << ",\n"
+          << "  \"capture_latency_baseline_ms\": " << health->baseline_ms() << ",\n"
+          << "  \"capture_latency_cusum\": " << health->cusum() << ",\n"
+          << "  \"capture_error_rate\": " << std::setprecision(3) << health->error_rate() << std::setprecision(1) << ",\n"
+          << "  \"camera_restart_due\": " << (health->restart_due() ? "true" : "false") << ",\n"
+          << "  \"camera_restarts\": " << health->restarts() << ",\n"
+          << "  \"capture_latency_rebaselines\": " << health->rebaselines() << ",\n";
+    }
+
+    if (slo) {
+        f << "  \"slo_target\": " << std::setprecision(4) << slo->target() << ",\n"
+          << "  \"slo_ratio_today\": " << slo->day_ratio() << ",\n"
+          << "  \"slo_burn_rate\": " << std::setprecision(2) << slo->burn_rate() << ",\n"
+          << "  \"slo_budget_remaining\": " << std::setprecision(1) << slo->budget_remaining() << ",\n";
+        for (int scope = 0; scope < 2; scope++) {
+            f << (scope == 0 ? "  \"slo_today\": {" : "  \"slo_window\": {");
+            for (int i = 0; i < SLO_OUTCOMES; i++) {
+                SloOutcome outcome = static_cast<SloOutcome>(i);
+                uint32_t count = scope == 0 ? slo->day_count(outcome) : slo->window_count(outcome);
+                f << (i ? ", " : "") << "\"" << slo_outcome_name(outcome) << "\": " << count;
+            }
+            f << "},\n";
+        }
+    }
+
+    if (backlog) {
+        f << "  \"encode_backlog\": " << backlog->depth() << ",\n"
+          << "  \"encode_backlog_gave_up\": " << backlog->gave_up() << ",\n";
+    }
+
+    std::vector<StageTime> stages = stage_times();
+    if (!stages.empty()) {
+        f << "  \"stages\": {";
+        for (size_t i = 0; i < stages.size(); i++) {
+            f << (i ? ", " : "") << "\"" << stages[i].name << "\": {\"calls\": " << stages[i].calls
+              << ", \"wall_s\": " << std::setprecision(3) << stages[i].wall_seconds
+              << ", \"cpu_s\": " << stages[i].cpu_seconds << std::setprecision(1) << "}";
+        }
+        f << "},\n";
+    }
+
+    if (job_graph != nullptr) {
+        f << "  \"jobs\": {";
+        auto states = job_graph->snapshot();
+        for (size_t i = 0; i < states.size(); i++) {
+            f << (i ? ", " : "") << "\"" << states[i].first << "\": \"" << states[i].second << "\"";
+        }
+        f << "},\n";
+    }
+
+    f << "  \"updated_at\": " << epoch << "\n"
       << "}\n";
-    f.close();
+
+    // Atomic replace - the metrics server may read while we write
+    std::string data = f.str();
+    if (!write_file_atomic(STATUS_FILE, data.data(), data.size())) {
+        log_status("Warning: Could not write status file");
+    }
 }
 
 bool TimeLapse::load_config() {
@@ -152,6 +387,231 @@ bool TimeLapse::load_config() {
                 log_status("Loaded config: capture_command = " + base_capture_command);
             }
 
+            if (key == "capture_backend") {
+                capture_backend = value;
+                log_status("Loaded config: capture_backend = " + capture_backend);
+            }
+
+            if (key == "v4l2_device") {
+                v4l2_device = value;
+            }
+
+            if (key == "snapshot_url") {
+                snapshot_url = value;
+            }
+
+            if (key == "network_timeout_ms") {
+                network_timeout_ms = std::stoi(value);
+            }
+
+            if (key == "job_graph_enabled") {
+                job_graph_enabled = (value == "true");
+                log_status("Loaded config: job_graph_enabled = " + value);
+            }
+
+            if (key == "max_concurrent_jobs") {
+                max_concurrent_jobs = std::stoi(value);
+            }
+
+            if (key == "job_retries") {
+                job_retries = std::stoi(value);
+            }
+
+            if (key == "job_retry_delay_seconds") {
+                job_retry_delay_seconds = std::stoi(value);
+            }
+
+            if (key == "scheduler_command") {
+                scheduler_command = value;
+            }
+
+            if (key == "adaptive_quality") {
+                adaptive_quality = (value == "true");
+                log_status("Loaded config: adaptive_quality = " + value);
+            }
+
+            if (key == "jpeg_quality") {
+                jpeg_quality = std::stoi(value);
+            }
+
+            if (key == "min_jpeg_quality") {
+                min_jpeg_quality = std::stoi(value);
+            }
+
+            if (key == "max_jpeg_quality") {
+                max_jpeg_quality = std::stoi(value);
+            }
+
+            if (key == "quality_step") {
+                quality_step = std::stoi(value);
+            }
+
+            if (key == "quality_adjust_every") {
+                quality_adjust_every = std::stoi(value);
+            }
+
+            if (key == "capture_health") {
+                capture_health_enabled = (value == "true");
+            }
+
+            if (key == "health_cusum_threshold") {
+                health_cusum_threshold = std::stod(value);
+            }
+
+            if (key == "health_error_threshold") {
+                health_error_threshold = std::stod(value);
+            }
+
+            if (key == "health_cooldown_frames") {
+                health_cooldown_frames = std::stoi(value);
+            }
+
+            if (key == "camera_restart_idle_seconds") {
+                camera_restart_idle_seconds = std::stoi(value);
+            }
+
+            if (key == "camera_restart_command") {
+                camera_restart_command = value;
+            }
+
+            if (key == "slo_target") {
+                slo_target = std::stod(value);
+            }
+
+            if (key == "slo_deadline_ms") {
+                slo_deadline_ms = std::stoi(value);
+            }
+
+            if (key == "slo_window_slots") {
+                slo_window_slots = std::stoi(value);
+            }
+
+            if (key == "backlog_enabled") {
+                backlog_enabled = (value == "true");
+            }
+
+            if (key == "backlog_days") {
+                backlog_days = std::stoi(value);
+            }
+
+            if (key == "backlog_max_attempts") {
+                backlog_max_attempts = std::stoi(value);
+            }
+
+            if (key == "backlog_max_temp_c") {
+                backlog_max_temp_c = std::stod(value);
+            }
+
+            if (key == "backlog_margin_minutes") {
+                backlog_margin_minutes = std::stoi(value);
+            }
+
+            if (key == "backlog_deadline") {
+                backlog_deadline = value;
+            }
+
+            if (key == "plan_enabled") {
+                plan_enabled = (value == "true");
+            }
+
+            if (key == "target_frame_kb") {
+                target_frame_kb = std::stoi(value);
+            }
+
+            if (key == "encoder") {
+                encoder = value;
+                log_status("Loaded config: encoder = " + encoder);
+            }
+
+            if (key == "ffmpeg_command") {
+                ffmpeg_command = value;
+            }
+
+            if (key == "x264_preset") {
+                x264_preset = value;
+            }
+
+            if (key == "x264_crf") {
+                x264_crf = std::stoi(value);
+            }
+
+            if (key == "deflicker") {
+                deflicker_enabled = (value == "true");
+            }
+
+            if (key == "deflicker_window") {
+                deflicker_window = std::stoi(value);
+            }
+
+            if (key == "rate_control") {
+                rate_control = value;
+                log_status("Loaded config: rate_control = " + rate_control);
+            }
+
+            if (key == "target_video_mb") {
+                target_video_mb = std::stod(value);
+            }
+
+            if (key == "rate_zone_frames") {
+                rate_zone_frames = std::stoi(value);
+            }
+
+            if (key == "render_mode") {
+                render_mode = value;
+                log_status("Loaded config: render_mode = " + render_mode);
+            }
+
+            if (key == "slitscan_depth") {
+                slitscan_depth = std::stoi(value);
+            }
+
+            if (key == "slitscan_axis") {
+                slitscan_axis = value;
+            }
+
+            if (key == "timeslice_slices") {
+                timeslice_slices = std::stoi(value);
+            }
+
+            if (key == "timeslice_quality") {
+                timeslice_quality = std::stoi(value);
+            }
+
+            if (key == "frame_index") {
+                frame_index_enabled = (value == "true");
+            }
+
+            if (key == "frame_index_colour") {
+                frame_indexer.set_colour(value == "true");
+            }
+            if (key == "sky_region") {
+                if (!parse_sky_region(value, sky_region)) {
+                    log_status("Ignoring sky_region = " + value + " (want left,top,right,bottom fractions)");
+                }
+                frame_indexer.set_sky_region(sky_region);
+            }
+
+            if (key == "cloud_ratio") {
+                sky_region.cloud_ratio = std::stod(value);
+                frame_indexer.set_sky_region(sky_region);
+            }
+
+            if (key == "recompress_enabled") {
+                recompress_enabled = (value == "true");
+            }
+
+            if (key == "parity_shards") {
+                parity_shards = std::stoi(value);
+            }
+
+            if (key == "resolution_width") {
+                resolution_width = std::stoi(value);
+            }
+
+            if (key == "resolution_height") {
+                resolution_height = std::stoi(value);
+            }
+
 			if (key == "id") {
 				device_id = value;
 				log_status("Loaded config: device_id = " + device_id);
@@ -160,7 +620,7 @@ bool TimeLapse::load_config() {
     }
     
     // Final check to ensure the command was actually loaded
-    if (base_capture_command.empty()) {
+    if (capture_backend == "command" && base_capture_command.empty()) {
         log_status("ERROR: 'capture_command' not found in config file.");
         return false;
     }
@@ -168,7 +628,76 @@ bool TimeLapse::load_config() {
     return true;
 }
 
-bool TimeLapse::load_today_schedule() {
+// Creates the backend named by capture_backend. A backend that fails to open
+// is kept and retried on each capture (e.g. webcam not plugged in yet).
+void TimeLapse::open_camera_backend() {
+    if (capture_backend == "command") {
+        return;
+    }
+
+    if (capture_backend == "v4l2") {
+        if (v4l2_device.empty()) {
+            v4l2_device = "/dev/video0";
+        }
+        camera.reset(new V4L2Camera(v4l2_device, resolution_width, resolution_height));
+    } else if (capture_backend == "http") {
+        if (snapshot_url.empty()) {
+            throw std::runtime_error("capture_backend = http needs snapshot_url in the config");
+        }
+        camera.reset(new NetworkCamera(snapshot_url, network_timeout_ms));
+    } else {
+        throw std::runtime_error("Unknown capture_backend: " + capture_backend);
+    }
+
+    if (camera->open()) {
+        log_status("Camera backend '" + camera->name() + "' opened");
+    } else {
+        log_status("Warning: camera backend '" + camera->name() + "' failed to open, will retry on each capture");
+    }
+}
+
+// Restarts the camera session when the health monitor asks for it. Native
+// backends are closed and reopened; the command backend starts a fresh
+// process per photo anyway, so it runs camera_restart_command if one is set
+// (e.g. reloading the camera driver). Without one there is nothing to
+// restart: the alarm is logged once and stays raised (camera_restart_due)
+// until the captures recover.
+void TimeLapse::restart_camera() {
+    const bool can_restart = camera || !camera_restart_command.empty();
+    if (!can_restart && camera_alarm_logged) {
+        return;
+    }
+
+    std::stringstream msg;
+    msg << "Capture health: " << (can_restart ? "restarting camera" : "camera degrading") << " ("
+        << health->reason() << ": latency " << std::fixed << std::setprecision(0) << health->latency_ms()
+        << " ms vs " << health->baseline_ms() << " ms baseline, error rate " << std::setprecision(2)
+        << health->error_rate() << ")";
+    if (!can_restart) {
+        msg << ", no camera_restart_command set, nothing to restart";
+        log_status(msg.str());
+        camera_alarm_logged = true;
+        return;
+    }
+    log_status(msg.str());
+
+    StageTimer timer("camera_restart");
+    if (camera) {
+        camera->close();
+        if (!camera->open()) {
+            log_status("Warning: camera backend '" + camera->name() + "' failed to reopen, will retry on each capture");
+        }
+    } else {
+        int result = std::system(camera_restart_command.c_str());
+        if (result != 0) {
+            log_status("Warning: camera_restart_command exited with " + std::to_string(result));
+        }
+    }
+    health->restarted();
+}
+
+// Today's file prefix, e.g. 20251114_Pi0Cam
+void TimeLapse::set_filename_prefix() {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto tm = *std::localtime(&time_t);
@@ -179,6 +708,39 @@ bool TimeLapse::load_today_schedule() {
 
 	filename_prefix = prefix_ss.str();
 
+    std::stringstream iso_ss;
+    iso_ss << std::put_time(&tm, "%Y-%m-%d");
+    today_iso = iso_ss.str();
+}
+
+// Re-solves today's interval against the capture latency and encode speed
+// of past days (see schedule_plan.hpp). A schedule is planned once: after
+// that, or once photos exist, its slots stay where they are.
+void TimeLapse::plan_today_schedule() {
+    std::string path = std::string(SCHEDULES_PATH) + filename_prefix + "_schedule.txt";
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return; // load_today_schedule reports it
+    }
+    if (!list_frames(std::string(PICS_PATH) + filename_prefix + "_pics/").empty()) {
+        return;
+    }
+
+    PlanOptions options = plan_options_from_config(read_config(CONFIG_FILE));
+    PlanTelemetry telemetry =
+        load_plan_telemetry(CAPTURE_LATENCY_FILE, STAGE_TIMES_FILE, options.history_days, today_iso);
+    std::vector<std::string> report;
+    std::string error;
+    if (!plan_schedule_file(path, options, telemetry, false, false, report, error)) {
+        log_status("Warning: could not plan the schedule: " + error);
+        return;
+    }
+    for (const std::string& line : report) {
+        log_status(line);
+    }
+}
+
+bool TimeLapse::load_today_schedule() {
 	schedule_filename = filename_prefix + "_schedule.txt";
 	// todo convert to json to make easier importing?
 	video_filename = std::string(VIDEOS_PATH) + filename_prefix + "_timelapse.mp4";
@@ -260,7 +822,45 @@ bool TimeLapse::is_time_to_stop() {
     return current_total_sec >= end_total_sec;
 }
 
+// Runs capture_command with "-o <filename>" appended. Returns true on exit code 0.
+bool TimeLapse::run_capture_command(const std::string& filename) {
+    StageTimer timer("capture_spawn");
+    // --- COMMAND ASSEMBLY ---
+    std::string capture_command = base_capture_command;
+    if (quality) {
+        capture_command += " --quality " + std::to_string(quality->quality());
+    }
+    capture_command += " -o ";
+    capture_command += filename; 
+    
+    // 3. Execute the command
+    int result = std::system(capture_command.c_str());
+    
+    // --- ERROR CHECKING ---
+
+    // 1. Check if the shell failed to execute the command itself.
+    if (result == -1) {
+        log_status("FATAL ERROR: Failed to execute shell command (system() returned -1). Command: " + capture_command);
+        return false;
+    }
+
+    // 2. Check if the command (libcamera-still) executed but returned an error code.
+    // WEXITSTATUS requires <sys/wait.h>
+    int exit_code = WEXITSTATUS(result);
+
+    if (exit_code != 0) {
+        // Log the failure with the specific exit code.
+        std::string error_msg = "COMMAND ERROR: Capture failed. Command exit code: " + std::to_string(exit_code) + ". Command: " + capture_command;
+        log_status(error_msg);
+        return false;
+    }
+
+    return true;
+}
+
 bool TimeLapse::capture_photo() {
+    HeapStage heap_stage("capture");
+    StageTimer capture_timer("capture");
     photo_count++;
     
     // Cleanup date string (e.g., 2025-11-14 -> 20251114)
@@ -288,37 +888,21 @@ bool TimeLapse::capture_photo() {
 	// 	<< ".jpg";
     // std::string filename = ss.str();
     
-    // --- COMMAND ASSEMBLY ---
-    std::string capture_command = base_capture_command;
-    capture_command += " -o ";
-    capture_command += filename; 
-    
     if (photo_count % 10 == 1 || photo_count == 1) { 
         log_status("Capturing photo " + std::to_string(photo_count) + "/" + 
                   std::to_string(expected_photos) + " -> " + filename);
     }
-    
-    // 3. Execute the command
-    int result = std::system(capture_command.c_str());
-    
-    // --- ERROR CHECKING ---
-
-    // 1. Check if the shell failed to execute the command itself.
-    if (result == -1) {
-        log_status("FATAL ERROR: Failed to execute shell command (system() returned -1). Command: " + capture_command);
-        capture_errors++;
-        last_capture_success = false;
-        return false;
-    }
 
-    // 2. Check if the command (libcamera-still) executed but returned an error code.
-    // WEXITSTATUS requires <sys/wait.h>
-    int exit_code = WEXITSTATUS(result);
-
-    if (exit_code != 0) {
-        // Log the failure with the specific exit code.
-        std::string error_msg = "COMMAND ERROR: Capture failed. Command exit code: " + std::to_string(exit_code) + ". Command: " + capture_command;
-        log_status(error_msg);
+    // Native backend: the camera session is already open, just grab a frame
+    if (camera) {
+        std::string error;
+        if (!camera->capture(filename, error)) {
+            log_status("CAPTURE ERROR (" + camera->name() + "): " + error);
+            capture_errors++;
+            last_capture_success = false;
+            return false;
+        }
+    } else if (!run_capture_command(filename)) {
         capture_errors++;
         last_capture_success = false;
         return false;
@@ -330,6 +914,8 @@ bool TimeLapse::capture_photo() {
     last_capture_epoch = std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
     photo_files.push_back(filename);
+    update_quality(filename);
+    index_frame(filename);
     
     // Log success only if we didn't log the "Capturing" message earlier
     if (photo_count % 10 != 1 && photo_count != 1) {
@@ -339,123 +925,620 @@ bool TimeLapse::capture_photo() {
     return true;
 }
 
-// --- Video Creation Logic (Uses OpenCV) ---
-void TimeLapse::create_video() {
+// --- Video Creation Logic ---
+// Today's video. A failure leaves the day in the encode backlog, which
+// retries it when the camera is idle.
+bool TimeLapse::create_video() {
     if (photo_files.empty()) {
         log_status("No photos to create video from! Skipping.");
-        return;
+        return false;
+    }
+    bool stopped = false;
+    bool ok = encode_video(photo_files, output_dir, video_filename, 0, stopped);
+    if (backlog) {
+        backlog->record(filename_prefix, static_cast<int>(photo_files.size()), ok, std::time(nullptr));
     }
+    return ok;
+}
 
-    log_status("Creating video from " + std::to_string(photo_files.size()) + " photos using OpenCV...");
+// Encodes frames (from frames_dir) into video_path. Frames are decoded
+// straight to YUV planes and filtered there. The "ffmpeg" encoder (the
+// default) takes those planes as they are. The "opencv" encoder, also the
+// fallback when ffmpeg isn't installed, needs BGR: without filters, frames
+// are decoded straight to BGR as cv::imread did; with them, the filtered
+// planes are converted just before the write. The video is written as
+// <name>.part.mp4 and renamed when complete, so a failed or interrupted
+// encode never leaves a video that looks finished. deadline_epoch > 0 makes
+// it a background encode: it pauses while the CPU is too hot and stops
+// (stopped = true) at the deadline.
+bool TimeLapse::encode_video(const std::vector<std::string>& frames, const std::string& frames_dir,
+                             const std::string& video_path, long deadline_epoch, bool& stopped) {
+    stopped = false;
+    std::string part_path = video_path;
+    if (part_path.size() > 4 && part_path.compare(part_path.size() - 4, 4, ".mp4") == 0) {
+        part_path.resize(part_path.size() - 4);
+    }
+    part_path += ".part.mp4";
+
+    bool use_ffmpeg = encoder == "ffmpeg";
+    if (use_ffmpeg && !ffmpeg_available(ffmpeg_command)) {
+        log_status("Warning: " + ffmpeg_command + " not found - falling back to the OpenCV encoder");
+        use_ffmpeg = false;
+    }
+
+    log_status("Creating video from " + std::to_string(frames.size()) + " photos using " +
+               (use_ffmpeg ? "ffmpeg (YUV pipe)" : "OpenCV") + "...");
     
-    // 1. Read the first image to determine frame size
-    cv::Mat first_image = cv::imread(photo_files[0]);
-    if (first_image.empty()) {
-        log_status("Error reading first image! Cannot determine frame size. Check photo integrity.");
-        return;
+    // 1. Decode the first image to determine frame size
+    HeapStage video_stage("video_setup");
+    StageTimer video_timer("video_setup");
+    YuvFrame frame;
+    std::string error;
+    if (!decode_jpeg_yuv420(frames[0], frame, error)) {
+        log_status("Error reading first image! Cannot determine frame size. Check photo integrity. (" + error + ")");
+        return false;
     }
 
     int fps = 25; // Frame rate for the final video (25 frames per second)
-    cv::Size frame_size(first_image.cols, first_image.rows);
+    const int width = frame.width;
+    const int height = frame.height;
 
 	// --- Start Timing for Video Compilation ---
     auto start_time = std::chrono::high_resolution_clock::now();
-    
-	// Clean the date string
-	// std::string clean_date = date_str;
-    // clean_date.erase(std::remove(clean_date.begin(), clean_date.end(), '-'), clean_date.end());
-
-    // Output file name
-	// std::string video_filename = std::string(VIDEOS_PATH)
-	// 								+ clean_date
-	// 								+ "_"
-	// 								+ device_id
-	// 								+ "_timelapse_.mp4";
 
     // 2. Initialize the video writer
-    // FOURCC 'mp4v' for MP4 container (ensure OpenCV is built with FFMPEG support)
-    cv::VideoWriter video_writer(video_filename,
-                                 cv::VideoWriter::fourcc('m','p','4','v'), 
-                                 fps, frame_size);
-    
-    if (!video_writer.isOpened()) {
-        log_status("Error creating cv::VideoWriter! Check dependencies (FFMPEG) and permissions.");
-        return;
+    YuvVideoWriter yuv_writer;
+    cv::VideoWriter video_writer;
+    cv::Mat bgr;
+
+    std::unique_ptr<SlitScanRenderer> slit_scan;
+    if (render_mode == "slitscan") {
+        slit_scan.reset(new SlitScanRenderer(slitscan_depth, slitscan_axis == "rows" ? SLIT_ROWS : SLIT_COLUMNS));
+        log_status("Slit-scan render: " + std::to_string(slitscan_depth) + " frames deep across the " + slitscan_axis +
+                   " (ring of " + std::to_string(static_cast<size_t>(width) * height * 3 / 2 * slitscan_depth / (1024 * 1024)) +
+                   " MB)");
+    }
+
+    if (rate_control == "target_size") {
+        if (!use_ffmpeg) {
+            log_status("Warning: rate_control = target_size needs encoder = ffmpeg - using the OpenCV encoder's defaults");
+        } else {
+            std::vector<FrameIndexEntry> index;
+            read_frame_index(frames_dir, index);
+            // A slit-scan video has depth - 1 fewer frames than the day, and
+            // output k spans inputs k..k+depth-1: plan each output frame on
+            // the middle input of its span, so zones count output frames
+            std::vector<std::string> planned = frames;
+            if (slit_scan) {
+                const size_t depth = slit_scan->depth_for(width, height);
+                planned.clear();
+                for (size_t k = 0; k + depth <= frames.size(); k++) {
+                    planned.push_back(frames[k + (depth - 1) / 2]);
+                }
+            }
+            RatePlan plan = plan_rate(planned, index, fps, target_video_mb, rate_zone_frames);
+            yuv_writer.set_rate_plan(plan.bitrate_kbps, plan.zones);
+
+            char range[64];
+            snprintf(range, sizeof(range), "%.2f-%.2f", plan.min_multiplier, plan.max_multiplier);
+            log_status("Rate plan: " + std::to_string(plan.bitrate_kbps) + " kb/s for " +
+                       std::to_string(target_video_mb) + " MB, " + std::to_string(plan.zone_count) +
+                       " zones (bitrate x" + range + "), " + std::to_string(plan.indexed_frames) + "/" +
+                       std::to_string(planned.size()) + " frames indexed");
+        }
     }
 
+    if (use_ffmpeg) {
+        if (!yuv_writer.open(part_path, width, height, fps, ffmpeg_command, x264_preset, x264_crf, error)) {
+            log_status("Error starting ffmpeg encoder: " + error);
+            return false;
+        }
+    } else {
+        // FOURCC 'mp4v' for MP4 container (ensure OpenCV is built with FFMPEG support)
+        video_writer.open(part_path, cv::VideoWriter::fourcc('m','p','4','v'),
+                          fps, cv::Size(width, height));
+        if (!video_writer.isOpened()) {
+            log_status("Error creating cv::VideoWriter! Check dependencies (FFMPEG) and permissions.");
+            return false;
+        }
+        bgr.create(height, width, CV_8UC3);
+    }
+
+    // Without a filter, the OpenCV encoder gets its BGR straight from
+    // libjpeg-turbo (SIMD conversion, smooth chroma) as cv::imread gave it
+    const bool decode_bgr = !use_ffmpeg && !deflicker_enabled && !slit_scan;
+    DeflickerFilter deflicker(deflicker_window);
+    bool write_failed = false;
+    int skipped = 0;
+    int written = 0;
+
     // 3. Loop through all captured images and write them as frames
-    for (size_t i = 0; i < photo_files.size(); i++) {
-		cv::Mat image = cv::imread(photo_files[i]);
-        if (!image.empty()) {
-			video_writer.write(image);
-            if (i % 100 == 0 && i != 0) {
-				std::string cpu_temp = get_cpu_temp();
-				log_status("Video progress: " + std::to_string(i) + "/" + std::to_string(photo_files.size()) + "   ||   CPU: " + cpu_temp);
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (deadline_epoch > 0 && i % 20 == 0 && !backlog_may_continue(deadline_epoch)) {
+            stopped = true;
+            break;
+        }
+
+        HeapStage decode_stage("decode");
+        StageTimer decode_timer("decode");
+        const YuvFrame* out = &frame;
+        if (decode_bgr) {
+            if (!decode_jpeg_bgr(frames[i], width, height, bgr.data, error)) {
+                log_status("Skipping unreadable frame: " + error);
+                skipped++;
+                continue;
+            }
+        } else {
+            if (i > 0 && !decode_jpeg_yuv420(frames[i], frame, error)) {
+                log_status("Skipping unreadable frame: " + error);
+                skipped++;
+                continue;
+            }
+            if (frame.width != width || frame.height != height) {
+                log_status("Skipping frame with different size: " + frames[i]);
+                skipped++;
+                continue;
             }
+
+            HeapStage filter_stage("filter");
+            StageTimer filter_timer("filter");
+            if (deflicker_enabled) {
+                deflicker.apply(frame);
+            }
+            if (slit_scan) {
+                if (!slit_scan->push(frame)) {
+                    continue; // the ring isn't full yet
+                }
+                out = &slit_scan->output();
+            }
+        }
+
+        HeapStage encode_stage("encode");
+        StageTimer encode_timer("encode");
+        if (use_ffmpeg) {
+            if (!yuv_writer.write(*out)) {
+                log_status("Error: ffmpeg stopped accepting frames at " + std::to_string(i));
+                write_failed = true;
+                break;
+            }
+        } else {
+            if (!decode_bgr) {
+                yuv420_to_bgr(*out, bgr.data);
+            }
+            video_writer.write(bgr);
+        }
+        written++;
+
+        if (i % 100 == 0 && i != 0) {
+            std::string cpu_temp = get_cpu_temp();
+            log_status("Video progress: " + std::to_string(i) + "/" + std::to_string(frames.size()) + "   ||   CPU: " + cpu_temp);
         }
     }
     
     // 4. Release the writer to finalize the video file
-    video_writer.release();
+    HeapStage finish_stage("encode");
+    StageTimer finish_timer("encode");
+    bool ok = !write_failed;
+    if (use_ffmpeg) {
+        // Close even after a failed write, so ffmpeg is reaped
+        if (!yuv_writer.close()) {
+            ok = false;
+            log_status("Error: ffmpeg failed to finish " + part_path);
+        }
+    } else {
+        video_writer.release();
+    }
+    if (stopped || !ok) {
+        std::remove(part_path.c_str());
+        if (stopped) {
+            log_status("Stopped encoding " + video_path + " at the backlog deadline");
+        }
+        return false;
+    }
+    if (std::rename(part_path.c_str(), video_path.c_str()) != 0) {
+        log_status("Error: could not rename " + part_path + " to " + video_path + ": " + strerror(errno));
+        std::remove(part_path.c_str());
+        return false;
+    }
 
 	// --- Stop Timing and Calculate Duration ---
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed_time = end_time - start_time;
-    
-    double actual_video_length = (double)photo_files.size() / fps;
-    log_status("Video saved as " + video_filename);
+
+    if (skipped > 0) {
+        log_status("Skipped " + std::to_string(skipped) + " frames");
+    }
+    double actual_video_length = (double)written / fps;
+    if (backlog && written > 0) {
+        backlog->record_rate(elapsed_time.count() / written);
+    }
+    log_status("Video saved as " + video_path);
     log_status("Actual video length: " + std::to_string(actual_video_length) + " seconds");
 	log_status("Video compilation finished! Time to encode: " + format_duration(elapsed_time.count()));
+    return ok;
 }
 
-// Public methods implementation
-void TimeLapse::run() {
+// Background encodes give way to heat: waits while the CPU is at or above
+// backlog_max_temp_c (until it is 5 degrees cooler). False once the
+// deadline has passed.
+bool TimeLapse::backlog_may_continue(long deadline_epoch) {
+    bool paused = false;
+    while (std::time(nullptr) < deadline_epoch) {
+        double temp = cpu_temp_celsius();
+        if (temp < 0 || temp < backlog_max_temp_c - (paused ? 5.0 : 0.0)) {
+            if (paused) {
+                log_status("Backlog: CPU cooled to " + get_cpu_temp() + ", resuming");
+            }
+            return true;
+        }
+        if (!paused) {
+            log_status("Backlog: CPU at " + get_cpu_temp() + ", pausing until it cools");
+            paused = true;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(30));
+    }
+    return false;
+}
+
+// Next time it is backlog_deadline (the end of the overnight window)
+long TimeLapse::backlog_deadline_epoch() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm = *std::localtime(&now);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    long deadline = static_cast<long>(std::mktime(&tm)) + time_to_seconds(backlog_deadline);
+    return deadline > now ? deadline : deadline + 86400;
+}
+
+// Encodes backlog days (today's first, then the oldest) until
+// deadline_epoch. A day that can't finish in time at the measured encode
+// speed is left for the next idle window. Each video made is then backed up
+// and uploaded like the day's own.
+void TimeLapse::drain_backlog(long deadline_epoch, const std::string& skip_prefix) {
+    if (!backlog) {
+        return;
+    }
+    backlog->refresh(PICS_PATH, VIDEOS_PATH, backlog_days, skip_prefix);
+
+    BacklogEntry entry;
+    while (backlog->next(std::time(nullptr), filename_prefix, entry)) {
+        long needed = static_cast<long>(backlog->seconds_per_frame() * entry.frames);
+        if (std::time(nullptr) + needed >= deadline_epoch) {
+            log_status("Backlog: not enough time left for " + entry.prefix + " (~" + std::to_string(needed / 60) +
+                       " min), leaving it for the next idle window");
+            break;
+        }
+        if (!backlog_may_continue(deadline_epoch)) {
+            break;
+        }
+
+        std::string dir = std::string(PICS_PATH) + entry.prefix + "_pics/";
+        std::vector<std::string> frames;
+        for (const std::string& name : list_dir(dir)) {
+            if (name.compare(0, entry.prefix.size(), entry.prefix) == 0 && name.size() > entry.prefix.size() + 4 &&
+                name.compare(name.size() - 4, 4, ".jpg") == 0) {
+                frames.push_back(dir + name);
+            }
+        }
+        log_status("Backlog: encoding " + entry.prefix + " (" + std::to_string(frames.size()) + " frames, attempt " +
+                   std::to_string(entry.attempts + 1) + "/" + std::to_string(backlog_max_attempts) + ")");
+        write_status_file("creating_video");
+
+        bool stopped = false;
+        bool ok = !frames.empty() &&
+                  encode_video(frames, dir, std::string(VIDEOS_PATH) + entry.prefix + "_timelapse.mp4",
+                               deadline_epoch, stopped);
+        if (stopped) {
+            write_status_file("finished");
+            break; // not the day's fault: no attempt counted
+        }
+        backlog->record(entry.prefix, static_cast<int>(frames.size()), ok, std::time(nullptr));
+        write_status_file("finished");
+        if (!ok) {
+            log_status("Backlog: encoding " + entry.prefix + " failed");
+            continue;
+        }
+
+        std::string date = entry.prefix.substr(0, 4) + "-" + entry.prefix.substr(4, 2) + "-" +
+                           entry.prefix.substr(6, 2);
+        for (const char* step : { "backup", "upload" }) {
+            std::string command = "python3 ./programs/manager.py --step " + std::string(step) + " " + date;
+            int result = std::system(command.c_str());
+            if (result == -1 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+                log_status("Backlog: '" + command + "' failed");
+            }
+        }
+    }
+
+    if (backlog->depth() > 0 || backlog->gave_up() > 0) {
+        log_status("Backlog: " + std::to_string(backlog->depth()) + " days still without a video, " +
+                   std::to_string(backlog->gave_up()) + " given up after " + std::to_string(backlog_max_attempts) +
+                   " attempts (see " + BACKLOG_FILE + ")");
+    }
+}
+
+// Daily time-slice still next to the video (see timeslice.hpp)
+void TimeLapse::create_timeslice() {
+    if (timeslice_slices <= 0 || photo_files.empty()) {
+        return;
+    }
+    HeapStage timeslice_stage("timeslice");
+    StageTimer timeslice_timer("timeslice");
+    std::string output = std::string(VIDEOS_PATH) + filename_prefix + "_timeslice.jpg";
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    if (!build_timeslice(output_dir, photo_files, timeslice_slices, timeslice_quality, output, error)) {
+        log_status("Warning: time-slice image failed: " + error);
+        return;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    log_status("Time-slice image saved as " + output + " (" + std::to_string(timeslice_slices) + " slices, " +
+               format_duration(elapsed.count()) + ")");
+}
+
+// Epoch of today's start_time; capture slot k is due interval_seconds x k later
+long TimeLapse::start_epoch() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm = *std::localtime(&now);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return static_cast<long>(std::mktime(&tm)) + time_to_seconds(start_time);
+}
+
+// Waits for the start time, then captures until the end time.
+// Captures are anchored to slots (start_time + k x interval) rather than
+// sleeping "interval minus capture time", so the rhythm doesn't drift and
+// every slot can be scored against the frames-on-time SLO.
+void TimeLapse::capture_day() {
+    using std::chrono::system_clock;
+    const long first_epoch = start_epoch();
+    const long interval_ms = interval_seconds * 1000L;
+    auto slot_due = [&](long slot) {
+        return system_clock::from_time_t(first_epoch) + std::chrono::seconds(slot * interval_seconds);
+    };
+    auto ms_since = [&](long slot) {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            system_clock::now() - slot_due(slot)).count());
+    };
+
+    // Idle until the capture window: catch up on old videos first
+    drain_backlog(first_epoch - backlog_margin_minutes * 60L, filename_prefix);
+
     log_status("Waiting for start time: " + start_time);
     write_status_file("waiting");
 
     // Wait until start time
-    while (!is_time_to_start()) {
-        std::this_thread::sleep_for(std::chrono::seconds(30));
+    if (ms_since(0) < 0) {
+        std::this_thread::sleep_until(slot_due(0));
+    }
+
+    // First slot that can still be captured on time. Slots before it were
+    // missed unless photos from an earlier run cover them.
+    long slot = std::max(0L, (ms_since(0) - slo_deadline_ms + interval_ms - 1) / interval_ms);
+    if (slo) {
+        slo->start_day(expected_photos);
+        long covered = std::min(slot, static_cast<long>(photo_files.size()));
+        slo->record(SLO_ON_TIME, static_cast<int>(covered));
+        slo->record(SLO_MISSED, static_cast<int>(slot - covered));
     }
 
     log_status("Starting automated timelapse capture!");
     write_status_file("capturing");
     
     // Capture loop
-    while (!is_time_to_stop()) {
+    while (true) {
+        std::this_thread::sleep_until(slot_due(slot));
+        if (is_time_to_stop()) {
+            break;
+        }
     
 		// record start time
 		auto capture_start = std::chrono::steady_clock::now();
     
-		if (!capture_photo()) {
+		bool captured = capture_photo();
+		if (!captured) {
 			log_status("Failed to capture photo, continuing...");
 		}
 
     // record end time
 	    auto capture_end = std::chrono::steady_clock::now();
-	// calc diff
-	    auto capture_duration = std::chrono::duration_cast<std::chrono::seconds>(capture_end - capture_start);
 	    last_capture_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(capture_end - capture_start).count();
+	    if (health) {
+	        health->record(last_capture_duration_ms, captured);
+	    }
+	    if (captured) {
+	        capture_latencies_ms.push_back(static_cast<float>(last_capture_duration_ms));
+	    }
+
+	    // Score the slot, then move to the next one. Slots whose whole
+	    // interval went by during this capture are missed.
+	    long late_ms = ms_since(slot);
+	    long next = std::max(slot + 1, late_ms / interval_ms + slot);
+	    if (slo) {
+	        SloOutcome outcome = SLO_MISSED;
+	        if (captured) {
+	            StageTimer validate_timer("validate");
+	            outcome = !jpeg_file_complete(photo_files.back()) ? SLO_INVALID
+	                    : late_ms <= slo_deadline_ms             ? SLO_ON_TIME
+	                                                             : SLO_LATE;
+	        }
+	        slo->record(outcome);
+	        slo->record(SLO_MISSED, static_cast<int>(next - slot - 1));
+	    }
+	    if (next > slot + 1) {
+	        log_status("Warning: Capture took longer than interval! Skipped " + std::to_string(next - slot - 1) +
+	                   " slot(s)");
+	    }
+	    slot = next;
 
 	    // Update status file for metrics scraping
 	    write_status_file("capturing");
-    
-    // Sleep for the remaining time to maintain the interval
-		auto sleep_time = interval_seconds - capture_duration.count();
-		if (sleep_time > 0) {
-			std::this_thread::sleep_for(std::chrono::seconds(sleep_time));
-		} else {
-			log_status("Warning: Capture took longer than interval!");
-		}
+
+	    // Restart a degrading camera between frames, never when that would
+	    // delay the next one
+	    if (health && !health->restart_due()) {
+	        camera_alarm_logged = false;
+	    } else if (health && -ms_since(slot) >= camera_restart_idle_seconds * 1000L) {
+	        restart_camera();
+	    }
 	}
     
     log_status("Scheduled capture complete! Captured " + std::to_string(photo_count) + " photos.");
     log_status("Expected: " + std::to_string(expected_photos) + " photos");
 
+    std::string error;
+    if (!append_capture_latency(CAPTURE_LATENCY_FILE, capture_latencies_ms, error)) {
+        log_status("Warning: " + error);
+    }
+}
+
+// Runs the whole day as a job graph: each step starts as soon as the one
+// before it finishes (backup right after the encode, not at the next cron slot).
+bool TimeLapse::run_job_graph() {
+    std::string state_file = std::string(LOGS_PATH) + filename_prefix + "_jobs.state";
+    JobGraph graph(state_file, max_concurrent_jobs, [this](const std::string& message) {
+        log_status(message);
+    });
+
+    // A state file can say "schedule: done" from before a restart, so load it
+    // up front; the schedule job only runs the scheduler when it's missing.
+    day_prepared = prepare_day();
+
+    graph.add_job("schedule", {}, [this]() {
+        if (day_prepared) {
+            return true;
+        }
+        log_status("No schedule for today yet, running: " + scheduler_command);
+        int result = std::system(scheduler_command.c_str());
+        if (result == -1 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+            int code = (result != -1 && WIFEXITED(result)) ? WEXITSTATUS(result) : -1;
+            log_status("Job 'schedule' command failed with exit code " + std::to_string(code));
+            return false;
+        }
+        day_prepared = prepare_day();
+        return day_prepared;
+    }, job_retries, 120);
+
+    graph.add_job("capture", {"schedule"}, [this]() {
+        if (!day_prepared) {
+            return false;
+        }
+        capture_day();
+        return true;
+    });
+
+    graph.add_job("encode", {"capture"}, [this]() {
+        if (!day_prepared) {
+            return false;
+        }
+        write_status_file("creating_video");
+        bool ok = create_video();
+        write_status_file("finished");
+        return ok;
+    }, 2, 60);
+
+    // Time-slice still, alongside the encode (recompress replaces frames
+    // atomically, so it can't tear one being read). Best effort: a failure
+    // is logged and never holds up the backup.
+    if (timeslice_slices > 0) {
+        graph.add_job("timeslice", {"capture"}, [this]() {
+            if (day_prepared) {
+                create_timeslice();
+            }
+            return true;
+        });
+    }
+
+    // Optional lossless recompression of today's frames before they are
+    // backed up. Best effort: if it fails the frames are simply left as they
+    // are, so it never holds up the backup.
+    std::string backup_after = "encode";
+    if (recompress_enabled) {
+        std::string command = "./programs/timelapse recompress --idle " + std::string(PICS_PATH) +
+                              filename_prefix + "_pics/";
+        graph.add_job("recompress", {"encode"}, [this, command]() {
+            log_status("Job 'recompress' running: " + command);
+            int result = std::system(command.c_str());
+            if (result == -1 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+                log_status("Warning: recompress failed for some frames - see logs/archive.log");
+            }
+            return true;
+        });
+        backup_after = "recompress";
+    }
+
+    // Optional Reed-Solomon parity for the final frames (after recompress,
+    // which changes them), so the day can be repaired on the card until the
+    // NAS copy is safe. Best effort, like recompress.
+    if (parity_shards > 0) {
+        std::string command = "./programs/timelapse parity --day " + filename_prefix + "_pics";
+        graph.add_job("parity", {backup_after}, [this, command]() {
+            log_status("Job 'parity' running: " + command);
+            int result = std::system(command.c_str());
+            if (result == -1 || !WIFEXITED(result) || WEXITSTATUS(result) != 0) {
+                log_status("Warning: parity failed for some frame groups - see logs/archive.log");
+            }
+            return true;
+        });
+        backup_after = "parity";
+    }
+
+    std::string manager = "python3 ./programs/manager.py --step ";
+    graph.add_command_job("backup", {backup_after}, manager + "backup " + today_iso,
+                          job_retries, job_retry_delay_seconds);
+    graph.add_command_job("upload", {"backup"}, manager + "upload " + today_iso,
+                          job_retries, job_retry_delay_seconds);
+    // Cleanup deletes backed-up videos, so it waits for the upload too
+    graph.add_command_job("cleanup", {"backup", "upload"},
+                          manager + "cleanup " + today_iso + " && python3 ./programs/disk_cleanup.py",
+                          job_retries, job_retry_delay_seconds);
+
+    job_graph = &graph;
+    write_status_file("waiting");
+    bool ok = graph.run();
+    write_status_file("finished");
+    job_graph = nullptr;
+    drain_backlog(backlog_deadline_epoch(), "");
+    report_stage_times();
+
+    log_status(ok ? "All jobs finished." : "Job graph finished with failed jobs - see " + state_file);
+    return ok;
+}
+
+// Logs the day's per-stage wall/CPU times and appends them to
+// logs/stage_times.csv (see stage_times.hpp)
+void TimeLapse::report_stage_times() {
+    log_status("Stage times (wall vs this thread's CPU):");
+    for (const std::string& line : format_stage_times()) {
+        log_status("  " + line);
+    }
+    std::string error;
+    if (!append_stage_times(STAGE_TIMES_FILE, "timelapse", error)) {
+        log_status("Warning: " + error);
+    }
+}
+
+// Public methods implementation
+void TimeLapse::run() {
+    if (job_graph_enabled) {
+        run_job_graph();
+        log_status("Automated timelapse thread finished.");
+        return;
+    }
+
+    capture_day();
+
     // Execute video creation immediately after capture finishes
     write_status_file("creating_video");
     create_video();
+    create_timeslice();
 
     write_status_file("finished");
+    drain_backlog(backlog_deadline_epoch(), "");
+    report_stage_times();
     log_status("Automated timelapse thread finished.");
 }
\ No newline at end of file
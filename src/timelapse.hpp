@@ -7,6 +7,16 @@
 #include <vector>
 #include <stdexcept>
 #include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "camera_backend.hpp"
+#include "capture_health.hpp"
+#include "encode_backlog.hpp"
+#include "frame_slo.hpp"
+#include "job_graph.hpp"
+#include "quality_controller.hpp"
+#include "frame_index.hpp"
 
 // --- Constants ---
 #define LOGS_PATH "logs/"
@@ -16,6 +26,9 @@
 
 // --- Constants ---
 #define STATUS_FILE "/tmp/timelapse_status.json"
+#define STAGE_TIMES_FILE LOGS_PATH "stage_times.csv"
+#define BACKLOG_FILE LOGS_PATH "encode_backlog.txt"
+#define CAPTURE_LATENCY_FILE LOGS_PATH "capture_latency.csv"
 
 // --- Class Definition ---
 class TimeLapse {
@@ -24,6 +37,13 @@ private:
     int photo_count;
     std::vector<std::string> photo_files;
 	std::string base_capture_command;
+	std::string capture_backend;
+	std::string v4l2_device;
+	std::string snapshot_url;
+	int network_timeout_ms;
+	int resolution_width;
+	int resolution_height;
+	std::unique_ptr<CameraBackend> camera;
 	std::string device_id;
 	std::string filename_prefix;
 	std::string schedule_filename;
@@ -35,29 +55,127 @@ private:
     std::string end_time;
     int interval_seconds;
     int expected_photos;
+    std::string today_iso;
+
+    // Job graph (replaces the cron chain when enabled)
+    bool job_graph_enabled;
+    int max_concurrent_jobs;
+    int job_retries;
+    int job_retry_delay_seconds;
+    std::string scheduler_command;
+    bool recompress_enabled;
+    int parity_shards;
+    bool day_prepared;
+    JobGraph* job_graph;
+
+    // Adaptive JPEG quality (tracks a daily byte budget)
+    bool adaptive_quality;
+    int jpeg_quality;
+    int min_jpeg_quality;
+    int max_jpeg_quality;
+    int quality_step;
+    int quality_adjust_every;
+    int target_frame_kb;
+    std::unique_ptr<QualityController> quality;
+
+    // Capture health: restart the camera when latency creeps up or
+    // captures start failing (see capture_health.hpp)
+    bool capture_health_enabled;
+    double health_cusum_threshold;
+    double health_error_threshold;
+    int health_cooldown_frames;
+    int camera_restart_idle_seconds;
+    std::string camera_restart_command;
+    std::unique_ptr<CaptureHealthMonitor> health;
+    bool camera_alarm_logged; // alarm with nothing to restart, already logged
+
+    // Frames-on-time SLO: share of slots with a valid frame within
+    // slo_deadline_ms of their time (see frame_slo.hpp)
+    double slo_target;
+    int slo_deadline_ms;
+    int slo_window_slots;
+    std::unique_ptr<FrameSlo> slo;
+
+    // Days without a video, encoded while the camera is idle (see
+    // encode_backlog.hpp)
+    bool backlog_enabled;
+    int backlog_days;
+    int backlog_max_attempts;
+    double backlog_max_temp_c;
+    int backlog_margin_minutes;
+    std::string backlog_deadline;
+    std::unique_ptr<EncodeBacklog> backlog;
+
+    // Re-solve the schedule's interval against past capture latency and
+    // encode speed (see schedule_plan.hpp)
+    bool plan_enabled;
+    std::vector<float> capture_latencies_ms; // today's successful captures
+
+    // Per-frame statistics in the day's frame_index.csv
+    bool frame_index_enabled;
+    FrameIndexer frame_indexer;
+    SkyRegion sky_region; // where cloud cover is measured
+
+    // Video encoding
+    std::string encoder;
+    std::string ffmpeg_command;
+    std::string x264_preset;
+    int x264_crf;
+    bool deflicker_enabled;
+    int deflicker_window;
+    std::string rate_control;
+    double target_video_mb;
+    int rate_zone_frames;
+    std::string render_mode;
+    int slitscan_depth;
+    std::string slitscan_axis;
+    int timeslice_slices;
+    int timeslice_quality;
 
     // Metrics tracking
     int capture_errors;
     double last_capture_duration_ms;
     bool last_capture_success;
     long last_capture_epoch;
+    double last_cloud_cover; // -1 = none yet, or too dark
+    std::mutex status_mutex;
 
     // Private utility methods
     std::string get_timestamp();
     void log_status(const std::string& message);
+    void set_filename_prefix();
     bool load_today_schedule();
+    void plan_today_schedule();
+    bool prepare_day();
+    void load_existing_photos();
 	bool load_config();
+	void open_camera_backend();
+	void restart_camera();
+    void report_stage_times();
+    void start_quality_controller();
+    void update_quality(const std::string& filename);
+    void index_frame(const std::string& filename);
     void write_status_file(const std::string& status);
 
     // Time conversion methods
     long time_to_seconds(const std::string& time_str);
     long get_current_day_seconds();
+    long start_epoch();
     bool is_time_to_start();
     bool is_time_to_stop();
 
     // Core capture/video methods
     bool capture_photo();
-    void create_video();
+    bool run_capture_command(const std::string& filename);
+    void capture_day();
+    bool create_video();
+    bool encode_video(const std::vector<std::string>& frames, const std::string& frames_dir,
+                      const std::string& video_path, long deadline_epoch, bool& stopped);
+    bool backlog_may_continue(long deadline_epoch);
+    long backlog_deadline_epoch();
+    void drain_backlog(long deadline_epoch, const std::string& skip_prefix);
+    void create_timeslice();
+    bool run_job_graph();
 
 public:
     // Constructor
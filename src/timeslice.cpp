@@ -0,0 +1,269 @@
+// timeslice.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sys/stat.h>
+
+#include "timeslice.hpp"
+#include "frame_index.hpp"
+#include "jpeg_error.hpp"
+#include "manifest.hpp"
+#include "timelapse.hpp"
+#include "utils.hpp"
+
+TimesliceBuilder::TimesliceBuilder(int slices, long start_epoch, long end_epoch)
+    : slices(std::max(1, slices)), start_epoch(start_epoch), end_epoch(std::max(start_epoch, end_epoch)),
+      next_slice(0), width(0), height(0) {}
+
+bool TimesliceBuilder::add(const std::string& path, long epoch, std::string& error) {
+    last_path = path;
+
+    // Last slice whose middle time this frame has reached
+    int last = next_slice - 1;
+    double span = static_cast<double>(end_epoch - start_epoch);
+    while (last + 1 < slices && start_epoch + (last + 1.5) * span / slices <= epoch) {
+        last++;
+    }
+    if (last < next_slice) {
+        return true;
+    }
+
+    if (!blit_slices(path, next_slice, last, error)) {
+        return false;
+    }
+    next_slice = last + 1;
+    return true;
+}
+
+// Decodes the columns of slices first..last from one frame into the composite
+bool TimesliceBuilder::blit_slices(const std::string& path, int first, int last, std::string& error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+    std::vector<uint8_t> row;
+
+    if (setjmp(err.jump)) {
+        error = path + ": " + err.message;
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    if (rgb.empty()) {
+        width = cinfo.output_width;
+        height = cinfo.output_height;
+        rgb.assign(static_cast<size_t>(width) * height * 3, 0);
+    } else if (static_cast<int>(cinfo.output_width) != width || static_cast<int>(cinfo.output_height) != height) {
+        error = path + ": size differs from the first frame";
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+
+    const int x0 = static_cast<int>(static_cast<int64_t>(first) * width / slices);
+    const int x1 = static_cast<int>(static_cast<int64_t>(last + 1) * width / slices);
+    JDIMENSION crop_x = x0;
+    JDIMENSION crop_width = x1 - x0;
+#ifdef LIBJPEG_TURBO_VERSION
+    // Widened to whole iMCUs; only those columns are reconstructed
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+#else
+    crop_x = 0;
+    crop_width = width;
+#endif
+
+    row.resize(static_cast<size_t>(cinfo.output_width) * 3);
+    const size_t skip = static_cast<size_t>(x0 - static_cast<int>(crop_x)) * 3;
+    const size_t bytes = static_cast<size_t>(x1 - x0) * 3;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        size_t y = cinfo.output_scanline;
+        JSAMPROW rows[1] = { row.data() };
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        memcpy(&rgb[(y * width + x0) * 3], row.data() + skip, bytes);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return true;
+}
+
+// Compresses an RGB image into a libjpeg-allocated buffer. The buffer
+// pointer and size belong to the caller: they change after setjmp, so they
+// must not be locals of this frame when libjpeg jumps back.
+static bool compress_rgb(const std::vector<uint8_t>& rgb, int width, int height, int quality,
+                         unsigned char** jpeg, unsigned long* jpeg_size, std::string& error) {
+    jpeg_compress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+
+    if (setjmp(err.jump)) {
+        error = err.message;
+        jpeg_destroy_compress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, jpeg, jpeg_size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.optimize_coding = TRUE;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW rows[1] = { const_cast<uint8_t*>(&rgb[static_cast<size_t>(cinfo.next_scanline) * width * 3]) };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+bool TimesliceBuilder::finish(const std::string& output, int quality, std::string& error) {
+    if (next_slice < slices && !last_path.empty() && blit_slices(last_path, next_slice, slices - 1, error)) {
+        next_slice = slices;
+    }
+    if (rgb.empty()) {
+        if (error.empty()) {
+            error = "no frames";
+        }
+        return false;
+    }
+
+    unsigned char* jpeg = nullptr;
+    unsigned long jpeg_size = 0;
+    std::string compress_error;
+    if (!compress_rgb(rgb, width, height, quality, &jpeg, &jpeg_size, compress_error)) {
+        error = output + ": " + compress_error;
+        free(jpeg);
+        return false;
+    }
+
+    bool ok = write_file_atomic(output, reinterpret_cast<const char*>(jpeg), jpeg_size);
+    free(jpeg);
+    if (!ok) {
+        error = "could not write " + output;
+    }
+    return ok;
+}
+
+bool build_timeslice(const std::string& day_dir, const std::vector<std::string>& frames, int slices, int quality,
+                     const std::string& output, std::string& error) {
+    if (frames.empty()) {
+        error = "no frames in " + day_dir;
+        return false;
+    }
+
+    // Capture times: the frame index, or the file time for frames it lacks
+    std::vector<FrameIndexEntry> index;
+    read_frame_index(day_dir, index);
+    std::map<std::string, long> indexed;
+    for (const FrameIndexEntry& entry : index) {
+        indexed[entry.name] = entry.epoch;
+    }
+
+    std::vector<long> epochs(frames.size(), 0);
+    for (size_t i = 0; i < frames.size(); i++) {
+        std::string name = frames[i].substr(frames[i].find_last_of('/') + 1);
+        auto it = indexed.find(name);
+        struct stat st;
+        if (it != indexed.end() && it->second > 0) {
+            epochs[i] = it->second;
+        } else if (stat(frames[i].c_str(), &st) == 0) {
+            epochs[i] = st.st_mtime;
+        }
+    }
+
+    auto range = std::minmax_element(epochs.begin(), epochs.end());
+    TimesliceBuilder builder(slices, *range.first, *range.second);
+    for (size_t i = 0; i < frames.size(); i++) {
+        // An unreadable frame leaves its slices to the next one
+        std::string frame_error;
+        builder.add(frames[i], epochs[i], frame_error);
+    }
+    return builder.finish(output, quality, error);
+}
+
+// --- Command line ---
+
+static void timeslice_usage() {
+    std::cerr << "Usage: timelapse timeslice [--slices N] [--quality Q] [-o OUTPUT.jpg] PICS_DAY_DIR\n";
+}
+
+int run_timeslice(int argc, char* argv[]) {
+    auto config = read_config(CONFIG_FILE);
+    int slices = std::stoi(config_value(config, "timeslice_slices", "0"));
+    int quality = std::stoi(config_value(config, "timeslice_quality", "90"));
+    std::string output;
+    std::string day_dir;
+
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--slices" && has_value) {
+            slices = std::stoi(argv[++i]);
+        } else if (arg == "--quality" && has_value) {
+            quality = std::stoi(argv[++i]);
+        } else if ((arg == "-o" || arg == "--output") && has_value) {
+            output = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-' && day_dir.empty()) {
+            day_dir = arg;
+        } else {
+            timeslice_usage();
+            return 2;
+        }
+    }
+    if (day_dir.empty() || quality < 1 || quality > 100) {
+        timeslice_usage();
+        return 2;
+    }
+    if (slices <= 0) {
+        slices = 12; // the daily run has them switched off; asking for one means a default
+    }
+
+    if (day_dir.back() != '/') {
+        day_dir += "/";
+    }
+    if (output.empty()) {
+        // pics/<prefix>_pics/ -> videos/<prefix>_timeslice.jpg, next to the video
+        std::string name = day_dir.substr(0, day_dir.size() - 1);
+        name = name.substr(name.find_last_of('/') + 1);
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, "_pics") == 0) {
+            name.resize(name.size() - 5);
+        }
+        output = std::string(VIDEOS_PATH) + name + "_timeslice.jpg";
+    }
+
+    std::vector<std::string> frames;
+    for (const std::string& name : list_frames(day_dir)) {
+        frames.push_back(day_dir + name);
+    }
+
+    std::string error;
+    if (!build_timeslice(day_dir, frames, slices, quality, output, error)) {
+        std::cerr << "Time-slice failed: " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Time-slice (" << slices << " slices from " << frames.size() << " frames) written to "
+              << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,60 @@
+// timeslice.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- Time-Slice Composites ---
+// One still made of N vertical slices, each from a different time of day:
+// dawn on the left, night on the right. Slice i is taken from the first frame
+// captured at or after the middle of its share of the day.
+//
+// The builder is streaming. Frames are offered in capture order, and each
+// frame only decodes the columns of the slices it fills. libjpeg-turbo's
+// jpeg_crop_scanline() skips the IDCT, upsampling and colour conversion for
+// every other column. Frames that fill no slice are never opened. Memory is
+// the output image plus one scanline.
+//
+// "timelapse timeslice" builds one for a day directory in a single pass over
+// its frames. Capture times come from the frame index (file times for frames
+// without an entry). The daily run does the same after capture when
+// timeslice_slices > 0.
+
+class TimesliceBuilder {
+public:
+    // Slices cover start_epoch..end_epoch evenly
+    TimesliceBuilder(int slices, long start_epoch, long end_epoch);
+
+    // Offers the frame captured at `epoch`. Decodes it only if a slice's
+    // time has come. False (with `error`) if it was needed but unreadable,
+    // or its size differs from the first frame's; those slices stay pending.
+    bool add(const std::string& path, long epoch, std::string& error);
+
+    // Slices not reached yet (capture ended early) come from the last frame
+    // offered; then the composite is written as a JPEG
+    bool finish(const std::string& output, int quality, std::string& error);
+
+    int filled_slices() const { return next_slice; }
+
+private:
+    int slices;
+    long start_epoch;
+    long end_epoch;
+    int next_slice;
+    std::string last_path;
+    int width;
+    int height;
+    std::vector<uint8_t> rgb; // the composite, width * height * 3
+
+    bool blit_slices(const std::string& path, int first, int last, std::string& error);
+};
+
+// Builds the composite for `frames` (capture order) in one pass. Returns
+// false if no slice could be filled.
+bool build_timeslice(const std::string& day_dir, const std::vector<std::string>& frames, int slices, int quality,
+                     const std::string& output, std::string& error);
+
+// Command line entry point: "timelapse timeslice ..."
+int run_timeslice(int argc, char* argv[]);
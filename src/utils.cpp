@@ -8,7 +8,19 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <vector>
 #include <sys/stat.h>
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 // Creates a directory. Returns true if successful or if it already exists.
 bool create_dir(const std::string& path) {
@@ -58,4 +70,260 @@ std::string get_cpu_temp() {
     }
 
     return "Temp Read Error";
-}
\ No newline at end of file
+}
+
+double cpu_temp_celsius() {
+    std::ifstream temp_file("/sys/class/thermal/thermal_zone0/temp");
+    int temp_milli = 0;
+    if (!(temp_file >> temp_milli)) {
+        return -1.0;
+    }
+    return temp_milli / 1000.0;
+}
+
+// Writes to "<path>.tmp" first and renames it into place once complete.
+bool write_file_atomic(const std::string& path, const char* data, size_t size, bool durable) {
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    out.write(data, size);
+    out.close();
+    if (!out) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    if (durable) {
+        int fd = open(tmp_path.c_str(), O_RDONLY);
+        bool synced = fd >= 0 && fsync(fd) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!synced) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error renaming " << tmp_path << ": " << strerror(errno) << std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void log_message(const std::string& logfile_path, const std::string& message) {
+    static std::mutex log_mutex;
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    auto time_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::stringstream ts;
+    ts << std::put_time(std::localtime(&time_t), "%Y%m%d_%H%M%S");
+
+    std::cout << "[" << ts.str() << "] " << message << std::endl;
+
+    std::ofstream logfile(logfile_path, std::ios::app);
+    if (logfile.is_open()) {
+        logfile << "[" << ts.str() << "] " << message << std::endl;
+    }
+}
+
+std::map<std::string, std::string> read_config(const std::string& path) {
+    std::map<std::string, std::string> config;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t equals_pos = line.find('=');
+        if (equals_pos == std::string::npos || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        std::string key = line.substr(0, equals_pos);
+        std::string value = line.substr(equals_pos + 1);
+
+        // Strip leading/trailing whitespace from key and value
+        key.erase(0, key.find_first_not_of(" \t\n\r"));
+        key.erase(key.find_last_not_of(" \t\n\r") + 1);
+        value.erase(0, value.find_first_not_of(" \t\n\r"));
+        value.erase(value.find_last_not_of(" \t\n\r") + 1);
+        config[key] = value;
+    }
+    return config;
+}
+
+std::string config_value(const std::map<std::string, std::string>& config, const std::string& key,
+                         const std::string& default_value) {
+    auto it = config.find(key);
+    if (it == config.end() || it->second.empty()) {
+        return default_value;
+    }
+    return it->second;
+}
+
+uint64_t hash_bytes(const char* data, size_t size, uint64_t seed) {
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string hash_to_hex(uint64_t hash) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return ss.str();
+}
+
+std::string hash_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return "";
+    }
+
+    std::vector<char> buffer(1 << 16);
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        hash = hash_bytes(buffer.data(), file.gcount(), hash);
+    }
+    if (file.bad()) {
+        return "";
+    }
+    return hash_to_hex(hash);
+}
+
+std::vector<std::string> list_dir(const std::string& path) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return names;
+    }
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::string with_slash(const std::string& dir) {
+    return (!dir.empty() && dir.back() == '/') ? dir : dir + "/";
+}
+
+std::string base_name(std::string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool file_exists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+std::vector<std::string> split_csv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool archive_log_stderr = false;
+
+void archive_log(const std::string& message) {
+    if (archive_log_stderr) {
+        std::cerr << message << std::endl;
+    } else {
+        log_message(ARCHIVE_LOG, message);
+    }
+}
+
+void set_archive_log_stderr(bool enabled) {
+    archive_log_stderr = enabled;
+}
+
+// glibc has no ioprio_set() wrapper; values from linux/ioprio.h
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+void set_idle_priority() {
+    if (setpriority(PRIO_PROCESS, 0, 19) != 0) {
+        std::cerr << "Could not lower CPU priority: " << strerror(errno) << std::endl;
+    }
+#ifdef SYS_ioprio_set
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        std::cerr << "Could not set idle I/O priority: " << strerror(errno) << std::endl;
+    }
+#endif
+}
+
+static double steady_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RateLimiter::RateLimiter(double bytes_per_second) : rate(bytes_per_second), next_free(0.0) {
+}
+
+void RateLimiter::consume(size_t bytes) {
+    if (rate <= 0.0) {
+        return;
+    }
+
+    double wait;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        double now = steady_seconds();
+        // Unused budget doesn't pile up beyond a short burst
+        next_free = std::max(next_free, now - 0.5);
+        next_free += bytes / rate;
+        wait = next_free - now;
+    }
+    if (wait > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
 
 bool create_dir(const std::string& path);
 
@@ -8,4 +13,72 @@ bool create_dir(const std::string& path);
 std::string format_duration(double seconds);
 
 // Reads CPU temp and returns a formatted string
-std::string get_cpu_temp();
\ No newline at end of file
+std::string get_cpu_temp();
+
+// CPU temperature in degrees Celsius, or -1 if it can't be read
+double cpu_temp_celsius();
+
+// Writes data to path via a temporary file + rename, so readers never see a partial file.
+// durable also fsyncs the data before the rename (for files that replace the only copy).
+bool write_file_atomic(const std::string& path, const char* data, size_t size, bool durable = false);
+
+// Prints "[timestamp] message" to stdout and appends it to logfile_path
+void log_message(const std::string& logfile_path, const std::string& message);
+
+// Reads every "key = value" line of an INI file (sections are ignored, like TimeLapse::load_config)
+std::map<std::string, std::string> read_config(const std::string& path);
+
+// Looks up key in config, falling back to default_value
+std::string config_value(const std::map<std::string, std::string>& config, const std::string& key,
+                         const std::string& default_value);
+
+// 64-bit FNV-1a content hash, as 16 hex digits
+uint64_t hash_bytes(const char* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+std::string hash_to_hex(uint64_t hash);
+
+// Hashes a whole file. Returns an empty string if it can't be read.
+std::string hash_file(const std::string& path);
+
+// Sorted names in a directory (no "." / ".."). Empty if it can't be read.
+std::vector<std::string> list_dir(const std::string& path);
+
+// "dir" -> "dir/" (unchanged if it already ends in a slash)
+std::string with_slash(const std::string& dir);
+
+// Last component of a path, ignoring trailing slashes ("pics/day/" -> "day")
+std::string base_name(std::string path);
+
+// True if something (file or directory) exists at path
+bool file_exists(const std::string& path);
+
+// Fields of a comma-separated line (no quoting)
+std::vector<std::string> split_csv(const std::string& line);
+
+// The whole buffer to/from fd, across short transfers and EINTR
+bool write_all(int fd, const void* data, size_t size);
+bool read_all(int fd, void* data, size_t size);
+
+// Archive jobs (recompress, scrub, parity, send-day/receive) log to
+// ARCHIVE_LOG. A command whose stdout carries data (send-day -o -) sends its
+// messages to stderr instead.
+#define ARCHIVE_LOG "logs/archive.log"
+void archive_log(const std::string& message);
+void set_archive_log_stderr(bool enabled);
+
+// Lowest CPU (nice 19) and I/O (idle class) priority for the calling
+// process, for background work that must never slow down a capture.
+void set_idle_priority();
+
+// Caps the rate of some work (bytes read/written) across threads: consume()
+// sleeps just long enough to keep the average under bytes_per_second.
+// A rate of 0 means unlimited.
+class RateLimiter {
+public:
+    explicit RateLimiter(double bytes_per_second);
+    void consume(size_t bytes);
+
+private:
+    double rate;
+    double next_free; // seconds on the steady clock when the budget is free again
+    std::mutex mutex;
+};
@@ -0,0 +1,319 @@
+// v4l2_camera.cpp
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <opencv2/opencv.hpp> // YUYV fallback encode
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "v4l2_camera.hpp"
+#include "utils.hpp"
+
+// Number of mmap buffers requested from the driver
+#define V4L2_BUFFER_COUNT 4
+
+// ioctl() that retries when interrupted by a signal
+static int xioctl(int fd, unsigned long request, void* arg) {
+    int r;
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r == -1 && errno == EINTR);
+    return r;
+}
+
+V4L2Camera::V4L2Camera(const std::string& device, int width, int height, int timeout_ms)
+    : device(device), width(width), height(height), fd(-1),
+      pixel_format(0), bytes_per_line(0), timeout_ms(timeout_ms), jpeg_quality(0),
+      quality_control(false), quality_min(1), quality_max(100) {
+}
+
+V4L2Camera::~V4L2Camera() {
+    close();
+}
+
+bool V4L2Camera::open() {
+    if (fd >= 0) {
+        return true;
+    }
+
+    fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+        std::cerr << "V4L2: could not open " << device << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(fd, VIDIOC_QUERYCAP, &cap) == -1) {
+        std::cerr << "V4L2: " << device << " is not a V4L2 device" << std::endl;
+        close();
+        return false;
+    }
+
+    unsigned int caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+        std::cerr << "V4L2: " << device << " does not support streaming capture" << std::endl;
+        close();
+        return false;
+    }
+
+    if (!set_format() || !start_streaming()) {
+        close();
+        return false;
+    }
+    query_quality_control();
+
+    if (jpeg_quality > 0) {
+        apply_quality();
+    }
+    return true;
+}
+
+// Whether (and in what range) the camera's MJPEG encoder takes a quality
+void V4L2Camera::query_quality_control() {
+    quality_control = false;
+    if (pixel_format != V4L2_PIX_FMT_MJPEG) {
+        return;
+    }
+
+    v4l2_queryctrl query;
+    memset(&query, 0, sizeof(query));
+    query.id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+    if (xioctl(fd, VIDIOC_QUERYCTRL, &query) == -1 || (query.flags & V4L2_CTRL_FLAG_DISABLED) ||
+        (query.flags & V4L2_CTRL_FLAG_READ_ONLY) || query.type != V4L2_CTRL_TYPE_INTEGER) {
+        return;
+    }
+    quality_control = true;
+    quality_min = query.minimum;
+    quality_max = query.maximum;
+}
+
+// The device has to be open to know whether it can take a quality at all,
+// so this opens it if it isn't yet.
+bool V4L2Camera::set_quality(int quality) {
+    jpeg_quality = quality;
+    if (!is_open() && !open()) {
+        return false;
+    }
+    return apply_quality();
+}
+
+// YUYV frames are encoded here, so any quality works. MJPEG is encoded by
+// the camera, and only some expose a JPEG quality control.
+bool V4L2Camera::apply_quality() {
+    if (pixel_format != V4L2_PIX_FMT_MJPEG) {
+        return true;
+    }
+    if (!quality_control) {
+        std::cerr << "V4L2: " << device << " has no JPEG quality control" << std::endl;
+        return false;
+    }
+
+    v4l2_control ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+    ctrl.id = V4L2_CID_JPEG_COMPRESSION_QUALITY;
+    ctrl.value = std::min(quality_max, std::max(quality_min, jpeg_quality));
+    if (xioctl(fd, VIDIOC_S_CTRL, &ctrl) == -1) {
+        std::cerr << "V4L2: could not set JPEG quality on " << device << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Prefer MJPEG so frames can be written as-is, otherwise take YUYV.
+bool V4L2Camera::set_format() {
+    const unsigned int formats[] = { V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_YUYV };
+
+    for (unsigned int wanted : formats) {
+        v4l2_format fmt;
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = width;
+        fmt.fmt.pix.height = height;
+        fmt.fmt.pix.pixelformat = wanted;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+
+        if (xioctl(fd, VIDIOC_S_FMT, &fmt) == -1) {
+            continue;
+        }
+
+        // The driver may substitute a format it likes better
+        if (fmt.fmt.pix.pixelformat != wanted) {
+            continue;
+        }
+
+        pixel_format = fmt.fmt.pix.pixelformat;
+        bytes_per_line = fmt.fmt.pix.bytesperline;
+        if (static_cast<int>(fmt.fmt.pix.width) != width || static_cast<int>(fmt.fmt.pix.height) != height) {
+            std::cerr << "V4L2: driver adjusted resolution to "
+                      << fmt.fmt.pix.width << "x" << fmt.fmt.pix.height << std::endl;
+            width = fmt.fmt.pix.width;
+            height = fmt.fmt.pix.height;
+        }
+        return true;
+    }
+
+    std::cerr << "V4L2: " << device << " supports neither MJPEG nor YUYV" << std::endl;
+    return false;
+}
+
+bool V4L2Camera::start_streaming() {
+    v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = V4L2_BUFFER_COUNT;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(fd, VIDIOC_REQBUFS, &req) == -1 || req.count < 2) {
+        std::cerr << "V4L2: could not allocate streaming buffers: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < req.count; i++) {
+        v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buf) == -1) {
+            std::cerr << "V4L2: VIDIOC_QUERYBUF failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+        if (start == MAP_FAILED) {
+            std::cerr << "V4L2: mmap failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        buffers.push_back({start, buf.length});
+
+        if (xioctl(fd, VIDIOC_QBUF, &buf) == -1) {
+            std::cerr << "V4L2: VIDIOC_QBUF failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_STREAMON, &type) == -1) {
+        std::cerr << "V4L2: VIDIOC_STREAMON failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void V4L2Camera::close() {
+    if (fd >= 0) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(fd, VIDIOC_STREAMOFF, &type);
+    }
+
+    for (const Buffer& b : buffers) {
+        munmap(b.start, b.length);
+    }
+    buffers.clear();
+
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+// Between triggers the driver keeps filling buffers, so whatever is queued
+// is stale (possibly minutes old). Hand everything back to the driver.
+void V4L2Camera::drain_queue() {
+    v4l2_buffer buf;
+    for (;;) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(fd, VIDIOC_DQBUF, &buf) == -1) {
+            break; // EAGAIN: queue is empty
+        }
+        xioctl(fd, VIDIOC_QBUF, &buf);
+    }
+}
+
+bool V4L2Camera::capture(const std::string& path, std::string& error) {
+    if (!is_open() && !open()) {
+        error = "could not open " + device;
+        return false;
+    }
+
+    drain_queue();
+
+    // Wait for the first frame exposed after the trigger
+    pollfd pfd = { fd, POLLIN, 0 };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while (ready == -1 && errno == EINTR);
+
+    if (ready == 0) {
+        error = "timed out after " + std::to_string(timeout_ms) + " ms waiting for a frame";
+        return false;
+    }
+
+    v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (ready < 0 || xioctl(fd, VIDIOC_DQBUF, &buf) == -1) {
+        // Usually ENODEV (unplugged) or EIO - reopen on the next trigger
+        error = std::string("VIDIOC_DQBUF failed: ") + strerror(errno);
+        close();
+        return false;
+    }
+
+    bool ok = write_frame(buffers[buf.index], buf.bytesused, path, error);
+
+    if (xioctl(fd, VIDIOC_QBUF, &buf) == -1) {
+        close();
+    }
+    return ok;
+}
+
+bool V4L2Camera::write_frame(const Buffer& buf, size_t bytes_used, const std::string& path, std::string& error) {
+    const unsigned char* data = static_cast<const unsigned char*>(buf.start);
+
+    if (pixel_format == V4L2_PIX_FMT_MJPEG) {
+        // Some cameras hand out truncated/empty frames while adjusting exposure.
+        // (Missing DHT segments are fine - libjpeg-turbo fills in the defaults.)
+        if (bytes_used < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+            error = "camera delivered an invalid MJPEG frame (" + std::to_string(bytes_used) + " bytes)";
+            return false;
+        }
+        if (!write_file_atomic(path, reinterpret_cast<const char*>(data), bytes_used)) {
+            error = "could not write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // YUYV: convert and encode in memory, then save like an MJPEG frame, so a
+    // crash mid-write never leaves a truncated photo under the final name
+    cv::Mat yuyv(height, width, CV_8UC2, const_cast<unsigned char*>(data), bytes_per_line);
+    cv::Mat bgr;
+    cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+    std::vector<int> params;
+    if (jpeg_quality > 0) {
+        params = { cv::IMWRITE_JPEG_QUALITY, jpeg_quality };
+    }
+    std::vector<unsigned char> jpeg;
+    if (!cv::imencode(".jpg", bgr, jpeg, params)) {
+        error = "cv::imencode failed for a " + std::to_string(width) + "x" + std::to_string(height) + " YUYV frame";
+        return false;
+    }
+    if (!write_file_atomic(path, reinterpret_cast<const char*>(jpeg.data()), jpeg.size())) {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
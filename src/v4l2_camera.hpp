@@ -0,0 +1,52 @@
+// v4l2_camera.hpp
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "camera_backend.hpp"
+
+// --- V4L2 Streaming Camera ---
+// Keeps a USB webcam open with mmap'd streaming buffers. MJPEG frames are
+// written straight to disk (no re-encode); cameras without MJPEG fall back
+// to YUYV, which is converted and encoded with OpenCV.
+class V4L2Camera : public CameraBackend {
+private:
+    struct Buffer {
+        void* start;
+        size_t length;
+    };
+
+    std::string device;
+    int width;
+    int height;
+    int fd;
+    unsigned int pixel_format;
+    unsigned int bytes_per_line;
+    int timeout_ms;
+    int jpeg_quality;
+    bool quality_control; // MJPEG camera with V4L2_CID_JPEG_COMPRESSION_QUALITY
+    int quality_min;
+    int quality_max;
+    std::vector<Buffer> buffers;
+
+    bool set_format();
+    void query_quality_control();
+    bool start_streaming();
+    bool apply_quality();
+    void drain_queue();
+    bool write_frame(const Buffer& buf, size_t bytes_used, const std::string& path, std::string& error);
+
+public:
+    V4L2Camera(const std::string& device, int width, int height, int timeout_ms = 2000);
+    ~V4L2Camera();
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override { return fd >= 0; }
+    bool capture(const std::string& path, std::string& error) override;
+    bool set_quality(int quality) override;
+    std::string name() const override { return "v4l2"; }
+};
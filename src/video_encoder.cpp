@@ -0,0 +1,77 @@
+// video_encoder.cpp
+
+#include <csignal>
+#include <cstdlib>
+#include <sys/wait.h>
+
+#include "video_encoder.hpp"
+
+YuvVideoWriter::YuvVideoWriter() : pipe(nullptr), width(0), height(0), bitrate_kbps(0) {
+}
+
+YuvVideoWriter::~YuvVideoWriter() {
+    close();
+}
+
+void YuvVideoWriter::set_rate_plan(int bitrate_kbps, const std::string& zones) {
+    this->bitrate_kbps = bitrate_kbps;
+    this->zones = zones;
+}
+
+bool ffmpeg_available(const std::string& ffmpeg_command) {
+    int status = system((ffmpeg_command + " -hide_banner -version > /dev/null 2>&1").c_str());
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool YuvVideoWriter::open(const std::string& output_file, int width, int height, int fps,
+                          const std::string& ffmpeg_command, const std::string& preset, int crf,
+                          std::string& error) {
+    close();
+
+    // If ffmpeg dies mid-video, fwrite should fail rather than kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    // JPEG planes are full range: yuvj420p in and out keeps them that way
+    // (x264 flags the stream as full range) instead of rescaling to 16-235.
+    std::string rate = " -crf " + std::to_string(crf);
+    if (bitrate_kbps > 0) {
+        rate = " -b:v " + std::to_string(bitrate_kbps) + "k";
+        if (!zones.empty()) {
+            rate += " -x264-params 'zones=" + zones + "'";
+        }
+    }
+
+    std::string command = ffmpeg_command +
+        " -y -loglevel error -f rawvideo -pix_fmt yuvj420p" +
+        " -s " + std::to_string(width) + "x" + std::to_string(height) +
+        " -r " + std::to_string(fps) + " -i -" +
+        " -c:v libx264 -preset " + preset + rate +
+        " -pix_fmt yuvj420p -movflags +faststart '" + output_file + "'";
+
+    pipe = popen(command.c_str(), "w");
+    if (pipe == nullptr) {
+        error = "could not start: " + command;
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    return true;
+}
+
+bool YuvVideoWriter::write(const YuvFrame& frame) {
+    if (pipe == nullptr || frame.width != width || frame.height != height) {
+        return false;
+    }
+    return fwrite(frame.y.data(), 1, frame.y.size(), pipe) == frame.y.size() &&
+           fwrite(frame.u.data(), 1, frame.u.size(), pipe) == frame.u.size() &&
+           fwrite(frame.v.data(), 1, frame.v.size(), pipe) == frame.v.size();
+}
+
+bool YuvVideoWriter::close() {
+    if (pipe == nullptr) {
+        return true;
+    }
+    int status = pclose(pipe);
+    pipe = nullptr;
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
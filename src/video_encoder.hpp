@@ -0,0 +1,43 @@
+// video_encoder.hpp
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "yuv_frame.hpp"
+
+// --- YUV Video Encoder ---
+// Pipes raw yuv420p frames into ffmpeg (libx264) - the frames go from the
+// JPEG decoder to the encoder without ever being converted to BGR.
+
+// True if ffmpeg_command runs (ffmpeg is installed)
+bool ffmpeg_available(const std::string& ffmpeg_command);
+
+class YuvVideoWriter {
+public:
+    YuvVideoWriter();
+    ~YuvVideoWriter();
+
+    // Encode at an average bitrate instead of the CRF given to open(), with
+    // optional x264 zones ("start,end,b=1.5/..."); call before open()
+    void set_rate_plan(int bitrate_kbps, const std::string& zones);
+
+    // Starts ffmpeg; every frame written afterwards must be width x height
+    bool open(const std::string& output_file, int width, int height, int fps,
+              const std::string& ffmpeg_command, const std::string& preset, int crf,
+              std::string& error);
+    bool write(const YuvFrame& frame);
+
+    // Waits for ffmpeg to finish the file; false if it failed
+    bool close();
+
+    bool is_open() const { return pipe != nullptr; }
+
+private:
+    FILE* pipe;
+    int width;
+    int height;
+    int bitrate_kbps; // 0 = CRF
+    std::string zones;
+};
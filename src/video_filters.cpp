@@ -0,0 +1,119 @@
+// video_filters.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "video_filters.hpp"
+#include "pixel_kernels.hpp"
+
+DeflickerFilter::DeflickerFilter(int window)
+    : alpha(1.0 / std::max(1, window)), average(0.0), gain(1.0), primed(false) {
+}
+
+void DeflickerFilter::apply(YuvFrame& frame) {
+    const PixelKernels& k = pixel_kernels();
+
+    // Mean luma from every 4th row - plenty for a global brightness figure
+    uint32_t hist[256];
+    memset(hist, 0, sizeof(hist));
+    for (int row = 0; row < frame.height; row += 4) {
+        k.histogram(&frame.y[static_cast<size_t>(row) * frame.width], frame.width, hist);
+    }
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    for (int v = 0; v < 256; v++) {
+        count += hist[v];
+        sum += static_cast<uint64_t>(hist[v]) * v;
+    }
+    double mean = count > 0 ? static_cast<double>(sum) / count : 0.0;
+
+    if (!primed) {
+        average = mean;
+        primed = true;
+    } else {
+        average += alpha * (mean - average);
+    }
+
+    // Black frames (night, lens cap) have nothing to correct
+    if (mean < 1.0) {
+        gain = 1.0;
+        return;
+    }
+    gain = std::min(2.0, std::max(0.5, average / mean));
+    if (std::fabs(gain - 1.0) < 0.002) {
+        return;
+    }
+
+    uint8_t lut[256];
+    for (int v = 0; v < 256; v++) {
+        long scaled = std::lround(v * gain);
+        lut[v] = static_cast<uint8_t>(std::min(255L, scaled));
+    }
+    k.apply_lut(frame.y.data(), frame.y.data(), frame.y.size(), lut);
+}
+
+SlitScanRenderer::SlitScanRenderer(int depth, SlitAxis axis)
+    : requested(std::max(1, depth)), axis(axis), slots(0), pushed(0), ready(0) {
+}
+
+// Copies luma band `band` of `in` (and the matching chroma) into `out`
+void SlitScanRenderer::copy_band(const YuvFrame& in, YuvFrame& out, int band) const {
+    const int b0 = bounds[band];
+    const int b1 = bounds[band + 1];
+    const int cw = in.chroma_width();
+
+    if (axis == SLIT_ROWS) {
+        // Rows are contiguous: one copy per plane
+        memcpy(&out.y[static_cast<size_t>(b0) * in.width], &in.y[static_cast<size_t>(b0) * in.width],
+               static_cast<size_t>(b1 - b0) * in.width);
+        memcpy(&out.u[static_cast<size_t>(b0 / 2) * cw], &in.u[static_cast<size_t>(b0 / 2) * cw],
+               static_cast<size_t>(b1 - b0) / 2 * cw);
+        memcpy(&out.v[static_cast<size_t>(b0 / 2) * cw], &in.v[static_cast<size_t>(b0 / 2) * cw],
+               static_cast<size_t>(b1 - b0) / 2 * cw);
+        return;
+    }
+
+    for (int row = 0; row < in.height; row++) {
+        size_t offset = static_cast<size_t>(row) * in.width + b0;
+        memcpy(&out.y[offset], &in.y[offset], b1 - b0);
+    }
+    for (int row = 0; row < in.chroma_height(); row++) {
+        size_t offset = static_cast<size_t>(row) * cw + b0 / 2;
+        memcpy(&out.u[offset], &in.u[offset], (b1 - b0) / 2);
+        memcpy(&out.v[offset], &in.v[offset], (b1 - b0) / 2);
+    }
+}
+
+int SlitScanRenderer::depth_for(int width, int height) const {
+    int extent = axis == SLIT_COLUMNS ? width : height;
+    return std::max(1, std::min(requested, extent / 2));
+}
+
+bool SlitScanRenderer::push(const YuvFrame& frame) {
+    if (slots == 0) {
+        int extent = axis == SLIT_COLUMNS ? frame.width : frame.height;
+        slots = depth_for(frame.width, frame.height);
+        bounds.resize(slots + 1);
+        for (int b = 0; b <= slots; b++) {
+            bounds[b] = static_cast<int>(static_cast<int64_t>(b) * extent / slots) & ~1;
+        }
+        bounds[slots] = extent;
+        ring.resize(slots);
+        for (YuvFrame& out : ring) {
+            out.resize(frame.width, frame.height);
+        }
+    }
+
+    // Input i supplies band b of output i - b
+    for (int band = 0; band < slots && band <= pushed; band++) {
+        copy_band(frame, ring[(pushed - band) % slots], band);
+    }
+    pushed++;
+    if (pushed < slots) {
+        return false;
+    }
+    ready = static_cast<int>((pushed - slots) % slots);
+    return true;
+}
@@ -0,0 +1,74 @@
+// video_filters.hpp
+
+#pragma once
+
+#include <vector>
+
+#include "yuv_frame.hpp"
+
+// --- Video Filters ---
+// Filters run on the YUV planes of each frame before it is encoded. Luma-only
+// filters touch just the Y plane: a third of the bytes of BGR (one byte per
+// pixel instead of three).
+
+// Deflicker: pulls each frame's mean brightness towards a running average of
+// the previous `window` frames, so exposure steps between shots (auto
+// exposure, passing clouds at long intervals) don't flash in the video.
+// Only the Y plane changes.
+class DeflickerFilter {
+public:
+    explicit DeflickerFilter(int window);
+
+    void apply(YuvFrame& frame);
+
+    // Gain applied to the last frame (1.0 = unchanged), for logging
+    double last_gain() const { return gain; }
+
+private:
+    double alpha;
+    double average;
+    double gain;
+    bool primed;
+};
+
+// Slit-scan (time displacement): output frame k takes band b of its columns
+// (or rows) from input frame k + b, so time runs across the picture. Band 0
+// shows the present and the far edge shows `depth - 1` frames later.
+//
+// Rather than keeping `depth` decoded inputs for random access, every input
+// is read once, front to back. Its bands are scattered into a ring of `depth`
+// output frames that are still being assembled, and input i completes output
+// i - depth + 1. Memory is `depth` frames. Each input row is copied as
+// `depth` contiguous runs (one per ring slot), so reads stay sequential.
+// A day of N frames renders N - depth + 1.
+enum SlitAxis { SLIT_COLUMNS, SLIT_ROWS };
+
+class SlitScanRenderer {
+public:
+    SlitScanRenderer(int depth, SlitAxis axis);
+
+    // Scatters `frame` into the ring. Returns true when an output frame is
+    // complete; output() holds it until the next push. The first frame fixes
+    // the size (the caller skips frames that differ, as for the encoder).
+    bool push(const YuvFrame& frame);
+
+    const YuvFrame& output() const { return ring[ready]; }
+
+    // Depth actually used: at most half the frame width (or height), so
+    // every band is at least two pixels and keeps whole chroma samples
+    int depth() const { return slots; }
+
+    // Depth that frames of this size will get, before any is pushed
+    int depth_for(int width, int height) const;
+
+private:
+    int requested;
+    SlitAxis axis;
+    int slots;
+    long pushed;
+    int ready;
+    std::vector<YuvFrame> ring;
+    std::vector<int> bounds; // luma band edges, even, slots + 1 of them
+
+    void copy_band(const YuvFrame& in, YuvFrame& out, int band) const;
+};
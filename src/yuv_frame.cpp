@@ -0,0 +1,339 @@
+// yuv_frame.cpp
+
+#include <cstring>
+
+#include "yuv_frame.hpp"
+#include "jpeg_error.hpp"
+
+
+void YuvFrame::resize(int w, int h) {
+    width = w;
+    height = h;
+    y.resize(static_cast<size_t>(w) * h);
+    u.resize(static_cast<size_t>(w / 2) * (h / 2));
+    v.resize(static_cast<size_t>(w / 2) * (h / 2));
+}
+
+// The row buffers below belong to decode_jpeg_yuv420, which calls setjmp:
+// a libjpeg error longjmps out of these functions, past the destructors of
+// anything they own.
+
+// Reads 4:2:0 JPEGs as raw planes, a stripe of 16 luma / 8 chroma rows at a
+// time. libjpeg pads each plane to whole 8x8 blocks, so stripes go through a
+// scratch buffer and only the visible part is copied.
+static void read_raw_420(jpeg_decompress_struct& cinfo, YuvFrame& frame, std::vector<uint8_t>& scratch) {
+    const int rows_per_pass = cinfo.max_v_samp_factor * DCTSIZE; // 16
+    const int y_stride = cinfo.comp_info[0].width_in_blocks * DCTSIZE;
+    const int c_stride = cinfo.comp_info[1].width_in_blocks * DCTSIZE;
+    const int cw = frame.chroma_width();
+    const int ch = frame.chroma_height();
+
+    scratch.resize(static_cast<size_t>(rows_per_pass) * y_stride + static_cast<size_t>(rows_per_pass) * c_stride);
+    uint8_t* y_buf = scratch.data();
+    uint8_t* u_buf = y_buf + static_cast<size_t>(rows_per_pass) * y_stride;
+    uint8_t* v_buf = u_buf + static_cast<size_t>(rows_per_pass / 2) * c_stride;
+
+    JSAMPROW y_rows[16], u_rows[8], v_rows[8];
+    for (int r = 0; r < rows_per_pass; r++) {
+        y_rows[r] = y_buf + static_cast<size_t>(r) * y_stride;
+    }
+    for (int r = 0; r < rows_per_pass / 2; r++) {
+        u_rows[r] = u_buf + static_cast<size_t>(r) * c_stride;
+        v_rows[r] = v_buf + static_cast<size_t>(r) * c_stride;
+    }
+    JSAMPARRAY planes[3] = { y_rows, u_rows, v_rows };
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        int row0 = cinfo.output_scanline;
+        jpeg_read_raw_data(&cinfo, planes, rows_per_pass);
+
+        for (int r = 0; r < rows_per_pass && row0 + r < frame.height; r++) {
+            memcpy(&frame.y[static_cast<size_t>(row0 + r) * frame.width], y_rows[r], frame.width);
+        }
+        for (int r = 0; r < rows_per_pass / 2 && row0 / 2 + r < ch; r++) {
+            size_t offset = static_cast<size_t>(row0 / 2 + r) * cw;
+            memcpy(&frame.u[offset], u_rows[r], cw);
+            memcpy(&frame.v[offset], v_rows[r], cw);
+        }
+    }
+}
+
+// Everything else: let libjpeg upsample to interleaved YCbCr (or grey), then
+// keep Y and average each 2x2 block of chroma.
+static void read_ycbcr_scanlines(jpeg_decompress_struct& cinfo, YuvFrame& frame, std::vector<uint8_t>& rows) {
+    const int components = cinfo.output_components; // 3, or 1 for greyscale
+    const size_t row_bytes = static_cast<size_t>(cinfo.output_width) * components;
+    rows.resize(row_bytes * 2);
+    JSAMPROW row_ptrs[2] = { rows.data(), rows.data() + row_bytes };
+
+    if (components == 1) {
+        memset(frame.u.data(), 128, frame.u.size());
+        memset(frame.v.data(), 128, frame.v.size());
+    }
+
+    for (int pair = 0; pair < frame.chroma_height(); pair++) {
+        for (int r = 0; r < 2; r++) {
+            jpeg_read_scanlines(&cinfo, &row_ptrs[r], 1);
+            uint8_t* y_out = &frame.y[static_cast<size_t>(pair * 2 + r) * frame.width];
+            const uint8_t* in = row_ptrs[r];
+            for (int x = 0; x < frame.width; x++) {
+                y_out[x] = in[x * components];
+            }
+        }
+        if (components != 3) {
+            continue;
+        }
+
+        uint8_t* u_out = &frame.u[static_cast<size_t>(pair) * frame.chroma_width()];
+        uint8_t* v_out = &frame.v[static_cast<size_t>(pair) * frame.chroma_width()];
+        const uint8_t* a = row_ptrs[0];
+        const uint8_t* b = row_ptrs[1];
+        for (int x = 0; x < frame.chroma_width(); x++) {
+            size_t i = static_cast<size_t>(x) * 6;
+            u_out[x] = static_cast<uint8_t>((a[i + 1] + a[i + 4] + b[i + 1] + b[i + 4] + 2) >> 2);
+            v_out[x] = static_cast<uint8_t>((a[i + 2] + a[i + 5] + b[i + 2] + b[i + 5] + 2) >> 2);
+        }
+    }
+
+    // Drain an odd last row so finish_decompress doesn't complain
+    while (cinfo.output_scanline < cinfo.output_height) {
+        jpeg_read_scanlines(&cinfo, row_ptrs, 1);
+    }
+}
+
+bool decode_jpeg_yuv420(const std::string& path, YuvFrame& frame, std::string& error, int scale_denom) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+    std::vector<uint8_t> rows; // outlives a longjmp from the readers
+
+    if (setjmp(err.jump)) {
+        error = path + ": " + err.message;
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+
+    // Scaled, libjpeg-turbo widens the chroma IDCT to upsample inside it, so
+    // the raw planes would no longer be 4:2:0: take the scanline path
+    bool raw_420 = scale_denom == 1 && cinfo.num_components == 3 &&
+                   cinfo.jpeg_color_space == JCS_YCbCr &&
+                   cinfo.comp_info[0].h_samp_factor == 2 && cinfo.comp_info[0].v_samp_factor == 2 &&
+                   cinfo.comp_info[1].h_samp_factor == 1 && cinfo.comp_info[1].v_samp_factor == 1 &&
+                   cinfo.comp_info[2].h_samp_factor == 1 && cinfo.comp_info[2].v_samp_factor == 1;
+
+    if (raw_420) {
+        cinfo.raw_data_out = TRUE;
+        cinfo.do_fancy_upsampling = FALSE;
+    } else if (cinfo.num_components == 1) {
+        cinfo.out_color_space = JCS_GRAYSCALE;
+    } else {
+        cinfo.out_color_space = JCS_YCbCr;
+        cinfo.do_fancy_upsampling = scale_denom == 1;
+    }
+
+    jpeg_start_decompress(&cinfo);
+
+    int width = cinfo.output_width & ~1;
+    int height = cinfo.output_height & ~1;
+    if (width == 0 || height == 0) {
+        error = path + ": image too small";
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+    frame.resize(width, height);
+
+    if (raw_420) {
+        read_raw_420(cinfo, frame, rows);
+    } else {
+        read_ycbcr_scanlines(cinfo, frame, rows);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return true;
+}
+
+// Reads the top-left width x height of the decoded BGR image into bgr
+static void read_bgr_scanlines(jpeg_decompress_struct& cinfo, int width, int height, uint8_t* bgr,
+                               std::vector<uint8_t>& rows) {
+    const size_t row_bytes = static_cast<size_t>(width) * 3;
+    rows.resize(static_cast<size_t>(cinfo.output_width) * 3);
+    JSAMPROW row = rows.data();
+    while (cinfo.output_scanline < cinfo.output_height) {
+        const int y = cinfo.output_scanline;
+        if (y < height && cinfo.output_width == static_cast<JDIMENSION>(width)) {
+            JSAMPROW out = bgr + y * row_bytes;
+            jpeg_read_scanlines(&cinfo, &out, 1);
+            continue;
+        }
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        if (y < height) {
+            memcpy(bgr + y * row_bytes, rows.data(), row_bytes);
+        }
+    }
+}
+
+bool decode_jpeg_bgr(const std::string& path, int width, int height, uint8_t* bgr, std::string& error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+    std::vector<uint8_t> rows; // outlives a longjmp from the reader
+
+    if (setjmp(err.jump)) {
+        error = path + ": " + err.message;
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_BGR;
+    jpeg_start_decompress(&cinfo);
+
+    if (static_cast<int>(cinfo.output_width & ~1) != width || static_cast<int>(cinfo.output_height & ~1) != height) {
+        error = path + ": size differs from " + std::to_string(width) + "x" + std::to_string(height);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+    read_bgr_scanlines(cinfo, width, height, bgr, rows);
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return true;
+}
+
+bool decode_jpeg_luma_scaled(const std::string& path, int scale_denom, LumaImage& image, std::string& error) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_error_init(&err);
+
+    if (setjmp(err.jump)) {
+        error = path + ": " + err.message;
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    image.width = cinfo.output_width;
+    image.height = cinfo.output_height;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &image.pixels[static_cast<size_t>(cinfo.output_scanline) * image.width];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return true;
+}
+
+// Same fixed-point constants libjpeg uses for its own YCbCr -> RGB
+struct ChromaTables {
+    int cr_r[256], cb_b[256], cr_g[256], cb_g[256];
+
+    ChromaTables() {
+        for (int i = 0; i < 256; i++) {
+            int c = i - 128;
+            cr_r[i] = (91881 * c + 32768) >> 16;   // 1.40200
+            cb_b[i] = (116130 * c + 32768) >> 16;  // 1.77200
+            cr_g[i] = -46802 * c;                  // 0.71414
+            cb_g[i] = -22554 * c + 32768;          // 0.34414
+        }
+    }
+};
+
+// One output row of libjpeg's h2v2 "fancy" upsampling (what cv::imread
+// gets): each pixel blends its four nearest chroma samples 9:3:3:1 instead
+// of repeating one sample over 2x2 pixels, which leaves blocky colour
+// edges. `near` is the chroma row above (even output rows) or below.
+static void upsample_chroma_row(const uint8_t* __restrict cur, const uint8_t* __restrict near, int cw,
+                                uint16_t* __restrict sum, uint8_t* __restrict out) {
+    for (int x = 0; x < cw; x++) {
+        sum[x] = static_cast<uint16_t>(3 * cur[x] + near[x]);
+    }
+    out[0] = static_cast<uint8_t>((4 * sum[0] + 8) >> 4);
+    for (int x = 1; x < cw; x++) {
+        out[2 * x] = static_cast<uint8_t>((3 * sum[x] + sum[x - 1] + 8) >> 4);
+    }
+    for (int x = 0; x + 1 < cw; x++) {
+        out[2 * x + 1] = static_cast<uint8_t>((3 * sum[x] + sum[x + 1] + 7) >> 4);
+    }
+    out[2 * cw - 1] = static_cast<uint8_t>((4 * sum[cw - 1] + 7) >> 4);
+}
+
+void yuv420_to_bgr(const YuvFrame& frame, uint8_t* bgr) {
+    static const ChromaTables t;
+
+    auto clamp = [](int value) -> uint8_t {
+        return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    };
+
+    const int cw = frame.chroma_width();
+    const int ch = frame.chroma_height();
+    std::vector<uint16_t> u_sum(cw), v_sum(cw);
+    std::vector<uint8_t> u_row(frame.width), v_row(frame.width);
+
+    for (int row = 0; row < frame.height; row++) {
+        const int c = row / 2;
+        const int near = row % 2 == 0 ? (c > 0 ? c - 1 : c) : (c + 1 < ch ? c + 1 : c);
+        upsample_chroma_row(&frame.u[static_cast<size_t>(c) * cw], &frame.u[static_cast<size_t>(near) * cw], cw,
+                            u_sum.data(), u_row.data());
+        upsample_chroma_row(&frame.v[static_cast<size_t>(c) * cw], &frame.v[static_cast<size_t>(near) * cw], cw,
+                            v_sum.data(), v_row.data());
+
+        const uint8_t* y = &frame.y[static_cast<size_t>(row) * frame.width];
+        uint8_t* out = bgr + static_cast<size_t>(row) * frame.width * 3;
+
+        for (int x = 0; x < frame.width; x++) {
+            int cb = u_row[x];
+            int cr = v_row[x];
+            int luma = y[x];
+            out[x * 3] = clamp(luma + t.cb_b[cb]);
+            out[x * 3 + 1] = clamp(luma + ((t.cb_g[cb] + t.cr_g[cr]) >> 16));
+            out[x * 3 + 2] = clamp(luma + t.cr_r[cr]);
+        }
+    }
+}
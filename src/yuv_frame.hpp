@@ -0,0 +1,63 @@
+// yuv_frame.hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --- YUV Frames ---
+// The render pipeline works on planar YUV 4:2:0 (I420) frames: JPEG already
+// stores Y/Cb/Cr, so decoding straight to planes skips the YCbCr -> BGR
+// conversion in cv::imread and the BGR -> YUV conversion in the encoder.
+// Values are full range (JFIF), not the 16-235 "TV" range.
+//
+// Width and height are always even (an odd last row/column is dropped) so
+// the chroma planes are exactly half size in each direction.
+
+struct YuvFrame {
+    int width;
+    int height;
+    std::vector<uint8_t> y; // width * height
+    std::vector<uint8_t> u; // (width / 2) * (height / 2), Cb
+    std::vector<uint8_t> v; // (width / 2) * (height / 2), Cr
+
+    YuvFrame() : width(0), height(0) {}
+
+    void resize(int w, int h);
+    int chroma_width() const { return width / 2; }
+    int chroma_height() const { return height / 2; }
+};
+
+// Decodes a JPEG into `frame` (buffers are reused between calls). 4:2:0
+// JPEGs (rpicam-still's default) are read as raw downsampled planes with no
+// colour conversion or upsampling at all; anything else (4:2:2 webcams,
+// greyscale) is decoded to YCbCr and the chroma is averaged down.
+// scale_denom 2, 4 or 8 decodes at that fraction of the size inside the IDCT
+// (tiles, previews); scaled frames always take the YCbCr path.
+bool decode_jpeg_yuv420(const std::string& path, YuvFrame& frame, std::string& error, int scale_denom = 1);
+
+// A single luma plane, e.g. a 1/8 scale thumbnail for frame statistics
+struct LumaImage {
+    int width;
+    int height;
+    std::vector<uint8_t> pixels; // width * height
+
+    LumaImage() : width(0), height(0) {}
+};
+
+// Decodes just the luma of a JPEG at 1/scale_denom size (1, 2, 4 or 8).
+// libjpeg scales inside the IDCT and skips the chroma IDCT and upsampling,
+// so 1/8 costs little more than the entropy decode. `image` is reused.
+bool decode_jpeg_luma_scaled(const std::string& path, int scale_denom, LumaImage& image, std::string& error);
+
+// Decodes a JPEG straight to BGR (cropped to width x height, the even size
+// decode_jpeg_yuv420 gives) with libjpeg-turbo's SIMD colour conversion and
+// smooth chroma upsampling - cv::imread's decode, for the OpenCV encoder when
+// no filter needs the YUV planes. False if the size differs.
+bool decode_jpeg_bgr(const std::string& path, int width, int height, uint8_t* bgr, std::string& error);
+
+// Full-range BT.601 conversion for stages that really need BGR (OpenCV's
+// VideoWriter), with the same smooth chroma upsampling libjpeg (and so
+// cv::imread) uses. `bgr` must hold width * height * 3 bytes.
+void yuv420_to_bgr(const YuvFrame& frame, uint8_t* bgr);